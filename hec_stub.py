@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+#
+# hec_stub.py
+#
+# A stand-in for a Splunk HTTP Event Collector to try LOGGING_CONFIGURATION=hec
+# against, e.g.
+#
+#   python3 hec_stub.py --port 8088 --token tok --busy 3
+#
+# with HEC_URL=http://127.0.0.1:8088 and HEC_TOKEN=tok. It takes gzip'ed
+# or plain batches on /services/collector/event, hands out ackIds when a
+# request channel is given and acknowledges a share of them per poll of
+# /services/collector/ack. Like the real collector it answers 400 (code 6)
+# to a batch that is not valid UTF-8 JSON, and 503 to the first --busy
+# posts. GET / returns the counters as JSON.
+#
+
+import argparse
+import gzip
+import json
+import random
+import threading
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+lock = threading.Lock()
+state = {"events": [], "ack": 0, "pending": {}, "posts": 0, "rejected": 0,
+         "conns": set(), "busy": 0}
+args = None
+
+
+class Collector(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, *a):
+        pass
+
+    def reply(self, code, obj, chunked=False):
+        body = json.dumps(obj).encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        if chunked:
+            # the ack responses come chunked, as from splunkd
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            half = len(body) // 2
+            for part in (body[:half], body[half:]):
+                self.wfile.write(b"%x\r\n%s\r\n" % (len(part), part))
+            self.wfile.write(b"0\r\n\r\n")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+    def do_POST(self):
+        data = self.rfile.read(int(self.headers["Content-Length"]))
+        if self.headers.get("Authorization") != "Splunk " + args.token:
+            return self.reply(401, {"text": "Invalid token", "code": 4})
+        with lock:
+            state["conns"].add(self.client_address)
+
+        if self.path.endswith("/services/collector/ack"):
+            with lock:
+                acks = {}
+                for i in json.loads(data)["acks"]:
+                    events = state["pending"].get(i)
+                    acked = events is not None and random.random() < args.ack_rate
+                    if acked:
+                        state["events"].extend(events)
+                        del state["pending"][i]
+                    acks[str(i)] = acked
+            return self.reply(200, {"acks": acks}, chunked=True)
+
+        with lock:
+            state["posts"] += 1
+            if state["busy"] > 0:
+                state["busy"] -= 1
+                return self.reply(503, {"text": "Server is busy", "code": 9})
+        if self.headers.get("Content-Encoding") == "gzip":
+            data = gzip.decompress(data)
+        try:
+            events = [json.loads(line) for line in data.decode("utf-8").splitlines() if line]
+        except ValueError:
+            with lock:
+                state["rejected"] += 1
+            return self.reply(400, {"text": "Invalid data format", "code": 6,
+                                    "invalid-event-number": 0})
+        if not events:
+            return self.reply(400, {"text": "No data", "code": 5})
+
+        with lock:
+            if self.headers.get("X-Splunk-Request-Channel"):
+                state["ack"] += 1
+                state["pending"][state["ack"]] = events
+                return self.reply(200, {"text": "Success", "code": 0, "ackId": state["ack"]})
+            state["events"].extend(events)
+        self.reply(200, {"text": "Success", "code": 0})
+
+    def do_GET(self):
+        with lock:
+            bodies = [json.dumps(e.get("event"), sort_keys=True) for e in state["events"]]
+            self.reply(200, {"events": len(bodies), "unique": len(set(bodies)),
+                             "posts": state["posts"], "rejected": state["rejected"],
+                             "unacknowledged": len(state["pending"]),
+                             "connections": len(state["conns"])})
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="stub HTTP Event Collector")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8088)
+    parser.add_argument("--token", default="tok")
+    parser.add_argument("--busy", type=int, default=0,
+                        help="answer the first N posts with 503")
+    parser.add_argument("--ack-rate", type=float, default=0.7,
+                        help="share of the pending ackIds acknowledged per poll")
+    args = parser.parse_args()
+    state["busy"] = args.busy
+    ThreadingHTTPServer((args.host, args.port), Collector).serve_forever()
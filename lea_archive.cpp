@@ -0,0 +1,391 @@
+/******************************************************************************/
+/* lea_archive - extracts records from a lea_loggrabber archive              */
+/******************************************************************************/
+/*                                                                            */
+/* An archive (LOGGING_CONFIGURATION=archive) is a log file made of           */
+/* independently compressed blocks, gzip members or zstd frames, and a block  */
+/* index <archive>.idx with one line per block:                               */
+/*                                                                            */
+/*   offset=<bytes>|length=<bytes>|fileid=<id>|loc=<min>-<max>|               */
+/*   time=<min>-<max>|records=<n>                                             */
+/*                                                                            */
+/* Only the blocks whose range overlaps the requested one are read and        */
+/* decompressed. A block without loc (-1) or time (0) is always read.         */
+/*                                                                            */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+
+#ifdef USE_ZLIB
+#	include <zlib.h>
+#endif
+#ifdef USE_ZSTD
+#	include <zstd.h>
+#endif
+
+#define TRUE			1
+#define FALSE			0
+
+using namespace std;
+
+typedef struct archive_range
+{
+    int fileid;			// -1 for any
+    long loc_from;		// -1 for any
+    long loc_to;
+    unsigned long time_from;	// 0 for any
+    unsigned long time_to;
+    char separator;
+} archive_range;
+
+typedef struct archive_entry
+{
+    long offset;
+    long length;
+    int fileid;
+    long loc_min;
+    long loc_max;
+    unsigned long time_min;
+    unsigned long time_max;
+} archive_entry;
+
+/*
+ * function usage
+ */
+void
+usage (const char *name)
+{
+    fprintf (stderr,
+             "Usage: %s [--loc <from>-<to>] [--time <from>-<to>] [--fileid <id>] [--separator <c>] <archive>\n",
+             name);
+    fprintf (stderr,
+             "  --loc <from>-<to>    : Extract the records with loc in the range\n"
+             "  --time <from>-<to>   : Extract the records with a unix time in the range\n"
+             "  --fileid <id>        : Extract the records of one logfile only\n"
+             "  --separator <c>      : Field separator of the records (default: |)\n");
+    exit (1);
+}
+
+/*
+ * function parse_range
+ */
+int
+parse_range (const char *arg, unsigned long *from, unsigned long *to)
+{
+    char *end;
+
+    *from = strtoul (arg, &end, 10);
+    if (*end == '\0')
+    {
+        *to = *from;
+        return TRUE;
+    }
+    if (*end != '-')
+    {
+        return FALSE;
+    }
+    *to = strtoul (end + 1, &end, 10);
+    return (*end == '\0') && (*from <= *to);
+}
+
+/*
+ * function record_field
+ *
+ * numeric value of name=<digits> in a record, -1 if it has none
+ */
+long
+record_field (const string& line, const char *name, char separator)
+{
+    size_t len = strlen (name);
+    size_t start = 0;
+    size_t end;
+    char *stop;
+    long value;
+
+    while (start < line.length())
+    {
+        end = line.find (separator, start);
+        if (end == string::npos)
+        {
+            end = line.length();
+        }
+        if ((end - start > len) && (line.compare (start, len, name) == 0) &&
+                (line[start + len] == '='))
+        {
+            value = strtol (line.c_str() + start + len + 1, &stop, 10);
+            return ((stop == line.c_str() + end) && (stop > line.c_str() + start + len + 1)) ?
+                   value : -1;
+        }
+        start = end + 1;
+    }
+    return -1;
+}
+
+/*
+ * function read_index
+ */
+int
+read_index (const char *path, vector<archive_entry> *entries)
+{
+    string index_path = string (path) + ".idx";
+    archive_entry entry;
+    char line[512];
+    FILE *index;
+
+    if ((index = fopen (index_path.c_str(), "r")) == NULL)
+    {
+        fprintf (stderr, "ERROR: Cannot open the archive index %s (%s)\n",
+                 index_path.c_str(), strerror (errno));
+        return FALSE;
+    }
+    while (fgets (line, sizeof line, index))
+    {
+        if (sscanf (line,
+                    "offset=%ld|length=%ld|fileid=%d|loc=%ld-%ld|time=%lu-%lu",
+                    &entry.offset, &entry.length, &entry.fileid, &entry.loc_min,
+                    &entry.loc_max, &entry.time_min, &entry.time_max) == 7)
+        {
+            entries->push_back (entry);
+        }
+    }
+    fclose (index);
+    return TRUE;
+}
+
+/*
+ * function block_selected
+ */
+int
+block_selected (const archive_entry& entry, const archive_range& range)
+{
+    if ((range.fileid >= 0) && (entry.fileid != range.fileid))
+    {
+        return FALSE;
+    }
+    if ((range.loc_from >= 0) && (entry.loc_min >= 0) &&
+            ((entry.loc_max < range.loc_from) || (entry.loc_min > range.loc_to)))
+    {
+        return FALSE;
+    }
+    if ((range.time_from > 0) && (entry.time_min > 0) &&
+            ((entry.time_max < range.time_from) || (entry.time_min > range.time_to)))
+    {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * function decompress_block
+ *
+ * the format is told by the magic bytes of the block
+ */
+int
+decompress_block (const vector<char>& in, string *out)
+{
+    const unsigned char *magic = (const unsigned char *) &in[0];
+
+    out->clear();
+    if ((in.size() > 2) && (magic[0] == 0x1f) && (magic[1] == 0x8b))
+    {
+#ifdef USE_ZLIB
+        z_stream strm;
+        char buffer[65536];
+        int ret;
+
+        memset (&strm, 0, sizeof strm);
+        if (inflateInit2 (&strm, 15 + 16) != Z_OK)
+        {
+            return FALSE;
+        }
+        strm.next_in = (Bytef *) & in[0];
+        strm.avail_in = in.size();
+        do
+        {
+            strm.next_out = (Bytef *) buffer;
+            strm.avail_out = sizeof buffer;
+            ret = inflate (&strm, Z_NO_FLUSH);
+            if ((ret != Z_OK) && (ret != Z_STREAM_END))
+            {
+                inflateEnd (&strm);
+                return FALSE;
+            }
+            out->append (buffer, sizeof buffer - strm.avail_out);
+        }
+        while (ret != Z_STREAM_END);
+        inflateEnd (&strm);
+        return TRUE;
+#else
+        fprintf (stderr, "ERROR: gzip is not available in this build\n");
+        return FALSE;
+#endif
+    }
+    if ((in.size() > 4) && (magic[0] == 0x28) && (magic[1] == 0xb5) &&
+            (magic[2] == 0x2f) && (magic[3] == 0xfd))
+    {
+#ifdef USE_ZSTD
+        unsigned long long size = ZSTD_getFrameContentSize (&in[0], in.size());
+        size_t len;
+
+        if ((size == ZSTD_CONTENTSIZE_UNKNOWN) || (size == ZSTD_CONTENTSIZE_ERROR))
+        {
+            return FALSE;
+        }
+        out->resize (size);
+        len = ZSTD_decompress (&(*out)[0], size, &in[0], in.size());
+        return !ZSTD_isError (len) && (len == size);
+#else
+        fprintf (stderr, "ERROR: zstd is not available in this build\n");
+        return FALSE;
+#endif
+    }
+    return FALSE;
+}
+
+/*
+ * function extract_block
+ *
+ * writes the records of a block that fall into the range to stdout
+ */
+long
+extract_block (const string& data, const archive_range& range)
+{
+    string line;
+    size_t start = 0;
+    size_t end;
+    long loc;
+    long t;
+    long records = 0;
+
+    while ((end = data.find ('\n', start)) != string::npos)
+    {
+        line = data.substr (start, end - start);
+        start = end + 1;
+        if (range.loc_from >= 0)
+        {
+            loc = record_field (line, "loc", range.separator);
+            if ((loc >= 0) && ((loc < range.loc_from) || (loc > range.loc_to)))
+            {
+                continue;
+            }
+        }
+        if (range.time_from > 0)
+        {
+            t = record_field (line, "time", range.separator);
+            if ((t >= 0) && (((unsigned long) t < range.time_from) ||
+                             ((unsigned long) t > range.time_to)))
+            {
+                continue;
+            }
+        }
+        fprintf (stdout, "%s\n", line.c_str());
+        records++;
+    }
+    return records;
+}
+
+int
+main (int argc, char *argv[])
+{
+    archive_range range;
+    vector<archive_entry> entries;
+    vector<char> block;
+    string data;
+    const char *path = NULL;
+    unsigned long from;
+    unsigned long to;
+    unsigned int i;
+    long blocks = 0;
+    long records = 0;
+    FILE *archive;
+    int k;
+
+    range.fileid = -1;
+    range.loc_from = -1;
+    range.loc_to = -1;
+    range.time_from = 0;
+    range.time_to = 0;
+    range.separator = '|';
+
+    for (k = 1; k < argc; k++)
+    {
+        if ((strcmp (argv[k], "--loc") == 0) && (k + 1 < argc))
+        {
+            if (!parse_range (argv[++k], &from, &to))
+            {
+                usage (argv[0]);
+            }
+            range.loc_from = from;
+            range.loc_to = to;
+        }
+        else if ((strcmp (argv[k], "--time") == 0) && (k + 1 < argc))
+        {
+            if (!parse_range (argv[++k], &from, &to) || (from == 0))
+            {
+                usage (argv[0]);
+            }
+            range.time_from = from;
+            range.time_to = to;
+        }
+        else if ((strcmp (argv[k], "--fileid") == 0) && (k + 1 < argc))
+        {
+            range.fileid = atoi (argv[++k]);
+        }
+        else if ((strcmp (argv[k], "--separator") == 0) && (k + 1 < argc))
+        {
+            range.separator = argv[++k][0];
+        }
+        else if ((argv[k][0] != '-') && (path == NULL))
+        {
+            path = argv[k];
+        }
+        else
+        {
+            usage (argv[0]);
+        }
+    }
+    if (path == NULL)
+    {
+        usage (argv[0]);
+    }
+
+    if (!read_index (path, &entries))
+    {
+        return 1;
+    }
+    if ((archive = fopen (path, "rb")) == NULL)
+    {
+        fprintf (stderr, "ERROR: Cannot open the archive %s (%s)\n", path,
+                 strerror (errno));
+        return 1;
+    }
+    for (i = 0; i < entries.size(); i++)
+    {
+        if (!block_selected (entries[i], range))
+        {
+            continue;
+        }
+        block.resize (entries[i].length);
+        if ((fseek (archive, entries[i].offset, SEEK_SET) != 0) ||
+                (fread (&block[0], 1, block.size(), archive) != block.size()) ||
+                !decompress_block (block, &data))
+        {
+            fprintf (stderr, "ERROR: Cannot read the block at offset %ld\n",
+                     entries[i].offset);
+            fclose (archive);
+            return 1;
+        }
+        records += extract_block (data, range);
+        blocks++;
+    }
+    fclose (archive);
+    fflush (stdout);
+    fprintf (stderr, "METRICS: archive_blocks=%lu|blocks_read=%ld|records=%ld\n",
+             (unsigned long) entries.size(), blocks, records);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/******************************************************************************/
+/* lea_bin2txt - converts LOGGING_CONFIGURATION=binary output back to the    */
+/* name=value text format of lea_loggrabber                                   */
+/******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string>
+#include "lea_binary.h"
+
+#define DATETIME_CP		0
+#define DATETIME_UNIX		1
+#define DATETIME_STD		2
+
+using namespace std;
+
+/*
+ * function usage
+ */
+void
+usage (const char *name)
+{
+    fprintf (stderr,
+             "Usage: %s [--separator <c>] [--dateformat cp|unix|std] [<file>]\n",
+             name);
+    fprintf (stderr,
+             "  --separator <c>      : Field separator (default: |)\n"
+             "  --dateformat <fmt>   : Format of the time field (default: std)\n"
+             "  <file>               : Binary output to convert (default: stdin)\n");
+    exit (1);
+}
+
+/*
+ * function append_escaped
+ *
+ * escapes the separator and backslashes like string_escape, newlines are
+ * masked like string_mask_newlines
+ */
+void
+append_escaped (string& out, const string& value, char separator)
+{
+    size_t i;
+
+    for (i = 0; i < value.length(); i++)
+    {
+        if (value[i] == '\n')
+        {
+            out += "(+)";
+            continue;
+        }
+        if ((value[i] == separator) || (value[i] == '\\'))
+        {
+            out.push_back ('\\');
+        }
+        out.push_back (value[i]);
+    }
+}
+
+/*
+ * function format_value
+ */
+string
+format_value (const leabin_field& field, int dateformat)
+{
+    char text[64];
+    time_t t;
+    struct tm *tm;
+
+    switch (field.type)
+    {
+    case LEABIN_IP:
+        snprintf (text, sizeof text, "%lu.%lu.%lu.%lu", (field.number >> 24) & 0xff,
+                  (field.number >> 16) & 0xff, (field.number >> 8) & 0xff,
+                  field.number & 0xff);
+        return text;
+    case LEABIN_TIME:
+        t = (time_t) field.number;
+        tm = localtime (&t);
+        if (dateformat == DATETIME_UNIX)
+        {
+            snprintf (text, sizeof text, "%lu", field.number);
+        }
+        else if (dateformat == DATETIME_CP)
+        {
+            // the Check Point notation, e.g. 3Jan2006 10:49:02
+            strftime (text, sizeof text, "%d%b%Y %H:%M:%S", tm);
+            return (text[0] == '0') ? text + 1 : text;
+        }
+        else
+        {
+            strftime (text, sizeof text, "%Y-%m-%d %H:%M:%S", tm);
+        }
+        return text;
+    case LEABIN_PORT:
+        snprintf (text, sizeof text, "%lu", field.number);
+        return text;
+    default:
+        return field.text;
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+    leabin_reader reader;
+    leabin_frame frame;
+    string line;
+    const char *name;
+    const char *path = NULL;
+    char loc[32];
+    char separator = '|';
+    int dateformat = DATETIME_STD;
+    FILE *in = stdin;
+    unsigned int i;
+    int ret;
+    int k;
+
+    for (k = 1; k < argc; k++)
+    {
+        if ((strcmp (argv[k], "--separator") == 0) && (k + 1 < argc))
+        {
+            separator = argv[++k][0];
+        }
+        else if ((strcmp (argv[k], "--dateformat") == 0) && (k + 1 < argc))
+        {
+            k++;
+            if (strcmp (argv[k], "cp") == 0)
+            {
+                dateformat = DATETIME_CP;
+            }
+            else if (strcmp (argv[k], "unix") == 0)
+            {
+                dateformat = DATETIME_UNIX;
+            }
+            else if (strcmp (argv[k], "std") == 0)
+            {
+                dateformat = DATETIME_STD;
+            }
+            else
+            {
+                usage (argv[0]);
+            }
+        }
+        else if ((argv[k][0] != '-') && (path == NULL))
+        {
+            path = argv[k];
+        }
+        else
+        {
+            usage (argv[0]);
+        }
+    }
+
+    if ((path != NULL) && ((in = fopen (path, "rb")) == NULL))
+    {
+        fprintf (stderr, "ERROR: Cannot open %s\n", path);
+        return 1;
+    }
+    if (!leabin_open (&reader, in))
+    {
+        fprintf (stderr, "ERROR: Not a lea_loggrabber binary stream\n");
+        return 1;
+    }
+
+    while ((ret = leabin_next (&reader, &frame)) > 0)
+    {
+        if (frame.kind == LEABIN_MESSAGE)
+        {
+            // formatted by lea_loggrabber already
+            fprintf (stdout, "%s\n", frame.text.c_str());
+            continue;
+        }
+        snprintf (loc, sizeof loc, "loc=%lu", frame.loc);
+        line = loc;
+        for (i = 0; i < frame.fields.size(); i++)
+        {
+            name = leabin_attr_name (&reader, frame.session, frame.fields[i].attr);
+            if (name == NULL)
+            {
+                continue;
+            }
+            line.push_back (separator);
+            append_escaped (line, name, separator);
+            line.push_back ('=');
+            append_escaped (line, format_value (frame.fields[i], dateformat),
+                            separator);
+        }
+        if (frame.sample_rate > 1)
+        {
+            snprintf (loc, sizeof loc, "%csample_rate=%lu", separator,
+                      frame.sample_rate);
+            line += loc;
+        }
+        fprintf (stdout, "%s\n", line.c_str());
+    }
+    if (ret < 0)
+    {
+        fprintf (stderr, "ERROR: Malformed binary stream\n");
+        return 1;
+    }
+    return 0;
+}
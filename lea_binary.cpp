@@ -0,0 +1,231 @@
+/******************************************************************************/
+/* lea_binary - decoder of the LOGGING_CONFIGURATION=binary framing, see     */
+/* lea_binary.h                                                               */
+/******************************************************************************/
+
+#include <string.h>
+#include "lea_binary.h"
+
+#define TRUE			1
+#define FALSE			0
+
+using namespace std;
+
+/*
+ * function leabin_varint
+ *
+ * reads an unsigned LEB128 value at *pos, FALSE if it runs past the end
+ */
+static int
+leabin_varint (const string& data, size_t *pos, unsigned long *value)
+{
+    int shift = 0;
+    unsigned char byte;
+
+    *value = 0;
+    do
+    {
+        if ((*pos >= data.length()) || (shift > 63))
+        {
+            return FALSE;
+        }
+        byte = (unsigned char) data[(*pos)++];
+        *value |= (unsigned long) (byte & 0x7f) << shift;
+        shift += 7;
+    }
+    while (byte & 0x80);
+    return TRUE;
+}
+
+/*
+ * function leabin_bytes
+ */
+static int
+leabin_bytes (const string& data, size_t *pos, string *value)
+{
+    unsigned long len;
+
+    if (!leabin_varint (data, pos, &len) || (len > data.length() - *pos))
+    {
+        return FALSE;
+    }
+    value->assign (data, *pos, len);
+    *pos += len;
+    return TRUE;
+}
+
+/*
+ * function leabin_read_frame
+ *
+ * 1 with the frame in reader->frame, 0 at a clean end of the stream
+ */
+static int
+leabin_read_frame (leabin_reader * reader)
+{
+    unsigned long len = 0;
+    int shift = 0;
+    int c;
+
+    do
+    {
+        if ((c = getc (reader->in)) == EOF)
+        {
+            return (shift == 0) ? 0 : -1;
+        }
+        if (shift > 63)
+        {
+            return -1;
+        }
+        len |= (unsigned long) (c & 0x7f) << shift;
+        shift += 7;
+    }
+    while (c & 0x80);
+
+    if (len == 0)
+    {
+        return -1;
+    }
+    reader->frame.resize (len);
+    if (fread (&(reader->frame[0]), 1, len, reader->in) != len)
+    {
+        return -1;
+    }
+    return 1;
+}
+
+/*
+ * function leabin_open
+ */
+int
+leabin_open (leabin_reader * reader, FILE * in)
+{
+    char magic[LEABIN_MAGIC_LEN];
+
+    reader->in = in;
+    reader->names.clear();
+    return (fread (magic, 1, LEABIN_MAGIC_LEN, in) == LEABIN_MAGIC_LEN) &&
+           (memcmp (magic, LEABIN_MAGIC, LEABIN_MAGIC_LEN) == 0);
+}
+
+/*
+ * function leabin_next
+ */
+int
+leabin_next (leabin_reader * reader, leabin_frame * frame)
+{
+    const string& data = reader->frame;
+    leabin_field field;
+    unsigned long count;
+    unsigned long attr;
+    unsigned long i;
+    string name;
+    size_t pos;
+    int ret;
+
+    while ((ret = leabin_read_frame (reader)) > 0)
+    {
+        pos = 1;
+        frame->kind = (unsigned char) data[0];
+        frame->fields.clear();
+        frame->text.clear();
+        switch (frame->kind)
+        {
+        case LEABIN_DICT:
+            if (!leabin_varint (data, &pos, &frame->session) ||
+                    !leabin_varint (data, &pos, &count))
+            {
+                return -1;
+            }
+            for (i = 0; i < count; i++)
+            {
+                if (!leabin_varint (data, &pos, &attr) ||
+                        !leabin_bytes (data, &pos, &name))
+                {
+                    return -1;
+                }
+                reader->names[frame->session][attr] = name;
+            }
+            break;
+
+        case LEABIN_MESSAGE:
+            return leabin_bytes (data, &pos, &frame->text) ? 1 : -1;
+
+        case LEABIN_RECORD:
+            if (!leabin_varint (data, &pos, &frame->session) ||
+                    !leabin_varint (data, &pos, &frame->loc) ||
+                    !leabin_varint (data, &pos, &frame->sample_rate) ||
+                    !leabin_varint (data, &pos, &count))
+            {
+                return -1;
+            }
+            for (i = 0; i < count; i++)
+            {
+                if (!leabin_varint (data, &pos, &field.attr) ||
+                        (pos >= data.length()))
+                {
+                    return -1;
+                }
+                field.type = (unsigned char) data[pos++];
+                field.number = 0;
+                field.text.clear();
+                switch (field.type)
+                {
+                case LEABIN_IP:
+                    if (pos + 4 > data.length())
+                    {
+                        return -1;
+                    }
+                    field.number = ((unsigned long) (unsigned char) data[pos] << 24) |
+                                   ((unsigned long) (unsigned char) data[pos + 1] << 16) |
+                                   ((unsigned long) (unsigned char) data[pos + 2] << 8) |
+                                   (unsigned long) (unsigned char) data[pos + 3];
+                    pos += 4;
+                    break;
+                case LEABIN_PORT:
+                case LEABIN_TIME:
+                    if (!leabin_varint (data, &pos, &field.number))
+                    {
+                        return -1;
+                    }
+                    break;
+                case LEABIN_STRING:
+                    if (!leabin_bytes (data, &pos, &field.text))
+                    {
+                        return -1;
+                    }
+                    break;
+                default:
+                    return -1;
+                }
+                frame->fields.push_back (field);
+            }
+            return 1;
+
+        default:
+            // a frame kind of a later version
+            break;
+        }
+    }
+    return ret;
+}
+
+/*
+ * function leabin_attr_name
+ *
+ * NULL if the session did not announce the attribute id
+ */
+const char *
+leabin_attr_name (leabin_reader * reader, unsigned long session,
+                  unsigned long attr)
+{
+    map<unsigned long, map<unsigned long, string> >::iterator s =
+        reader->names.find (session);
+    map<unsigned long, string>::iterator a;
+
+    if (s == reader->names.end())
+    {
+        return NULL;
+    }
+    a = s->second.find (attr);
+    return (a == s->second.end()) ? NULL : a->second.c_str();
+}
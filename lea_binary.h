@@ -0,0 +1,80 @@
+/******************************************************************************/
+/* lea_binary - record framing of LOGGING_CONFIGURATION=binary               */
+/******************************************************************************/
+/*                                                                            */
+/*   stream  := LEABIN_MAGIC frame*                                           */
+/*   frame   := varint length, u8 kind, body   (length counts kind and body) */
+/*                                                                            */
+/*   LEABIN_DICT     varint session, varint n, n * (varint attr, varint len,  */
+/*                   name)                                                    */
+/*   LEABIN_RECORD   varint session, varint loc, varint sample_rate,          */
+/*                   varint n, n * field                                      */
+/*   LEABIN_MESSAGE  varint len, text   (rollups and other formatted lines)  */
+/*                                                                            */
+/*   field   := varint attr, u8 type, value                                   */
+/*     LEABIN_IP      4 bytes, a.b.c.d in that order                          */
+/*     LEABIN_PORT    varint                                                  */
+/*     LEABIN_TIME    varint, seconds since the epoch                         */
+/*     LEABIN_STRING  varint len, bytes                                       */
+/*                                                                            */
+/* Varints are unsigned LEB128. Attribute ids are only valid within their     */
+/* session; a session announces its ids in a dictionary frame before the     */
+/* first record that uses them. Readers skip frames of unknown kinds.         */
+/*                                                                            */
+/******************************************************************************/
+
+#ifndef LEA_BINARY_H
+#define LEA_BINARY_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#define LEABIN_MAGIC		"LEABIN1\n"
+#define LEABIN_MAGIC_LEN	8
+
+#define LEABIN_DICT		'D'
+#define LEABIN_RECORD		'R'
+#define LEABIN_MESSAGE		'M'
+
+#define LEABIN_IP		1
+#define LEABIN_PORT		2
+#define LEABIN_TIME		3
+#define LEABIN_STRING		4
+
+typedef struct leabin_field
+{
+    unsigned long attr;
+    int type;
+    unsigned long number;		// LEABIN_IP (a << 24 | ...), PORT and TIME
+    std::string text;		// LEABIN_STRING
+} leabin_field;
+
+typedef struct leabin_frame
+{
+    int kind;			// LEABIN_RECORD or LEABIN_MESSAGE
+    unsigned long session;
+    unsigned long loc;
+    unsigned long sample_rate;
+    std::vector<leabin_field> fields;
+    std::string text;		// LEABIN_MESSAGE
+} leabin_frame;
+
+typedef struct leabin_reader
+{
+    FILE *in;
+    std::string frame;
+    std::map<unsigned long, std::map<unsigned long, std::string> > names;
+} leabin_reader;
+
+/*
+ * leabin_open checks the magic, leabin_next returns 1 with the next record
+ * or message frame, 0 at the end of the stream and -1 on a malformed
+ * stream. Dictionary frames are taken in by leabin_next.
+ */
+int leabin_open (leabin_reader *, FILE *);
+int leabin_next (leabin_reader *, leabin_frame *);
+const char *leabin_attr_name (leabin_reader *, unsigned long, unsigned long);
+
+#endif
@@ -80,65 +80,24 @@ static void addFilter(configvalues& cfgvalues, const char* filter)
     cfgvalues.fw1_filter_array[cfgvalues.fw1_filter_count - 1] = string_duplicate(filter);
 }
 
-static bool add_drop_vpn_rule(LeaFilterRulebase* rb)
+static void add_drop_vpn_rule(filter_program& program)
 {
-    LeaFilterRule* dropVpnRule;
-    if ((dropVpnRule = lea_filter_rule_create (LEA_FILTER_ACTION_DROP)) == NULL)
-    {
-        fprintf (stderr, "ERROR: failed to create drop vpn rule\n");
-        lea_filter_rulebase_destroy (rb);
-        return 0;
-    }
-
-    LeaFilterPredicate *dropVpnPred;
-    int negation = 0;
-    int argumentcount = 1;
-
-    lea_value_ex_t* pVal[1];
-    if ((pVal[0] = lea_value_ex_create())==NULL)
-    {
-        fprintf(stderr, "CreateRule2Pred: failed to create value\n");
-        return 0;
-    }
-
-    int res = lea_value_ex_set(pVal[0], LEA_VT_STRING, "VPN-1");
-    if (res!=OPSEC_SESSION_OK)
-    {
-        fprintf(stderr, "CreateRule2Pred: failed to set value\n");
-        lea_value_ex_destroy(pVal[0]);
-        return 0;
-    }
-
-    if ((dropVpnPred = lea_filter_predicate_create ("fw_subproduct", -1, negation,
-            LEA_FILTER_PRED_BELONGS_TO, argumentcount, pVal)) == NULL)
-    {
-        fprintf (stderr, "ERROR: failed to create drop vpn predicate\n");
-        lea_filter_rule_destroy (dropVpnRule);
-        lea_filter_rulebase_destroy (rb);
-        return 0;
-    }
-
-    if (lea_filter_rule_add_predicate(dropVpnRule, dropVpnPred)!=OPSEC_SESSION_OK)
-    {
-        fprintf(stderr, "Could not add dropVpnRule to dropVpnPred\n");
-        lea_filter_rule_destroy(dropVpnRule);
-        lea_filter_predicate_destroy(dropVpnPred);
-        return 0;
-    }
-
-    if (lea_filter_rulebase_add_rule(rb, dropVpnRule)!=OPSEC_SESSION_OK)
-    {
-        fprintf(stderr, "Could not add dropVpnRule to rulebase rulebase\n");
-        lea_filter_rulebase_destroy(rb);
-        lea_filter_rule_destroy(dropVpnRule);
-        return 0;
-    } else {
-        fprintf(stderr, "Added dropvpn rule successfully!\n");
-    }
-
-    lea_value_ex_destroy(pVal[0]);
-
-    return 1;
+    filter_rule dropVpnRule;
+    filter_pred dropVpnPred;
+    filter_value vpn;
+
+    vpn.type = LEA_VT_STRING;
+    vpn.num = 0;
+    vpn.str = "VPN-1";
+
+    dropVpnPred.attr = "fw_subproduct";
+    dropVpnPred.negation = 0;
+    dropVpnPred.op = LEA_FILTER_PRED_BELONGS_TO;
+    dropVpnPred.values.push_back(vpn);
+
+    dropVpnRule.action = LEA_FILTER_ACTION_DROP;
+    dropVpnRule.preds.push_back(dropVpnPred);
+    program.push_back(dropVpnRule);
 }
 
 bool launch_external_cmd(const string& command, string& result)
@@ -670,13 +629,13 @@ bool getStatus(const string& entity, const string& status_server,
 bool postEntityLogStatus(const string& entity, const string& status_server,
                          const string& log_status_endpoint,
                          const string& status_server_auth_token,
-                         lea_logdesc* logdesc, int last_rec_pos)
+                         int fileid, const string& filename, int last_rec_pos)
 {
     stringstream sstream;
     string response;
     string logGuid;
     unsigned int httpCode;
-    sstream << logdesc->fileid << "@" << entity.c_str();
+    sstream << fileid << "@" << entity.c_str();
     logGuid = sstream.str();
 
     //
@@ -691,8 +650,8 @@ bool postEntityLogStatus(const string& entity, const string& status_server,
     sstream.str( std::string() );
     sstream.clear();
     sstream << "$SPLUNK_HOME/bin/splunk _internal call " << log_status_endpoint.c_str()
-            << uri << " -post:name " << logGuid.c_str() << " -post:fileid " << logdesc->fileid
-            << " -post:filename " << logdesc->filename << " -post:last_rec_pos "  << last_rec_pos;
+            << uri << " -post:name " << logGuid.c_str() << " -post:fileid " << fileid
+            << " -post:filename " << filename.c_str() << " -post:last_rec_pos "  << last_rec_pos;
 
     if (!splunkd_internal_call(sstream.str(), response, httpCode))
     {
@@ -704,7 +663,7 @@ bool postEntityLogStatus(const string& entity, const string& status_server,
         fprintf(stderr,
                 "Log position posted from REST: entity=%s status-server=%s log_status_endpoint=%s logFileName=%s logFileId=%d last_rec_pos=%d\n",
                 entity.c_str(), status_server.c_str(), log_status_endpoint.c_str(),
-                logdesc->filename, logdesc->fileid, last_rec_pos);
+                filename.c_str(), fileid, last_rec_pos);
     }
     return true;
 }
@@ -759,82 +718,803 @@ bool postEntityHealthStatus(const string& entity, const string& status_server,
 }
 
 /*
- * main function
+ * function current_time_ms
+ */
+long
+current_time_ms ()
+{
+#ifdef WIN32
+    return (long) GetTickCount ();
+#else
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec * 1000L) + (tv.tv_usec / 1000L);
+#endif
+}
+
+/*
+ * function metrics_emit
+ */
+void
+metrics_emit (const string& line)
+{
+    fprintf (stderr, "METRICS: %s\n", line.c_str());
+}
+
+/*
+ * function checkpoint_init
+ */
+void
+checkpoint_init (PSESSION_CONTEXT pContext, int start_pos)
+{
+    pContext->checkpoint.last_commit_pos = start_pos;
+    pContext->checkpoint.last_seen_pos = start_pos;
+    pContext->checkpoint.records_since_commit = 0;
+    pContext->checkpoint.last_commit_time = time (NULL);
+    pContext->checkpoint.backoff = 1;
+    pContext->checkpoint.journal_fd = -1;
+    pContext->checkpoint.journal_unsynced = 0;
+    pContext->checkpoint.journal_last_sync = time (NULL);
+    pContext->checkpoint.journal_path = "";
+    pContext->checkpoint.resume_pos = start_pos;
+    if (pContext->config_entity.length() > 0)
+    {
+        pContext->checkpoint.journal_path =
+            checkpoint_journal_path (pContext->config_entity, pContext->fileid);
+    }
+}
+
+/*
+ * function checkpoint_record
+ *
+ * called for every record after it has been handed to the sink. Commits
+ * once splunkRestStatusCommit records or splunkRestStatusCommitInterval
+ * seconds (both scaled by the current backoff) have passed.
+ */
+void
+checkpoint_record (PSESSION_CONTEXT pContext, int pos)
+{
+    checkpoint_state *cp = &(pContext->checkpoint);
+
+    if (pos > cp->last_seen_pos)
+    {
+        cp->last_seen_pos = pos;
+    }
+    cp->records_since_commit++;
+
+    if ((cfgvalues.splunkRestStatusCommit > 0) &&
+            (cp->records_since_commit >=
+             cfgvalues.splunkRestStatusCommit * cp->backoff))
+    {
+        checkpoint_commit (pContext);
+    }
+    else if ((cfgvalues.splunkRestStatusCommitInterval > 0) &&
+             (time (NULL) - cp->last_commit_time >=
+              cfgvalues.splunkRestStatusCommitInterval * cp->backoff))
+    {
+        checkpoint_commit (pContext);
+    }
+}
+
+/*
+ * function checkpoint_commit
+ *
+ * flushes the sink and appends the watermark it reports, i.e. the last
+ * position that is durably written, to the local journal. Posting to the
+ * status server is left to the sync thread.
+ * The commit latency is used to adapt the cadence: when committing takes
+ * more than a tenth of the commit interval the cadence is halved (up to
+ * splunkRestStatusCommitMaxBackoff), when it is fast again it recovers.
  */
 int
-main (int argc, char *argv[])
+checkpoint_commit (PSESSION_CONTEXT pContext)
 {
-    int i;
-    int lfield_order_index;
-    int afield_order_index;
-    short amatch;
-    short lmatch;
-    int field_index;
-    stringlist *lstptr;
-    char *foundstring;
-    char *field;
-    char *fieldstring = NULL;
-    string entity;
+    checkpoint_state *cp = &(pContext->checkpoint);
+    lea_logdesc *logdesc = NULL;
+    long started;
+    long latency;
+    long budget;
+    int pos;
+    int ret;
 
-    /*
-     * initialize field arrays
-     */
-    initialize_lfield_headers (lfield_headers);
-    initialize_afield_headers (afield_headers);
-    initialize_lfield_output (lfield_output);
-    initialize_afield_output (afield_output);
-    initialize_lfield_order (lfield_order);
-    initialize_afield_order (afield_order);
-    initialize_lfield_values (lfields);
-    initialize_afield_values (afields);
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function checkpoint_commit\n");
+    }
 
-    /* The default settings are shown as follows:
-     * FW1_TYPE = NG release
-     * Offline mode
-     * Database is off
-     * Print off log records
-     */
+    cp->records_since_commit = 0;
+    cp->last_commit_time = time (NULL);
+
+    if ((pContext->config_entity.length() == 0) ||
+            (cp->last_seen_pos <= cp->last_commit_pos))
+    {
+        return TRUE;
+    }
+
+    started = current_time_ms ();
+    pos = flush_log ();
+    if (pos == FLUSH_FAILED)
+    {
+        fprintf (stderr, "ERROR: Cannot flush output, checkpoint not committed\n");
+        ret = FALSE;
+    }
+    else if (pos <= cp->last_commit_pos)
+    {
+        ret = TRUE;
+    }
+    else if ((ret = checkpoint_journal_append (cp, pos)))
+    {
+        cp->last_commit_pos = pos;
+    }
 
     /*
-     * process command line arguments
+     * a backfill range is not a position of the whole logfile, it is only
+     * kept in the local journal
      */
-    for (i = 1; i < argc; i++)
+    if (ret && (pos == cp->last_commit_pos) && (backfill.index < 0))
     {
-        if (strcmp (argv[i], "--help") == 0)
+        logdesc = lea_get_logfile_desc (pContext->session);
+    }
+    if (logdesc)
+    {
+        checkpoint_sync_post (pContext->config_entity, logdesc->fileid,
+                              logdesc->filename, pos);
+    }
+    else if (ret && cfgvalues.debug_mode)
+    {
+        fprintf (stderr,
+                 "ERROR: Received error when trying to obtain log file descriptor: function call lea_get_logfile_desc\n");
+    }
+    latency = current_time_ms () - started;
+
+    budget = (cfgvalues.splunkRestStatusCommitInterval > 0) ?
+             cfgvalues.splunkRestStatusCommitInterval * 1000L : 30000L;
+    if ((latency * 10 > budget) || !ret)
+    {
+        if (cp->backoff < cfgvalues.splunkRestStatusCommitMaxBackoff)
         {
-            usage (argv[0]);
-            exit_loggrabber (1);
+            cp->backoff *= 2;
         }
-        else if (strcmp (argv[i], "--help-fields") == 0)
+    }
+    else if ((latency * 40 < budget) && (cp->backoff > 1))
+    {
+        cp->backoff /= 2;
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr,
+                 "DEBUG: checkpoint at position %d (%s, %ld ms, backoff %d)\n",
+                 pos, (ret ? "committed" : "failed"), latency, cp->backoff);
+    }
+    return ret;
+}
+
+/*
+ * function checkpoint_close
+ */
+void
+checkpoint_close (PSESSION_CONTEXT pContext)
+{
+    checkpoint_state *cp = &(pContext->checkpoint);
+
+    if (cp->journal_fd >= 0)
+    {
+        checkpoint_journal_sync (cp, TRUE);
+        close (cp->journal_fd);
+        cp->journal_fd = -1;
+    }
+}
+
+/*
+ * function entity_file_name
+ *
+ * the entity name with everything but [A-Za-z0-9.-] replaced by '_'
+ */
+static string
+entity_file_name (const string& entity)
+{
+    string name = entity;
+    unsigned int i;
+
+    for (i = 0; i < name.length(); i++)
+    {
+        if (!(isalnum (name[i]) || (name[i] == '-') || (name[i] == '.')))
         {
-            show_supported_fields ();
-            exit_loggrabber (1);
+            name[i] = '_';
         }
-        else if (strcmp (argv[i], "--resolve") == 0)
+    }
+    return name;
+}
+
+/*
+ * function checkpoint_file_prefix
+ *
+ * <CHECKPOINT_DIR>/<entity>, the base of all state kept for an entity
+ */
+string
+checkpoint_file_prefix (const string& entity)
+{
+    string dir = cfgvalues.checkpoint_dir;
+
+    if (dir.length() == 0)
+    {
+        char *tempdir = getenv ("LOGGRABBER_TEMP_PATH");
+        dir = (tempdir != NULL) ? tempdir : ".";
+    }
+    return dir + "/" + entity_file_name (entity);
+}
+
+/*
+ * function ssl_session_path
+ *
+ * <SSL_SESSION_DIR>/<entity>, where OPSEC keeps the SSL session cache
+ * (sslsess.C) and the authentication keys of the entity. Created on demand,
+ * empty if it cannot be.
+ */
+string
+ssl_session_path (const string& entity)
+{
+    string path = cfgvalues.ssl_session_dir + "/" + entity_file_name (entity);
+
+    if (((mkdir (cfgvalues.ssl_session_dir.c_str(), 0700) < 0) &&
+            (errno != EEXIST)) ||
+            ((mkdir (path.c_str(), 0700) < 0) && (errno != EEXIST)))
+    {
+        fprintf (stderr, "ERROR: Cannot create SSL session directory %s (%s)\n",
+                 path.c_str(), strerror (errno));
+        return "";
+    }
+    return path;
+}
+
+/*
+ * function checkpoint_journal_path
+ *
+ * <CHECKPOINT_DIR>/<entity>_<fileid>.ckpt, CHECKPOINT_DIR defaults to
+ * $LOGGRABBER_TEMP_PATH or the current working directory
+ */
+string
+checkpoint_journal_path (const string& entity, int fileid)
+{
+    stringstream sstream;
+
+    sstream << checkpoint_file_prefix (entity) << "_" << fileid;
+    if (backfill.index >= 0)
+    {
+        sstream << ".part" << backfill.index << "of" << backfill.count;
+    }
+    sstream << ".ckpt";
+    return sstream.str();
+}
+
+/*
+ * function checkpoint_journal_read
+ *
+ * returns the highest position recorded in the journal, -1 if there is
+ * none. Lines are "pos=<n>|time=<t>"; a torn last line is ignored.
+ */
+int
+checkpoint_journal_read (const string& entity, int fileid)
+{
+    return checkpoint_journal_scan (checkpoint_journal_path (entity, fileid));
+}
+
+/*
+ * function checkpoint_journal_scan
+ *
+ * the highest position in the journal at path, -1 if there is none
+ */
+int
+checkpoint_journal_scan (const string& path)
+{
+    FILE *journal;
+    char line[256];
+    int last_rec_pos = -1;
+    int pos;
+
+    if ((journal = fopen (path.c_str(), "r")) == NULL)
+    {
+        return -1;
+    }
+    while (fgets (line, sizeof line, journal))
+    {
+        if (strchr (line, '\n') == NULL)
         {
-            resolve_mode = 1;
+            break;
         }
-        else if ((strcmp (argv[i], "--noresolve") == 0)
-                 || (strcmp (argv[i], "--no-resolve") == 0))
+        if ((sscanf (line, "pos=%d", &pos) == 1) && (pos > last_rec_pos))
         {
-            resolve_mode = 0;
+            last_rec_pos = pos;
         }
-        else if (strcmp (argv[i], "--debug-level") == 0)
+    }
+    fclose (journal);
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: checkpoint journal %s: last position %d\n",
+                 path.c_str(), last_rec_pos);
+    }
+    return last_rec_pos;
+}
+
+/*
+ * function checkpoint_resume_pos
+ *
+ * position to resume reading a log file from: the newest of the journal,
+ * the watermark recovered by the sink, the status server once the sync
+ * thread has fetched it and, when reconnecting, whatever was already handed
+ * to the sink by this process. -1 if none is known.
+ */
+int
+checkpoint_resume_pos (const string& entity, int fileid)
+{
+    map<int, int>::iterator it;
+    int last_rec_pos = checkpoint_journal_read (entity, fileid);
+
+    it = watermark.resume.find (fileid);
+    if ((it != watermark.resume.end()) && (it->second > last_rec_pos))
+    {
+        last_rec_pos = it->second;
+    }
+    if ((watermark.fileid == fileid) && (watermark.submitted_pos > last_rec_pos))
+    {
+        last_rec_pos = watermark.submitted_pos;
+    }
+    if (checkpoint_sync_remote (fileid) > last_rec_pos)
+    {
+        last_rec_pos = checkpoint_sync_remote (fileid);
+    }
+    return last_rec_pos;
+}
+
+/*
+ * function sync_directory_of
+ *
+ * fsyncs the directory of path, so that a file created or renamed in it
+ * survives a crash
+ */
+int
+sync_directory_of (const string& path)
+{
+    size_t slash = path.rfind ('/');
+    string dir = (slash == string::npos) ? "." :
+                 (slash == 0) ? "/" : path.substr (0, slash);
+    int fd;
+    int ret;
+
+    if ((fd = open (dir.c_str(), O_RDONLY)) < 0)
+    {
+        return FALSE;
+    }
+    ret = (fsync (fd) == 0);
+    close (fd);
+    return ret;
+}
+
+/*
+ * function checkpoint_journal_append
+ *
+ * appends a position to the journal and fsyncs every
+ * checkpoint_fsync_batch appends or once a second. Once the journal grows
+ * beyond 64k it is compacted into a single line with the highest position.
+ * Another context of the same logfile, e.g. the catch-up one, may have
+ * compacted it in the meantime, then it is opened again.
+ */
+int
+checkpoint_journal_append (checkpoint_state *cp, int pos)
+{
+    char line[64];
+    struct stat st;
+    struct stat current;
+    int len;
+    int last;
+
+    if (cp->journal_path.length() == 0)
+    {
+        return FALSE;
+    }
+
+    if ((cp->journal_fd >= 0) &&
+            ((stat (cp->journal_path.c_str(), &current) != 0) ||
+             (fstat (cp->journal_fd, &st) != 0) ||
+             (current.st_ino != st.st_ino) || (current.st_dev != st.st_dev)))
+    {
+        checkpoint_journal_sync (cp, TRUE);
+        close (cp->journal_fd);
+        cp->journal_fd = -1;
+    }
+    if (cp->journal_fd < 0)
+    {
+        cp->journal_fd = open (cp->journal_path.c_str(),
+                               O_WRONLY | O_APPEND | O_CREAT, 0600);
+        if (cp->journal_fd < 0)
         {
-            i++;
-            if (argv[i] == NULL)
-            {
-                fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i - 1]);
-                usage (argv[0]);
-                exit_loggrabber (1);
-            }
-            if (argv[i][0] == '-')
-            {
-                fprintf (stderr, "ERROR: Value expected for argument %s\n",
-                         argv[i - 1]);
-                usage (argv[0]);
-                exit_loggrabber (1);
-            }
+            fprintf (stderr, "ERROR: Cannot open checkpoint journal %s (%s)\n",
+                     cp->journal_path.c_str(), strerror (errno));
+            return FALSE;
+        }
+    }
+
+    len = snprintf (line, sizeof line, "pos=%d|time=%ld\n", pos,
+                    (long) time (NULL));
+
+    if ((fstat (cp->journal_fd, &st) == 0) && (st.st_size > 65536))
+    {
+        string tmppath = cp->journal_path + ".tmp";
+        int fd = open (tmppath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        char compacted[64];
+        int clen;
+
+        checkpoint_journal_sync (cp, TRUE);
+        last = checkpoint_journal_scan (cp->journal_path);
+        clen = snprintf (compacted, sizeof compacted, "pos=%d|time=%ld\n",
+                         (last > pos) ? last : pos, (long) time (NULL));
+        if ((fd >= 0) && (write (fd, compacted, clen) == clen) && (fsync (fd) == 0) &&
+                (rename (tmppath.c_str(), cp->journal_path.c_str()) == 0))
+        {
+            sync_directory_of (cp->journal_path);
+            close (fd);
+            close (cp->journal_fd);
+            cp->journal_fd = open (cp->journal_path.c_str(),
+                                   O_WRONLY | O_APPEND | O_CREAT, 0600);
+            cp->journal_unsynced = 0;
+            cp->journal_last_sync = time (NULL);
+            return TRUE;
+        }
+        if (fd >= 0)
+        {
+            close (fd);
+        }
+    }
+
+    if (write (cp->journal_fd, line, len) != len)
+    {
+        fprintf (stderr, "ERROR: Cannot write checkpoint journal %s (%s)\n",
+                 cp->journal_path.c_str(), strerror (errno));
+        return FALSE;
+    }
+    cp->journal_unsynced++;
+    checkpoint_journal_sync (cp, FALSE);
+    return TRUE;
+}
+
+/*
+ * function checkpoint_journal_sync
+ */
+void
+checkpoint_journal_sync (checkpoint_state *cp, int force)
+{
+    if ((cp->journal_fd < 0) || (cp->journal_unsynced == 0))
+    {
+        return;
+    }
+    if (force || (cp->journal_unsynced >= cfgvalues.checkpoint_fsync_batch) ||
+            (time (NULL) > cp->journal_last_sync))
+    {
+        fsync (cp->journal_fd);
+        cp->journal_unsynced = 0;
+        cp->journal_last_sync = time (NULL);
+    }
+}
+
+/*
+ * function checkpoint_sync_post
+ *
+ * queues a position for the sync thread, starting the thread on first use.
+ * Only the newest position per fileid is kept.
+ */
+void
+checkpoint_sync_post (const string& entity, int fileid, const char *filename,
+                      int pos)
+{
+    checkpoint_pending pending;
+
+    checkpoint_sync_start (entity);
+    if (!checkpoint_sync.running)
+    {
+        return;
+    }
+
+    pending.fileid = fileid;
+    pending.filename = (filename != NULL) ? filename : "";
+    pending.pos = pos;
+
+    pthread_mutex_lock (&checkpoint_sync.lock);
+    checkpoint_sync.pending[fileid] = pending;
+    checkpoint_sync.established = established;
+    pthread_cond_signal (&checkpoint_sync.wakeup);
+    pthread_mutex_unlock (&checkpoint_sync.lock);
+}
+
+/*
+ * function checkpoint_sync_start
+ *
+ * starts the sync thread unless it is running
+ */
+void
+checkpoint_sync_start (const string& entity)
+{
+    if (checkpoint_sync.running)
+    {
+        return;
+    }
+    pthread_mutex_init (&checkpoint_sync.lock, NULL);
+    pthread_cond_init (&checkpoint_sync.wakeup, NULL);
+    checkpoint_sync.stop = FALSE;
+    checkpoint_sync.entity = entity;
+    checkpoint_sync.pending.clear();
+    checkpoint_sync.fetch.clear();
+    checkpoint_sync.remote.clear();
+    checkpoint_sync.established = established;
+    if (pthread_create (&checkpoint_sync.thread, NULL,
+                        checkpoint_sync_thread, NULL) != 0)
+    {
+        fprintf (stderr, "ERROR: Cannot start checkpoint sync thread\n");
+        return;
+    }
+    checkpoint_sync.running = TRUE;
+}
+
+/*
+ * function checkpoint_sync_fetch
+ *
+ * asks the sync thread for the position the status server has for fileid,
+ * so that starting from the local journal needs no round trip to splunkd
+ */
+void
+checkpoint_sync_fetch (const string& entity, int fileid)
+{
+    checkpoint_sync_start (entity);
+    if (!checkpoint_sync.running)
+    {
+        return;
+    }
+    pthread_mutex_lock (&checkpoint_sync.lock);
+    checkpoint_sync.fetch.push_back (fileid);
+    pthread_cond_signal (&checkpoint_sync.wakeup);
+    pthread_mutex_unlock (&checkpoint_sync.lock);
+}
+
+/*
+ * function checkpoint_sync_remote
+ *
+ * the position the status server had for fileid, -1 if it is not known
+ * (yet)
+ */
+int
+checkpoint_sync_remote (int fileid)
+{
+    map<int, int>::iterator it;
+    int pos = -1;
+
+    if (!checkpoint_sync.running)
+    {
+        return -1;
+    }
+    pthread_mutex_lock (&checkpoint_sync.lock);
+    if ((it = checkpoint_sync.remote.find (fileid)) != checkpoint_sync.remote.end())
+    {
+        pos = it->second;
+    }
+    pthread_mutex_unlock (&checkpoint_sync.lock);
+    return pos;
+}
+
+/*
+ * function checkpoint_sync_thread
+ *
+ * fetches the positions of the status server that were asked for, then
+ * posts queued positions and the entity health to it, retrying with the
+ * splunkRestMaxRetries/splunkRestRetryFactor policy. A position behind the
+ * one the server has is not posted, it would move the server back.
+ */
+void *
+checkpoint_sync_thread (void *arg)
+{
+    map<int, checkpoint_pending> batch;
+    map<int, checkpoint_pending>::iterator it;
+    map<int, int>::iterator remote;
+    vector<int> fetch;
+    unsigned int k;
+    int stop = FALSE;
+    int health;
+    int pos;
+
+    while (!stop)
+    {
+        pthread_mutex_lock (&checkpoint_sync.lock);
+        while (checkpoint_sync.pending.empty() && checkpoint_sync.fetch.empty() &&
+                !checkpoint_sync.stop)
+        {
+            pthread_cond_wait (&checkpoint_sync.wakeup, &checkpoint_sync.lock);
+        }
+        batch.swap (checkpoint_sync.pending);
+        fetch.swap (checkpoint_sync.fetch);
+        health = checkpoint_sync.established;
+        stop = checkpoint_sync.stop;
+        pthread_mutex_unlock (&checkpoint_sync.lock);
+
+        for (k = 0; k < fetch.size(); k++)
+        {
+            pos = -1;
+            if (!getStatus(checkpoint_sync.entity, cfgvalues.status_server,
+                           cfgvalues.log_status_endpoint,
+                           cfgvalues.status_server_auth_token, fetch[k], pos))
+            {
+                fprintf (stderr,
+                         "WARNING: unable to get progress from the status server, resuming from the local journal\n");
+                continue;
+            }
+            if (cfgvalues.debug_mode)
+            {
+                fprintf (stderr, "DEBUG: status server position of %d: %d\n",
+                         fetch[k], pos);
+            }
+            pthread_mutex_lock (&checkpoint_sync.lock);
+            checkpoint_sync.remote[fetch[k]] = pos;
+            pthread_mutex_unlock (&checkpoint_sync.lock);
+        }
+        fetch.clear();
+
+        for (it = batch.begin(); it != batch.end(); it++)
+        {
+            int retryWait = 1;
+
+            pthread_mutex_lock (&checkpoint_sync.lock);
+            remote = checkpoint_sync.remote.find (it->first);
+            pos = (remote != checkpoint_sync.remote.end()) ? remote->second : -1;
+            pthread_mutex_unlock (&checkpoint_sync.lock);
+            if (it->second.pos < pos)
+            {
+                continue;
+            }
+            for (int i = 0; i < cfgvalues.splunkRestMaxRetries; i++)
+            {
+                if (postEntityLogStatus(checkpoint_sync.entity, cfgvalues.status_server,
+                                        cfgvalues.log_status_endpoint,
+                                        cfgvalues.status_server_auth_token,
+                                        it->second.fileid, it->second.filename,
+                                        it->second.pos))
+                {
+                    break;
+                }
+                sleep(retryWait);
+                retryWait = retryWait*cfgvalues.splunkRestRetryFactor;
+            }
+        }
+        if (!batch.empty())
+        {
+            postEntityHealthStatus(checkpoint_sync.entity, cfgvalues.status_server,
+                                   cfgvalues.entity_health_endpoint,
+                                   cfgvalues.status_server_auth_token, health);
+        }
+        batch.clear();
+    }
+    return NULL;
+}
+
+/*
+ * function checkpoint_sync_stop
+ *
+ * drains the queue and stops the sync thread
+ */
+void
+checkpoint_sync_stop ()
+{
+    if (!checkpoint_sync.running)
+    {
+        return;
+    }
+    pthread_mutex_lock (&checkpoint_sync.lock);
+    checkpoint_sync.stop = TRUE;
+    pthread_cond_signal (&checkpoint_sync.wakeup);
+    pthread_mutex_unlock (&checkpoint_sync.lock);
+    pthread_join (checkpoint_sync.thread, NULL);
+    checkpoint_sync.running = FALSE;
+}
+
+/*
+ * function checkpoint_timer
+ *
+ * scheduled once per second in the opsec mainloop so that the time based
+ * cadence also fires when no records arrive.
+ */
+void
+checkpoint_timer (void *opaque)
+{
+    PSESSION_CONTEXT pContext = (PSESSION_CONTEXT) opaque;
+    checkpoint_state *cp = &(pContext->checkpoint);
+
+    checkpoint_journal_sync (cp, FALSE);
+    if ((cfgvalues.splunkRestStatusCommitInterval > 0) &&
+            (cp->last_seen_pos > cp->last_commit_pos) &&
+            (time (NULL) - cp->last_commit_time >=
+             cfgvalues.splunkRestStatusCommitInterval * cp->backoff))
+    {
+        checkpoint_commit (pContext);
+    }
+    opsec_schedule (pContext->env, 1000, checkpoint_timer, pContext);
+}
+
+/*
+ * main function
+ */
+int
+main (int argc, char *argv[])
+{
+    int i;
+    int lfield_order_index;
+    int afield_order_index;
+    short amatch;
+    short lmatch;
+    int field_index;
+    vector<int> selected;
+    unsigned int k;
+    char *logfile;
+    char *field;
+    char *fieldstring = NULL;
+    string entity;
+
+    /*
+     * initialize field arrays
+     */
+    initialize_lfield_headers (lfield_headers);
+    initialize_afield_headers (afield_headers);
+    initialize_lfield_output (lfield_output);
+    initialize_afield_output (afield_output);
+    initialize_lfield_order (lfield_order);
+    initialize_afield_order (afield_order);
+    initialize_lfield_values (lfields);
+    initialize_afield_values (afields);
+
+    /* The default settings are shown as follows:
+     * FW1_TYPE = NG release
+     * Offline mode
+     * Database is off
+     * Print off log records
+     */
+
+    /*
+     * process command line arguments
+     */
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp (argv[i], "--help") == 0)
+        {
+            usage (argv[0]);
+            exit_loggrabber (1);
+        }
+        else if (strcmp (argv[i], "--help-fields") == 0)
+        {
+            show_supported_fields ();
+            exit_loggrabber (1);
+        }
+        else if (strcmp (argv[i], "--resolve") == 0)
+        {
+            resolve_mode = 1;
+        }
+        else if ((strcmp (argv[i], "--noresolve") == 0)
+                 || (strcmp (argv[i], "--no-resolve") == 0))
+        {
+            resolve_mode = 0;
+        }
+        else if (strcmp (argv[i], "--debug-level") == 0)
+        {
+            i++;
+            if (argv[i] == NULL)
+            {
+                fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            if (argv[i][0] == '-')
+            {
+                fprintf (stderr, "ERROR: Value expected for argument %s\n",
+                         argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
             debug_mode = atoi (argv[i]);
         }
         else if (strcmp (argv[i], "--showfiles") == 0)
@@ -1033,7 +1713,29 @@ main (int argc, char *argv[])
             }
             filterarray[filtercount - 1] = string_duplicate (argv[i]);
         }
-        else if (strcmp (argv[i], "--fields") == 0)
+        else if (strcmp (argv[i], "--post-filter") == 0)
+        {
+            i++;
+            if (argv[i] == NULL)
+            {
+                fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            post_filter_args.push_back (argv[i]);
+        }
+        else if (strcmp (argv[i], "--sample") == 0)
+        {
+            i++;
+            if (argv[i] == NULL)
+            {
+                fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            sample_arg = argv[i];
+        }
+        else if (strcmp (argv[i], "--aggregate") == 0)
         {
             i++;
             if (argv[i] == NULL)
@@ -1049,40 +1751,132 @@ main (int argc, char *argv[])
                 usage (argv[0]);
                 exit_loggrabber (1);
             }
-            fieldstring = string_duplicate (argv[i]);
+            aggregate_window = atoi (argv[i]);
         }
-        else
+        else if (strcmp (argv[i], "--dedup") == 0)
         {
-            fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i]);
-            usage (argv[0]);
-            exit_loggrabber (1);
+            i++;
+            if (argv[i] == NULL)
+            {
+                fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            if (argv[i][0] == '-')
+            {
+                fprintf (stderr, "ERROR: Value expected for argument %s\n",
+                         argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            dedup_window = atoi (argv[i]);
         }
-    }
-
-
-    /*
-     * check configuration files
-     */
-    check_loggrabber_config (cfgvalues.config_filename);
-    if (cfgvalues.app_name.length() == 0)
-    {
-        check_lea_config (cfgvalues.leaconfig_filename);
-    }
-
-    /*
-     * load configuration file
-     */
-    read_config_file (cfgvalues.config_filename, &cfgvalues);
-
-    // construct endpoints
-    string endpoint_prefix = "/servicesNS/nobody/";
-    string config_endpoint_postfix = "/opsec/opsec_conf/";
-    string log_status_endpoint_postfix = "/opsec/log_status/";
-    string entity_health_endpoint_postfix = "/opsec/entity_health/";
-    //construct config endpoint
-    cfgvalues.config_endpoint = endpoint_prefix;
-    cfgvalues.config_endpoint += cfgvalues.app_name;
-    cfgvalues.config_endpoint += config_endpoint_postfix;
+        else if (strcmp (argv[i], "--backfill") == 0)
+        {
+            i++;
+            if (argv[i] == NULL)
+            {
+                fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            if (argv[i][0] == '-')
+            {
+                fprintf (stderr, "ERROR: Value expected for argument %s\n",
+                         argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            backfill_partitions = atoi (argv[i]);
+        }
+        else if (strcmp (argv[i], "--backfill-split") == 0)
+        {
+            backfill_split = 1;
+        }
+        else if (strcmp (argv[i], "--catchup") == 0)
+        {
+            catchup_mode = 1;
+        }
+        else if (strcmp (argv[i], "--no-catchup") == 0)
+        {
+            catchup_mode = 0;
+        }
+        else if ((strcmp (argv[i], "--start-time") == 0)
+                 || (strcmp (argv[i], "--end-time") == 0))
+        {
+            i++;
+            if (argv[i] == NULL)
+            {
+                fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            if (argv[i][0] == '-')
+            {
+                fprintf (stderr, "ERROR: Value expected for argument %s\n",
+                         argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            if (strcmp (argv[i - 1], "--start-time") == 0)
+            {
+                start_time_arg = argv[i];
+            }
+            else
+            {
+                end_time_arg = argv[i];
+            }
+        }
+        else if (strcmp (argv[i], "--fields") == 0)
+        {
+            i++;
+            if (argv[i] == NULL)
+            {
+                fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            if (argv[i][0] == '-')
+            {
+                fprintf (stderr, "ERROR: Value expected for argument %s\n",
+                         argv[i - 1]);
+                usage (argv[0]);
+                exit_loggrabber (1);
+            }
+            fieldstring = string_duplicate (argv[i]);
+        }
+        else
+        {
+            fprintf (stderr, "ERROR: Invalid argument: %s\n", argv[i]);
+            usage (argv[0]);
+            exit_loggrabber (1);
+        }
+    }
+
+
+    /*
+     * check configuration files
+     */
+    check_loggrabber_config (cfgvalues.config_filename);
+    if (cfgvalues.app_name.length() == 0)
+    {
+        check_lea_config (cfgvalues.leaconfig_filename);
+    }
+
+    /*
+     * load configuration file
+     */
+    read_config_file (cfgvalues.config_filename, &cfgvalues);
+
+    // construct endpoints
+    string endpoint_prefix = "/servicesNS/nobody/";
+    string config_endpoint_postfix = "/opsec/opsec_conf/";
+    string log_status_endpoint_postfix = "/opsec/log_status/";
+    string entity_health_endpoint_postfix = "/opsec/entity_health/";
+    //construct config endpoint
+    cfgvalues.config_endpoint = endpoint_prefix;
+    cfgvalues.config_endpoint += cfgvalues.app_name;
+    cfgvalues.config_endpoint += config_endpoint_postfix;
     //construct log status endpoint
     cfgvalues.log_status_endpoint = endpoint_prefix;
     cfgvalues.log_status_endpoint += cfgvalues.app_name;
@@ -1105,6 +1899,24 @@ main (int argc, char *argv[])
     cfgvalues.showfiles_mode =
         (show_files != -1) ? show_files : cfgvalues.showfiles_mode;
     cfgvalues.audit_mode = (audit_log != -1) ? audit_log : cfgvalues.audit_mode;
+    cfgvalues.backfill_partitions =
+        (backfill_partitions != -1) ? backfill_partitions : cfgvalues.backfill_partitions;
+    cfgvalues.backfill_split =
+        (backfill_split != -1) ? backfill_split : cfgvalues.backfill_split;
+    cfgvalues.catchup_mode =
+        (catchup_mode != -1) ? catchup_mode : cfgvalues.catchup_mode;
+    if ((start_time_arg != NULL) &&
+            !filter_parse_time ("--start-time", start_time_arg,
+                                &cfgvalues.start_time))
+    {
+        exit_loggrabber (1);
+    }
+    if ((end_time_arg != NULL) &&
+            !filter_parse_time ("--end-time", end_time_arg,
+                                &cfgvalues.end_time))
+    {
+        exit_loggrabber (1);
+    }
     cfgvalues.fieldnames_mode = TRUE;
     cfgvalues.fw1_logfile =
         (LogfileName !=
@@ -1116,6 +1928,18 @@ main (int argc, char *argv[])
         cfgvalues.audit_filter_count = filtercount;
         cfgvalues.audit_filter_array = filterarray;
     }
+    if (post_filter_args.size() > 0)
+    {
+        cfgvalues.post_filters = post_filter_args;
+    }
+    if (sample_arg != NULL)
+    {
+        cfgvalues.sample_rates = sample_arg;
+    }
+    cfgvalues.aggregate_window =
+        (aggregate_window != -1) ? aggregate_window : cfgvalues.aggregate_window;
+    cfgvalues.dedup_window =
+        (dedup_window != -1) ? dedup_window : cfgvalues.dedup_window;
     if ((!fieldstring) && (cfgvalues.fields))
     {
         fieldstring = string_duplicate (cfgvalues.fields);
@@ -1131,6 +1955,7 @@ main (int argc, char *argv[])
         {
             field = string_trim (string_get_token (&fieldstring, ';'), ' ');
             output_fields[field] = true;
+            csv_add_column (field);
         }
     }
 
@@ -1192,6 +2017,41 @@ main (int argc, char *argv[])
         exit_loggrabber (1);
     }
 
+    if (cfgvalues.catchup_mode && !cfgvalues.online_mode)
+    {
+        fprintf (stderr,
+                 "ERROR: --catchup option is only available in online mode.\n");
+        exit_loggrabber (1);
+    }
+
+    if (cfgvalues.catchup_mode && cfgvalues.fw1_2000)
+    {
+        fprintf (stderr,
+                 "ERROR: --catchup option is not available for FW-1 4.1.\n");
+        exit_loggrabber (1);
+    }
+
+    if (cfgvalues.online_mode && (cfgvalues.start_time || cfgvalues.end_time))
+    {
+        fprintf (stderr,
+                 "ERROR: --start-time and --end-time options are not available in online mode.\n");
+        exit_loggrabber (1);
+    }
+
+    if (cfgvalues.start_time && cfgvalues.end_time &&
+            (cfgvalues.start_time > cfgvalues.end_time))
+    {
+        fprintf (stderr, "ERROR: --start-time is later than --end-time.\n");
+        exit_loggrabber (1);
+    }
+
+    if (cfgvalues.online_mode && (cfgvalues.backfill_partitions > 1))
+    {
+        fprintf (stderr,
+                 "ERROR: --backfill option is not available in online mode.\n");
+        exit_loggrabber (1);
+    }
+
     if (cfgvalues.online_mode && cfgvalues.showfiles_mode)
     {
         fprintf (stderr,
@@ -1199,6 +2059,79 @@ main (int argc, char *argv[])
         exit_loggrabber (1);
     }
 
+    if (!post_filter_compile () || !sample_compile ())
+    {
+        exit_loggrabber (1);
+    }
+    if ((output_fields.size() > 0) && (cfgvalues.sample_rates.length() > 0))
+    {
+        output_fields["sample_rate"] = true;
+    }
+
+    if ((cfgvalues.aggregate_window > 0) && cfgvalues.catchup_mode)
+    {
+        fprintf (stderr,
+                 "ERROR: --aggregate and --catchup options cannot be combined.\n");
+        exit_loggrabber (1);
+    }
+    if ((cfgvalues.dedup_window > 0) && cfgvalues.catchup_mode)
+    {
+        fprintf (stderr,
+                 "ERROR: --dedup and --catchup options cannot be combined.\n");
+        exit_loggrabber (1);
+    }
+    if ((cfgvalues.dedup_window > 0) && (cfgvalues.aggregate_window > 0))
+    {
+        fprintf (stderr,
+                 "ERROR: --dedup and --aggregate options cannot be combined.\n");
+        exit_loggrabber (1);
+    }
+    if ((cfgvalues.log_mode == COLUMNAR) &&
+            ((cfgvalues.aggregate_window > 0) || (cfgvalues.dedup_window > 0)))
+    {
+        fprintf (stderr,
+                 "ERROR: --aggregate and --dedup are not available with columnar output.\n");
+        exit_loggrabber (1);
+    }
+    // odbc output does not take formatted records, held ones would be lost
+    if (((cfgvalues.log_mode == BINARY) || (cfgvalues.log_mode == ODBC)) &&
+            (cfgvalues.dedup_window > 0))
+    {
+        fprintf (stderr,
+                 "ERROR: --dedup is not available with binary and odbc output.\n");
+        exit_loggrabber (1);
+    }
+    /*
+     * merged ranges are resubmitted as text lines, without the loc and time
+     * the archive index is built from
+     */
+    if (((cfgvalues.log_mode == ARCHIVE) || (cfgvalues.log_mode == COLUMNAR) ||
+            (cfgvalues.log_mode == BINARY) || (cfgvalues.log_mode == HEC) ||
+            (cfgvalues.log_mode == STREAM)) &&
+            (cfgvalues.backfill_partitions > 1) && !cfgvalues.backfill_split)
+    {
+        fprintf (stderr,
+                 "ERROR: --backfill with archive, columnar, binary, hec and stream output needs BACKFILL_OUTPUT=split.\n");
+        exit_loggrabber (1);
+    }
+    if ((cfgvalues.output_format != FORMAT_KV) &&
+            ((cfgvalues.log_mode == COLUMNAR) || (cfgvalues.log_mode == BINARY)))
+    {
+        fprintf (stderr,
+                 "ERROR: OUTPUT_FORMAT is only available with screen, file and archive output.\n");
+        exit_loggrabber (1);
+    }
+    if ((cfgvalues.output_format != FORMAT_KV) && (cfgvalues.aggregate_window > 0))
+    {
+        fprintf (stderr,
+                 "ERROR: --aggregate is only available with OUTPUT_FORMAT=kv.\n");
+        exit_loggrabber (1);
+    }
+    aggregate_init ();
+    dedup_init ();
+    csv_init ();
+    cef_init ();
+
     if (!(cfgvalues.audit_mode)
             && (strcmp (cfgvalues.fw1_logfile, "fw.adtlog") == 0))
     {
@@ -1207,6 +2140,26 @@ main (int argc, char *argv[])
         exit_loggrabber (1);
     }
 
+    if (cfgvalues.log_mode == HEC)
+    {
+        if ((cfgvalues.hec_url.length() == 0) || (cfgvalues.hec_token.length() == 0))
+        {
+            fprintf (stderr,
+                     "ERROR: LOGGING_CONFIGURATION=hec needs HEC_URL and HEC_TOKEN.\n");
+            exit_loggrabber (1);
+        }
+        if (cfgvalues.hec_host.length() == 0)
+        {
+            cfgvalues.hec_host = entity;
+        }
+    }
+    if ((cfgvalues.log_mode == STREAM) && (cfgvalues.stream_target.length() == 0))
+    {
+        fprintf (stderr,
+                 "ERROR: LOGGING_CONFIGURATION=stream needs STREAM_TARGET.\n");
+        exit_loggrabber (1);
+    }
+
     /*
      * set logging envionment
      */
@@ -1259,57 +2212,44 @@ main (int argc, char *argv[])
     }
 
     /*
-     * process all logfiles if ALL specified
+     * read the logfiles selected from the catalog: ALL, an exact name or a
+     * pattern with * and ?, narrowed to those overlapping --start-time and
+     * --end-time. A name unknown to the catalog is read as it is.
      */
-    if (strcmp (cfgvalues.fw1_logfile, "ALL") == 0)
+    if (!catalog_select (entity, cfgvalues.fw1_logfile, selected))
     {
-        lstptr = sl;
-
-        while (lstptr)
+        if (cfgvalues.debug_mode)
         {
-            if (cfgvalues.debug_mode)
-            {
-                fprintf (stderr, "DEBUG: Processing Logfile: %s\n",
-                         lstptr->data);
-            }
-            read_fw1_logfile (&(lstptr->data), entity, lstptr->normalFID);
-            //TODO: Read the accounting id
-            lstptr = lstptr->next;
+            fprintf (stderr, "DEBUG: Processing Logfile: %s\n",
+                     cfgvalues.fw1_logfile);
+        }
+        if (cfgvalues.backfill_partitions > 1)
+        {
+            backfill_fw1_logfile (&(cfgvalues.fw1_logfile), entity, LEA_NORMAL_FILEID);
+        }
+        else
+        {
+            read_fw1_logfile (&(cfgvalues.fw1_logfile), entity, LEA_NORMAL_FILEID);
         }
     }
-
-    /*
-     * else search for given string in available logfile-names
-     */
-    else
+    for (k = 0; k < selected.size(); k++)
     {
-        lstptr = stringlist_search (&sl, cfgvalues.fw1_logfile, &foundstring);
+        catalog_entry *entry = &(catalog.entries[selected[k]]);
 
-        /*
-         * get the data from the matching logfiles
-         */
-        if (!lstptr)
+        logfile = const_cast<char *>(entry->name.c_str());
+        if (cfgvalues.debug_mode)
         {
-            if (cfgvalues.debug_mode)
-            {
-                fprintf (stderr, "DEBUG: Processing Logfile: %s\n",
-                         cfgvalues.fw1_logfile);
-            }
-            read_fw1_logfile (&(cfgvalues.fw1_logfile), entity, LEA_NORMAL_FILEID);
+            fprintf (stderr, "DEBUG: Processing Logfile: %s\n", logfile);
         }
-        while (lstptr)
+        if (cfgvalues.backfill_partitions > 1)
         {
-            if (cfgvalues.debug_mode)
-            {
-                fprintf (stderr, "DEBUG: Processing Logfile: %s\n",
-                         foundstring);
-            }
-            read_fw1_logfile (&foundstring, entity, lstptr->normalFID);
-            //TODO: read the account file id
-            lstptr =
-                stringlist_search (&(lstptr->next), cfgvalues.fw1_logfile,
-                                   &foundstring);
+            backfill_fw1_logfile (&logfile, entity, entry->normalFID);
+        }
+        else
+        {
+            read_fw1_logfile (&logfile, entity, entry->normalFID);
         }
+        //TODO: read the account file id
     }
 
     close_log ();
@@ -1328,251 +2268,149 @@ read_fw1_logfile (char **LogfileName, const string& entity, int fileid)
     OpsecEntity *pServer = NULL;
     OpsecSession *pSession = NULL;
     OpsecEnv *pEnv = NULL;
-    LeaFilterRulebase *rb;
+    LeaFilterRulebase *rb = NULL;
     int rbid = 1;
-    int i, index;
+    int index;
     int opsecAlive;
 
     char *tmpstr1;
     char *message = NULL;
     unsigned int messagecap = 0;
 
-    char *auth_type;
-    char *fw1_server;
-    char *fw1_port;
-    char *opsec_certificate;
-    char *opsec_client_dn;
-    char *opsec_server_dn;
     int first = TRUE;
 
     char *(**headers);
     int *order;
     int number_fields;
 
+    /*
+     * state kept across reconnects: the position obtained from the status
+     * server, like the environment with the lea config fetched from splunkd
+     * and the compiled filters, is reused until a reconnect fails without
+     * ever establishing
+     */
+    int status_pos = -1;
+    int status_cached = FALSE;
+    int attempt = 0;
+    long session_started;
+
+    /*
+     * a --start-time/--end-time read is a one-off that must not move the
+     * checkpoint; backfill workers inherit the window of their parent
+     */
+    int time_window = (cfgvalues.start_time || cfgvalues.end_time) &&
+                      (backfill.index < 0);
+
     if (cfgvalues.debug_mode >= 2)
     {
         fprintf (stderr, "DEBUG: function read_fw1_logfile\n");
     }
 
+    if (time_window && !locate_time_window (LogfileName, entity, fileid))
+    {
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "DEBUG: No records of %s in the time window\n",
+                     *LogfileName);
+        }
+        return 0;
+    }
+
     keepAlive = TRUE;
 
     while (keepAlive)
     {
         int last_rec_pos = -1;
-        /* create opsec environment for the main loop */
-        if (cfgvalues.app_name.length() > 0)
+        attempt_established = FALSE;
+        /*
+         * the environment is shared with the listing and probe sessions
+         * and survives reconnects, see fw1_env_open
+         */
+        if (!fw1_env_open (entity))
+        {
+            exit_loggrabber (1, entity);
+        }
+        pEnv = fw1_env.env;
+        pClient = fw1_env.client;
+        pServer = fw1_env.server;
+        if ((cfgvalues.app_name.length() > 0) && cfgvalues.audit_mode)
+        {
+            fileid = -1;
+        }
+
+        /*
+         * compile the filter definitions once, every session instantiates
+         * its rulebase from the result
+         */
+        if (!fw1_env.filters_compiled)
         {
-            int argc = 0;
-            char** argv = NULL;
-            if (!getSplunkLeaConfigArgs(entity, cfgvalues,
-                                        &argc, &argv))
+            if (!compile_filters ())
             {
-                fprintf (stderr, "ERROR: unable to get splunk lea config arguments (read_fw1_logfile)\n");
                 exit_loggrabber (1, entity);
             }
+            fw1_env.filters_compiled = TRUE;
+        }
 
-            if (cfgvalues.audit_mode)
+        if ((cfgvalues.app_name.length() > 0) && !time_window)
+        {
+            /*
+             * a position in the local journal is enough to start without a
+             * round trip to splunkd. The status server, which may have been
+             * fed by another host, is then asked by the sync thread and its
+             * position is taken on the next reconnect if it is newer. It is
+             * only waited for when there is no local position.
+             */
+            last_rec_pos = checkpoint_resume_pos (entity, fileid);
+            if (!status_cached && (backfill.index < 0))
+            {
+                if (last_rec_pos >= 0)
+                {
+                    checkpoint_sync_fetch (entity, fileid);
+                }
+                else if (!getStatus(entity, cfgvalues.status_server,
+                                    cfgvalues.log_status_endpoint,
+                                    cfgvalues.status_server_auth_token,
+                                    fileid, status_pos))
+                {
+                    fprintf (stderr, "ERROR: unable get progress (%s)\n",
+                             opsec_errno_str (opsec_errno));
+                    exit_loggrabber (1, entity);
+                }
+                status_cached = TRUE;
+            }
+            if (status_pos > last_rec_pos)
             {
-                fileid = -1;
+                last_rec_pos = status_pos;
             }
 
-            if ((pEnv =
-                        opsec_init (OPSEC_CONF_ARGV, &argc, argv,
-                                    OPSEC_EOL)) == NULL)
+            if (cfgvalues.debug_mode)
             {
-                fprintf (stderr, "ERROR: unable to create environment (%s)\n",
-                         opsec_errno_str (opsec_errno));
-                exit_loggrabber (1, entity);
+                fprintf (stderr, "DEBUG: Starting %s %s %d at offset %d\n", entity.c_str(), *LogfileName, fileid,
+                         last_rec_pos);
             }
 
         }
-        else
+        else if (time_window && (watermark.fileid == fileid))
         {
-            if ((pEnv =
-                        opsec_init (OPSEC_CONF_FILE, cfgvalues.leaconfig_filename,
-                                    OPSEC_EOL)) == NULL)
-            {
-                fprintf (stderr, "ERROR: unable to create environment (%s)\n",
-                         opsec_errno_str (opsec_errno));
-                exit_loggrabber (1);
-            }
+            // after a reconnect, continue behind what was already handed on
+            last_rec_pos = watermark.submitted_pos;
         }
 
-        if (cfgvalues.app_name.length() > 0)
+        /*
+         * a backfill range or time window starts at its first position
+         * unless its checkpoint is further, and is done once the checkpoint
+         * reaches its end
+         */
+        if (backfill.end_pos >= 0)
         {
-            if (!getStatus(entity, cfgvalues.status_server,
-                           cfgvalues.log_status_endpoint,
-                           cfgvalues.status_server_auth_token,
-                           fileid, last_rec_pos))
-            {
-                fprintf (stderr, "ERROR: unable get progress (%s)\n",
-                         opsec_errno_str (opsec_errno));
-                exit_loggrabber (1, entity);
-            }
-
-            if (cfgvalues.debug_mode)
+            if (last_rec_pos < backfill.start_pos - 1)
             {
-                fprintf (stderr, "DEBUG: Starting %s %s %d at offset %d\n", entity.c_str(), *LogfileName, fileid,
-                         last_rec_pos);
+                last_rec_pos = backfill.start_pos - 1;
             }
-
-        }
-
-        if (cfgvalues.debug_mode)
-        {
-
-            fprintf (stderr, "DEBUG: OPSEC LEA conf file is %s\n",
-                     cfgvalues.leaconfig_filename);
-
-            fw1_server = opsec_get_conf (pEnv, "lea_server", "ip", NULL);
-            if (fw1_server == NULL)
-            {
-                fprintf (stderr,
-                         "ERROR: The fw1 server ip address has not been set.\n");
-                exit_loggrabber (1, entity);
-            }     //end of if
-            auth_type = opsec_get_conf (pEnv, "lea_server", "auth_type", NULL);
-            if (auth_type != NULL)
+            if (last_rec_pos >= backfill.end_pos)
             {
-                //Authentication mode
-                if (cfgvalues.fw1_2000)
-                {
-                    //V4.1.2
-                    fw1_port =
-                        opsec_get_conf (pEnv, "lea_server", "auth_port", NULL);
-                    if (fw1_port == NULL)
-                    {
-                        fprintf (stderr,
-                                 "ERROR: The parameters about authentication mode have not been set.\n");
-                        exit_loggrabber (1, entity);
-                    }
-                    else
-                    {
-                        fprintf (stderr,
-                                 "DEBUG: Authentication mode has been used.\n");
-                        fprintf (stderr, "DEBUG: Server-IP     : %s\n",
-                                 fw1_server);
-                        fprintf (stderr, "DEBUG: Server-Port     : %s\n",
-                                 fw1_port);
-                        fprintf (stderr, "DEBUG: Authentication type: %s\n",
-                                 auth_type);
-                    }   //end of inner if
-                }
-                else
-                {
-                    //NG
-                    fw1_port =
-                        opsec_get_conf (pEnv, "lea_server", "auth_port", NULL);
-                    opsec_certificate =
-                        opsec_get_conf (pEnv, "opsec_sslca_file", NULL);
-                    opsec_client_dn =
-                        opsec_get_conf (pEnv, "opsec_sic_name", NULL);
-                    opsec_server_dn =
-                        opsec_get_conf (pEnv, "lea_server",
-                                        "opsec_entity_sic_name", NULL);
-                    if ((fw1_port == NULL) || (opsec_certificate == NULL)
-                            || (opsec_client_dn == NULL)
-                            || (opsec_server_dn == NULL))
-                    {
-                        fprintf (stderr,
-                                 "ERROR: The parameters about authentication mode have not been set.\n");
-                        exit_loggrabber (1, entity);
-                    }
-                    else
-                    {
-                        fprintf (stderr,
-                                 "DEBUG: Authentication mode has been used.\n");
-                        fprintf (stderr, "DEBUG: Server-IP     : %s\n",
-                                 fw1_server);
-                        fprintf (stderr, "DEBUG: Server-Port     : %s\n",
-                                 fw1_port);
-                        fprintf (stderr, "DEBUG: Authentication type: %s\n",
-                                 auth_type);
-                        fprintf (stderr,
-                                 "DEBUG: OPSEC sic certificate file name : %s\n",
-                                 opsec_certificate);
-                        fprintf (stderr, "DEBUG: Server DN (sic name) : %s\n",
-                                 opsec_server_dn);
-                        fprintf (stderr,
-                                 "DEBUG: OPSEC LEA client DN (sic name) : %s\n",
-                                 opsec_client_dn);
-                    }   //end of inner if
-                }
+                break;
             }
-            else
-            {
-                //Clear Text mode, i.e. non-auth mode
-                fw1_port = opsec_get_conf (pEnv, "lea_server", "port", NULL);
-                if (fw1_port != NULL)
-                {
-                    fprintf (stderr, "DEBUG: Clear text mode has been used.\n");
-                    fprintf (stderr, "DEBUG: Server-IP        : %s\n",
-                             fw1_server);
-                    fprintf (stderr, "DEBUG: Server-Port      : %s\n",
-                             fw1_port);
-                }
-                else
-                {
-                    fprintf (stderr,
-                             "ERROR: The fw1 server lea service port has not been set.\n");
-                    exit_loggrabber (1, entity);
-                }   //end of inner if
-            }     //end of middle if
-        }     //end of if
-
-        /*
-         * initialize opsec-client
-         */
-        pClient = opsec_init_entity (pEnv, LEA_CLIENT,
-                                     LEA_RECORD_HANDLER,
-                                     read_fw1_logfile_record,
-                                     LEA_DICT_HANDLER, read_fw1_logfile_dict,
-                                     LEA_EOF_HANDLER, read_fw1_logfile_eof,
-                                     LEA_SWITCH_HANDLER,
-                                     read_fw1_logfile_switch,
-                                     LEA_FILTER_QUERY_ACK,
-                                     ((cfgvalues.
-                                       audit_mode) ? ((cfgvalues.
-                                               audit_filter_count >
-                                               0) ?
-                                               read_fw1_logfile_queryack
-                                               : NULL) : ((cfgvalues.
-                                                       fw1_filter_count
-                                                       >
-                                                       0) ?
-                                                       read_fw1_logfile_queryack
-                                                       : NULL)),
-                                     LEA_COL_LOGS_HANDLER,
-                                     read_fw1_logfile_collogs,
-                                     LEA_SUSPEND_HANDLER,
-                                     read_fw1_logfile_suspend,
-                                     LEA_RESUME_HANDLER,
-                                     read_fw1_logfile_resume,
-                                     OPSEC_SESSION_START_HANDLER,
-                                     read_fw1_logfile_start,
-                                     OPSEC_SESSION_END_HANDLER,
-                                     read_fw1_logfile_end,
-                                     OPSEC_SESSION_ESTABLISHED_HANDLER,
-                                     read_fw1_logfile_established, OPSEC_EOL);
-
-        /*
-         * initialize opsec-server for authenticated and unauthenticated connections
-         */
-
-        pServer =
-            opsec_init_entity (pEnv, LEA_SERVER, OPSEC_ENTITY_NAME, "lea_server",
-                               OPSEC_EOL);
-
-        /*
-         * continue only if opsec initializations were successful
-         */
-        if ((!pClient) || (!pServer))
-        {
-            fprintf (stderr,
-                     "ERROR: failed to initialize client/server-pair (%s)\n",
-                     opsec_errno_str (opsec_errno));
-            cleanup_fw1_environment (pEnv, pClient, pServer);
-            exit_loggrabber (1, entity);
         }
 
         /*
@@ -1606,7 +2444,6 @@ read_fw1_logfile (char **LogfileName, const string& entity, int fileid)
                     {
                         fprintf (stderr, "ERROR: could not establish connection starting at position (%d)\n",
                                  last_rec_pos);
-                        cleanup_fw1_environment (pEnv, pClient, pServer);
                         exit_loggrabber (1, entity);
                     }
 
@@ -1616,7 +2453,6 @@ read_fw1_logfile (char **LogfileName, const string& entity, int fileid)
             {
                 fprintf (stderr, "ERROR: failed to create session (%s)\n",
                          opsec_errno_str (opsec_errno));
-                cleanup_fw1_environment (pEnv, pClient, pServer);
                 exit_loggrabber (1, entity);
             }
         }
@@ -1678,7 +2514,6 @@ read_fw1_logfile (char **LogfileName, const string& entity, int fileid)
                     {
                         fprintf (stderr, "ERROR: could not establish connection starting at position (%d)\n",
                                  last_rec_pos);
-                        cleanup_fw1_environment (pEnv, pClient, pServer);
                         exit_loggrabber (1, entity);
                     }
                 }
@@ -1687,7 +2522,6 @@ read_fw1_logfile (char **LogfileName, const string& entity, int fileid)
             {
                 fprintf (stderr, "ERROR: failed to create session (%s)\n",
                          opsec_errno_str (opsec_errno));
-                cleanup_fw1_environment (pEnv, pClient, pServer);
                 exit_loggrabber (1, entity);
             }
 
@@ -1698,89 +2532,22 @@ read_fw1_logfile (char **LogfileName, const string& entity, int fileid)
              * In the case when no filters are used, the suspended session
              * will be continued immediately.
              */
-            if (cfgvalues.audit_mode)
+            if (filter_rules.size() > 0)
             {
-                if (cfgvalues.audit_filter_count > 0)
+                if ((rb = filter_rulebase_create ()) == NULL)
                 {
-                    if ((rb = lea_filter_rulebase_create ()) == NULL)
-                    {
-                        fprintf (stderr, "ERROR: failed to create rulebase\n");
-                        exit_loggrabber (1, entity);
-                    }
-
-                    for (i = 0; i < cfgvalues.audit_filter_count; i++)
-                    {
-                        if ((rb =
-                                    create_audit_filter_rule (rb,
-                                                              cfgvalues.
-                                                              audit_filter_array[i]))
-                                == NULL)
-                        {
-                            fprintf (stderr, "ERROR: failed to create rule\n");
-                            exit_loggrabber (1, entity);
-                        }
-                    }
-
-                    if (lea_filter_rulebase_register (pSession, rb, &rbid) ==
-                            LEA_FILTER_ERR)
-                    {
-                        fprintf (stderr, "ERROR: Cannot register rulebase\n");
-                    }
+                    exit_loggrabber (1, entity);
                 }
-                else
+
+                if (lea_filter_rulebase_register (pSession, rb, &rbid) ==
+                        LEA_FILTER_ERR)
                 {
-                    lea_session_resume (pSession);
+                    fprintf (stderr, "ERROR: Cannot register rulebase\n");
                 }
             }
             else
             {
-                if (cfgvalues.fw1_filter_count > 0)
-                {
-                    if ((rb = lea_filter_rulebase_create ()) == NULL)
-                    {
-                        fprintf (stderr, "ERROR: failed to create rulebase\n");
-                        exit_loggrabber (1, entity);
-                    }
-
-                    if(cfgvalues.fw_mode)
-                    {
-                        if(!add_drop_vpn_rule(rb))
-                        {
-                            fprintf(stderr, "ERROR: failed to create drop vpn rule\n");
-                            exit_loggrabber(1,entity);
-                        }
-                    }
-
-                    for (i = 0; i < cfgvalues.fw1_filter_count; i++)
-                    {
-                        if (cfgvalues.debug_mode)
-                        {
-                            fprintf(stderr, "filter %d: %s\n", 
-                                i,
-                                cfgvalues.fw1_filter_array[i]);
-                        }
-
-                        if ((rb =
-                                    create_fw1_filter_rule (rb,
-                                                            cfgvalues.
-                                                            fw1_filter_array[i])) ==
-                                NULL)
-                        {
-                            fprintf (stderr, "ERROR: failed to create rule\n");
-                            exit_loggrabber (1,entity);
-                        }
-                    }
-
-                    if (lea_filter_rulebase_register (pSession, rb, &rbid) ==
-                            LEA_FILTER_ERR)
-                    {
-                        fprintf (stderr, "ERROR: Cannot register rulebase\n");
-                    }
-                }
-                else
-                {
-                    lea_session_resume (pSession);
-                }
+                lea_session_resume (pSession);
             }
         }
 
@@ -1794,22 +2561,132 @@ read_fw1_logfile (char **LogfileName, const string& entity, int fileid)
         sessionContext.log_status_endpoint = cfgvalues.log_status_endpoint;
         sessionContext.entity_health_endpoint = cfgvalues.entity_health_endpoint;
         sessionContext.status_server_auth_token = cfgvalues.status_server_auth_token;
-        sessionContext.config_entity = entity;
-        SESSION_OPAQUE(pSession) = &sessionContext;
+        sessionContext.config_entity = time_window ? string ("") : entity;
+        sessionContext.env = pEnv;
+        sessionContext.session = pSession;
+        sessionContext.fileid = fileid;
+        checkpoint_init (&sessionContext, last_rec_pos);
+        if (watermark.fileid != fileid)
+        {
+            watermark.fileid = fileid;
+            watermark.submitted_pos = -1;
+            watermark.flushed_pos = -1;
+        }
+        fw1_env_bind (pSession, SESSION_ROLE_READ, &sessionContext);
+        if (sessionContext.config_entity.length() > 0)
+        {
+            opsec_schedule (pEnv, 1000, checkpoint_timer, &sessionContext);
+        }
+        if (cfgvalues.online_mode && (cfgvalues.aggregate_window > 0))
+        {
+            opsec_schedule (pEnv, 1000, aggregate_timer, pEnv);
+        }
+        if (cfgvalues.online_mode && (cfgvalues.dedup_window > 0))
+        {
+            opsec_schedule (pEnv, 1000, dedup_timer, pEnv);
+        }
+        if (cfgvalues.online_mode && (cfgvalues.stall_timeout > 0))
+        {
+            stall_watch_start (pSession, pClient, pServer, *LogfileName,
+                               fileid, rb);
+            opsec_schedule (pEnv, 1000, stall_timer, pEnv);
+        }
 
         /*
-         * start the opsec loop
+         * --catchup: a second, offline session drains the records behind
+         * the checkpoint while the live one already delivers new records
          */
-        opsec_mainloop (pEnv);
+        SESSION_CONTEXT catchupContext;
+        catchupContext.session = NULL;
+        catchup.live = pSession;
+        catchup.session = NULL;
+        catchup.active = FALSE;
+        catchup.failed = FALSE;
+        if (cfgvalues.catchup_mode && (last_rec_pos > 0))
+        {
+            catchup.session = catchup_open (pClient, pServer, *LogfileName,
+                                            fileid, last_rec_pos, rb);
+            if (catchup.session == NULL)
+            {
+                exit_loggrabber (1, entity);
+            }
+            catchupContext = sessionContext;
+            catchupContext.session = catchup.session;
+            checkpoint_init (&catchupContext, last_rec_pos);
+            fw1_env_bind (catchup.session, SESSION_ROLE_READ, &catchupContext);
+            catchup.active = TRUE;
+            catchup.handoff_pos = -1;
+            catchup.last_pos = last_rec_pos;
+            catchup.started = current_time_ms ();
+            catchup.records = 0;
+            if (catchupContext.config_entity.length() > 0)
+            {
+                opsec_schedule (pEnv, 1000, checkpoint_timer, &catchupContext);
+            }
+        }
 
         /*
-         * remove opsec stuff
+         * start the opsec loop
          */
-        cleanup_fw1_environment (pEnv, pClient, pServer);
+        session_started = current_time_ms ();
+        opsec_mainloop (pEnv);
+        opsec_deschedule (pEnv, checkpoint_timer, &sessionContext);
+        opsec_deschedule (pEnv, stall_timer, pEnv);
+        stall.session = NULL;
+        opsec_deschedule (pEnv, aggregate_timer, pEnv);
+        opsec_deschedule (pEnv, dedup_timer, pEnv);
+        post_filter_report ();
+        sample_report ();
+        aggregate_report ();
+        dedup_report ();
+        checkpoint_close (&sessionContext);
+        if (catchupContext.session != NULL)
+        {
+            opsec_deschedule (pEnv, checkpoint_timer, &catchupContext);
+            checkpoint_close (&catchupContext);
+        }
+        catchup.live = NULL;
+        catchup.session = NULL;
+
+        if (rb != NULL)
+        {
+            lea_filter_rulebase_destroy (rb);
+            rb = NULL;
+        }
 
         if (keepAlive)
         {
-            SLEEP (recoverInterval);
+            long delay;
+
+            if (metrics.disconnected_at == 0)
+            {
+                metrics.disconnected_at = current_time_ms ();
+            }
+
+            /*
+             * a session that stayed up longer than the backoff cap starts a
+             * new series with an immediate retry; one that never came up
+             * may be caused by stale config, so fetch it again
+             */
+            if (attempt_established &&
+                    (current_time_ms () - session_started >= cfgvalues.reconnect_backoff_max_ms))
+            {
+                attempt = 0;
+            }
+            else if (!attempt_established && (attempt > 0))
+            {
+                fw1_env_close ();
+            }
+            delay = reconnect_delay_ms (attempt++);
+            metrics.reconnects++;
+
+            if (cfgvalues.debug_mode)
+            {
+                fprintf (stderr, "DEBUG: Reconnect attempt %d in %ld ms\n",
+                         attempt, delay);
+            }
+            SLEEP (delay / 1000);
+            SLEEP_MS (delay % 1000);
         }
     }
 
@@ -1817,4663 +2694,10799 @@ read_fw1_logfile (char **LogfileName, const string& entity, int fileid)
 }
 
 /*
- * function read_fw1_logfile_queryack
+ * function reconnect_delay_ms
+ *
+ * the first retry is immediate, after that the delay doubles from
+ * reconnect_backoff_min_ms up to reconnect_backoff_max_ms. Half of the
+ * delay is randomized so that several loggrabbers don't reconnect in lockstep.
  */
-int
-read_fw1_logfile_queryack (OpsecSession * psession, int filterID,
-                           eLeaFilterAction filterAction, int filterResult)
+long
+reconnect_delay_ms (int attempt)
 {
-    if (cfgvalues.debug_mode >= 2)
+    static int seeded = FALSE;
+    long delay = cfgvalues.reconnect_backoff_min_ms;
+
+    if (attempt <= 0)
     {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_queryack\n");
+        return 0;
     }
-
-    if (cfgvalues.debug_mode)
+    if (!seeded)
     {
-        fprintf (stderr, "DEBUG: LEA logfile query ack handler was invoked\n");
+        srand ((unsigned int) (time (NULL) ^ getpid ()));
+        seeded = TRUE;
     }
-    lea_session_resume (psession);
-    return OPSEC_SESSION_OK;
+    while ((--attempt > 0) && (delay < cfgvalues.reconnect_backoff_max_ms))
+    {
+        delay *= 2;
+    }
+    if (delay > cfgvalues.reconnect_backoff_max_ms)
+    {
+        delay = cfgvalues.reconnect_backoff_max_ms;
+    }
+    return delay / 2 + rand () % (delay / 2 + 1);
 }
 
 /*
- * function string_cat
+ * function backfill_fw1_logfile
+ *
+ * reads one logfile with backfill_partitions worker processes, each of them
+ * serving a contiguous range of record positions over its own LEA session.
+ * The ranges are derived from the last position, located with probe
+ * sessions. Every worker checkpoints its range separately. Output goes to
+ * <prefix>.part<N>.log, which is either kept (BACKFILL_OUTPUT=split) or
+ * handed to the configured output in position order (merged). Merging
+ * resubmits the text lines, so it needs screen or logfile output. A
+ * backfill never advances the checkpoint of the logfile itself: the next
+ * regular run resumes from where the last regular run stopped.
  */
-unsigned int
-string_cat (char **dst, const char *src, unsigned int cap)
+int
+backfill_fw1_logfile (char **LogfileName, const string& entity, int fileid)
 {
-    char *buffer = NULL;
-    unsigned int capacity = cap;
+    probe_env probe;
+    vector<pid_t> workers;
+    stringstream sstream;
+    long started = current_time_ms ();
+    int first_pos;
+    int last_pos;
+    int count;
+    int partitions;
+    int size;
+    int status;
+    int failed = FALSE;
+    int k;
+    pid_t pid;
 
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function string_cat\n");
+        fprintf (stderr, "DEBUG: function backfill_fw1_logfile\n");
     }
 
-    // allocate memory for the string if NULL
-    if (*dst == NULL)
+    if (!probe_open (entity, &probe))
     {
-        *dst = (char *) malloc (INITIAL_CAPACITY + 1);
-        if (*dst == NULL)
-        {
-            fprintf (stderr, "ERROR: Out of memory\n");
-            exit_loggrabber (1);
-        }
-        **dst = '\0';
-        capacity = INITIAL_CAPACITY;
+        exit_loggrabber (1, entity);
     }
-
-    // is src NULL, just return the capacity of dst
-    if (!src)
+    if (!probe_window (&probe, *LogfileName, fileid, &first_pos, &last_pos))
     {
-        return (capacity);
+        probe_close (&probe);
+        exit_loggrabber (1, entity);
     }
+    probe_close (&probe);
 
-    // is the capacity big enough for both src and dst?
-    if (capacity >= strlen (*dst) + strlen (src))
+    if (cfgvalues.debug_mode)
     {
-        strcat (*dst, src);
-        return (capacity);
+        fprintf (stderr, "DEBUG: Backfilling %s positions %d-%d (%d probes)\n",
+                 *LogfileName, first_pos, last_pos, probe.probes);
+    }
+    if (last_pos < first_pos)
+    {
+        return 0;
     }
 
-    // otherwise define the new capacity
-    capacity =
-        ((capacity + CAPACITY_INCREMENT) >=
-         (strlen (*dst) + strlen (src))) ? (capacity +
-                                            CAPACITY_INCREMENT) : (strlen (*dst) +
-                                                    strlen (src));
+    count = last_pos - first_pos + 1;
+    partitions = (cfgvalues.backfill_partitions < count) ?
+                 cfgvalues.backfill_partitions : count;
+    size = count / partitions + ((count % partitions) ? 1 : 0);
 
-    // and allocate a temp buffer for dst
-    buffer = (char *) malloc (strlen (*dst) + 1);
-    if (!buffer)
+    // the workers must not inherit buffered output
+    fflush (NULL);
+    for (k = 0; k < partitions; k++)
     {
-        fprintf (stderr, "ERROR: Out of memory\n");
-        exit_loggrabber (1);
+        int start_pos = first_pos + k * size;
+        int end_pos = (start_pos + size - 1 < last_pos) ?
+                      start_pos + size - 1 : last_pos;
+
+        if (start_pos > end_pos)
+        {
+            break;
+        }
+        if ((pid = fork ()) < 0)
+        {
+            fprintf (stderr, "ERROR: Cannot start backfill worker (%s)\n",
+                     strerror (errno));
+            failed = TRUE;
+            break;
+        }
+        if (pid == 0)
+        {
+            backfill_run_range (LogfileName, entity, fileid, k, partitions,
+                                start_pos, end_pos);
+        }
+        workers.push_back (pid);
     }
 
-    // copy dst to the tempbuffer and destroy dst
-    strcpy (buffer, *dst);
-    free (*dst);
+    /*
+     * collect the workers in range order; merged output is handed on as soon
+     * as a range and all ranges before it are complete
+     */
+    for (k = 0; k < (int) workers.size(); k++)
+    {
+        if ((waitpid (workers[k], &status, 0) < 0) || !WIFEXITED (status) ||
+                (WEXITSTATUS (status) != 0))
+        {
+            fprintf (stderr, "ERROR: backfill worker %d failed\n", k);
+            failed = TRUE;
+        }
+        else if (!failed && !cfgvalues.backfill_split)
+        {
+            if (!backfill_merge_range (k))
+            {
+                failed = TRUE;
+            }
+        }
+    }
 
-    // recreate dst with the new capacity
-    *dst = (char *) malloc (capacity + 1);
-    if (*dst == NULL)
+    sstream << "backfill_ranges=" << workers.size()
+            << "|backfill_first_pos=" << first_pos
+            << "|backfill_last_pos=" << last_pos
+            << "|backfill_ms=" << (current_time_ms () - started);
+    metrics_emit (sstream.str());
+
+    if (failed)
     {
-        fprintf (stderr, "ERROR: Out of memory\n");
-        exit_loggrabber (1);
+        exit_loggrabber (1, entity);
     }
+    return 0;
+}
 
-    // finally copy buffered dst and src back to dest and destroy temp buffer
-    strcpy (*dst, buffer);
-    free (buffer);
-    strcat (*dst, src);
+/*
+ * function backfill_range_prefix
+ */
+string
+backfill_range_prefix (int index)
+{
+    stringstream sstream;
 
-    // retrung new capacity
-    return (capacity);
+    sstream << cfgvalues.output_file_prefix << ".part" << index;
+    return sstream.str();
 }
 
 /*
- * function read_fw1_logfile_record
+ * function backfill_run_range
+ *
+ * body of a backfill worker process, never returns
  */
-int
-read_fw1_logfile_record (OpsecSession * pSession, lea_record * pRec,
-                         int pnAttribPerm[])
+void
+backfill_run_range (char **LogfileName, const string& entity, int fileid,
+                    int index, int count, int start_pos, int end_pos)
 {
-    char *szAttrib;
-    char szNum[20];
-    int i, j, match, index;
-    unsigned long ul;
-    unsigned short us;
-    char tmpdata[16];
-    time_t logtime;
-    struct tm *datetime;
-    char timestring[21];
-    char *tmpstr1;
-    char *tmpstr2;
-    short first = TRUE;
-    char *message = NULL;
-    char *mymsg = NULL;
-    char *(**headers);
-    int *order;
-    int num;
-    int time;
-    int number_fields;
-    unsigned int messagecap = 0;
-    int last_rec_pos = -1;
-    vector<string> fields;
-    vector<string> field_names;
+    stringstream sstream;
+    long started = current_time_ms ();
 
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_record\n");
-    }
+    backfill.index = index;
+    backfill.count = count;
+    backfill.start_pos = start_pos;
+    backfill.end_pos = end_pos;
+    backfill.records = 0;
+    checkpoint_sync.running = FALSE;
+    fw1_env_forget ();
+    compress_forget ();
 
-    if (cfgvalues.audit_mode)
-    {
-        num = AIDX_NUM;
-        time = AIDX_TIME;
-        number_fields = NUMBER_AIDX_FIELDS;
-        headers = afield_headers;
-        order = afield_order;
-    }
-    else
+    if (cfgvalues.debug_mode)
     {
-        num = LIDX_NUM;
-        time = LIDX_TIME;
-        number_fields = NUMBER_LIDX_FIELDS;
-        headers = lfield_headers;
-        order = lfield_order;
+        fprintf (stderr, "DEBUG: Backfill worker %d reading positions %d-%d\n",
+                 index, start_pos, end_pos);
     }
 
     /*
-     * get record position
-     */
-    last_rec_pos = lea_get_record_pos (pSession) - 1;
-    // preserve 1-based for output to splunk
-    snprintf (szNum, sizeof(szNum), "%d", last_rec_pos+1);
-
-    fields.push_back(szNum);
-    field_names.push_back(*headers[num]);
-    /*
-     * process all fields of logentry
+     * each worker writes its own file, merged ranges are never rotated and
+     * stay plain text for backfill_merge_range
      */
-    for (i = 0; i < pRec->n_fields; i++)
+    cfgvalues.output_file_prefix =
+        string_duplicate ((char *) backfill_range_prefix (index).c_str());
+    if (!cfgvalues.backfill_split)
     {
-        j = 0;
-        match = FALSE;
-        strcpy (tmpdata, "\0");
-        szAttrib = lea_attr_name (pSession, pRec->fields[i].lea_attr_id);
-        if (!szAttrib)
-        {
-            if (cfgvalues.debug_mode >= 2)
-            {
-                fprintf (stderr, "DEBUG: function read_fw1_logfile_record, lea_attr_name failed %d %d\n", i,
-                         pRec->n_fields);
-            }
-            continue;
-        }
-
-        if (!(cfgvalues.resolve_mode))
-        {
-            switch (pRec->fields[i].lea_val_type)
-            {
-            /*
-             * create dotted string of IP address. this differs between
-             * Linux and Solaris.
-             */
-            case LEA_VT_IP_ADDR:
-                ul = pRec->fields[i].lea_value.ul_value;
-                if (BYTE_ORDER == LITTLE_ENDIAN)
-                {
-                    snprintf (tmpdata, sizeof(tmpdata), "%d.%d.%d.%d", (int) ((ul & 0xff) >> 0),
-                              (int) ((ul & 0xff00) >> 8),
-                              (int) ((ul & 0xff0000) >> 16),
-                              (int) ((ul & 0xff000000) >> 24));
-                }
-                else
-                {
-                    snprintf (tmpdata, sizeof(tmpdata), "%d.%d.%d.%d",
-                              (int) ((ul & 0xff000000) >> 24),
-                              (int) ((ul & 0xff0000) >> 16),
-                              (int) ((ul & 0xff00) >> 8),
-                              (int) ((ul & 0xff) >> 0));
-                }
-                break;
-
-            /*
-             * print out the port number of the used service
-             */
-            case LEA_VT_TCP_PORT:
-            case LEA_VT_UDP_PORT:
-                us = pRec->fields[i].lea_value.ush_value;
-                if (BYTE_ORDER == LITTLE_ENDIAN)
-                {
-                    us = (us >> 8) + ((us & 0xff) << 8);
-                }
-                snprintf (tmpdata, sizeof(tmpdata), "%d", us);
-                break;
-            }
-        }
-
-        if (strcmp (szAttrib, *headers[time]) == 0)
-        {
-            switch (cfgvalues.dateformat)
-            {
-            case DATETIME_CP:
-                fields.push_back(lea_resolve_field(pSession, pRec->fields[i]));
-                field_names.push_back(*headers[time]);
-                break;
-            case DATETIME_UNIX:
-                snprintf (timestring, sizeof(timestring), "%lu",
-                          pRec->fields[i].lea_value.ul_value);
-                fields.push_back(timestring);
-                field_names.push_back(*headers[time]);
-                break;
-            case DATETIME_STD:
-                logtime = (time_t) pRec->fields[i].lea_value.ul_value;
-                datetime = localtime (&logtime);
-                strftime (timestring, 20, "%Y-%m-%d %H:%M:%S", datetime);
-                fields.push_back(timestring);
-                field_names.push_back(*headers[time]);
-                break;
-            default:
-                fprintf (stderr, "ERROR: Unsupported dateformat chosen\n");
-                exit_loggrabber (1);
-            }
-        }
-        else
-        {
-            if (tmpdata[0])
-            {
-                fields.push_back(tmpdata);
-                field_names.push_back(szAttrib);
-            }
-            else
-            {
-                fields.push_back(lea_resolve_field
-                                 (pSession, pRec->fields[i]));
-                field_names.push_back(szAttrib);
-            }
-        }
+        cfgvalues.output_file_rotatesize = LONG_MAX;
+        cfgvalues.output_compression = COMPRESS_NONE;
     }
-
-    /*
-     * print logentry to stdout
-     */
-    for (i = 0; i < fields.size(); i++)
+    cfgvalues.log_mode = (cfgvalues.backfill_split &&
+                          ((cfgvalues.log_mode == ARCHIVE) ||
+                           (cfgvalues.log_mode == COLUMNAR))) ?
+                         cfgvalues.log_mode : LOGFILE;
+    logging_init_env (cfgvalues.log_mode);
+    open_log ();
+    if (!cfgvalues.backfill_split)
     {
-        // fieldname mode -> process only existing fields
-        if (output_fields.size() == 0 || output_fields.find(field_names[i]) != output_fields.end())
-        {
-            tmpstr1 =
-                string_escape (field_names[i].c_str(),
-                               cfgvalues.record_separator);
-            tmpstr2 =
-                string_escape (fields[i].c_str(),
-                               cfgvalues.record_separator);
-
-            char* stringnumber;
-
-            if (first)
-            {
-                // snprintf reserves 1 byte for the null terminator
-                // Therefore another byte is added to guarantee there is enough room
-                int size = 1 + snprintf(NULL, 0, "%s=%s", tmpstr1, tmpstr2);
-                stringnumber = (char*) malloc(size);
-                snprintf(stringnumber, size, "%s=%s", tmpstr1, tmpstr2);
-
-                first = FALSE;
-            }
-            else
-            {
-                int size = 1 + snprintf(NULL, 0, "%c%s=%s",
-                                        cfgvalues.record_separator, tmpstr1, tmpstr2);
+        // the merged output has its header already
+        csv.header_pending = FALSE;
+    }
 
-                stringnumber = (char*) malloc(size + 1);
-                snprintf(stringnumber, size, "%c%s=%s",
-                         cfgvalues.record_separator, tmpstr1, tmpstr2);
-            }
+    read_fw1_logfile (LogfileName, entity, fileid);
+    close_log ();
+    checkpoint_sync_stop ();
+
+    sstream << "backfill_range=" << index
+            << "|start_pos=" << start_pos << "|end_pos=" << end_pos
+            << "|records=" << backfill.records
+            << "|elapsed_ms=" << (current_time_ms () - started);
+    metrics_emit (sstream.str());
+    exit (0);
+}
 
-            messagecap = string_cat (&message, stringnumber, messagecap);
+/*
+ * function backfill_merge_range
+ *
+ * hands the records of a completed range to the configured output and
+ * removes the range file
+ */
+int
+backfill_merge_range (int index)
+{
+    string path = backfill_range_prefix (index) + ".log";
+    string wmpath = path + ".wm";
+    string line;
+    char buffer[4096];
+    FILE *part;
+    size_t len;
 
-            free (tmpstr1);
-            free (tmpstr2);
-            free(stringnumber);
-        }
+    if ((part = fopen (path.c_str(), "r")) == NULL)
+    {
+        fprintf (stderr, "ERROR: Cannot open backfill range %s (%s)\n",
+                 path.c_str(), strerror (errno));
+        return FALSE;
     }
-
-    if (cfgvalues.log_mode != ODBC)
+    while (fgets (buffer, sizeof buffer, part))
     {
-        if ((message != NULL) && (strlen (message) > 0))
+        line += buffer;
+        len = line.length();
+        if (line[len - 1] != '\n')
         {
-            mymsg = string_mask_newlines (message);
-            submit_log (mymsg);
-            free (message);
-            free (mymsg);
+            continue;
         }
+        line.erase (len - 1);
+        submit_log ((char *) line.c_str());
+        line.clear();
     }
+    fclose (part);
 
-    PSESSION_CONTEXT pContext = (PSESSION_CONTEXT) SESSION_OPAQUE(pSession);
-    lea_logdesc *logdesc = NULL;
-    if (pContext->config_entity.length() > 0 &&
-            (last_rec_pos > 0 && (last_rec_pos%cfgvalues.splunkRestStatusCommit == 0)))
+    // the range file is the only copy until the output has it on disk
+    if (flush_log () == FLUSH_FAILED)
     {
-        logdesc = lea_get_logfile_desc(pSession);
-        if (logdesc)
-        {
-            postEntityLogStatus(pContext->config_entity, pContext->status_server, pContext->log_status_endpoint,
-                                pContext->status_server_auth_token,
-                                logdesc,  last_rec_pos);
-            postEntityHealthStatus(pContext->config_entity, pContext->status_server,
-                                   pContext->entity_health_endpoint,
-                                   pContext->status_server_auth_token, established);
-        }
+        fprintf (stderr, "ERROR: Cannot write backfill range %s, it is kept\n",
+                 path.c_str());
+        return FALSE;
     }
-    return OPSEC_SESSION_OK;
+    unlink (path.c_str());
+    unlink (wmpath.c_str());
+    return TRUE;
 }
 
 /*
- * function read_fw1_logfile_dict
+ * function probe_open
+ *
+ * probe sessions run on the shared environment
  */
 int
-read_fw1_logfile_dict (OpsecSession * psession, int dict_id, LEA_VT val_type,
-                       int n_d_entries)
+probe_open (const string& entity, probe_env *probe)
 {
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_dict\n");
+        fprintf (stderr, "DEBUG: function probe_open\n");
     }
 
-    if (cfgvalues.debug_mode)
+    probe->probes = 0;
+    if (!fw1_env_open (entity))
     {
-        fprintf (stderr, "DEBUG: LEA logfile dict handler was invoked\n");
+        return FALSE;
     }
-    return OPSEC_SESSION_OK;
+    probe->env = fw1_env.env;
+    probe->client = fw1_env.client;
+    probe->server = fw1_env.server;
+    return TRUE;
 }
 
 /*
- * function read_fw1_logfile_eof
+ * function probe_start
+ *
+ * opens a probe session for the first record at or after pos, passing rb
+ * if it is not NULL. The result is complete once the session has ended.
  */
-int
-read_fw1_logfile_eof (OpsecSession * psession)
+OpsecSession *
+probe_start (OpsecEntity * pClient, OpsecEntity * pServer, char *LogfileName,
+             int fileid, int pos, LeaFilterRulebase * rb, probe_result *result)
 {
-    if (cfgvalues.debug_mode >= 2)
+    OpsecSession *pSession;
+    int rbid = 1;
+
+    result->found = FALSE;
+    result->pos = -1;
+    result->time = 0;
+
+    if (cfgvalues.fw1_2000)
     {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_eof\n");
+        pSession = lea_new_session (pClient, pServer, LEA_OFFLINE,
+                                    LEA_FILENAME, LogfileName, LEA_AT_POS, pos);
+    }
+    else if (cfgvalues.audit_mode)
+    {
+        pSession = lea_new_suspended_session (pClient, pServer,
+                                              LEA_OFFLINE, LEA_FILENAME,
+                                              LogfileName, LEA_AT_POS, pos);
+    }
+    else
+    {
+        pSession = lea_new_suspended_session (pClient, pServer,
+                                              LEA_OFFLINE, LEA_UNIFIED_FILEID,
+                                              fileid, LEA_AT_POS, pos);
+    }
+    if (!pSession)
+    {
+        return NULL;
     }
 
-    if (cfgvalues.debug_mode)
+    fw1_env_bind (pSession, SESSION_ROLE_PROBE, result);
+    if (cfgvalues.fw1_2000)
     {
-        fprintf (stderr, "DEBUG: LEA end of logfile handler was invoked\n");
+        return pSession;
     }
-    return OPSEC_SESSION_OK;
+    if ((rb == NULL) ||
+            (lea_filter_rulebase_register (pSession, rb, &rbid) == LEA_FILTER_ERR))
+    {
+        lea_session_resume (pSession);
+    }
+    return pSession;
 }
 
 /*
- * function read_fw1_logfile_switch
+ * function probe_record
+ *
+ * reads the first record at or after pos, result->found is FALSE if there
+ * is none
  */
 int
-read_fw1_logfile_switch (OpsecSession * psession)
+probe_record (probe_env *probe, char *LogfileName, int fileid, int pos,
+              probe_result *result)
 {
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_switch\n");
-    }
-
-    if (cfgvalues.debug_mode)
+    probe->probes++;
+    if (probe_start (probe->client, probe->server, LogfileName, fileid, pos,
+                     NULL, result) == NULL)
     {
-        fprintf (stderr, "DEBUG: LEA logfile switch handler was invoked\n");
+        return FALSE;
     }
-    return OPSEC_SESSION_OK;
+    opsec_mainloop (probe->env);
+    return TRUE;
 }
 
 /*
- * function read_fw1_logfile_collogs
+ * function probe_last_pos
+ *
+ * locates the last record of a logfile: doubles the position until a probe
+ * comes back empty, then bisects. 0 if the logfile is empty.
  */
 int
-read_fw1_logfile_collogs (OpsecSession * psession)
+probe_last_pos (probe_env *probe, char *LogfileName, int fileid)
 {
-    if (cfgvalues.debug_mode >= 2)
+    probe_result result;
+    int found = 0;
+    int missing = 1;
+    int pos;
+
+    while (probe_record (probe, LogfileName, fileid, missing, &result) &&
+            result.found)
     {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_collogs\n");
+        found = (result.pos > missing) ? result.pos : missing;
+        if (found > INT_MAX / 2)
+        {
+            return found;
+        }
+        missing = found * 2;
     }
 
-    if (cfgvalues.debug_mode)
+    while (missing - found > 1)
     {
-        fprintf (stderr, "DEBUG: LEA collected logfile handler was invoked\n");
+        pos = found + (missing - found) / 2;
+        if (probe_record (probe, LogfileName, fileid, pos, &result) &&
+                result.found)
+        {
+            found = (result.pos > pos) ? result.pos : pos;
+        }
+        else
+        {
+            missing = pos;
+        }
     }
-    return OPSEC_SESSION_OK;
+    return found;
 }
 
 /*
- * function read_fw1_logfile_suspend
+ * function probe_time_pos
+ *
+ * bisects for the first position up to last_pos whose record was logged at
+ * or after when, last_pos + 1 if there is none and -1 if a probe fails.
+ * Records are assumed to be appended in time order.
  */
 int
-read_fw1_logfile_suspend (OpsecSession * psession)
+probe_time_pos (probe_env *probe, char *LogfileName, int fileid,
+                int last_pos, unsigned long when)
 {
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_suspend\n");
-    }
+    probe_result result;
+    int lo = 1;
+    int hi = last_pos + 1;
+    int pos;
 
-    if (cfgvalues.debug_mode)
+    while (lo < hi)
     {
-        fprintf (stderr, "DEBUG: LEA suspended session handler was invoked\n");
+        pos = lo + (hi - lo) / 2;
+        if (!probe_record (probe, LogfileName, fileid, pos, &result))
+        {
+            fprintf (stderr, "ERROR: Cannot read position %d of %s (%s)\n",
+                     pos, LogfileName, opsec_errno_str (opsec_errno));
+            return -1;
+        }
+        if (!result.found || (result.time >= when))
+        {
+            hi = pos;
+        }
+        else
+        {
+            lo = ((result.pos > pos) ? result.pos : pos) + 1;
+        }
     }
-    return OPSEC_SESSION_OK;
+    return lo;
 }
 
 /*
- * function read_fw1_logfile_resume
+ * function probe_window
+ *
+ * the positions to read: the whole logfile, or the records between
+ * cfgvalues.start_time and cfgvalues.end_time. The window is empty when
+ * end_pos < start_pos.
  */
 int
-read_fw1_logfile_resume (OpsecSession * psession)
+probe_window (probe_env *probe, char *LogfileName, int fileid,
+              int *start_pos, int *end_pos)
 {
-    if (cfgvalues.debug_mode >= 2)
+    int last_pos;
+    int pos;
+
+    last_pos = probe_last_pos (probe, LogfileName, fileid);
+    *start_pos = 1;
+    *end_pos = last_pos;
+    if (last_pos <= 0)
     {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_resume\n");
+        return TRUE;
     }
 
-    if (cfgvalues.debug_mode)
+    if (cfgvalues.start_time)
     {
-        fprintf (stderr, "DEBUG: LEA resumed session handler was invoked\n");
+        if ((pos = probe_time_pos (probe, LogfileName, fileid, last_pos,
+                                   cfgvalues.start_time)) < 0)
+        {
+            return FALSE;
+        }
+        *start_pos = pos;
     }
-    return OPSEC_SESSION_OK;
+    if (cfgvalues.end_time)
+    {
+        if ((pos = probe_time_pos (probe, LogfileName, fileid, last_pos,
+                                   cfgvalues.end_time + 1)) < 0)
+        {
+            return FALSE;
+        }
+        *end_pos = pos - 1;
+    }
+    return TRUE;
 }
 
 /*
- * function get_fw1_logfiles_end
+ * function locate_time_window
+ *
+ * translates --start-time/--end-time into the position window of this
+ * process. FALSE if no record of the logfile falls into the window.
  */
 int
-get_fw1_logfiles_end (OpsecSession * psession)
+locate_time_window (char **LogfileName, const string& entity, int fileid)
 {
-    int end_reason = 0;
-    int sic_errno = 0;
-    char *sic_errmsg = NULL;
+    probe_env probe;
+    stringstream sstream;
+    long started = current_time_ms ();
 
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function get_fw1_logfiles_end\n");
+        fprintf (stderr, "DEBUG: function locate_time_window\n");
     }
 
-    if (cfgvalues.debug_mode)
+    if (!probe_open (entity, &probe))
     {
-        fprintf (stderr, "DEBUG: OPSEC_SESSION_END_HANDLER called\n");
+        exit_loggrabber (1, entity);
+    }
+    if (!probe_window (&probe, *LogfileName, fileid, &backfill.start_pos,
+                       &backfill.end_pos))
+    {
+        probe_close (&probe);
+        exit_loggrabber (1, entity);
     }
+    probe_close (&probe);
 
-    // Check what is the reason of opsec session end
-    end_reason = opsec_session_end_reason (psession);
-    switch (end_reason)
+    sstream << "window_start_pos=" << backfill.start_pos
+            << "|window_end_pos=" << backfill.end_pos
+            << "|window_probes=" << probe.probes
+            << "|window_ms=" << (current_time_ms () - started);
+    metrics_emit (sstream.str());
+
+    return (backfill.start_pos <= backfill.end_pos);
+}
+
+/*
+ * function probe_close
+ *
+ * the environment stays open for the next sessions
+ */
+void
+probe_close (probe_env *probe)
+{
+    probe->env = NULL;
+    probe->client = NULL;
+    probe->server = NULL;
+}
+
+/*
+ * function probe_record_handler
+ */
+int
+probe_record_handler (OpsecSession * pSession, lea_record * pRec, int pattr[])
+{
+    probe_result *result = (probe_result *) SESSION_OPAQUE(pSession);
+    char *name;
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
     {
-    case END_BY_APPLICATION:
-    case SESSION_TIMEOUT:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "DEBUG: The session has been ended.\n");
-        }
-        break;
-    case SESSION_NOT_ENDED:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "WARNING: The session has not been terminated.\n");
-        }
-        break;
-    case UNABLE_TO_ATTACH_COMM:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: Failed to establish connection.\n");
-        }
-        break;
-    case ENTITY_TYPE_SESSION_INIT_FAIL:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr,
-                     "ERROR: OPSEC API-specific library code on other side of connection failed when attempting to initialize the session.\n");
-        }
-        break;
-    case ENTITY_SESSION_INIT_FAIL:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr,
-                     "ERROR: Third-party start handler on other side of connection failed.\n");
-        }
-        break;
-    case COMM_FAILURE:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: Communication failure.\n");
-        }
-        break;
-    case BAD_VERSION:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: Incorrect version at other side.\n");
-        }
-        break;
-    case PEER_SEND_DROP:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: The peer dropped the connection.\n");
-        }
-        break;
-    case PEER_ENDED:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: The peer ends.\n");
-        }
-        break;
-    case PEER_SEND_RESET:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: The peer reset the connection.\n");
-        }
-        break;
-    case COMM_IS_DEAD:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: No communication.\n");
-        }
-        break;
-    case SIC_FAILURE:
-        if (!opsec_get_sic_error (psession, &sic_errno, &sic_errmsg))
+        fprintf (stderr, "DEBUG: function probe_record_handler\n");
+    }
+
+    if (!result->found)
+    {
+        result->found = TRUE;
+        result->pos = lea_get_record_pos (pSession);
+        for (i = 0; i < pRec->n_fields; i++)
         {
-            if (cfgvalues.debug_mode)
+            name = lea_attr_name (pSession, pRec->fields[i].lea_attr_id);
+            if ((name != NULL) && (strcmp (name, "time") == 0))
             {
-                fprintf (stderr, "ERROR: SIC ERROR %d - %s\n", sic_errno,
-                         sic_errmsg);
+                result->time = pRec->fields[i].lea_value.ul_value;
+                break;
             }
         }
-        break;
-    default:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "Warning: Unknown reason of session end.\n");
-        }
-        break;
-    }       //end of switch
-
-    return OPSEC_SESSION_OK;
+    }
+    return OPSEC_SESSION_END;
 }
 
 /*
- * function read_fw1_logfile_end
+ * function probe_eof_handler
  */
 int
-read_fw1_logfile_end (OpsecSession * psession)
+probe_eof_handler (OpsecSession * pSession)
 {
-    int end_reason = 0;
-    int sic_errno = 0;
-    char *sic_errmsg = NULL;
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function probe_eof_handler\n");
+    }
 
-    int last_rec_pos = -1;
-    PSESSION_CONTEXT pContext = (PSESSION_CONTEXT) SESSION_OPAQUE(psession);
-    lea_logdesc *logdesc = NULL;
+    return OPSEC_SESSION_END;
+}
+
+/*
+ * function catchup_open
+ *
+ * opens the offline session that reads from pos up to the first record of
+ * the live session, on the entities of the live session
+ */
+OpsecSession *
+catchup_open (OpsecEntity * pClient, OpsecEntity * pServer,
+              char *LogfileName, int fileid, int pos, LeaFilterRulebase * rb)
+{
+    OpsecSession *pSession;
+    int rbid = 1;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function catchup_open\n");
+    }
 
     if (cfgvalues.debug_mode)
     {
-        fprintf (stderr, "DEBUG: OPSEC_SESSION_END_HANDLER called\n");
+        fprintf (stderr, "DEBUG: Catching up from position %d\n", pos);
     }
 
-    // Check what is the reason of opsec session end
-    end_reason = opsec_session_end_reason (psession);
-    switch (end_reason)
+    if (cfgvalues.audit_mode)
     {
-    case END_BY_APPLICATION:
-    case SESSION_TIMEOUT:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "DEBUG: The session has been ended.\n");
-        }
-        keepAlive = FALSE;
-        break;
-    case SESSION_NOT_ENDED:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "WARNING: The session has not been terminated.\n");
-        }
-        keepAlive = FALSE;
-        break;
-    case UNABLE_TO_ATTACH_COMM:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: Failed to establish connection.\n");
-        }
-        if (established)
-        {
-            keepAlive = TRUE;
-        }
-        else
-        {
-            keepAlive = FALSE;
-        };
-        break;
-    case ENTITY_TYPE_SESSION_INIT_FAIL:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr,
-                     "ERROR: OPSEC API-specific library code on other side of connection failed when attempting to initialize the session.\n");
-        }
-        keepAlive = FALSE;
-        break;
-    case ENTITY_SESSION_INIT_FAIL:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr,
-                     "ERROR: Third-party start handler on other side of connection failed.\n");
-        }
-        keepAlive = FALSE;
-        break;
-    case COMM_FAILURE:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: Communication failure.\n");
-        }
-        if (established)
+        pSession = lea_new_suspended_session (pClient, pServer, LEA_OFFLINE,
+                                              LEA_FILENAME, LogfileName,
+                                              LEA_AT_POS, pos);
+    }
+    else
+    {
+        pSession = lea_new_suspended_session (pClient, pServer, LEA_OFFLINE,
+                                              LEA_UNIFIED_FILEID, fileid,
+                                              LEA_AT_POS, pos);
+    }
+    if (!pSession)
+    {
+        fprintf (stderr, "ERROR: failed to create catch-up session (%s)\n",
+                 opsec_errno_str (opsec_errno));
+        return NULL;
+    }
+
+    if (rb != NULL)
+    {
+        if (lea_filter_rulebase_register (pSession, rb, &rbid) ==
+                LEA_FILTER_ERR)
         {
-            keepAlive = TRUE;
+            fprintf (stderr, "ERROR: Cannot register rulebase\n");
         }
-        else
-        {
-            keepAlive = FALSE;
-        };
-        break;
-    case BAD_VERSION:
-        if (cfgvalues.debug_mode)
+    }
+    else
+    {
+        lea_session_resume (pSession);
+    }
+    return pSession;
+}
+
+/*
+ * function catchup_admit
+ *
+ * decides whether a record at pos is emitted while the backlog is drained.
+ * The first live record fixes the hand-off position: the catch-up session
+ * stops below it and the live session skips what the catch-up session has
+ * already emitted.
+ */
+int
+catchup_admit (OpsecSession * pSession, int pos)
+{
+    if (pSession == catchup.session)
+    {
+        if ((catchup.handoff_pos >= 0) && (pos >= catchup.handoff_pos))
         {
-            fprintf (stderr, "ERROR: Incorrect version at other side.\n");
+            catchup_complete ();
+            return FALSE;
         }
-        keepAlive = FALSE;
-        break;
-    case PEER_SEND_DROP:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: The peer dropped the connection.\n");
-        }
-        if (established)
-        {
-            keepAlive = TRUE;
-        }
-        else
-        {
-            keepAlive = FALSE;
-        };
-        break;
-    case PEER_ENDED:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: The peer ends.\n");
-        }
-        keepAlive = FALSE;
-        break;
-    case PEER_SEND_RESET:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: The peer reset the connection.\n");
-        }
-        if (established)
-        {
-            keepAlive = TRUE;
-        }
-        else
-        {
-            keepAlive = FALSE;
-        };
-        break;
-    case COMM_IS_DEAD:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "ERROR: No communication.\n");
-        }
-        if (established)
-        {
-            keepAlive = TRUE;
-        }
-        else
-        {
-            keepAlive = FALSE;
-        };
-        break;
-    case SIC_FAILURE:
-        if (!opsec_get_sic_error (psession, &sic_errno, &sic_errmsg))
-        {
-            if (cfgvalues.debug_mode)
-            {
-                fprintf (stderr, "ERROR: SIC ERROR %d - %s\n", sic_errno,
-                         sic_errmsg);
-            }
-        }
-        keepAlive = FALSE;
-        break;
-    default:
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "Warning: Unknown reason of session end.\n");
-        }
-        keepAlive = FALSE;
-        break;
-    }   //end of switch
+        catchup.last_pos = pos;
+        catchup.records++;
+        return TRUE;
+    }
 
-    if (pContext->config_entity.length() > 0)
+    if (catchup.failed)
     {
-        last_rec_pos = lea_get_record_pos(psession);
-        if (last_rec_pos <= 0)
-        {
-            if (cfgvalues.debug_mode)
-            {
-                fprintf (stderr,
-                         "ERROR: Received error when trying to obtain last record number: function call lea_get_record_pos");
-            }
-        }
-        else
-        {
-            logdesc = lea_get_logfile_desc(psession);
-            if (cfgvalues.debug_mode && !logdesc)
-            {
-                fprintf (stderr,
-                         "ERROR: Received error when trying to obtain log file descriptor: function call lea_get_logfile_desc");
-            }
-            else
-            {
-                int retryWait = 1;
-                for (int i = 0; i < cfgvalues.splunkRestMaxRetries; i++)
-                {
-                    if (postEntityLogStatus(pContext->config_entity, pContext->status_server,
-                                            pContext->log_status_endpoint,
-                                            pContext->status_server_auth_token,
-                                            logdesc,  last_rec_pos))
-                    {
-                        break;
-                    }
-                    sleep(retryWait);
-                    retryWait = retryWait*cfgvalues.splunkRestRetryFactor;
-                }
-            }
-        }
-        postEntityHealthStatus(pContext->config_entity, pContext->status_server,
-                               pContext->entity_health_endpoint,
-                               pContext->status_server_auth_token, established);
+        return FALSE;
     }
-    return OPSEC_SESSION_OK;
+    if (catchup.handoff_pos < 0)
+    {
+        catchup.handoff_pos = pos;
+    }
+    return (pos > catchup.last_pos);
 }
 
 /*
- * function read_fw1_logfile_start
+ * function catchup_complete
+ *
+ * commits the drained backlog, from here on the live session checkpoints
  */
-int
-read_fw1_logfile_start (OpsecSession * psession)
+void
+catchup_complete ()
 {
+    PSESSION_CONTEXT pContext =
+        (PSESSION_CONTEXT) SESSION_OPAQUE(catchup.session);
+    stringstream sstream;
+
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_start\n");
+        fprintf (stderr, "DEBUG: function catchup_complete\n");
     }
 
-    if (cfgvalues.debug_mode)
+    catchup.active = FALSE;
+    if (pContext->config_entity.length() > 0)
     {
-        fprintf (stderr, "DEBUG: OPSEC session start handler was invoked\n");
+        opsec_deschedule (pContext->env, checkpoint_timer, pContext);
+        checkpoint_commit (pContext);
+        checkpoint_close (pContext);
     }
-    return OPSEC_SESSION_OK;
+
+    sstream << "catchup_records=" << catchup.records
+            << "|catchup_handoff_pos=" << catchup.handoff_pos
+            << "|catchup_ms=" << (current_time_ms () - catchup.started);
+    metrics_emit (sstream.str());
 }
 
 /*
- * function read_fw1_logfile_established
+ * function catchup_end
+ *
+ * end handler of the catch-up session. Ending before the hand-off leaves a
+ * gap, so the live session is ended too and both are started again.
  */
 int
-read_fw1_logfile_established (OpsecSession * psession)
+catchup_end (OpsecSession * psession)
 {
+    PSESSION_CONTEXT pContext = (PSESSION_CONTEXT) SESSION_OPAQUE(psession);
+
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_established\n");
+        fprintf (stderr, "DEBUG: function catchup_end\n");
     }
 
-    if (cfgvalues.debug_mode)
+    catchup.session = NULL;
+    if (!catchup.active)
     {
-        fprintf (stderr,
-                 "DEBUG: OPSEC session established handler was invoked\n");
+        return OPSEC_SESSION_OK;
+    }
+
+    fprintf (stderr,
+             "ERROR: catch-up session ended at position %d before the hand-off\n",
+             catchup.last_pos);
+    catchup.failed = TRUE;
+    if (pContext->config_entity.length() > 0)
+    {
+        opsec_deschedule (pContext->env, checkpoint_timer, pContext);
+        checkpoint_commit (pContext);
+        checkpoint_close (pContext);
+    }
+    if (catchup.live != NULL)
+    {
+        opsec_end_session (catchup.live);
     }
-    established = TRUE;
     return OPSEC_SESSION_OK;
 }
 
 /*
- * function read_fw1_logfile_failedconn
+ * function stall_watch_start
+ *
+ * puts the live session under the watchdog, the gap learned from the
+ * previous sessions is kept
  */
-int
-read_fw1_logfile_failedconn (OpsecEntity * entity, long peer_ip,
-                             int sic_errno, char *sic_errmsg)
+void
+stall_watch_start (OpsecSession * pSession, OpsecEntity * pClient,
+                   OpsecEntity * pServer, char *LogfileName, int fileid,
+                   LeaFilterRulebase * rb)
 {
-    if (cfgvalues.debug_mode >= 2)
+    stall.session = pSession;
+    stall.client = pClient;
+    stall.server = pServer;
+    stall.rb = rb;
+    stall.logfile = LogfileName;
+    stall.fileid = fileid;
+    stall.last_pos = -1;
+    stall.last_record = current_time_ms ();
+    stall.probe = NULL;
+    stall.tripped = FALSE;
+}
+
+/*
+ * function stall_watch_record
+ *
+ * notes a record of the live session and learns the gap between records
+ */
+void
+stall_watch_record (OpsecSession * pSession, int pos)
+{
+    long now;
+    long gap;
+
+    if ((pSession != stall.session) || (stall.session == NULL))
     {
-        fprintf (stderr, "DEBUG: function read_fw1_logfile_failedconn\n");
+        return;
     }
-
-    if (cfgvalues.debug_mode)
+    now = current_time_ms ();
+    if (stall.last_pos >= 0)
     {
-        fprintf (stderr,
-                 "DEBUG: OPSEC failed connection handler was invoked\n");
+        gap = now - stall.last_record;
+        stall.gap_avg = (stall.samples == 0) ? gap :
+                        stall.gap_avg + (gap - stall.gap_avg) / 8;
+        stall.samples++;
     }
-    return OPSEC_SESSION_OK;
+    stall.last_record = now;
+    stall.last_pos = pos;
 }
 
 /*
- * function get_fw1_logfiles
+ * function stall_threshold
+ *
+ * the silence after which the live session is probed, in ms
  */
-int
-get_fw1_logfiles (const string& entity)
+static long
+stall_threshold ()
 {
-    OpsecEntity *pClient = NULL;
-    OpsecEntity *pServer = NULL;
-    OpsecSession *pSession = NULL;
-    OpsecEnv *pEnv = NULL;
-    int opsecAlive;
-
-    char *auth_type;
-    char *fw1_server;
-    char *fw1_port;
-    char *opsec_certificate;
-    char *opsec_client_dn;
-    char *opsec_server_dn;
+    long threshold = cfgvalues.stall_timeout * 1000L;
+    long learned = stall.gap_avg * STALL_GAP_FACTOR;
 
-    if (cfgvalues.debug_mode >= 2)
+    if ((stall.samples >= STALL_MIN_SAMPLES) && (learned < threshold))
     {
-        fprintf (stderr, "DEBUG: function get_fw1_logfiles\n");
+        threshold = (learned > STALL_MIN_MS) ? learned : STALL_MIN_MS;
     }
+    return threshold;
+}
 
-    /* create opsec environment for the main loop */
-    if (cfgvalues.app_name.length() > 0)
-    {
-        int argc = 0;
-        char** argv = NULL;
-        if (!getSplunkLeaConfigArgs(entity,
-                                    cfgvalues,
-                                    &argc, &argv))
-        {
-            fprintf (stderr, "ERROR: unable to get splunk lea config arguments(get_fw1_logfiles)\n");
-            exit_loggrabber (1);
-
-        }
-
-        if ((pEnv =
-                    opsec_init (OPSEC_CONF_ARGV, &argc, argv,
-                                OPSEC_EOL)) == NULL)
-        {
-            fprintf (stderr, "ERROR: unable to create environment (%s)\n",
-                     opsec_errno_str (opsec_errno));
-            exit_loggrabber (1, entity);
-        }
+/*
+ * function stall_timer
+ *
+ * scheduled once per second in the opsec mainloop while a live session is
+ * watched. A silent session is probed behind its last record: a record
+ * there was never delivered, so the session is ended and read_fw1_logfile
+ * reconnects. A session that has not delivered any record yet cannot be
+ * probed and is ended after STALL_TIMEOUT, which is why the watchdog is
+ * off unless STALL_TIMEOUT is set: a quiet feed looks the same.
+ */
+void
+stall_timer (void *opaque)
+{
+    OpsecEnv *pEnv = (OpsecEnv *) opaque;
+    stringstream sstream;
+    const char *reason = NULL;
+    long now = current_time_ms ();
+    long silence = now - stall.last_record;
+    long threshold = stall_threshold ();
 
-    }
-    else
+    if ((stall.session == NULL) || stall.tripped)
     {
-        if ((pEnv =
-                    opsec_init (OPSEC_CONF_FILE, cfgvalues.leaconfig_filename,
-                                OPSEC_EOL)) == NULL)
-        {
-            fprintf (stderr, "ERROR: unable to create environment (%s)\n",
-                     opsec_errno_str (opsec_errno));
-            exit_loggrabber (1);
-        }
-
+        return;
     }
 
-    if (cfgvalues.debug_mode)
+    if (stall.probe != NULL)
     {
+        int running = (fw1_env.roles.find (stall.probe) != fw1_env.roles.end());
 
-        fprintf (stderr, "DEBUG: OPSEC LEA conf file is %s\n",
-                 cfgvalues.leaconfig_filename);
-
-        fw1_server = opsec_get_conf (pEnv, "lea_server", "ip", NULL);
-        if (fw1_server == NULL)
+        if (stall.last_record >= stall.probe_started)
         {
-            fprintf (stderr,
-                     "ERROR: The fw1 server ip address has not been set.\n");
-            exit_loggrabber (1, entity);
-        }     //end of if
-        auth_type = opsec_get_conf (pEnv, "lea_server", "auth_type", NULL);
-        if (auth_type != NULL)
+            // the session delivered again while it was probed
+            if (running)
+            {
+                opsec_end_session (stall.probe);
+            }
+            stall.probe = NULL;
+        }
+        else if (!running)
         {
-            //Authentication mode
-            fw1_port = opsec_get_conf (pEnv, "lea_server", "auth_port", NULL);
-            opsec_certificate = opsec_get_conf (pEnv, "opsec_sslca_file", NULL);
-            opsec_client_dn = opsec_get_conf (pEnv, "opsec_sic_name", NULL);
-            opsec_server_dn =
-                opsec_get_conf (pEnv, "lea_server", "opsec_entity_sic_name",
-                                NULL);
-            if ((fw1_port == NULL) || (opsec_certificate == NULL)
-                    || (opsec_client_dn == NULL) || (opsec_server_dn == NULL))
+            stall.probe = NULL;
+            if (stall.result.found)
             {
-                fprintf (stderr,
-                         "ERROR: The parameters about authentication mode have not been set.\n");
-                exit_loggrabber (1, entity);
+                reason = "behind";
             }
             else
             {
-                fprintf (stderr, "DEBUG: Authentication mode has been used.\n");
-                fprintf (stderr, "DEBUG: Server-IP     : %s\n", fw1_server);
-                fprintf (stderr, "DEBUG: Server-Port     : %s\n", fw1_port);
-                fprintf (stderr, "DEBUG: Authentication type: %s\n", auth_type);
-                fprintf (stderr,
-                         "DEBUG: OPSEC sic certificate file name : %s\n",
-                         opsec_certificate);
-                fprintf (stderr, "DEBUG: Server DN (sic name) : %s\n",
-                         opsec_server_dn);
-                fprintf (stderr, "DEBUG: OPSEC LEA client DN (sic name) : %s\n",
-                         opsec_client_dn);
-            }     //end of inner if
+                stall.quiet++;
+                stall.last_record = now;
+            }
         }
-        else
+        else if (now - stall.probe_started >= STALL_MIN_MS)
         {
-            //Clear Text mode, i.e. non-auth mode
-            fw1_port = opsec_get_conf (pEnv, "lea_server", "port", NULL);
-            if (fw1_port != NULL)
+            opsec_end_session (stall.probe);
+            stall.probe = NULL;
+            reason = "probe_timeout";
+        }
+    }
+    else if (silence >= threshold)
+    {
+        if (stall.last_pos >= 0)
+        {
+            if (cfgvalues.debug_mode)
             {
-                fprintf (stderr, "DEBUG: Clear text mode has been used.\n");
-                fprintf (stderr, "DEBUG: Server-IP        : %s\n", fw1_server);
-                fprintf (stderr, "DEBUG: Server-Port      : %s\n", fw1_port);
+                fprintf (stderr,
+                         "DEBUG: No record for %ld ms, probing behind position %d\n",
+                         silence, stall.last_pos);
             }
-            else
+            stall.probe_started = now;
+            stall.probe = probe_start (stall.client, stall.server,
+                                       stall.logfile, stall.fileid,
+                                       stall.last_pos + 1, stall.rb,
+                                       &stall.result);
+            if (stall.probe == NULL)
             {
-                fprintf (stderr,
-                         "ERROR: The fw1 server lea service port has not been set.\n");
-                exit_loggrabber (1, entity);
-            }     //end of inner if
-        }     //end of middle if
-    }       //end of if
+                reason = "probe_failed";
+            }
+        }
+        else if (silence >= cfgvalues.stall_timeout * 1000L)
+        {
+            reason = "no_records";
+        }
+    }
 
+    if (reason == NULL)
+    {
+        opsec_schedule (pEnv, 1000, stall_timer, pEnv);
+        return;
+    }
 
-    /*
-     * initialize opsec-client
-     */
-    pClient = opsec_init_entity (pEnv, LEA_CLIENT,
-                                 LEA_DICT_HANDLER, get_fw1_logfiles_dict,
-                                 OPSEC_SESSION_END_HANDLER,
-                                 get_fw1_logfiles_end, OPSEC_EOL);
+    fprintf (stderr,
+             "WARNING: online session delivered no record for %ld ms (%s), reconnecting\n",
+             silence, reason);
+    stall.stalls++;
+    stall.tripped = TRUE;
+    sstream << "stalls=" << stall.stalls
+            << "|stall_reason=" << reason
+            << "|stall_silence_ms=" << silence
+            << "|stall_threshold_ms=" << threshold
+            << "|stall_gap_avg_ms=" << stall.gap_avg
+            << "|stall_probes_quiet=" << stall.quiet;
+    metrics_emit (sstream.str());
+    opsec_end_session (stall.session);
+}
 
-    /*
-     * initialize opsec-server for authenticated and unauthenticated connections
-     */
-    pServer =
-        opsec_init_entity (pEnv, LEA_SERVER, OPSEC_ENTITY_NAME, "lea_server",
-                           OPSEC_EOL);
+/*
+ * function read_fw1_logfile_queryack
+ */
+int
+read_fw1_logfile_queryack (OpsecSession * psession, int filterID,
+                           eLeaFilterAction filterAction, int filterResult)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_queryack\n");
+    }
 
-    /*
-     * continue only if opsec initializations were successful
-     */
-    if ((!pClient) || (!pServer))
+    if (cfgvalues.debug_mode)
     {
-        fprintf (stderr,
-                 "ERROR: failed to initialize client/server-pair (%s)\n",
-                 opsec_errno_str (opsec_errno));
-        cleanup_fw1_environment (pEnv, pClient, pServer);
-        exit_loggrabber (1, entity);
+        fprintf (stderr, "DEBUG: LEA logfile query ack handler was invoked\n");
     }
-
-    /*
-     * create LEA-session
-     */
-    if (!
-            (pSession =
-                 lea_new_session (pClient, pServer, LEA_OFFLINE, LEA_FILENAME,
-                                  LEA_NORMAL, LEA_AT_START)))
-    {
-        fprintf (stderr, "ERROR: failed to create session (%s)\n",
-                 opsec_errno_str (opsec_errno));
-        cleanup_fw1_environment (pEnv, pClient, pServer);
-        exit_loggrabber (1, entity);
-    }
-
-    opsecAlive = opsec_start_keep_alive (pSession, 0);
-
-    /*
-     * start the opsec loop
-     */
-    opsec_mainloop (pEnv);
-
-    /*
-     * remove opsec stuff
-     */
-    cleanup_fw1_environment (pEnv, pClient, pServer);
-
-    return 0;
-}
+    lea_session_resume (psession);
+    return OPSEC_SESSION_OK;
+}
 
 /*
- * function get_fw1_logfiles_dict
+ * function string_cat
  */
-int
-get_fw1_logfiles_dict (OpsecSession * pSession, int nDictId, LEA_VT nValType,
-                       int nEntries)
+unsigned int
+string_cat (char **dst, const char *src, unsigned int cap)
 {
-    int learesult = 0;
-    int nID = 0;
-    int aID = 0;
-    char *logfile = NULL;
+    char *buffer = NULL;
+    unsigned int capacity = cap;
 
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function get_fw1_logfiles_dict\n");
+        fprintf (stderr, "DEBUG: function string_cat\n");
     }
 
-    if (cfgvalues.debug_mode)
+    // allocate memory for the string if NULL
+    if (*dst == NULL)
     {
-        fprintf (stderr, "DEBUG: Available FW-1 Logfiles\n");
+        *dst = (char *) malloc (INITIAL_CAPACITY + 1);
+        if (*dst == NULL)
+        {
+            fprintf (stderr, "ERROR: Out of memory\n");
+            exit_loggrabber (1);
+        }
+        **dst = '\0';
+        capacity = INITIAL_CAPACITY;
     }
 
-    if (cfgvalues.showfiles_mode)
+    // is src NULL, just return the capacity of dst
+    if (!src)
     {
-        fprintf (stderr, "Available FW-1 Logfiles\n");
+        return (capacity);
     }
 
-    /*
-     * get names of available logfiles and create list of these names
-     */
-    learesult = lea_get_first_file_info (pSession, &logfile, &nID, &aID);
-
-    if (cfgvalues.debug_mode >= 2)
+    // is the capacity big enough for both src and dst?
+    if (capacity >= strlen (*dst) + strlen (src))
     {
-        fprintf (stderr, "DEBUG: function get_fw1_logfiles_dict, lea_get_first_file_info returned %d\n",
-                 learesult);
+        strcat (*dst, src);
+        return (capacity);
     }
-    while (LEA_SESSION_FILE_PURGED == learesult || LEA_SESSION_OK == learesult)
+
+    // otherwise define the new capacity
+    capacity =
+        ((capacity + CAPACITY_INCREMENT) >=
+         (strlen (*dst) + strlen (src))) ? (capacity +
+                                            CAPACITY_INCREMENT) : (strlen (*dst) +
+                                                    strlen (src));
+
+    // and allocate a temp buffer for dst
+    buffer = (char *) malloc (strlen (*dst) + 1);
+    if (!buffer)
     {
-        if (cfgvalues.debug_mode)
-        {
-            fprintf (stderr, "DEBUG: - %s\n", logfile);
-        }
-        if (cfgvalues.showfiles_mode)
-        {
-            fprintf (stderr, "- %s\n", logfile);
-        }
-        stringlist_append (&sl, logfile, nID, aID);
-        learesult = lea_get_next_file_info (pSession, &logfile, &nID, &aID);
-        if (cfgvalues.debug_mode >= 2)
-        {
-            fprintf (stderr, "DEBUG: function get_fw1_logfiles_dict, lea_get_next_file_info returned %d\n",
-                     learesult);
-        }
+        fprintf (stderr, "ERROR: Out of memory\n");
+        exit_loggrabber (1);
     }
 
-    /*
-     * end opsec-session
-     */
-    opsec_end_session (pSession);
-
-    return OPSEC_SESSION_OK;
-}
+    // copy dst to the tempbuffer and destroy dst
+    strcpy (buffer, *dst);
+    free (*dst);
 
-/*
- * function cleanup_fw1_environment
- */
-void
-cleanup_fw1_environment (OpsecEnv * env, OpsecEntity * client,
-                         OpsecEntity * server)
-{
-    if (cfgvalues.debug_mode >= 2)
+    // recreate dst with the new capacity
+    *dst = (char *) malloc (capacity + 1);
+    if (*dst == NULL)
     {
-        fprintf (stderr, "DEBUG: function cleanup_fw1_environment\n");
+        fprintf (stderr, "ERROR: Out of memory\n");
+        exit_loggrabber (1);
     }
 
-    if (client)
-        opsec_destroy_entity (client);
-    if (server)
-        opsec_destroy_entity (server);
-    if (env)
-        opsec_env_destroy (env);
+    // finally copy buffered dst and src back to dest and destroy temp buffer
+    strcpy (*dst, buffer);
+    free (buffer);
+    strcat (*dst, src);
+
+    // retrung new capacity
+    return (capacity);
 }
 
 /*
- * function show_supported_fields
+ * function record_submit
+ *
+ * hands a formatted record on to the output, or to --dedup to be held
  */
-void
-show_supported_fields ()
+static void
+record_submit (PSESSION_CONTEXT pContext, int pos, int ahead, int dedup_slot,
+               unsigned long rec_time, const char *message)
 {
-    int i;
-
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function show_supported_fields\n");
-    }
+    char *mymsg;
 
-    fprintf (stderr,
-             "\nFW1-Loggrabber v%s, (C)2004, Torsten Fellhauer, Xiaodong Lin\n",
-             VERSION);
-    fprintf (stderr, "Supported Fields for normal logs:\n");
-    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    if (!ahead)
     {
-        fprintf (stderr, "  - %s\n", *lfield_headers[i]);
+        watermark.submitted_pos = dedup_handoff_pos (pos);
     }
-    fprintf (stderr, "Supported Fields for audit logs:\n");
-    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    backfill.records++;
+    if ((cfgvalues.log_mode != ODBC) && (message != NULL) && (strlen (message) > 0))
     {
-        fprintf (stderr, "  - %s\n", *afield_headers[i]);
+        compress_stamp (pos, rec_time);
+        mymsg = string_mask_newlines ((char *) message);
+        if (dedup_slot >= 0)
+        {
+            dedup_hold (dedup_slot, mymsg);
+        }
+        else
+        {
+            submit_log (mymsg);
+        }
+        free (mymsg);
     }
-}
 
-/*
- * function usage
- */
-void
-usage (char *szProgName)
-{
-    if (cfgvalues.debug_mode >= 2)
+    if ((pContext->config_entity.length() > 0) && !ahead)
     {
-        fprintf (stderr, "DEBUG: function usage\n");
+        checkpoint_record (pContext, pos);
     }
-
-    fprintf (stderr, "\nFW1-Loggrabber v%s (%s)\n", VERSION, ODBCVERSION);
-    fprintf (stderr, "    (C)2005, Torsten Fellhauer, Xiaodong Lin\n\n");
-    fprintf (stderr, "Usage:\n");
-    fprintf (stderr, " %s [ options ]\n", szProgName);
-    fprintf (stderr,
-             "  -c|--configfile <file>     : Name of Configfile (default: fw1-loggrabber.conf)\n");
-    fprintf (stderr,
-             "  -l|--leaconfigfile <file>  : Name of Leaconfigfile (default: lea.conf)\n");
-    fprintf (stderr,
-             "  -f|--logfile Logfile|ALL   : Name of Logfile (default: fw.log)\n");
-    fprintf (stderr,
-             "  --resolve|--no-resolve     : Resolve Port Numbers and IP-Addresses (Default: Resolve)\n");
-    fprintf (stderr,
-             "  --showfiles|--showlogs     : Show only Filenames of all available FW-1 Logfiles (default: showlogs)\n");
-    fprintf (stderr,
-             "  --2000|--ng                : Connect to a CP FW-1 4.1 (2000) (default is ng)\n");
-    fprintf (stderr,
-             "  --filter \"...\"             : Specify filters to be applied\n");
-    fprintf (stderr,
-             "  --fields \"...\"             : Specify fields to be printed\n");
-    fprintf (stderr,
-             "  --online|--no-online       : Enable Online mode (default: no-online)\n");
-    fprintf (stderr,
-             "  --auditlog|--normallog     : Get data of audit-logfile (fw.adtlog)(default: normallog)\n");
-    fprintf (stderr,
-             "  --debug-level <level>      : Specify Debuglevel (default: 0 - no debugging)\n");
-    fprintf (stderr,
-             "  --configentity <entity>    : Specifies the entity name in the Splunk opsec app endpoint to collect logs from\n");
-    fprintf (stderr,
-             "  --configserver <splunkd>   : optional, specifies the Splunk instance to get lea configuration from, e.g. https://127.0.0.1:8089/. defaults to instance in $SPLUNK_HOME\n");
-    fprintf (stderr,
-             "  --statusserver <splunkd>   : optional, specifies the Splunk instance to post status information to, e.g. https://127.0.0.1:8089/. defaults to instance in $SPLUNK_HOME\n");
-    fprintf (stderr,
-             "  --appname <app>            : Specifies the name of the splunk app on the Splunk server \n");
-    fprintf (stderr,
-             "  --help                     : Show usage informations\n");
-    fprintf (stderr,
-             "  --help-fields              : Show supported log fields\n");
 }
 
 /*
- * function stringlist_append
+ * function read_fw1_logfile_record
  */
 int
-stringlist_append (stringlist ** lst, char *data, int normalFID, int accountFID)
+read_fw1_logfile_record (OpsecSession * pSession, lea_record * pRec,
+                         int pnAttribPerm[])
 {
+    char *szAttrib;
+    char szNum[20];
+    int i, j, match, index;
+    unsigned long ul;
+    unsigned short us;
+    char tmpdata[16];
+    time_t logtime;
+    struct tm *datetime;
+    char timestring[21];
+    char *tmpstr1;
+    char *tmpstr2;
+    short first = TRUE;
+    char *message = NULL;
+    char *(**headers);
+    int *order;
+    int num;
+    int time;
+    int number_fields;
+    unsigned int messagecap = 0;
+    int last_rec_pos = -1;
+    unsigned long sample_rate = 1;
+    unsigned long rec_time = 0;
+    int dedup_slot = -1;
+    vector<string> fields;
+    vector<string> field_names;
+
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function stringlist_append\n");
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_record\n");
     }
 
-    /*
-     * return if data is NULL
-     */
-    if (data == NULL)
+    if (cfgvalues.audit_mode)
     {
-        return 0;
+        num = AIDX_NUM;
+        time = AIDX_TIME;
+        number_fields = NUMBER_AIDX_FIELDS;
+        headers = afield_headers;
+        order = afield_order;
+    }
+    else
+    {
+        num = LIDX_NUM;
+        time = LIDX_TIME;
+        number_fields = NUMBER_LIDX_FIELDS;
+        headers = lfield_headers;
+        order = lfield_order;
     }
 
     /*
-     * move to last element of list
-     */
-    while (*lst)
-        lst = &((*lst)->next);
-    /*
-     * allocate memory for new element
+     * get record position
      */
-    *lst = (stringlist *) malloc (sizeof (stringlist));
-    if (*lst == NULL)
-        return 0;
+    last_rec_pos = lea_get_record_pos (pSession) - 1;
+    stall_watch_record (pSession, last_rec_pos + 1);
+
     /*
-     * append new element
+     * LEA_AT_POS starts at the checkpointed record itself, skip what has
+     * already been emitted before the restart
      */
-    (*lst)->data = string_duplicate (data);
-    (*lst)->normalFID = normalFID;
-    (*lst)->accountFID = accountFID;
-    (*lst)->next = NULL;
-    return 1;
-}
-
-/*
- * function stringlist_print
- */
-void
-stringlist_print (stringlist ** lst)
-{
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function stringlist_print\n");
-    }
-
-    while (*lst)
-    {
-        printf ("%s %d %d\n", (*lst)->data, (*lst)->normalFID, (*lst)->accountFID);
-        lst = &((*lst)->next);
-    }
-}
-
-/*
- * function stringlist_delete
- */
-stringlist *
-stringlist_delete (stringlist ** lst)
-{
-    stringlist *first;
-
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function stringlist_delete\n");
-    }
-
-    if (*lst)
+    PSESSION_CONTEXT pContext = (PSESSION_CONTEXT) SESSION_OPAQUE(pSession);
+    if (last_rec_pos < pContext->checkpoint.resume_pos)
     {
-        first = (*lst)->next;
-        free ((*lst)->data);
-        free (*lst);
-        return (first);
+        return OPSEC_SESSION_OK;
     }
-    else
+    if ((backfill.end_pos >= 0) && (last_rec_pos >= backfill.end_pos))
     {
-        return (NULL);
+        return OPSEC_SESSION_END;
     }
-}
-
-/*
- * function stringlist_search
- */
-stringlist *
-stringlist_search (stringlist ** lst, char *searchstring, char **result)
-{
-    if (cfgvalues.debug_mode >= 2)
+    if (catchup.active && !catchup_admit (pSession, last_rec_pos + 1))
     {
-        fprintf (stderr, "DEBUG: function stringlist_search\n");
+        return (pSession == catchup.session) ? OPSEC_SESSION_END : OPSEC_SESSION_OK;
     }
 
     /*
-     * return if searchstring is NULL
+     * until the hand-off the checkpoint follows the catch-up session only,
+     * live records above it are not contiguous
      */
-    if (searchstring == NULL)
-    {
-        return NULL;
-    }
+    int ahead = catchup.active && (pSession == catchup.live);
 
     /*
-     * compare all elements of list with given string
+     * the local filter and the sampling run on the raw record, a dropped
+     * record counts as handed off
      */
-    while (*lst)
+    if (!post_filter_match (pSession, pRec) ||
+            ((sample_rate = sample_record (pSession, pRec, last_rec_pos + 1)) == 0))
     {
-        if (strstr ((*lst)->data, searchstring))
+        if (!ahead && (aggregate.used > 0))
         {
-            *result = (*lst)->data;
-//                      *result = string_duplicate((*lst)->data);
-            return (*lst);
+            // handed off together with the rollup in front of it
+            aggregate.context = pContext;
+            aggregate.last_pos = last_rec_pos + 1;
         }
-        lst = &((*lst)->next);
+        else if (!ahead)
+        {
+            watermark.submitted_pos = dedup_handoff_pos (last_rec_pos + 1);
+            if (pContext->config_entity.length() > 0)
+            {
+                checkpoint_record (pContext, last_rec_pos + 1);
+            }
+        }
+        return OPSEC_SESSION_OK;
     }
-    return NULL;
-}
-
-/*
- * function create_fw1_filter_rule
- */
-LeaFilterRulebase *
-create_fw1_filter_rule (LeaFilterRulebase * prulebase, char filterstring[255])
-{
-    LeaFilterRule *prule;
-    LeaFilterPredicate *ppred;
-    char *filterargument;
-    char *argumentvalue;
-    char *argumentname;
-    unsigned int tempint;
-    unsigned int tmpint1;
-    unsigned int tmpint2;
-    unsigned short tempushort;
-    unsigned short tmpushort1;
-    unsigned short tmpushort2;
-    unsigned long templong;
-    lea_value_ex_t **val_arr;
-    lea_value_ex_t *lea_value;
-    char *argumentsinglevalue;
-    int argumentcount;
-    int negation;
-    char *tmpstring1;
-    char *tmpstring2;
-    struct tm timestruct;
-    char tempchararray[10];
 
-    if (cfgvalues.debug_mode >= 2)
+    /*
+     * --aggregate: the record is folded into the rollup, not formatted
+     */
+    if (cfgvalues.aggregate_window > 0)
     {
-        fprintf (stderr, "DEBUG: function create_fw1_filter_rule\n");
+        aggregate_record (pSession, pRec, ahead ? NULL : pContext,
+                          last_rec_pos + 1, sample_rate);
+        backfill.records++;
+        return OPSEC_SESSION_OK;
     }
 
     /*
-     * create an empty rule with action "pass"
+     * --dedup: a repeat of a held record is only counted
      */
-    if ((prule = lea_filter_rule_create (LEA_FILTER_ACTION_PASS)) == NULL)
+    if ((cfgvalues.dedup_window > 0) &&
+            ((dedup_slot = dedup_record (pSession, pRec, last_rec_pos + 1)) < 0))
     {
-        fprintf (stderr, "ERROR: failed to create rule\n");
-        lea_filter_rulebase_destroy (prulebase);
-        return NULL;
+        watermark.submitted_pos = dedup_handoff_pos (last_rec_pos + 1);
+        if (pContext->config_entity.length() > 0)
+        {
+            checkpoint_record (pContext, last_rec_pos + 1);
+        }
+        backfill.records++;
+        return OPSEC_SESSION_OK;
     }
 
     /*
-     * split filter string in arguments separated by ";"
+     * columnar and binary output take the typed values, the record is not
+     * formatted
      */
-    filterargument = strtok (filterstring, ";");
-    while (filterargument != NULL)
+    if ((cfgvalues.log_mode == COLUMNAR) || (cfgvalues.log_mode == BINARY))
     {
-        /*
-         * split argument into name and value separated by "="
-         */
-        argumentvalue = strchr (filterargument, '=');
-        if (argumentvalue == NULL)
+        if (!ahead)
         {
-            fprintf (stderr, "ERROR: syntax error in rule argument '%s'.\n"
-                     "       Required syntax: 'argument=value'\n",
-                     filterargument);
-            return NULL;
+            watermark.submitted_pos = last_rec_pos + 1;
         }
-        argumentvalue++;
-        argumentname = filterargument;
-        argumentname[argumentvalue - filterargument - 1] = '\0';
-        argumentvalue = string_trim (argumentvalue, ' ');
-        argumentname = string_trim (argumentname, ' ');
-        filterargument = strtok (NULL, ";");
-        val_arr = NULL;
-
-        if (argumentname[strlen (argumentname) - 1] == '!')
+        if (cfgvalues.log_mode == COLUMNAR)
         {
-            negation = 1;
-            argumentname = string_trim (argumentname, '!');
+            columnar_record (pSession, pRec, last_rec_pos + 1, sample_rate);
         }
         else
         {
-            negation = 0;
+            binary_record (pSession, pRec, last_rec_pos + 1, sample_rate);
         }
+        backfill.records++;
+        if ((pContext->config_entity.length() > 0) && !ahead)
+        {
+            checkpoint_record (pContext, last_rec_pos + 1);
+        }
+        return OPSEC_SESSION_OK;
+    }
 
-        /*
-         * change argument name to lower case letters
-         */
-        for (tempint = 0; tempint < strlen (argumentname); tempint++)
+    /*
+     * OUTPUT_FORMAT=cef or leef: the line is built in place
+     */
+    if ((cfgvalues.output_format == FORMAT_CEF) ||
+            (cfgvalues.output_format == FORMAT_LEEF))
+    {
+        const char *line = cef_format (pSession, pRec, last_rec_pos + 1,
+                                       sample_rate, &rec_time);
+        record_submit (pContext, last_rec_pos + 1, ahead, dedup_slot, rec_time,
+                       line);
+        return OPSEC_SESSION_OK;
+    }
+
+    /*
+     * OUTPUT_FORMAT=csv or tsv: values only, in the order of FIELDS
+     */
+    if (cfgvalues.output_format != FORMAT_KV)
+    {
+        message = string_duplicate (csv_format (pSession, pRec, last_rec_pos + 1,
+                                                sample_rate, &rec_time).c_str());
+        record_submit (pContext, last_rec_pos + 1, ahead, dedup_slot, rec_time,
+                       message);
+        free (message);
+        return OPSEC_SESSION_OK;
+    }
+
+    // preserve 1-based for output to splunk
+    snprintf (szNum, sizeof(szNum), "%d", last_rec_pos+1);
+
+    fields.push_back(szNum);
+    field_names.push_back(*headers[num]);
+    /*
+     * process all fields of logentry
+     */
+    for (i = 0; i < pRec->n_fields; i++)
+    {
+        j = 0;
+        match = FALSE;
+        strcpy (tmpdata, "\0");
+        szAttrib = lea_attr_name (pSession, pRec->fields[i].lea_attr_id);
+        if (!szAttrib)
         {
-            argumentname[tempint] = tolower (argumentname[tempint]);
+            if (cfgvalues.debug_mode >= 2)
+            {
+                fprintf (stderr, "DEBUG: function read_fw1_logfile_record, lea_attr_name failed %d %d\n", i,
+                         pRec->n_fields);
+            }
+            continue;
         }
 
-        /*
-         * process arguments of type "product"
-         */
-        if (strcmp (argumentname, "product") == 0)
+        if (!(cfgvalues.resolve_mode))
         {
-            argumentcount = 0;
+            switch (pRec->fields[i].lea_val_type)
+            {
             /*
-             * get argument values separated by ","
+             * create dotted string of IP address. this differs between
+             * Linux and Solaris.
              */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                argumentcount++;
-                if (val_arr)
+            case LEA_VT_IP_ADDR:
+                ul = pRec->fields[i].lea_value.ul_value;
+                if (BYTE_ORDER == LITTLE_ENDIAN)
                 {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
+                    snprintf (tmpdata, sizeof(tmpdata), "%d.%d.%d.%d", (int) ((ul & 0xff) >> 0),
+                              (int) ((ul & 0xff00) >> 8),
+                              (int) ((ul & 0xff0000) >> 16),
+                              (int) ((ul & 0xff000000) >> 24));
                 }
                 else
                 {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-
-                /*
-                 * check validity of argument value
-                 */
-                if (!((strcmp (argumentsinglevalue, "VPN-1 & FireWall-1") == 0)
-                         || (strcmp (argumentsinglevalue, "SmartDefense") == 0)))
-                {
-                    fprintf (stderr, "ERROR: invalid value for product: '%s'\n",
-                             argumentsinglevalue);
-                    return NULL;
+                    snprintf (tmpdata, sizeof(tmpdata), "%d.%d.%d.%d",
+                              (int) ((ul & 0xff000000) >> 24),
+                              (int) ((ul & 0xff0000) >> 16),
+                              (int) ((ul & 0xff00) >> 8),
+                              (int) ((ul & 0xff) >> 0));
                 }
+                break;
 
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_STRING,
-                         argumentsinglevalue) == OPSEC_SESSION_ERR)
+            /*
+             * print out the port number of the used service
+             */
+            case LEA_VT_TCP_PORT:
+            case LEA_VT_UDP_PORT:
+                us = pRec->fields[i].lea_value.ush_value;
+                if (BYTE_ORDER == LITTLE_ENDIAN)
                 {
-                    fprintf (stderr, "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
+                    us = (us >> 8) + ((us & 0xff) << 8);
                 }
+                snprintf (tmpdata, sizeof(tmpdata), "%d", us);
+                break;
             }
+        }
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("product", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
+        if (strcmp (szAttrib, *headers[time]) == 0)
+        {
+            rec_time = pRec->fields[i].lea_value.ul_value;
+            switch (cfgvalues.dateformat)
             {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
+            case DATETIME_CP:
+                fields.push_back(lea_resolve_field(pSession, pRec->fields[i]));
+                field_names.push_back(*headers[time]);
+                break;
+            case DATETIME_UNIX:
+                snprintf (timestring, sizeof(timestring), "%lu",
+                          pRec->fields[i].lea_value.ul_value);
+                fields.push_back(timestring);
+                field_names.push_back(*headers[time]);
+                break;
+            case DATETIME_STD:
+                logtime = (time_t) pRec->fields[i].lea_value.ul_value;
+                datetime = localtime (&logtime);
+                strftime (timestring, 20, "%Y-%m-%d %H:%M:%S", datetime);
+                fields.push_back(timestring);
+                field_names.push_back(*headers[time]);
+                break;
+            default:
+                fprintf (stderr, "ERROR: Unsupported dateformat chosen\n");
+                exit_loggrabber (1);
             }
-
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
-
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
+        }
+        else
+        {
+            if (tmpdata[0])
             {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
+                fields.push_back(tmpdata);
+                field_names.push_back(szAttrib);
+            }
+            else
+            {
+                fields.push_back(lea_resolve_field
+                                 (pSession, pRec->fields[i]));
+                field_names.push_back(szAttrib);
             }
-
-            lea_filter_predicate_destroy (ppred);
         }
+    }
+
+    /*
+     * a sampled record stands for sample_rate records
+     */
+    if (sample_rate > 1)
+    {
+        snprintf (szNum, sizeof(szNum), "%lu", sample_rate);
+        fields.push_back(szNum);
+        field_names.push_back("sample_rate");
+    }
 
-        else if (strcmp (argumentname, "fw_subproduct") == 0)
+    /*
+     * print logentry to stdout
+     */
+    for (i = 0; i < fields.size(); i++)
+    {
+        // fieldname mode -> process only existing fields
+        if (output_fields.size() == 0 || output_fields.find(field_names[i]) != output_fields.end())
         {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                argumentcount++;
-                if (val_arr)
-                {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-                else
-                {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
+            tmpstr1 =
+                string_escape (field_names[i].c_str(),
+                               cfgvalues.record_separator);
+            tmpstr2 =
+                string_escape (fields[i].c_str(),
+                               cfgvalues.record_separator);
 
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_STRING,
-                         argumentsinglevalue) == OPSEC_SESSION_ERR)
-                {
-                    fprintf (stderr, "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
+            char* stringnumber;
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("fw_subproduct", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
+            if (first)
             {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
-
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
+                // snprintf reserves 1 byte for the null terminator
+                // Therefore another byte is added to guarantee there is enough room
+                int size = 1 + snprintf(NULL, 0, "%s=%s", tmpstr1, tmpstr2);
+                stringnumber = (char*) malloc(size);
+                snprintf(stringnumber, size, "%s=%s", tmpstr1, tmpstr2);
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
+                first = FALSE;
+            }
+            else
             {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
+                int size = 1 + snprintf(NULL, 0, "%c%s=%s",
+                                        cfgvalues.record_separator, tmpstr1, tmpstr2);
+
+                stringnumber = (char*) malloc(size + 1);
+                snprintf(stringnumber, size, "%c%s=%s",
+                         cfgvalues.record_separator, tmpstr1, tmpstr2);
             }
 
-            lea_filter_predicate_destroy (ppred);
-        }
+            messagecap = string_cat (&message, stringnumber, messagecap);
 
-        /*
-         * process arguments of type "action"
-         */
-        else if (strcmp (argumentname, "action") == 0)
+            free (tmpstr1);
+            free (tmpstr2);
+            free(stringnumber);
+        }
+    }
+
+    record_submit (pContext, last_rec_pos + 1, ahead, dedup_slot, rec_time,
+                   message);
+    free (message);
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_dict
+ */
+int
+read_fw1_logfile_dict (OpsecSession * psession, int dict_id, LEA_VT val_type,
+                       int n_d_entries)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_dict\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: LEA logfile dict handler was invoked\n");
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_eof
+ */
+int
+read_fw1_logfile_eof (OpsecSession * psession)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_eof\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: LEA end of logfile handler was invoked\n");
+    }
+
+    /*
+     * the catch-up session reached the end before the live session
+     * delivered anything, everything after it is left to the live one
+     */
+    if (psession == catchup.session)
+    {
+        if (catchup.active && !catchup.failed)
         {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
+            if (catchup.handoff_pos < 0)
             {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                argumentcount++;
-                if (val_arr)
-                {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-                else
-                {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
+                catchup.handoff_pos = catchup.last_pos + 1;
+            }
+            catchup_complete ();
+        }
+        return OPSEC_SESSION_END;
+    }
+
+    PSESSION_CONTEXT pContext = (PSESSION_CONTEXT) SESSION_OPAQUE(psession);
+    if (cfgvalues.aggregate_window > 0)
+    {
+        aggregate_flush (FALSE);
+    }
+    if (cfgvalues.dedup_window > 0)
+    {
+        dedup_flush ();
+    }
+    if (pContext && pContext->config_entity.length() > 0)
+    {
+        checkpoint_commit (pContext);
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_switch
+ */
+int
+read_fw1_logfile_switch (OpsecSession * psession)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_switch\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: LEA logfile switch handler was invoked\n");
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_collogs
+ */
+int
+read_fw1_logfile_collogs (OpsecSession * psession)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_collogs\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: LEA collected logfile handler was invoked\n");
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_suspend
+ */
+int
+read_fw1_logfile_suspend (OpsecSession * psession)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_suspend\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: LEA suspended session handler was invoked\n");
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_resume
+ */
+int
+read_fw1_logfile_resume (OpsecSession * psession)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_resume\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: LEA resumed session handler was invoked\n");
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function get_fw1_logfiles_end
+ */
+int
+get_fw1_logfiles_end (OpsecSession * psession)
+{
+    int end_reason = 0;
+    int sic_errno = 0;
+    char *sic_errmsg = NULL;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function get_fw1_logfiles_end\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: OPSEC_SESSION_END_HANDLER called\n");
+    }
+
+    // Check what is the reason of opsec session end
+    end_reason = opsec_session_end_reason (psession);
+    switch (end_reason)
+    {
+    case END_BY_APPLICATION:
+    case SESSION_TIMEOUT:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "DEBUG: The session has been ended.\n");
+        }
+        break;
+    case SESSION_NOT_ENDED:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "WARNING: The session has not been terminated.\n");
+        }
+        break;
+    case UNABLE_TO_ATTACH_COMM:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: Failed to establish connection.\n");
+        }
+        break;
+    case ENTITY_TYPE_SESSION_INIT_FAIL:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr,
+                     "ERROR: OPSEC API-specific library code on other side of connection failed when attempting to initialize the session.\n");
+        }
+        break;
+    case ENTITY_SESSION_INIT_FAIL:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr,
+                     "ERROR: Third-party start handler on other side of connection failed.\n");
+        }
+        break;
+    case COMM_FAILURE:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: Communication failure.\n");
+        }
+        break;
+    case BAD_VERSION:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: Incorrect version at other side.\n");
+        }
+        break;
+    case PEER_SEND_DROP:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: The peer dropped the connection.\n");
+        }
+        break;
+    case PEER_ENDED:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: The peer ends.\n");
+        }
+        break;
+    case PEER_SEND_RESET:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: The peer reset the connection.\n");
+        }
+        break;
+    case COMM_IS_DEAD:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: No communication.\n");
+        }
+        break;
+    case SIC_FAILURE:
+        if (!opsec_get_sic_error (psession, &sic_errno, &sic_errmsg))
+        {
+            if (cfgvalues.debug_mode)
+            {
+                fprintf (stderr, "ERROR: SIC ERROR %d - %s\n", sic_errno,
+                         sic_errmsg);
+            }
+        }
+        break;
+    default:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "Warning: Unknown reason of session end.\n");
+        }
+        break;
+    }       //end of switch
+
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_end
+ */
+int
+read_fw1_logfile_end (OpsecSession * psession)
+{
+    int end_reason = 0;
+    int sic_errno = 0;
+    char *sic_errmsg = NULL;
+
+    int last_rec_pos = -1;
+    PSESSION_CONTEXT pContext = (PSESSION_CONTEXT) SESSION_OPAQUE(psession);
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: OPSEC_SESSION_END_HANDLER called\n");
+    }
+
+    if (psession == catchup.session)
+    {
+        return catchup_end (psession);
+    }
+
+    // Check what is the reason of opsec session end
+    end_reason = opsec_session_end_reason (psession);
+    switch (end_reason)
+    {
+    case END_BY_APPLICATION:
+    case SESSION_TIMEOUT:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "DEBUG: The session has been ended.\n");
+        }
+        keepAlive = FALSE;
+        break;
+    case SESSION_NOT_ENDED:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "WARNING: The session has not been terminated.\n");
+        }
+        keepAlive = FALSE;
+        break;
+    case UNABLE_TO_ATTACH_COMM:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: Failed to establish connection.\n");
+        }
+        if (established)
+        {
+            keepAlive = TRUE;
+        }
+        else
+        {
+            keepAlive = FALSE;
+        };
+        break;
+    case ENTITY_TYPE_SESSION_INIT_FAIL:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr,
+                     "ERROR: OPSEC API-specific library code on other side of connection failed when attempting to initialize the session.\n");
+        }
+        keepAlive = FALSE;
+        break;
+    case ENTITY_SESSION_INIT_FAIL:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr,
+                     "ERROR: Third-party start handler on other side of connection failed.\n");
+        }
+        keepAlive = FALSE;
+        break;
+    case COMM_FAILURE:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: Communication failure.\n");
+        }
+        if (established)
+        {
+            keepAlive = TRUE;
+        }
+        else
+        {
+            keepAlive = FALSE;
+        };
+        break;
+    case BAD_VERSION:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: Incorrect version at other side.\n");
+        }
+        keepAlive = FALSE;
+        break;
+    case PEER_SEND_DROP:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: The peer dropped the connection.\n");
+        }
+        if (established)
+        {
+            keepAlive = TRUE;
+        }
+        else
+        {
+            keepAlive = FALSE;
+        };
+        break;
+    case PEER_ENDED:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: The peer ends.\n");
+        }
+        keepAlive = FALSE;
+        break;
+    case PEER_SEND_RESET:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: The peer reset the connection.\n");
+        }
+        if (established)
+        {
+            keepAlive = TRUE;
+        }
+        else
+        {
+            keepAlive = FALSE;
+        };
+        break;
+    case COMM_IS_DEAD:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "ERROR: No communication.\n");
+        }
+        if (established)
+        {
+            keepAlive = TRUE;
+        }
+        else
+        {
+            keepAlive = FALSE;
+        };
+        break;
+    case SIC_FAILURE:
+        if (!opsec_get_sic_error (psession, &sic_errno, &sic_errmsg))
+        {
+            if (cfgvalues.debug_mode)
+            {
+                fprintf (stderr, "ERROR: SIC ERROR %d - %s\n", sic_errno,
+                         sic_errmsg);
+            }
+        }
+        keepAlive = FALSE;
+        break;
+    default:
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "Warning: Unknown reason of session end.\n");
+        }
+        keepAlive = FALSE;
+        break;
+    }   //end of switch
+
+    /*
+     * a backlog that was not drained is read again after a reconnect, the
+     * catch-up session cannot outlive the live one
+     */
+    if (psession == catchup.live)
+    {
+        catchup.live = NULL;
+        if (catchup.failed)
+        {
+            keepAlive = TRUE;
+        }
+        else if (catchup.session != NULL)
+        {
+            opsec_end_session (catchup.session);
+        }
+    }
+
+    /*
+     * a session ended by the watchdog is replaced by a new one
+     */
+    if (psession == stall.session)
+    {
+        stall.session = NULL;
+        if (stall.probe != NULL)
+        {
+            opsec_end_session (stall.probe);
+            stall.probe = NULL;
+        }
+        if (stall.tripped)
+        {
+            keepAlive = TRUE;
+        }
+    }
+
+    /*
+     * the timers re-arm themselves, opsec_mainloop would not return to the
+     * reconnect loop while they are scheduled
+     */
+    if (cfgvalues.aggregate_window > 0)
+    {
+        opsec_deschedule (pContext->env, aggregate_timer, pContext->env);
+        aggregate_flush (FALSE);
+    }
+    if (cfgvalues.dedup_window > 0)
+    {
+        opsec_deschedule (pContext->env, dedup_timer, pContext->env);
+        dedup_flush ();
+    }
+    if (pContext->config_entity.length() > 0)
+    {
+        opsec_deschedule (pContext->env, checkpoint_timer, pContext);
+        last_rec_pos = pContext->checkpoint.last_seen_pos;
+        if (last_rec_pos <= 0)
+        {
+            if (cfgvalues.debug_mode)
+            {
+                fprintf (stderr,
+                         "ERROR: Received error when trying to obtain last record number: function call lea_get_record_pos");
+            }
+        }
+        else
+        {
+            checkpoint_commit (pContext);
+            checkpoint_journal_sync (&(pContext->checkpoint), TRUE);
+        }
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_start
+ */
+int
+read_fw1_logfile_start (OpsecSession * psession)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_start\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: OPSEC session start handler was invoked\n");
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_established
+ */
+int
+read_fw1_logfile_established (OpsecSession * psession)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_established\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr,
+                 "DEBUG: OPSEC session established handler was invoked\n");
+    }
+    established = TRUE;
+    attempt_established = TRUE;
+
+    if (metrics.disconnected_at != 0)
+    {
+        stringstream sstream;
+
+        metrics.recover_ms_last = current_time_ms () - metrics.disconnected_at;
+        metrics.recover_ms_total += metrics.recover_ms_last;
+        metrics.disconnected_at = 0;
+        sstream << "reconnects=" << metrics.reconnects
+                << "|time_to_recover_ms=" << metrics.recover_ms_last
+                << "|time_to_recover_ms_total=" << metrics.recover_ms_total;
+        metrics_emit (sstream.str());
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function read_fw1_logfile_failedconn
+ */
+int
+read_fw1_logfile_failedconn (OpsecEntity * entity, long peer_ip,
+                             int sic_errno, char *sic_errmsg)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function read_fw1_logfile_failedconn\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr,
+                 "DEBUG: OPSEC failed connection handler was invoked\n");
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function get_fw1_logfiles
+ */
+int
+get_fw1_logfiles (const string& entity)
+{
+    OpsecEntity *pClient = NULL;
+    OpsecEntity *pServer = NULL;
+    OpsecSession *pSession = NULL;
+    OpsecEnv *pEnv = NULL;
+    int opsecAlive;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function get_fw1_logfiles\n");
+    }
+
+    if (!fw1_env_open (entity))
+    {
+        exit_loggrabber (1, entity);
+    }
+    pEnv = fw1_env.env;
+    pClient = fw1_env.client;
+    pServer = fw1_env.server;
+
+    /*
+     * create LEA-session
+     */
+    if (!
+            (pSession =
+                 lea_new_session (pClient, pServer, LEA_OFFLINE, LEA_FILENAME,
+                                  LEA_NORMAL, LEA_AT_START)))
+    {
+        fprintf (stderr, "ERROR: failed to create session (%s)\n",
+                 opsec_errno_str (opsec_errno));
+        exit_loggrabber (1, entity);
+    }
+
+    fw1_env_bind (pSession, SESSION_ROLE_LIST, NULL);
+    opsecAlive = opsec_start_keep_alive (pSession, 0);
+
+    /*
+     * start the opsec loop
+     */
+    opsec_mainloop (pEnv);
+
+    return 0;
+}
+
+/*
+ * function get_fw1_logfiles_dict
+ */
+int
+get_fw1_logfiles_dict (OpsecSession * pSession, int nDictId, LEA_VT nValType,
+                       int nEntries)
+{
+    int learesult = 0;
+    int nID = 0;
+    int aID = 0;
+    char *logfile = NULL;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function get_fw1_logfiles_dict\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: Available FW-1 Logfiles\n");
+    }
+
+    if (cfgvalues.showfiles_mode)
+    {
+        fprintf (stderr, "Available FW-1 Logfiles\n");
+    }
+
+    /*
+     * get names of available logfiles and create list of these names
+     */
+    learesult = lea_get_first_file_info (pSession, &logfile, &nID, &aID);
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function get_fw1_logfiles_dict, lea_get_first_file_info returned %d\n",
+                 learesult);
+    }
+    while (LEA_SESSION_FILE_PURGED == learesult || LEA_SESSION_OK == learesult)
+    {
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "DEBUG: - %s\n", logfile);
+        }
+        if (cfgvalues.showfiles_mode)
+        {
+            fprintf (stderr, "- %s\n", logfile);
+        }
+        catalog_add (logfile, nID, aID);
+        learesult = lea_get_next_file_info (pSession, &logfile, &nID, &aID);
+        if (cfgvalues.debug_mode >= 2)
+        {
+            fprintf (stderr, "DEBUG: function get_fw1_logfiles_dict, lea_get_next_file_info returned %d\n",
+                     learesult);
+        }
+    }
+
+    /*
+     * end opsec-session
+     */
+    opsec_end_session (pSession);
+
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function fw1_env_open
+ *
+ * creates the environment and the entity pair all sessions of this process
+ * run on, unless it exists already. Listing, probe and read sessions share
+ * it, so the lea config is fetched and the SIC/SSL setup is done once
+ * instead of for every logfile and reconnect. The handlers of the client
+ * entity dispatch on the role a session was bound to.
+ */
+int
+fw1_env_open (const string& entity)
+{
+    vector<char *> args;
+    string cache_path;
+    char **argv = NULL;
+    int argc = 0;
+    char *auth_type;
+    char *fw1_server;
+    char *fw1_port;
+    char *opsec_certificate;
+    char *opsec_client_dn;
+    char *opsec_server_dn;
+    int i;
+
+    if (fw1_env.env != NULL)
+    {
+        return TRUE;
+    }
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function fw1_env_open\n");
+    }
+
+    /*
+     * keep the SSL session cache of the entity across restarts, reconnects
+     * then resume the cached session instead of a full handshake
+     */
+    fw1_env.session_cache = "";
+    if (cfgvalues.ssl_session_dir.length() > 0)
+    {
+        cache_path = ssl_session_path (entity);
+        if (cache_path.length() == 0)
+        {
+            return FALSE;
+        }
+        fw1_env.session_cache = cache_path + "/sslsess.C";
+    }
+
+    if (cfgvalues.app_name.length() > 0)
+    {
+        if (!getSplunkLeaConfigArgs(entity, cfgvalues, &argc, &argv))
+        {
+            fprintf (stderr, "ERROR: unable to get splunk lea config arguments (fw1_env_open)\n");
+            return FALSE;
+        }
+        fw1_env.args.clear();
+        for (i = 0; i < argc; i++)
+        {
+            fw1_env.args.push_back(argv[i]);
+            delete[] argv[i];
+        }
+        delete[] argv;
+        if (cache_path.length() > 0)
+        {
+            fw1_env.args.push_back ("-v");
+            fw1_env.args.push_back ("opsec_shared_local_path");
+            fw1_env.args.push_back (cache_path);
+        }
+
+        // opsec_init may reorder argv, hand it a copy
+        for (i = 0; i < (int) fw1_env.args.size(); i++)
+        {
+            args.push_back(const_cast<char *>(fw1_env.args[i].c_str()));
+        }
+        args.push_back(NULL);
+        argc = fw1_env.args.size();
+        fw1_env.env = opsec_init (OPSEC_CONF_ARGV, &argc, &args[0], OPSEC_EOL);
+    }
+    else if (cache_path.length() > 0)
+    {
+        args.push_back(const_cast<char *>("-v"));
+        args.push_back(const_cast<char *>("opsec_shared_local_path"));
+        args.push_back(const_cast<char *>(cache_path.c_str()));
+        args.push_back(NULL);
+        argc = 3;
+        fw1_env.env = opsec_init (OPSEC_CONF_FILE, cfgvalues.leaconfig_filename,
+                                  OPSEC_CONF_ARGV, &argc, &args[0], OPSEC_EOL);
+    }
+    else
+    {
+        fw1_env.env = opsec_init (OPSEC_CONF_FILE, cfgvalues.leaconfig_filename,
+                                  OPSEC_EOL);
+    }
+    if (fw1_env.env == NULL)
+    {
+        fprintf (stderr, "ERROR: unable to create environment (%s)\n",
+                 opsec_errno_str (opsec_errno));
+        return FALSE;
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+
+        fprintf (stderr, "DEBUG: OPSEC LEA conf file is %s\n",
+                 cfgvalues.leaconfig_filename);
+        if (cache_path.length() > 0)
+        {
+            fprintf (stderr, "DEBUG: SSL session cache is kept in %s\n",
+                     cache_path.c_str());
+        }
+
+        fw1_server = opsec_get_conf (fw1_env.env, "lea_server", "ip", NULL);
+        if (fw1_server == NULL)
+        {
+            fprintf (stderr,
+                     "ERROR: The fw1 server ip address has not been set.\n");
+            exit_loggrabber (1, entity);
+        }     //end of if
+        auth_type = opsec_get_conf (fw1_env.env, "lea_server", "auth_type", NULL);
+        if (auth_type != NULL)
+        {
+            //Authentication mode
+            if (cfgvalues.fw1_2000)
+            {
+                //V4.1.2
+                fw1_port =
+                    opsec_get_conf (fw1_env.env, "lea_server", "auth_port", NULL);
+                if (fw1_port == NULL)
+                {
+                    fprintf (stderr,
+                             "ERROR: The parameters about authentication mode have not been set.\n");
+                    exit_loggrabber (1, entity);
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "DEBUG: Authentication mode has been used.\n");
+                    fprintf (stderr, "DEBUG: Server-IP     : %s\n",
+                             fw1_server);
+                    fprintf (stderr, "DEBUG: Server-Port     : %s\n",
+                             fw1_port);
+                    fprintf (stderr, "DEBUG: Authentication type: %s\n",
+                             auth_type);
+                }   //end of inner if
+            }
+            else
+            {
+                //NG
+                fw1_port =
+                    opsec_get_conf (fw1_env.env, "lea_server", "auth_port", NULL);
+                opsec_certificate =
+                    opsec_get_conf (fw1_env.env, "opsec_sslca_file", NULL);
+                opsec_client_dn =
+                    opsec_get_conf (fw1_env.env, "opsec_sic_name", NULL);
+                opsec_server_dn =
+                    opsec_get_conf (fw1_env.env, "lea_server",
+                                    "opsec_entity_sic_name", NULL);
+                if ((fw1_port == NULL) || (opsec_certificate == NULL)
+                        || (opsec_client_dn == NULL)
+                        || (opsec_server_dn == NULL))
+                {
+                    fprintf (stderr,
+                             "ERROR: The parameters about authentication mode have not been set.\n");
+                    exit_loggrabber (1, entity);
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "DEBUG: Authentication mode has been used.\n");
+                    fprintf (stderr, "DEBUG: Server-IP     : %s\n",
+                             fw1_server);
+                    fprintf (stderr, "DEBUG: Server-Port     : %s\n",
+                             fw1_port);
+                    fprintf (stderr, "DEBUG: Authentication type: %s\n",
+                             auth_type);
+                    fprintf (stderr,
+                             "DEBUG: OPSEC sic certificate file name : %s\n",
+                             opsec_certificate);
+                    fprintf (stderr, "DEBUG: Server DN (sic name) : %s\n",
+                             opsec_server_dn);
+                    fprintf (stderr,
+                             "DEBUG: OPSEC LEA client DN (sic name) : %s\n",
+                             opsec_client_dn);
+                }   //end of inner if
+            }
+        }
+        else
+        {
+            //Clear Text mode, i.e. non-auth mode
+            fw1_port = opsec_get_conf (fw1_env.env, "lea_server", "port", NULL);
+            if (fw1_port != NULL)
+            {
+                fprintf (stderr, "DEBUG: Clear text mode has been used.\n");
+                fprintf (stderr, "DEBUG: Server-IP        : %s\n",
+                         fw1_server);
+                fprintf (stderr, "DEBUG: Server-Port      : %s\n",
+                         fw1_port);
+            }
+            else
+            {
+                fprintf (stderr,
+                         "ERROR: The fw1 server lea service port has not been set.\n");
+                exit_loggrabber (1, entity);
+            }   //end of inner if
+        }     //end of middle if
+    }     //end of if
+
+    /*
+     * initialize opsec-client
+     */
+    fw1_env.client = opsec_init_entity (fw1_env.env, LEA_CLIENT,
+                                        LEA_RECORD_HANDLER, fw1_env_record,
+                                        LEA_DICT_HANDLER, fw1_env_dict,
+                                        LEA_EOF_HANDLER, fw1_env_eof,
+                                        LEA_SWITCH_HANDLER,
+                                        read_fw1_logfile_switch,
+                                        LEA_FILTER_QUERY_ACK,
+                                        read_fw1_logfile_queryack,
+                                        LEA_COL_LOGS_HANDLER,
+                                        read_fw1_logfile_collogs,
+                                        LEA_SUSPEND_HANDLER,
+                                        read_fw1_logfile_suspend,
+                                        LEA_RESUME_HANDLER,
+                                        read_fw1_logfile_resume,
+                                        OPSEC_SESSION_START_HANDLER,
+                                        read_fw1_logfile_start,
+                                        OPSEC_SESSION_END_HANDLER,
+                                        fw1_env_end,
+                                        OPSEC_SESSION_ESTABLISHED_HANDLER,
+                                        fw1_env_established, OPSEC_EOL);
+
+    /*
+     * initialize opsec-server for authenticated and unauthenticated connections
+     */
+    fw1_env.server =
+        opsec_init_entity (fw1_env.env, LEA_SERVER, OPSEC_ENTITY_NAME,
+                           "lea_server", OPSEC_EOL);
+
+    /*
+     * continue only if opsec initializations were successful
+     */
+    if ((!fw1_env.client) || (!fw1_env.server))
+    {
+        fprintf (stderr,
+                 "ERROR: failed to initialize client/server-pair (%s)\n",
+                 opsec_errno_str (opsec_errno));
+        fw1_env_close ();
+        return FALSE;
+    }
+    fw1_env.filters_compiled = FALSE;
+    fw1_env.setups++;
+    return TRUE;
+}
+
+/*
+ * function fw1_env_hit_rate
+ *
+ * share of the handshakes that resumed a cached SSL session, in percent
+ */
+static long
+fw1_env_hit_rate ()
+{
+    return (fw1_env.handshakes > 0) ?
+           (fw1_env.resumed * 100 / fw1_env.handshakes) : 0;
+}
+
+/*
+ * function fw1_env_close
+ */
+void
+fw1_env_close ()
+{
+    stringstream sstream;
+
+    if (fw1_env.env == NULL)
+    {
+        return;
+    }
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function fw1_env_close\n");
+    }
+
+    sstream << "env_setups=" << fw1_env.setups
+            << "|env_sessions=" << fw1_env.sessions
+            << "|handshakes=" << fw1_env.handshakes;
+    if (fw1_env.handshakes > 0)
+    {
+        sstream << "|handshake_ms_avg="
+                << (fw1_env.handshake_ms / fw1_env.handshakes);
+    }
+    if (fw1_env.session_cache.length() > 0)
+    {
+        sstream << "|ssl_resumed=" << fw1_env.resumed
+                << "|ssl_hit_rate_pct=" << fw1_env_hit_rate ();
+    }
+    metrics_emit (sstream.str());
+
+    cleanup_fw1_environment (fw1_env.env, fw1_env.client, fw1_env.server);
+    fw1_env.env = NULL;
+    fw1_env.client = NULL;
+    fw1_env.server = NULL;
+    fw1_env.roles.clear();
+    fw1_env.handshaking.clear();
+}
+
+/*
+ * function fw1_env_forget
+ *
+ * drops the environment inherited by a forked worker without tearing it
+ * down, it still belongs to the parent
+ */
+void
+fw1_env_forget ()
+{
+    fw1_env.env = NULL;
+    fw1_env.client = NULL;
+    fw1_env.server = NULL;
+    fw1_env.roles.clear();
+    fw1_env.handshaking.clear();
+}
+
+/*
+ * function fw1_env_cache_stat
+ *
+ * snapshots the SSL session cache. Its contents are compared rather than
+ * its mtime, which only has a resolution of a second on many file systems,
+ * and a renegotiated session of the same size would go unnoticed.
+ */
+static void
+fw1_env_cache_stat (handshake_pending *hs)
+{
+    char buffer[4096];
+    FILE *cache;
+    size_t len;
+
+    hs->cached = FALSE;
+    hs->cache.clear();
+    if ((fw1_env.session_cache.length() == 0) ||
+            ((cache = fopen (fw1_env.session_cache.c_str(), "rb")) == NULL))
+    {
+        return;
+    }
+    while ((len = fread (buffer, 1, sizeof buffer, cache)) > 0)
+    {
+        hs->cache.append (buffer, len);
+    }
+    hs->cached = !ferror (cache);
+    fclose (cache);
+}
+
+/*
+ * function fw1_env_bind
+ */
+void
+fw1_env_bind (OpsecSession * pSession, int role, void *opaque)
+{
+    handshake_pending hs;
+
+    SESSION_OPAQUE(pSession) = opaque;
+    fw1_env.roles[pSession] = role;
+    fw1_env.sessions++;
+
+    hs.started = current_time_ms ();
+    fw1_env_cache_stat (&hs);
+    fw1_env.handshaking[pSession] = hs;
+}
+
+/*
+ * function fw1_env_handshake_done
+ *
+ * accounts the handshake of a session that has just been established. The
+ * cache file is rewritten whenever a new SSL session is negotiated, so a
+ * cache with the same contents as when the session was created means it
+ * was resumed.
+ */
+static void
+fw1_env_handshake_done (OpsecSession * pSession, int role)
+{
+    map<OpsecSession *, handshake_pending>::iterator it =
+        fw1_env.handshaking.find (pSession);
+    handshake_pending now;
+    stringstream sstream;
+    long elapsed;
+    int resumed;
+
+    if (it == fw1_env.handshaking.end())
+    {
+        return;
+    }
+    elapsed = current_time_ms () - it->second.started;
+    fw1_env_cache_stat (&now);
+    resumed = now.cached && it->second.cached &&
+              (now.cache == it->second.cache);
+    fw1_env.handshaking.erase (it);
+
+    fw1_env.handshakes++;
+    fw1_env.handshake_ms += elapsed;
+    if (resumed)
+    {
+        fw1_env.resumed++;
+    }
+
+    // probe and listing sessions only count towards the totals
+    if (role != SESSION_ROLE_READ)
+    {
+        return;
+    }
+    sstream << "handshake_ms=" << elapsed
+            << "|handshake_ms_avg=" << (fw1_env.handshake_ms / fw1_env.handshakes);
+    if (fw1_env.session_cache.length() > 0)
+    {
+        sstream << "|ssl_resumed=" << (resumed ? 1 : 0)
+                << "|ssl_hit_rate_pct=" << fw1_env_hit_rate ();
+    }
+    metrics_emit (sstream.str());
+}
+
+/*
+ * function fw1_env_role
+ */
+static int
+fw1_env_role (OpsecSession * pSession)
+{
+    map<OpsecSession *, int>::iterator it = fw1_env.roles.find (pSession);
+
+    return (it != fw1_env.roles.end()) ? it->second : 0;
+}
+
+/*
+ * function fw1_env_record
+ */
+int
+fw1_env_record (OpsecSession * pSession, lea_record * pRec, int pattr[])
+{
+    switch (fw1_env_role (pSession))
+    {
+    case SESSION_ROLE_READ:
+        return read_fw1_logfile_record (pSession, pRec, pattr);
+    case SESSION_ROLE_PROBE:
+        return probe_record_handler (pSession, pRec, pattr);
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function fw1_env_dict
+ */
+int
+fw1_env_dict (OpsecSession * pSession, int dict_id, LEA_VT val_type,
+              int n_d_entries)
+{
+    switch (fw1_env_role (pSession))
+    {
+    case SESSION_ROLE_LIST:
+        return get_fw1_logfiles_dict (pSession, dict_id, val_type, n_d_entries);
+    case SESSION_ROLE_READ:
+        return read_fw1_logfile_dict (pSession, dict_id, val_type, n_d_entries);
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function fw1_env_eof
+ */
+int
+fw1_env_eof (OpsecSession * pSession)
+{
+    switch (fw1_env_role (pSession))
+    {
+    case SESSION_ROLE_READ:
+        return read_fw1_logfile_eof (pSession);
+    case SESSION_ROLE_PROBE:
+        return probe_eof_handler (pSession);
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function fw1_env_established
+ */
+int
+fw1_env_established (OpsecSession * pSession)
+{
+    int role = fw1_env_role (pSession);
+
+    fw1_env_handshake_done (pSession, role);
+    if (role == SESSION_ROLE_READ)
+    {
+        return read_fw1_logfile_established (pSession);
+    }
+    return OPSEC_SESSION_OK;
+}
+
+/*
+ * function fw1_env_end
+ */
+int
+fw1_env_end (OpsecSession * pSession)
+{
+    int role = fw1_env_role (pSession);
+    int ret = OPSEC_SESSION_OK;
+
+    fw1_env.roles.erase (pSession);
+    fw1_env.handshaking.erase (pSession);
+    switch (role)
+    {
+    case SESSION_ROLE_LIST:
+        ret = get_fw1_logfiles_end (pSession);
+        break;
+    case SESSION_ROLE_READ:
+        ret = read_fw1_logfile_end (pSession);
+        session_caches_forget (pSession);
+        break;
+    }
+    return ret;
+}
+
+/*
+ * function cleanup_fw1_environment
+ */
+void
+cleanup_fw1_environment (OpsecEnv * env, OpsecEntity * client,
+                         OpsecEntity * server)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function cleanup_fw1_environment\n");
+    }
+
+    if (client)
+        opsec_destroy_entity (client);
+    if (server)
+        opsec_destroy_entity (server);
+    if (env)
+        opsec_env_destroy (env);
+}
+
+/*
+ * function show_supported_fields
+ */
+void
+show_supported_fields ()
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function show_supported_fields\n");
+    }
+
+    fprintf (stderr,
+             "\nFW1-Loggrabber v%s, (C)2004, Torsten Fellhauer, Xiaodong Lin\n",
+             VERSION);
+    fprintf (stderr, "Supported Fields for normal logs:\n");
+    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    {
+        fprintf (stderr, "  - %s\n", *lfield_headers[i]);
+    }
+    fprintf (stderr, "Supported Fields for audit logs:\n");
+    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    {
+        fprintf (stderr, "  - %s\n", *afield_headers[i]);
+    }
+}
+
+/*
+ * function usage
+ */
+void
+usage (char *szProgName)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function usage\n");
+    }
+
+    fprintf (stderr, "\nFW1-Loggrabber v%s (%s)\n", VERSION, ODBCVERSION);
+    fprintf (stderr, "    (C)2005, Torsten Fellhauer, Xiaodong Lin\n\n");
+    fprintf (stderr, "Usage:\n");
+    fprintf (stderr, " %s [ options ]\n", szProgName);
+    fprintf (stderr,
+             "  -c|--configfile <file>     : Name of Configfile (default: fw1-loggrabber.conf)\n");
+    fprintf (stderr,
+             "  -l|--leaconfigfile <file>  : Name of Leaconfigfile (default: lea.conf)\n");
+    fprintf (stderr,
+             "  -f|--logfile Logfile|ALL   : Name of Logfile, may contain * and ? (default: fw.log)\n");
+    fprintf (stderr,
+             "  --resolve|--no-resolve     : Resolve Port Numbers and IP-Addresses (Default: Resolve)\n");
+    fprintf (stderr,
+             "  --showfiles|--showlogs     : Show only Filenames of all available FW-1 Logfiles (default: showlogs)\n");
+    fprintf (stderr,
+             "  --2000|--ng                : Connect to a CP FW-1 4.1 (2000) (default is ng)\n");
+    fprintf (stderr,
+             "  --filter \"...\"             : Specify filters to be applied\n");
+    fprintf (stderr,
+             "  --post-filter \"...\"        : Specify filters to be applied locally, e.g. \"attack*=Scan;bytes>1000\"\n");
+    fprintf (stderr,
+             "  --sample \"...\"             : Sample records by action or product, e.g. \"accept=1/100,drop=1\"\n");
+    fprintf (stderr,
+             "  --aggregate <seconds>      : Output one summary per src, dst, service, action and rule per window\n");
+    fprintf (stderr,
+             "  --dedup <seconds>          : Suppress repeated records within the window, counted in repeat_count\n");
+    fprintf (stderr,
+             "  --fields \"...\"             : Specify fields to be printed\n");
+    fprintf (stderr,
+             "  --online|--no-online       : Enable Online mode (default: no-online)\n");
+    fprintf (stderr,
+             "  --auditlog|--normallog     : Get data of audit-logfile (fw.adtlog)(default: normallog)\n");
+    fprintf (stderr,
+             "  --debug-level <level>      : Specify Debuglevel (default: 0 - no debugging)\n");
+    fprintf (stderr,
+             "  --configentity <entity>    : Specifies the entity name in the Splunk opsec app endpoint to collect logs from\n");
+    fprintf (stderr,
+             "  --configserver <splunkd>   : optional, specifies the Splunk instance to get lea configuration from, e.g. https://127.0.0.1:8089/. defaults to instance in $SPLUNK_HOME\n");
+    fprintf (stderr,
+             "  --statusserver <splunkd>   : optional, specifies the Splunk instance to post status information to, e.g. https://127.0.0.1:8089/. defaults to instance in $SPLUNK_HOME\n");
+    fprintf (stderr,
+             "  --appname <app>            : Specifies the name of the splunk app on the Splunk server \n");
+    fprintf (stderr,
+             "  --backfill <N>             : Read the logfile in N position ranges in parallel (offline only, the checkpoint is not moved)\n");
+    fprintf (stderr,
+             "  --backfill-split           : Keep the output of each range in <prefix>.part<N>.log instead of merging it\n");
+    fprintf (stderr,
+             "  --catchup|--no-catchup     : In online mode, also read the records since the last checkpoint\n");
+    fprintf (stderr,
+             "  --start-time <time>        : Start reading at the first record logged at or after YYYYMMDDhhmmss (offline only)\n");
+    fprintf (stderr,
+             "  --end-time <time>          : Stop reading after the last record logged at or before YYYYMMDDhhmmss (offline only)\n");
+    fprintf (stderr,
+             "  --help                     : Show usage informations\n");
+    fprintf (stderr,
+             "  --help-fields              : Show supported log fields\n");
+}
+
+/*
+ * function catalog_add
+ */
+void
+catalog_add (const char *name, int normalFID, int accountFID)
+{
+    catalog_entry entry;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function catalog_add\n");
+    }
+
+    if ((name == NULL) || (catalog.by_name.count (name) > 0))
+    {
+        return;
+    }
+    entry.name = name;
+    entry.normalFID = normalFID;
+    entry.accountFID = accountFID;
+    entry.known = FALSE;
+    entry.first_time = 0;
+    entry.last_time = 0;
+    catalog.by_name[entry.name] = catalog.entries.size();
+    catalog.by_fileid[normalFID] = catalog.entries.size();
+    catalog.entries.push_back (entry);
+}
+
+/*
+ * function catalog_active
+ *
+ * the logfile currently written by the server, its time range still grows
+ */
+static int
+catalog_active (const catalog_entry& entry)
+{
+    return (entry.name == "fw.log") || (entry.name == "fw.adtlog");
+}
+
+/*
+ * function catalog_match
+ *
+ * shell style match of a logfile name, * and ? are supported
+ */
+static int
+catalog_match (const char *pattern, const char *name)
+{
+    if (*pattern == '\0')
+    {
+        return (*name == '\0');
+    }
+    if (*pattern == '*')
+    {
+        return catalog_match (pattern + 1, name) ||
+               ((*name != '\0') && catalog_match (pattern, name + 1));
+    }
+    if ((*name != '\0') && ((*pattern == '?') || (*pattern == *name)))
+    {
+        return catalog_match (pattern + 1, name + 1);
+    }
+    return FALSE;
+}
+
+/*
+ * function catalog_overlaps
+ *
+ * whether a logfile may hold records between cfgvalues.start_time and
+ * cfgvalues.end_time
+ */
+static int
+catalog_overlaps (const catalog_entry& entry)
+{
+    if (!entry.known)
+    {
+        return TRUE;
+    }
+    if (entry.first_time == 0)
+    {
+        return catalog_active (entry);
+    }
+    if (cfgvalues.end_time && (entry.first_time > cfgvalues.end_time))
+    {
+        return FALSE;
+    }
+    if (cfgvalues.start_time && !catalog_active (entry) &&
+            (entry.last_time < cfgvalues.start_time))
+    {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * function catalog_select
+ *
+ * collects the catalog indexes of the logfiles selected by pattern: ALL,
+ * an exact name or a pattern with wildcards. With a time window, only the
+ * logfiles overlapping it are kept, learning the time ranges not known
+ * yet. FALSE if pattern selects no logfile of the catalog.
+ */
+int
+catalog_select (const string& entity, const char *pattern,
+                vector<int>& selected)
+{
+    map<string, int>::iterator it;
+    vector<int> candidates;
+    probe_env probe;
+    stringstream sstream;
+    int opened = FALSE;
+    unsigned int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function catalog_select\n");
+    }
+
+    selected.clear();
+    if (strcmp (pattern, "ALL") == 0)
+    {
+        for (i = 0; i < catalog.entries.size(); i++)
+        {
+            candidates.push_back (i);
+        }
+    }
+    else if ((it = catalog.by_name.find (pattern)) != catalog.by_name.end())
+    {
+        candidates.push_back (it->second);
+    }
+    else if (strpbrk (pattern, "*?") != NULL)
+    {
+        for (i = 0; i < catalog.entries.size(); i++)
+        {
+            if (catalog_match (pattern, catalog.entries[i].name.c_str()))
+            {
+                candidates.push_back (i);
+            }
+        }
+    }
+    if (candidates.empty())
+    {
+        if (strcmp (pattern, "ALL") == 0)
+        {
+            return TRUE;
+        }
+        if (strpbrk (pattern, "*?") != NULL)
+        {
+            fprintf (stderr, "WARNING: No logfile matches %s\n", pattern);
+            return TRUE;
+        }
+        return FALSE;
+    }
+    if (!cfgvalues.start_time && !cfgvalues.end_time)
+    {
+        selected = candidates;
+        return TRUE;
+    }
+
+    catalog_load (entity);
+    probe.probes = 0;
+    for (i = 0; i < candidates.size(); i++)
+    {
+        catalog_entry *entry = &(catalog.entries[candidates[i]]);
+
+        if (!entry->known)
+        {
+            if (!opened)
+            {
+                if (!probe_open (entity, &probe))
+                {
+                    exit_loggrabber (1, entity);
+                }
+                opened = TRUE;
+            }
+            if (!catalog_learn (&probe, entry))
+            {
+                fprintf (stderr,
+                         "WARNING: Cannot learn the time range of %s, reading it\n",
+                         entry->name.c_str());
+            }
+            else if (!catalog_active (*entry))
+            {
+                catalog.dirty = TRUE;
+            }
+        }
+        if (catalog_overlaps (*entry))
+        {
+            selected.push_back (candidates[i]);
+        }
+        else if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "DEBUG: Skipping logfile %s outside of the time window\n",
+                     entry->name.c_str());
+        }
+    }
+    if (opened)
+    {
+        probe_close (&probe);
+    }
+    if (catalog.dirty)
+    {
+        catalog_save (entity);
+    }
+
+    sstream << "catalog_candidates=" << candidates.size()
+            << "|catalog_selected=" << selected.size()
+            << "|catalog_probes=" << probe.probes;
+    metrics_emit (sstream.str());
+    return TRUE;
+}
+
+/*
+ * function catalog_learn
+ *
+ * reads the time of the first and the last record of a logfile. For the
+ * active logfile only the first one is of use.
+ */
+int
+catalog_learn (probe_env *probe, catalog_entry *entry)
+{
+    probe_result result;
+    char *name = const_cast<char *>(entry->name.c_str());
+    int last_pos;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function catalog_learn\n");
+    }
+
+    if (!probe_record (probe, name, entry->normalFID, 1, &result))
+    {
+        return FALSE;
+    }
+    entry->first_time = result.found ? result.time : 0;
+    entry->last_time = entry->first_time;
+    if (result.found && !catalog_active (*entry))
+    {
+        last_pos = probe_last_pos (probe, name, entry->normalFID);
+        if (!probe_record (probe, name, entry->normalFID, last_pos, &result) ||
+                !result.found)
+        {
+            return FALSE;
+        }
+        entry->last_time = result.time;
+    }
+    entry->known = TRUE;
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: Logfile %s covers %lu-%lu\n",
+                 name, entry->first_time, entry->last_time);
+    }
+    return TRUE;
+}
+
+/*
+ * function catalog_load
+ *
+ * applies the time ranges learned before. Lines are
+ * "fileid=<n>|first=<t>|last=<t>|name=<logfile>"; a line only applies to
+ * the logfile with the same fileid and name.
+ */
+void
+catalog_load (const string& entity)
+{
+    string path = checkpoint_file_prefix (entity) + ".catalog";
+    map<int, int>::iterator it;
+    char line[1024];
+    unsigned long first_time;
+    unsigned long last_time;
+    int fileid;
+    int offset;
+    FILE *file;
+
+    if (catalog.loaded)
+    {
+        return;
+    }
+    catalog.loaded = TRUE;
+    if ((file = fopen (path.c_str(), "r")) == NULL)
+    {
+        return;
+    }
+    while (fgets (line, sizeof line, file))
+    {
+        line[strcspn (line, "\r\n")] = '\0';
+        offset = 0;
+        if ((sscanf (line, "fileid=%d|first=%lu|last=%lu|name=%n", &fileid,
+                     &first_time, &last_time, &offset) != 3) || (offset == 0))
+        {
+            continue;
+        }
+        if (((it = catalog.by_fileid.find (fileid)) != catalog.by_fileid.end())
+                && (catalog.entries[it->second].name == line + offset)
+                && !catalog_active (catalog.entries[it->second]))
+        {
+            catalog.entries[it->second].first_time = first_time;
+            catalog.entries[it->second].last_time = last_time;
+            catalog.entries[it->second].known = TRUE;
+        }
+    }
+    fclose (file);
+}
+
+/*
+ * function catalog_save
+ *
+ * replaces the catalog file atomically (write, fsync, rename)
+ */
+int
+catalog_save (const string& entity)
+{
+    string path = checkpoint_file_prefix (entity) + ".catalog";
+    string tmppath = path + ".tmp";
+    unsigned int i;
+    FILE *file;
+
+    if ((file = fopen (tmppath.c_str(), "w")) == NULL)
+    {
+        fprintf (stderr, "ERROR: Cannot write catalog file %s (%s)\n",
+                 tmppath.c_str(), strerror (errno));
+        return FALSE;
+    }
+    for (i = 0; i < catalog.entries.size(); i++)
+    {
+        catalog_entry *entry = &(catalog.entries[i]);
+
+        if (entry->known && !catalog_active (*entry))
+        {
+            fprintf (file, "fileid=%d|first=%lu|last=%lu|name=%s\n",
+                     entry->normalFID, entry->first_time, entry->last_time,
+                     entry->name.c_str());
+        }
+    }
+    if ((fflush (file) != 0) || (fsync (fileno (file)) != 0))
+    {
+        fprintf (stderr, "ERROR: Cannot write catalog file %s (%s)\n",
+                 tmppath.c_str(), strerror (errno));
+        fclose (file);
+        return FALSE;
+    }
+    fclose (file);
+    if (rename (tmppath.c_str(), path.c_str()) != 0)
+    {
+        fprintf (stderr, "ERROR: Cannot replace catalog file %s (%s)\n",
+                 path.c_str(), strerror (errno));
+        return FALSE;
+    }
+    catalog.dirty = FALSE;
+    return TRUE;
+}
+
+/*
+ * function filter_trim
+ */
+static string
+filter_trim (const string& value)
+{
+    string::size_type first = value.find_first_not_of (' ');
+    string::size_type last = value.find_last_not_of (' ');
+
+    if (first == string::npos)
+    {
+        return string ("");
+    }
+    return value.substr (first, last - first + 1);
+}
+
+/*
+ * function filter_split
+ */
+static vector<string>
+filter_split (const string& value, char separator)
+{
+    vector<string> tokens;
+    string::size_type start = 0;
+    string::size_type end;
+
+    while ((end = value.find (separator, start)) != string::npos)
+    {
+        tokens.push_back (filter_trim (value.substr (start, end - start)));
+        start = end + 1;
+    }
+    tokens.push_back (filter_trim (value.substr (start)));
+    return tokens;
+}
+
+/*
+ * function filter_add_value
+ */
+static void
+filter_add_value (filter_pred *pred, int type, unsigned long num,
+                  const string& str = string (""))
+{
+    filter_value value;
+
+    value.type = type;
+    value.num = num;
+    value.str = str;
+    pred->values.push_back (value);
+}
+
+/*
+ * function filter_add_values
+ *
+ * a belongs-to predicate on the values froms, or with ranges a
+ * belongs-to-range predicate on the pairs froms[i]-tos[i]
+ */
+static void
+filter_add_values (filter_pred *pred, int type,
+                   const vector<unsigned long>& froms,
+                   const vector<unsigned long>& tos, int ranges)
+{
+    unsigned int i;
+
+    pred->op = ranges ? LEA_FILTER_PRED_BELONGS_TO_RANGE :
+               LEA_FILTER_PRED_BELONGS_TO;
+    for (i = 0; i < froms.size(); i++)
+    {
+        filter_add_value (pred, type, froms[i]);
+        if (ranges)
+        {
+            filter_add_value (pred, type, tos[i]);
+        }
+    }
+}
+
+/*
+ * function filter_parse_time
+ *
+ * converts YYYYMMDDhhmmss (local time) into unix time
+ */
+int
+filter_parse_time (const string& name, const string& value,
+                   unsigned long *result)
+{
+    struct tm timestruct;
+    time_t unixtime;
+
+    if ((value.length() != 14) ||
+            (value.find_first_not_of ("0123456789") != string::npos))
+    {
+        fprintf (stderr,
+                 "ERROR: syntax error in rule value of argument %s: '%s'.\n"
+                 "       Required syntax: '%s=YYYYMMDDhhmmss'\n",
+                 name.c_str(), value.c_str(), name.c_str());
+        return FALSE;
+    }
+
+    memset (&timestruct, 0, sizeof (timestruct));
+    timestruct.tm_year = atoi (value.substr (0, 4).c_str()) - 1900;
+    timestruct.tm_mon = atoi (value.substr (4, 2).c_str()) - 1;
+    timestruct.tm_mday = atoi (value.substr (6, 2).c_str());
+    timestruct.tm_hour = atoi (value.substr (8, 2).c_str());
+    timestruct.tm_min = atoi (value.substr (10, 2).c_str());
+    timestruct.tm_sec = atoi (value.substr (12, 2).c_str());
+    timestruct.tm_isdst = -1;
+
+    if ((timestruct.tm_mon > 11) || (timestruct.tm_mday > 31)
+            || (timestruct.tm_hour > 23) || (timestruct.tm_min > 59)
+            || (timestruct.tm_sec > 59)
+            || ((unixtime = mktime (&timestruct)) == (time_t) -1))
+    {
+        fprintf (stderr, "ERROR: illegal date format in argumentvalue\n");
+        return FALSE;
+    }
+    *result = (unsigned long) unixtime;
+    return TRUE;
+}
+
+/*
+ * function filter_parse_ip
+ *
+ * one dotted address in network byte order
+ */
+static int
+filter_parse_ip (const string& value, unsigned long *addr)
+{
+    in_addr_t ip = inet_addr (value.c_str());
+
+    if ((value.length() == 0) ||
+            ((ip == INADDR_NONE) && (value != "255.255.255.255")))
+    {
+        return FALSE;
+    }
+    *addr = (unsigned long) ip;
+    return TRUE;
+}
+
+/*
+ * function filter_parse_addresses
+ *
+ * orig, src and dst: a list of addresses. src and dst also take one
+ * address/netmask, and networks (address/bits) or address ranges (from-to)
+ * in the list. These are handed to the server as a belongs-to-mask or
+ * belongs-to-range predicate.
+ */
+static int
+filter_parse_addresses (const string& name, const string& value,
+                        int allow_mask, filter_pred *pred)
+{
+    vector<string> tokens;
+    vector<string> parts;
+    vector<unsigned long> froms;
+    vector<unsigned long> tos;
+    unsigned long from;
+    unsigned long to;
+    unsigned long mask;
+    unsigned long bits;
+    int ranges = FALSE;
+    unsigned int i;
+
+    if (allow_mask && (value.find ('/') != string::npos) &&
+            (value.find (',') == string::npos))
+    {
+        tokens = filter_split (value, '/');
+        if ((tokens.size() == 2) && (tokens[1].find ('.') != string::npos))
+        {
+            if (!filter_parse_ip (tokens[0], &from) ||
+                    !filter_parse_ip (tokens[1], &mask))
+            {
+                fprintf (stderr,
+                         "ERROR: syntax error in rule value of argument %s: '%s'.\n"
+                         "       Required syntax: '%s=aaa.bbb.ccc.ddd/eee.fff.ggg.hhh'\n",
+                         name.c_str(), value.c_str(), name.c_str());
+                return FALSE;
+            }
+            pred->op = LEA_FILTER_PRED_BELONGS_TO_MASK;
+            filter_add_value (pred, LEA_VT_IP_ADDR, from);
+            filter_add_value (pred, LEA_VT_IP_ADDR, mask);
+            return TRUE;
+        }
+    }
+
+    tokens = filter_split (value, ',');
+    for (i = 0; i < tokens.size(); i++)
+    {
+        if (allow_mask && (tokens[i].find ('/') != string::npos))
+        {
+            parts = filter_split (tokens[i], '/');
+            if ((parts.size() != 2) || (parts[1].length() == 0) ||
+                    (parts[1].find_first_not_of ("0123456789") != string::npos) ||
+                    ((bits = strtoul (parts[1].c_str(), (char **) NULL, 10)) > 32) ||
+                    !filter_parse_ip (parts[0], &from))
+            {
+                break;
+            }
+            mask = (bits == 0) ? 0 : (0xffffffffUL << (32 - bits)) & 0xffffffffUL;
+            from = ntohl ((in_addr_t) from) & mask;
+            to = from | (~mask & 0xffffffffUL);
+            from = htonl ((in_addr_t) from);
+            to = htonl ((in_addr_t) to);
+            ranges = TRUE;
+        }
+        else if (allow_mask && (tokens[i].find ('-') != string::npos))
+        {
+            parts = filter_split (tokens[i], '-');
+            if ((parts.size() != 2) || !filter_parse_ip (parts[0], &from) ||
+                    !filter_parse_ip (parts[1], &to) ||
+                    (ntohl ((in_addr_t) from) > ntohl ((in_addr_t) to)))
+            {
+                break;
+            }
+            ranges = TRUE;
+        }
+        else if (filter_parse_ip (tokens[i], &from))
+        {
+            to = from;
+        }
+        else
+        {
+            break;
+        }
+        froms.push_back (from);
+        tos.push_back (to);
+    }
+    if (i < tokens.size())
+    {
+        fprintf (stderr,
+                 "ERROR: syntax error in rule value of argument %s: '%s'.\n"
+                 "       Required syntax: '%s=aaa.bbb.ccc.ddd'%s\n",
+                 name.c_str(), tokens[i].c_str(), name.c_str(),
+                 (allow_mask ? ", 'aaa.bbb.ccc.ddd/nn' or 'aaa.bbb.ccc.ddd-eee.fff.ggg.hhh'" : ""));
+        return FALSE;
+    }
+
+    filter_add_values (pred, LEA_VT_IP_ADDR, froms, tos, ranges);
+    return TRUE;
+}
+
+/*
+ * function filter_parse_number
+ *
+ * a decimal number, or for services a name known to getservbyname
+ */
+static int
+filter_parse_number (const string& value, int services, unsigned long *num)
+{
+    struct servent *service;
+
+    if ((value.length() > 0) &&
+            (value.find_first_not_of ("0123456789") == string::npos))
+    {
+        *num = strtoul (value.c_str(), (char **) NULL, 10);
+        return TRUE;
+    }
+    if (services && (value.length() > 0))
+    {
+        if (((service = getservbyname (value.c_str(), "tcp")) != NULL) ||
+                ((service = getservbyname (value.c_str(), "udp")) != NULL))
+        {
+            *num = ntohs ((unsigned short) service->s_port);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * function filter_parse_ranges
+ *
+ * rule and service: comma separated numbers or ranges "from-to", services
+ * also by name. Service names may contain '-' themselves (netbios-ssn), so
+ * a token is first taken whole and only then split at a '-' with a number
+ * or name on both sides. Ranges are handed to the server as a
+ * belongs-to-range predicate instead of being expanded.
+ */
+static int
+filter_parse_ranges (const string& name, const string& value, int type,
+                     unsigned long max, filter_pred *pred)
+{
+    vector<string> tokens = filter_split (value, ',');
+    vector<unsigned long> froms;
+    vector<unsigned long> tos;
+    unsigned long from;
+    unsigned long to;
+    int services = (name == "service");
+    int ranges = FALSE;
+    int parsed;
+    size_t dash;
+    unsigned int i;
+
+    for (i = 0; i < tokens.size(); i++)
+    {
+        parsed = filter_parse_number (tokens[i], services, &from);
+        to = from;
+        for (dash = tokens[i].find ('-'); !parsed && (dash != string::npos);
+                dash = tokens[i].find ('-', dash + 1))
+        {
+            parsed = filter_parse_number (filter_trim (tokens[i].substr (0, dash)),
+                                          services, &from) &&
+                     filter_parse_number (filter_trim (tokens[i].substr (dash + 1)),
+                                          services, &to);
+        }
+        if (!parsed)
+        {
+            fprintf (stderr,
+                     "ERROR: syntax error in rule value of argument %s: '%s'.\n"
+                     "       Required syntax: '%s=x' or '%s=x-y'\n",
+                     name.c_str(), tokens[i].c_str(), name.c_str(),
+                     name.c_str());
+            return FALSE;
+        }
+        if ((from > max) || (to > max) || (from > to))
+        {
+            fprintf (stderr, "ERROR: value out of range for %s: '%s'\n",
+                     name.c_str(), tokens[i].c_str());
+            return FALSE;
+        }
+        ranges = ranges || (from != to);
+        froms.push_back (from);
+        tos.push_back (to);
+    }
+    filter_add_values (pred, type, froms, tos, ranges);
+    return TRUE;
+}
+
+/*
+ * function filter_parse_action
+ */
+static int
+filter_parse_action (const string& value, filter_pred *pred)
+{
+    vector<string> tokens = filter_split (value, ',');
+    unsigned long action;
+    unsigned int i;
+
+    for (i = 0; i < tokens.size(); i++)
+    {
+        if (tokens[i] == "ctl")
+        {
+            action = 0;
+        }
+        else if (tokens[i] == "drop")
+        {
+            action = 2;
+        }
+        else if (tokens[i] == "reject")
+        {
+            action = 3;
+        }
+        else if (tokens[i] == "accept")
+        {
+            action = 4;
+        }
+        else if (tokens[i] == "encrypt")
+        {
+            action = 5;
+        }
+        else if (tokens[i] == "decrypt")
+        {
+            action = 6;
+        }
+        else if (tokens[i] == "keyinst")
+        {
+            action = 7;
+        }
+        else
+        {
+            fprintf (stderr, "ERROR: invalid value for action: '%s'\n",
+                     tokens[i].c_str());
+            return FALSE;
+        }
+        filter_add_value (pred, LEA_VT_ACTION, action);
+    }
+    return TRUE;
+}
+
+/*
+ * function filter_parse_strings
+ *
+ * a list of strings, optionally restricted to the NULL terminated list of
+ * valid values
+ */
+static int
+filter_parse_strings (const string& name, const string& value,
+                      const char **valid, filter_pred *pred)
+{
+    vector<string> tokens = filter_split (value, ',');
+    unsigned int i;
+    int j;
+
+    for (i = 0; i < tokens.size(); i++)
+    {
+        if (valid != NULL)
+        {
+            for (j = 0; (valid[j] != NULL) && (tokens[i] != valid[j]); j++)
+                ;
+            if (valid[j] == NULL)
+            {
+                fprintf (stderr, "ERROR: invalid value for %s: '%s'\n",
+                         name.c_str(), tokens[i].c_str());
+                return FALSE;
+            }
+        }
+        filter_add_value (pred, LEA_VT_STRING, 0, tokens[i]);
+    }
+    return TRUE;
+}
+
+/*
+ * function compile_filter_rule
+ *
+ * compiles one filter definition ("argument=value;argument!=value;...")
+ * into a pass rule. The definition itself is left untouched, so it can be
+ * compiled again after a config refresh.
+ */
+int
+compile_filter_rule (const char *filterstring, int audit, filter_rule *rule)
+{
+    static const char *fw1_products[] =
+    {
+        "VPN-1 & FireWall-1", "SmartDefense", NULL
+    };
+    static const char *audit_products[] =
+    {
+        "SmartDashboard", "Policy Editor", "SmartView Tracker",
+        "SmartView Status", "SmartView Monitor", "System Monitor",
+        "cpstat_monitor", "SmartUpdate", "CPMI Client", NULL
+    };
+    vector<string> arguments = filter_split (filterstring, ';');
+    string name;
+    string value;
+    string::size_type equals;
+    unsigned long templong;
+    unsigned int i;
+    unsigned int j;
+    int ok;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function compile_filter_rule\n");
+    }
+
+    rule->action = LEA_FILTER_ACTION_PASS;
+    rule->preds.clear();
+
+    for (i = 0; i < arguments.size(); i++)
+    {
+        filter_pred pred;
+
+        if (arguments[i].length() == 0)
+        {
+            continue;
+        }
+
+        /*
+         * split argument into name and value separated by "="
+         */
+        if ((equals = arguments[i].find ('=')) == string::npos)
+        {
+            fprintf (stderr, "ERROR: syntax error in rule argument '%s'.\n"
+                     "       Required syntax: 'argument=value'\n",
+                     arguments[i].c_str());
+            return FALSE;
+        }
+        name = filter_trim (arguments[i].substr (0, equals));
+        value = filter_trim (arguments[i].substr (equals + 1));
+
+        pred.negation = 0;
+        if ((name.length() > 0) && (name[name.length() - 1] == '!'))
+        {
+            pred.negation = 1;
+            name = filter_trim (name.substr (0, name.length() - 1));
+        }
+        for (j = 0; j < name.length(); j++)
+        {
+            name[j] = tolower (name[j]);
+        }
+        pred.attr = name;
+        pred.op = LEA_FILTER_PRED_BELONGS_TO;
+
+        if (name == "product")
+        {
+            ok = filter_parse_strings (name, value,
+                                       (audit ? audit_products : fw1_products),
+                                       &pred);
+        }
+        else if (audit && (name == "administrator"))
+        {
+            pred.attr = "Administrator";
+            ok = filter_parse_strings (name, value, NULL, &pred);
+        }
+        else if (!audit && (name == "fw_subproduct"))
+        {
+            ok = filter_parse_strings (name, value, NULL, &pred);
+        }
+        else if (name == "action")
+        {
+            ok = filter_parse_action (value, &pred);
+        }
+        else if (name == "orig")
+        {
+            ok = filter_parse_addresses (name, value, FALSE, &pred);
+        }
+        else if (!audit && ((name == "src") || (name == "dst")))
+        {
+            ok = filter_parse_addresses (name, value, TRUE, &pred);
+        }
+        else if (!audit && (name == "proto"))
+        {
+            vector<string> tokens = filter_split (value, ',');
+            ok = TRUE;
+            for (j = 0; ok && (j < tokens.size()); j++)
+            {
+                if (tokens[j] == "icmp")
+                {
+                    filter_add_value (&pred, LEA_VT_IP_PROTO, 1);
+                }
+                else if (tokens[j] == "tcp")
+                {
+                    filter_add_value (&pred, LEA_VT_IP_PROTO, 6);
+                }
+                else if (tokens[j] == "udp")
+                {
+                    filter_add_value (&pred, LEA_VT_IP_PROTO, 17);
+                }
+                else
+                {
+                    fprintf (stderr, "ERROR: invalid value for proto: '%s'\n",
+                             tokens[j].c_str());
+                    ok = FALSE;
+                }
+            }
+        }
+        else if ((name == "starttime") || (name == "endtime"))
+        {
+            pred.attr = "time";
+            pred.op = (name == "starttime") ? LEA_FILTER_PRED_GREATER_EQUAL :
+                      LEA_FILTER_PRED_SMALLER_EQUAL;
+            if ((ok = filter_parse_time (name, value, &templong)))
+            {
+                filter_add_value (&pred, LEA_VT_TIME, templong);
+            }
+        }
+        else if (!audit && (name == "rule"))
+        {
+            ok = filter_parse_ranges (name, value, LEA_VT_RULE, INT_MAX, &pred);
+        }
+        else if (!audit && (name == "service"))
+        {
+            ok = filter_parse_ranges (name, value, LEA_VT_USHORT, 65535, &pred);
+        }
+        else
+        {
+            fprintf (stderr, "ERROR: Unknown filterargument: '%s'\n",
+                     name.c_str());
+            return FALSE;
+        }
+
+        if (!ok)
+        {
+            return FALSE;
+        }
+        rule->preds.push_back (pred);
+    }
+    return TRUE;
+}
+
+/*
+ * function compile_filters
+ *
+ * compiles the configured fw1 or audit filters, and for fw mode the rule
+ * dropping VPN-1 records in front of them, into filter_rules
+ */
+int
+compile_filters ()
+{
+    char **filter_array = cfgvalues.audit_mode ?
+                          cfgvalues.audit_filter_array : cfgvalues.fw1_filter_array;
+    int filter_count = cfgvalues.audit_mode ?
+                       cfgvalues.audit_filter_count : cfgvalues.fw1_filter_count;
+    filter_rule rule;
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function compile_filters\n");
+    }
+
+    filter_rules.clear();
+    if (filter_count <= 0)
+    {
+        return TRUE;
+    }
+
+    if (!cfgvalues.audit_mode && cfgvalues.fw_mode)
+    {
+        add_drop_vpn_rule (filter_rules);
+    }
+
+    for (i = 0; i < filter_count; i++)
+    {
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "filter %d: %s\n", i, filter_array[i]);
+        }
+        if (!compile_filter_rule (filter_array[i], cfgvalues.audit_mode, &rule))
+        {
+            fprintf (stderr, "ERROR: invalid filter '%s'\n", filter_array[i]);
+            filter_rules.clear();
+            return FALSE;
+        }
+        filter_rules.push_back (rule);
+    }
+    return TRUE;
+}
+
+/*
+ * function filter_predicate_create
+ *
+ * instantiates one compiled predicate
+ */
+static LeaFilterPredicate *
+filter_predicate_create (const filter_pred& pred)
+{
+    LeaFilterPredicate *ppred = NULL;
+    vector<lea_value_ex_t *> val_arr;
+    vector<lea_value_ex_t *> from_arr;
+    vector<lea_value_ex_t *> to_arr;
+    unsigned int i;
+    int ret;
+
+    if (pred.op == LEA_FILTER_PRED_BELONGS_TO_MASK)
+    {
+        return lea_filter_predicate_create (pred.attr.c_str(), -1, pred.negation,
+                                            LEA_FILTER_PRED_BELONGS_TO_MASK,
+                                            (in_addr_t) pred.values[0].num,
+                                            (in_addr_t) pred.values[1].num);
+    }
+
+    for (i = 0; i < pred.values.size(); i++)
+    {
+        lea_value_ex_t *value = lea_value_ex_create ();
+        const filter_value& v = pred.values[i];
+
+        if (value == NULL)
+        {
+            break;
+        }
+        val_arr.push_back (value);
+        switch (v.type)
+        {
+        case LEA_VT_STRING:
+            ret = lea_value_ex_set (value, LEA_VT_STRING, v.str.c_str());
+            break;
+        case LEA_VT_TIME:
+            ret = lea_value_ex_set (value, LEA_VT_TIME, v.num);
+            break;
+        case LEA_VT_IP_ADDR:
+            ret = lea_value_ex_set (value, LEA_VT_IP_ADDR, (in_addr_t) v.num);
+            break;
+        case LEA_VT_USHORT:
+            ret = lea_value_ex_set (value, LEA_VT_USHORT, (unsigned short) v.num);
+            break;
+        default:
+            ret = lea_value_ex_set (value, (LEA_VT) v.type, (unsigned int) v.num);
+            break;
+        }
+        if (ret == OPSEC_SESSION_ERR)
+        {
+            fprintf (stderr, "ERROR: failed to set rule value (%s)\n",
+                     opsec_errno_str (opsec_errno));
+            break;
+        }
+    }
+
+    if (val_arr.size() == pred.values.size() && (val_arr.size() > 0))
+    {
+        switch (pred.op)
+        {
+        case LEA_FILTER_PRED_BELONGS_TO:
+            ppred = lea_filter_predicate_create (pred.attr.c_str(), -1,
+                                                 pred.negation,
+                                                 LEA_FILTER_PRED_BELONGS_TO,
+                                                 (int) val_arr.size(),
+                                                 &val_arr[0]);
+            break;
+        case LEA_FILTER_PRED_BELONGS_TO_RANGE:
+            for (i = 0; i + 1 < val_arr.size(); i += 2)
+            {
+                from_arr.push_back (val_arr[i]);
+                to_arr.push_back (val_arr[i + 1]);
+            }
+            ppred = lea_filter_predicate_create (pred.attr.c_str(), -1,
+                                                 pred.negation,
+                                                 LEA_FILTER_PRED_BELONGS_TO_RANGE,
+                                                 (int) from_arr.size(),
+                                                 &from_arr[0], &to_arr[0]);
+            break;
+        case LEA_FILTER_PRED_GREATER_EQUAL:
+            ppred = lea_filter_predicate_create (pred.attr.c_str(), -1,
+                                                 pred.negation,
+                                                 LEA_FILTER_PRED_GREATER_EQUAL,
+                                                 val_arr[0]);
+            break;
+        case LEA_FILTER_PRED_SMALLER_EQUAL:
+            ppred = lea_filter_predicate_create (pred.attr.c_str(), -1,
+                                                 pred.negation,
+                                                 LEA_FILTER_PRED_SMALLER_EQUAL,
+                                                 val_arr[0]);
+            break;
+        }
+    }
+
+    for (i = 0; i < val_arr.size(); i++)
+    {
+        lea_value_ex_destroy (val_arr[i]);
+    }
+    return ppred;
+}
+
+/*
+ * function filter_rulebase_create
+ *
+ * instantiates the compiled filter_rules as a LEA rulebase for one session
+ */
+LeaFilterRulebase *
+filter_rulebase_create ()
+{
+    LeaFilterRulebase *prulebase;
+    LeaFilterRule *prule;
+    LeaFilterPredicate *ppred;
+    unsigned int i;
+    unsigned int j;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function filter_rulebase_create\n");
+    }
+
+    if ((prulebase = lea_filter_rulebase_create ()) == NULL)
+    {
+        fprintf (stderr, "ERROR: failed to create rulebase\n");
+        return NULL;
+    }
+
+    for (i = 0; i < filter_rules.size(); i++)
+    {
+        if ((prule = lea_filter_rule_create ((eLeaFilterAction) filter_rules[i].action)) == NULL)
+        {
+            fprintf (stderr, "ERROR: failed to create rule\n");
+            lea_filter_rulebase_destroy (prulebase);
+            return NULL;
+        }
+
+        for (j = 0; j < filter_rules[i].preds.size(); j++)
+        {
+            if ((ppred = filter_predicate_create (filter_rules[i].preds[j])) == NULL)
+            {
+                fprintf (stderr, "ERROR: failed to create predicate\n");
+                lea_filter_rule_destroy (prule);
+                lea_filter_rulebase_destroy (prulebase);
+                return NULL;
+            }
+            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
+            {
+                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
+                lea_filter_predicate_destroy (ppred);
+                lea_filter_rule_destroy (prule);
+                lea_filter_rulebase_destroy (prulebase);
+                return NULL;
+            }
+            lea_filter_predicate_destroy (ppred);
+        }
+
+        if (lea_filter_rulebase_add_rule (prulebase, prule) != OPSEC_SESSION_OK)
+        {
+            fprintf (stderr, "ERROR: failed to add rule to rulebase\n");
+            lea_filter_rule_destroy (prule);
+            lea_filter_rulebase_destroy (prulebase);
+            return NULL;
+        }
+        lea_filter_rule_destroy (prule);
+    }
+
+    return prulebase;
+}
+
+/*
+ * function record_fields
+ *
+ * looks up the fields named attrs in a record, values[k] is NULL if the
+ * record has no attrs[k]. The attribute ids of a session are resolved
+ * once and cached in slots.
+ */
+static void
+record_fields (OpsecSession * pSession, lea_record * pRec,
+               const vector<string>& attrs, vector<int>& slots,
+               vector<lea_field *>& values)
+{
+    unsigned int i;
+    unsigned int k;
+    int id;
+    char *name;
+
+    values.assign (attrs.size(), (lea_field *) NULL);
+    for (i = 0; i < (unsigned int) pRec->n_fields; i++)
+    {
+        id = pRec->fields[i].lea_attr_id;
+        if (id < 0)
+        {
+            continue;
+        }
+        if ((unsigned int) id >= slots.size())
+        {
+            slots.resize (id + 1, -2);
+        }
+        if (slots[id] == -2)
+        {
+            // first sight of this attribute id in the session
+            name = lea_attr_name (pSession, id);
+            slots[id] = -1;
+            for (k = 0; (name != NULL) && (k < attrs.size()); k++)
+            {
+                if (attrs[k] == name)
+                {
+                    slots[id] = k;
+                    break;
+                }
+            }
+        }
+        if (slots[id] >= 0)
+        {
+            values[slots[id]] = &(pRec->fields[i]);
+        }
+    }
+}
+
+/*
+ * function post_filter_parse_term
+ *
+ * "attribute op value", op one of =~ !~ *= == != <= >= < >
+ */
+static int
+post_filter_parse_term (const string& text, post_term *term, string *attr)
+{
+    static const char *ops[] =
+    {
+        "=~", "!~", "*=", "==", "!=", "<=", ">=", "<", ">", NULL
+    };
+    static const int codes[] =
+    {
+        POST_OP_MATCH, POST_OP_NOMATCH, POST_OP_CONTAINS, POST_OP_EQ,
+        POST_OP_NE, POST_OP_LE, POST_OP_GE, POST_OP_LT, POST_OP_GT
+    };
+    string::size_type pos;
+    string value;
+    char *end;
+    int i;
+
+    for (pos = 0; pos < text.length(); pos++)
+    {
+        for (i = 0; ops[i] != NULL; i++)
+        {
+            if (text.compare (pos, strlen (ops[i]), ops[i]) == 0)
+            {
+                break;
+            }
+        }
+        if (ops[i] != NULL)
+        {
+            break;
+        }
+    }
+    if (pos == text.length())
+    {
+        return FALSE;
+    }
+
+    *attr = filter_trim (text.substr (0, pos));
+    value = filter_trim (text.substr (pos + strlen (ops[i])));
+    if ((value.length() >= 2) && (value[0] == '"') &&
+            (value[value.length() - 1] == '"'))
+    {
+        value = value.substr (1, value.length() - 2);
+    }
+    if (attr->length() == 0)
+    {
+        return FALSE;
+    }
+
+    term->op = codes[i];
+    term->str = value;
+    term->regex = NULL;
+    term->num = strtol (value.c_str(), &end, 10);
+    term->numeric = (value.length() > 0) && (*end == '\0');
+
+    switch (term->op)
+    {
+    case POST_OP_MATCH:
+    case POST_OP_NOMATCH:
+        term->regex = new regex_t;
+        if (regcomp (term->regex, value.c_str(), REG_EXTENDED | REG_NOSUB) != 0)
+        {
+            delete term->regex;
+            term->regex = NULL;
+            return FALSE;
+        }
+        term->numeric = FALSE;
+        break;
+    case POST_OP_CONTAINS:
+        term->numeric = FALSE;
+        break;
+    case POST_OP_LT:
+    case POST_OP_LE:
+    case POST_OP_GT:
+    case POST_OP_GE:
+        if (!term->numeric)
+        {
+            return FALSE;
+        }
+        break;
+    }
+    return TRUE;
+}
+
+/*
+ * function post_filter_compile
+ *
+ * compiles the POST_FILTER_RULE definitions ("term;term;...") once into a
+ * flat list of terms with precompiled regular expressions. Attributes are
+ * mapped to slots, the attribute ids of a session are resolved lazily.
+ */
+int
+post_filter_compile ()
+{
+    vector<string> terms;
+    post_rule rule;
+    post_term term;
+    string attr;
+    unsigned int i;
+    unsigned int j;
+    unsigned int k;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function post_filter_compile\n");
+    }
+
+    for (i = 0; i < cfgvalues.post_filters.size(); i++)
+    {
+        rule.text = cfgvalues.post_filters[i];
+        rule.first = post_filter.terms.size();
+        rule.count = 0;
+        rule.hits = 0;
+
+        terms = filter_split (rule.text, ';');
+        for (j = 0; j < terms.size(); j++)
+        {
+            if (terms[j].length() == 0)
+            {
+                continue;
+            }
+            if (!post_filter_parse_term (terms[j], &term, &attr))
+            {
+                fprintf (stderr,
+                         "ERROR: syntax error in post filter term '%s'.\n"
+                         "       Required syntax: 'attribute op value', op one of =~ !~ *= == != < <= > >=\n",
+                         terms[j].c_str());
+                return FALSE;
+            }
+            for (k = 0; (k < post_filter.attrs.size()) && (post_filter.attrs[k] != attr); k++)
+                ;
+            if (k == post_filter.attrs.size())
+            {
+                post_filter.attrs.push_back (attr);
+            }
+            term.slot = k;
+            post_filter.terms.push_back (term);
+            rule.count++;
+        }
+        // a rule without terms would match every record
+        if (rule.count == 0)
+        {
+            fprintf (stderr,
+                     "WARNING: post filter rule '%s' has no terms, ignored\n",
+                     rule.text.c_str());
+            continue;
+        }
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr, "DEBUG: post filter %d: %s (%d terms)\n", i,
+                     rule.text.c_str(), rule.count);
+        }
+        post_filter.rules.push_back (rule);
+    }
+    return TRUE;
+}
+
+/*
+ * function post_filter_number
+ *
+ * the raw value of a numeric field, ports in host byte order
+ */
+static int
+post_filter_number (const lea_field *field, long *num)
+{
+    char *end;
+
+    switch (field->lea_val_type)
+    {
+    case LEA_VT_INT:
+        *num = field->lea_value.i_value;
+        return TRUE;
+    case LEA_VT_USHORT:
+        *num = field->lea_value.ush_value;
+        return TRUE;
+    case LEA_VT_TCP_PORT:
+    case LEA_VT_UDP_PORT:
+        *num = ntohs (field->lea_value.ush_value);
+        return TRUE;
+    case LEA_VT_IP_ADDR:
+        return FALSE;
+    case LEA_VT_STRING:
+        if (field->lea_value.string_value == NULL)
+        {
+            return FALSE;
+        }
+        *num = strtol (field->lea_value.string_value, &end, 10);
+        return (*end == '\0') && (end != field->lea_value.string_value);
+    default:
+        *num = (long) field->lea_value.ul_value;
+        return TRUE;
+    }
+}
+
+/*
+ * function post_filter_term
+ */
+static int
+post_filter_term (OpsecSession * pSession, const post_term& term,
+                  lea_field *field)
+{
+    const char *text;
+    long num;
+
+    if (field == NULL)
+    {
+        return (term.op == POST_OP_NOMATCH) || (term.op == POST_OP_NE);
+    }
+
+    if (term.numeric)
+    {
+        if (!post_filter_number (field, &num))
+        {
+            return (term.op == POST_OP_NE);
+        }
+        switch (term.op)
+        {
+        case POST_OP_EQ:
+            return num == term.num;
+        case POST_OP_NE:
+            return num != term.num;
+        case POST_OP_LT:
+            return num < term.num;
+        case POST_OP_LE:
+            return num <= term.num;
+        case POST_OP_GT:
+            return num > term.num;
+        case POST_OP_GE:
+            return num >= term.num;
+        }
+        return FALSE;
+    }
+
+    text = (field->lea_val_type == LEA_VT_STRING) ?
+           field->lea_value.string_value : lea_resolve_field (pSession, *field);
+    if (text == NULL)
+    {
+        text = "";
+    }
+    switch (term.op)
+    {
+    case POST_OP_MATCH:
+        return regexec (term.regex, text, 0, NULL, 0) == 0;
+    case POST_OP_NOMATCH:
+        return regexec (term.regex, text, 0, NULL, 0) != 0;
+    case POST_OP_CONTAINS:
+        return strstr (text, term.str.c_str()) != NULL;
+    case POST_OP_EQ:
+        return term.str == text;
+    case POST_OP_NE:
+        return term.str != text;
+    }
+    return FALSE;
+}
+
+/*
+ * function post_filter_match
+ *
+ * TRUE if the record passes the local filter, counts the hits per rule
+ */
+int
+post_filter_match (OpsecSession * pSession, lea_record * pRec)
+{
+    unsigned int i;
+    unsigned int j;
+
+    if (post_filter.rules.empty())
+    {
+        return TRUE;
+    }
+    post_filter.records++;
+    record_fields (pSession, pRec, post_filter.attrs,
+                   post_filter.slots[pSession], post_filter.values);
+
+    for (i = 0; i < post_filter.rules.size(); i++)
+    {
+        post_rule& rule = post_filter.rules[i];
+
+        for (j = rule.first; j < rule.first + rule.count; j++)
+        {
+            const post_term& term = post_filter.terms[j];
+
+            if (!post_filter_term (pSession, term, post_filter.values[term.slot]))
+            {
+                break;
+            }
+        }
+        if (j == rule.first + rule.count)
+        {
+            rule.hits++;
+            return TRUE;
+        }
+    }
+    post_filter.dropped++;
+    return FALSE;
+}
+
+/*
+ * function post_filter_report
+ *
+ * emits the counters of the local filter and forgets the attribute ids of
+ * the sessions that have ended
+ */
+void
+post_filter_report ()
+{
+    stringstream sstream;
+    unsigned int i;
+
+    post_filter.slots.clear();
+    if (post_filter.rules.empty())
+    {
+        return;
+    }
+    sstream << "post_filter_records=" << post_filter.records
+            << "|post_filter_dropped=" << post_filter.dropped;
+    for (i = 0; i < post_filter.rules.size(); i++)
+    {
+        sstream << "|post_filter_rule" << i << "_hits="
+                << post_filter.rules[i].hits;
+    }
+    metrics_emit (sstream.str());
+}
+
+/*
+ * function sample_compile
+ *
+ * parses SAMPLE_RATES ("accept=1/100, drop=1, SmartDefense=1, *=1/10").
+ * Keys are actions or products, a product rate takes precedence over the
+ * action rate. A rate is 1/N, 1 to keep everything or 0 to keep nothing.
+ */
+int
+sample_compile ()
+{
+    static const char *attrs[] =
+    {
+        "action", "product", "src", "dst", "proto", "s_port", "service", NULL
+    };
+    vector<string> tokens;
+    vector<string> parts;
+    string key;
+    string rate;
+    unsigned long n;
+    unsigned int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function sample_compile\n");
+    }
+
+    sampling.default_rate = 1;
+    if (cfgvalues.sample_rates.length() == 0)
+    {
+        return TRUE;
+    }
+    for (i = 0; attrs[i] != NULL; i++)
+    {
+        sampling.attrs.push_back (attrs[i]);
+    }
+
+    tokens = filter_split (cfgvalues.sample_rates, ',');
+    for (i = 0; i < tokens.size(); i++)
+    {
+        parts = filter_split (tokens[i], '=');
+        key = parts[0];
+        rate = (parts.size() == 2) ? parts[1] : string ("");
+        if (rate == "0")
+        {
+            n = 0;
+        }
+        else if (rate == "1")
+        {
+            n = 1;
+        }
+        else if ((rate.compare (0, 2, "1/") == 0) && (rate.length() > 2) &&
+                 (rate.find_first_not_of ("0123456789", 2) == string::npos))
+        {
+            n = strtoul (rate.c_str() + 2, (char **) NULL, 10);
+        }
+        else
+        {
+            n = 0;
+            key = "";
+        }
+        if ((key.length() == 0) || ((n == 0) && (rate != "0")))
+        {
+            fprintf (stderr,
+                     "ERROR: syntax error in sample rate '%s'.\n"
+                     "       Required syntax: 'action=1/N', 'product=1/N' or '*=1/N'\n",
+                     tokens[i].c_str());
+            return FALSE;
+        }
+        if (key == "*")
+        {
+            sampling.default_rate = n;
+        }
+        else
+        {
+            sampling.rates[key] = n;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * function sample_action_name
+ *
+ * the raw action codes, as used by filter_parse_action
+ */
+static const char *
+sample_action_name (unsigned long action)
+{
+    switch (action)
+    {
+    case 0:
+        return "ctl";
+    case 2:
+        return "drop";
+    case 3:
+        return "reject";
+    case 4:
+        return "accept";
+    case 5:
+        return "encrypt";
+    case 6:
+        return "decrypt";
+    case 7:
+        return "keyinst";
+    }
+    return "";
+}
+
+/*
+ * function sample_hash
+ *
+ * 32 bit FNV-1a
+ */
+static unsigned long
+sample_hash (unsigned long hash, const void *data, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        hash = ((hash ^ bytes[i]) * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+/*
+ * function sample_record
+ *
+ * the rate N the record was sampled with, 0 if it is skipped. The hash
+ * covers the raw connection 5-tuple, so all records of a connection are
+ * kept or skipped together. Records without any of it hash by position.
+ */
+unsigned long
+sample_record (OpsecSession * pSession, lea_record * pRec, int pos)
+{
+    map<string, unsigned long>::iterator it = sampling.rates.end();
+    lea_field *field;
+    unsigned long rate = sampling.default_rate;
+    unsigned long hash = 2166136261UL;
+    unsigned long ul;
+    unsigned short us;
+    int tuple = FALSE;
+    int k;
+
+    if (sampling.attrs.empty())
+    {
+        return 1;
+    }
+    record_fields (pSession, pRec, sampling.attrs, sampling.slots[pSession],
+                   sampling.values);
+
+    if (((field = sampling.values[SAMPLE_PRODUCT]) != NULL) &&
+            (field->lea_val_type == LEA_VT_STRING) &&
+            (field->lea_value.string_value != NULL))
+    {
+        it = sampling.rates.find (field->lea_value.string_value);
+    }
+    if ((it == sampling.rates.end()) &&
+            ((field = sampling.values[SAMPLE_ACTION]) != NULL))
+    {
+        it = sampling.rates.find (sample_action_name (field->lea_value.ul_value));
+    }
+    if (it != sampling.rates.end())
+    {
+        rate = it->second;
+    }
+
+    if (rate > 1)
+    {
+        for (k = SAMPLE_SRC; k <= SAMPLE_SERVICE; k++)
+        {
+            if ((field = sampling.values[k]) == NULL)
+            {
+                continue;
+            }
+            switch (field->lea_val_type)
+            {
+            case LEA_VT_USHORT:
+            case LEA_VT_TCP_PORT:
+            case LEA_VT_UDP_PORT:
+                us = field->lea_value.ush_value;
+                hash = sample_hash (hash, &us, sizeof (us));
+                break;
+            case LEA_VT_STRING:
+                if (field->lea_value.string_value != NULL)
+                {
+                    hash = sample_hash (hash, field->lea_value.string_value,
+                                        strlen (field->lea_value.string_value));
+                }
+                break;
+            default:
+                ul = field->lea_value.ul_value;
+                hash = sample_hash (hash, &ul, sizeof (ul));
+                break;
+            }
+            tuple = TRUE;
+        }
+        if (!tuple)
+        {
+            hash = sample_hash (hash, &pos, sizeof (pos));
+        }
+    }
+
+    if ((rate == 0) || ((rate > 1) && (hash % rate != 0)))
+    {
+        sampling.skipped++;
+        return 0;
+    }
+    sampling.kept++;
+    return rate;
+}
+
+/*
+ * function sample_report
+ */
+void
+sample_report ()
+{
+    stringstream sstream;
+
+    sampling.slots.clear();
+    if (sampling.attrs.empty())
+    {
+        return;
+    }
+    sstream << "sample_kept=" << sampling.kept
+            << "|sample_skipped=" << sampling.skipped;
+    metrics_emit (sstream.str());
+}
+
+/*
+ * function aggregate_init
+ *
+ * sizes the table to twice AGGREGATE_MAX_KEYS, rounded up to a power of 2
+ */
+void
+aggregate_init ()
+{
+    static const char *attrs[] =
+    {
+        "time", "src", "dst", "service", "action", "rule", "bytes",
+        "packets", "elapsed", NULL
+    };
+    aggregate_entry empty;
+    unsigned long size = 16;
+    int i;
+
+    if (cfgvalues.aggregate_window <= 0)
+    {
+        return;
+    }
+    if (cfgvalues.aggregate_max_keys < 1)
+    {
+        cfgvalues.aggregate_max_keys = 1;
+    }
+    for (i = 0; attrs[i] != NULL; i++)
+    {
+        aggregate.attrs.push_back (attrs[i]);
+    }
+    while (size < 2 * (unsigned long) cfgvalues.aggregate_max_keys)
+    {
+        size *= 2;
+    }
+    memset (&empty, 0, sizeof (empty));
+    aggregate.table.assign (size, empty);
+    aggregate.used = 0;
+    aggregate.window_start = 0;
+    aggregate.context = NULL;
+    aggregate.last_pos = -1;
+}
+
+/*
+ * function aggregate_value
+ *
+ * the raw value of a key or sum field, 0 if the record has none
+ */
+static unsigned long
+aggregate_value (const lea_field *field)
+{
+    long num;
+
+    if (field == NULL)
+    {
+        return 0;
+    }
+    if (field->lea_val_type == LEA_VT_IP_ADDR)
+    {
+        return field->lea_value.ul_value;
+    }
+    return post_filter_number (field, &num) ? (unsigned long) num : 0;
+}
+
+/*
+ * function aggregate_record
+ *
+ * folds a record into the table, weighted with its sample rate. Records
+ * of a later window flush the current one first. pContext is NULL for
+ * records that must not be checkpointed.
+ */
+void
+aggregate_record (OpsecSession * pSession, lea_record * pRec,
+                  PSESSION_CONTEXT pContext, int pos, unsigned long weight)
+{
+    unsigned long mask = aggregate.table.size() - 1;
+    unsigned long key[5];
+    unsigned long window;
+    unsigned long hash = 2166136261UL;
+    unsigned long idx;
+    aggregate_entry *entry;
+    int k;
+
+    record_fields (pSession, pRec, aggregate.attrs, aggregate.slots[pSession],
+                   aggregate.values);
+
+    window = aggregate_value (aggregate.values[AGG_TIME]);
+    window -= window % cfgvalues.aggregate_window;
+    if ((aggregate.window_start != 0) && (window > aggregate.window_start))
+    {
+        aggregate_flush (FALSE);
+    }
+
+    for (k = 0; k < 5; k++)
+    {
+        key[k] = aggregate_value (aggregate.values[AGG_SRC + k]);
+    }
+    hash = sample_hash (hash, key, sizeof (key));
+
+    for (idx = hash & mask; aggregate.table[idx].used; idx = (idx + 1) & mask)
+    {
+        entry = &(aggregate.table[idx]);
+        if ((entry->src == key[0]) && (entry->dst == key[1]) &&
+                (entry->service == key[2]) && (entry->action == key[3]) &&
+                (entry->rule == key[4]))
+        {
+            break;
+        }
+    }
+    if (!aggregate.table[idx].used)
+    {
+        if (aggregate.used >= (unsigned long) cfgvalues.aggregate_max_keys)
+        {
+            aggregate.evictions++;
+            aggregate_flush (TRUE);
+            idx = hash & mask;
+        }
+        entry = &(aggregate.table[idx]);
+        entry->used = TRUE;
+        entry->src = key[0];
+        entry->dst = key[1];
+        entry->service = key[2];
+        entry->action = key[3];
+        entry->rule = key[4];
+        aggregate.used++;
+    }
+    entry = &(aggregate.table[idx]);
+    entry->count += weight;
+    entry->bytes += weight * aggregate_value (aggregate.values[AGG_BYTES]);
+    entry->packets += weight * aggregate_value (aggregate.values[AGG_PACKETS]);
+    entry->elapsed += weight * aggregate_value (aggregate.values[AGG_ELAPSED]);
+
+    if (aggregate.window_start == 0)
+    {
+        aggregate.window_start = window;
+    }
+    aggregate.records++;
+    if (pContext != NULL)
+    {
+        aggregate.context = pContext;
+        aggregate.last_pos = pos;
+    }
+}
+
+/*
+ * function aggregate_flush
+ *
+ * hands one summary per connection of the current window to the output
+ * and empties the table. partial is set when the memory cap forced the
+ * flush before the window ended.
+ */
+void
+aggregate_flush (int partial)
+{
+    stringstream sstream;
+    aggregate_entry *entry;
+    struct in_addr addr;
+    char timestring[21];
+    time_t logtime;
+    char sep = cfgvalues.record_separator;
+    unsigned long i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function aggregate_flush\n");
+    }
+
+    if (cfgvalues.dateformat == DATETIME_STD)
+    {
+        logtime = (time_t) aggregate.window_start;
+        strftime (timestring, 20, "%Y-%m-%d %H:%M:%S", localtime (&logtime));
+    }
+    else
+    {
+        snprintf (timestring, sizeof(timestring), "%lu", aggregate.window_start);
+    }
+
+    for (i = 0; (aggregate.used > 0) && (i < aggregate.table.size()); i++)
+    {
+        entry = &(aggregate.table[i]);
+        if (!entry->used)
+        {
+            continue;
+        }
+        sstream.str ("");
+        sstream << "time=" << timestring
+                << sep << "window=" << cfgvalues.aggregate_window;
+        addr.s_addr = (in_addr_t) entry->src;
+        sstream << sep << "src=" << inet_ntoa (addr);
+        addr.s_addr = (in_addr_t) entry->dst;
+        sstream << sep << "dst=" << inet_ntoa (addr)
+                << sep << "service=" << entry->service
+                << sep << "action=";
+        // a code of a later version goes out as a number
+        if (sample_action_name (entry->action)[0] != '\0')
+        {
+            sstream << sample_action_name (entry->action);
+        }
+        else
+        {
+            sstream << entry->action;
+        }
+        sstream << sep << "rule=" << entry->rule
+                << sep << "count=" << entry->count
+                << sep << "bytes=" << entry->bytes
+                << sep << "packets=" << entry->packets
+                << sep << "elapsed=" << entry->elapsed;
+        if (partial)
+        {
+            sstream << sep << "partial=1";
+        }
+        compress_stamp (-1, aggregate.window_start);
+        submit_log ((char *) sstream.str().c_str());
+        memset (entry, 0, sizeof (*entry));
+        aggregate.used--;
+        aggregate.summaries++;
+    }
+    aggregate.used = 0;
+    aggregate.window_start = 0;
+
+    /*
+     * the records folded in are handed off only now
+     */
+    if (aggregate.last_pos >= 0)
+    {
+        watermark.submitted_pos = aggregate.last_pos;
+        if ((aggregate.context != NULL) &&
+                (aggregate.context->config_entity.length() > 0))
+        {
+            checkpoint_record (aggregate.context, aggregate.last_pos);
+        }
+        aggregate.last_pos = -1;
+    }
+}
+
+/*
+ * function aggregate_timer
+ *
+ * scheduled once per second in online mode, flushes a window no record
+ * has closed one window after it ended
+ */
+void
+aggregate_timer (void *opaque)
+{
+    OpsecEnv *pEnv = (OpsecEnv *) opaque;
+
+    if ((aggregate.window_start != 0) &&
+            ((unsigned long) time (NULL) >=
+             aggregate.window_start + 2 * cfgvalues.aggregate_window))
+    {
+        aggregate_flush (FALSE);
+    }
+    opsec_schedule (pEnv, 1000, aggregate_timer, pEnv);
+}
+
+/*
+ * function aggregate_report
+ */
+void
+aggregate_report ()
+{
+    stringstream sstream;
+
+    aggregate.slots.clear();
+    if (cfgvalues.aggregate_window <= 0)
+    {
+        return;
+    }
+    sstream << "aggregate_records=" << aggregate.records
+            << "|aggregate_summaries=" << aggregate.summaries
+            << "|aggregate_evictions=" << aggregate.evictions;
+    metrics_emit (sstream.str());
+}
+
+/*
+ * function dedup_init
+ */
+void
+dedup_init ()
+{
+    vector<string> fields;
+    unsigned int i;
+
+    if (cfgvalues.dedup_window <= 0)
+    {
+        return;
+    }
+    fields = filter_split (cfgvalues.dedup_fields, ';');
+    for (i = 0; i < fields.size(); i++)
+    {
+        if (fields[i].length() > 0)
+        {
+            dedup.attrs.push_back (fields[i]);
+        }
+    }
+    dedup.attrs.push_back ("time");
+    if (cfgvalues.dedup_table_size < DEDUP_PROBES)
+    {
+        cfgvalues.dedup_table_size = DEDUP_PROBES;
+    }
+    dedup.table.resize (cfgvalues.dedup_table_size);
+    dedup.generation = 0;
+    dedup.last_pos = -1;
+}
+
+/*
+ * function dedup_emit
+ *
+ * hands a held record to the output, repeat_count is the number of
+ * records it stands for
+ */
+static void
+dedup_emit (unsigned long slot)
+{
+    dedup_entry *entry = &(dedup.table[slot]);
+    stringstream sstream;
+
+    if (entry->message.length() > 0)
+    {
+        if ((cfgvalues.output_format == FORMAT_CEF) ||
+                (cfgvalues.output_format == FORMAT_LEEF))
+        {
+            sstream << entry->message << cef.separator << cef.repeat_key
+                    << (entry->repeats + 1);
+        }
+        else if (cfgvalues.output_format != FORMAT_KV)
+        {
+            // the last column
+            sstream << entry->message << csv.delimiter << (entry->repeats + 1);
+        }
+        else
+        {
+            sstream << entry->message << cfgvalues.record_separator
+                    << "repeat_count=" << (entry->repeats + 1);
+        }
+        compress_stamp (entry->pos, entry->first_time);
+        submit_log ((char *) sstream.str().c_str());
+        dedup.emitted++;
+    }
+    entry->used = FALSE;
+    entry->key.clear();
+    entry->message.clear();
+}
+
+/*
+ * function dedup_expire
+ *
+ * emits the held records whose window has closed at record time t
+ */
+static void
+dedup_expire (unsigned long t)
+{
+    dedup_entry *entry;
+
+    while (!dedup.order.empty())
+    {
+        entry = &(dedup.table[dedup.order.front().first]);
+        if (entry->used && (entry->generation == dedup.order.front().second))
+        {
+            if (entry->first_time + cfgvalues.dedup_window > t)
+            {
+                break;
+            }
+            dedup_emit (dedup.order.front().first);
+        }
+        dedup.order.pop_front();
+    }
+}
+
+/*
+ * function dedup_record
+ *
+ * -1 if the record repeats a held one and is suppressed, otherwise the
+ * slot its formatted message is held in, see dedup_hold
+ */
+int
+dedup_record (OpsecSession * pSession, lea_record * pRec, int pos)
+{
+    unsigned long size = dedup.table.size();
+    unsigned long t;
+    unsigned long hash;
+    unsigned long idx;
+    long victim = -1;
+    long slot = -1;
+    unsigned long ul;
+    unsigned short us;
+    lea_field *field;
+    dedup_entry *entry;
+    string key;
+    unsigned int k;
+    int i;
+
+    record_fields (pSession, pRec, dedup.attrs, dedup.slots[pSession],
+                   dedup.values);
+    field = dedup.values[dedup.attrs.size() - 1];
+    t = (field != NULL) ? field->lea_value.ul_value : 0;
+    dedup.records++;
+    dedup.last_pos = pos;
+    dedup_expire (t);
+
+    for (k = 0; k + 1 < dedup.attrs.size(); k++)
+    {
+        if ((field = dedup.values[k]) == NULL)
+        {
+            key += '\0';
+        }
+        else if (field->lea_val_type == LEA_VT_STRING)
+        {
+            key += '\1';
+            if (field->lea_value.string_value != NULL)
+            {
+                key.append (field->lea_value.string_value,
+                            strlen (field->lea_value.string_value) + 1);
+            }
+        }
+        else
+        {
+            // the union is only as wide as the member of the type
+            key += '\2';
+            switch (field->lea_val_type)
+            {
+            case LEA_VT_USHORT:
+            case LEA_VT_TCP_PORT:
+            case LEA_VT_UDP_PORT:
+                us = field->lea_value.ush_value;
+                key.append ((const char *) &us, sizeof (us));
+                break;
+            default:
+                ul = field->lea_value.ul_value;
+                key.append ((const char *) &ul, sizeof (ul));
+                break;
+            }
+        }
+    }
+    hash = sample_hash (2166136261UL, key.data(), key.length());
+
+    for (i = 0; i < DEDUP_PROBES; i++)
+    {
+        idx = (hash + i) % size;
+        entry = &(dedup.table[idx]);
+        if (entry->used && (entry->key == key))
+        {
+            entry->repeats++;
+            dedup.suppressed++;
+            return -1;
+        }
+        if (!entry->used)
+        {
+            if (slot < 0)
+            {
+                slot = idx;
+            }
+        }
+        else if ((victim < 0) || (entry->first_time < dedup.table[victim].first_time))
+        {
+            victim = idx;
+        }
+    }
+    if (slot < 0)
+    {
+        dedup.evictions++;
+        dedup_emit (victim);
+        slot = victim;
+    }
+
+    entry = &(dedup.table[slot]);
+    entry->used = TRUE;
+    entry->key = key;
+    entry->first_time = t;
+    entry->pos = pos;
+    entry->repeats = 0;
+    entry->generation = ++dedup.generation;
+    dedup.order.push_back (make_pair ((unsigned long) slot, entry->generation));
+    return (int) slot;
+}
+
+/*
+ * function dedup_hold
+ */
+void
+dedup_hold (int slot, const char *message)
+{
+    dedup.table[slot].message = message;
+}
+
+/*
+ * function dedup_handoff_pos
+ *
+ * the position up to which all records are handed to the output, records
+ * from the oldest held one on are not
+ */
+int
+dedup_handoff_pos (int pos)
+{
+    dedup_entry *entry;
+
+    while (!dedup.order.empty())
+    {
+        entry = &(dedup.table[dedup.order.front().first]);
+        if (entry->used && (entry->generation == dedup.order.front().second))
+        {
+            return (entry->pos - 1 < pos) ? entry->pos - 1 : pos;
+        }
+        dedup.order.pop_front();
+    }
+    return pos;
+}
+
+/*
+ * function dedup_flush
+ *
+ * emits all held records
+ */
+void
+dedup_flush ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function dedup_flush\n");
+    }
+
+    while (!dedup.order.empty())
+    {
+        dedup_entry *entry = &(dedup.table[dedup.order.front().first]);
+
+        if (entry->used && (entry->generation == dedup.order.front().second))
+        {
+            dedup_emit (dedup.order.front().first);
+        }
+        dedup.order.pop_front();
+    }
+    if (dedup.last_pos >= 0)
+    {
+        watermark.submitted_pos = dedup.last_pos;
+    }
+}
+
+/*
+ * function dedup_timer
+ *
+ * scheduled once per second in online mode, emits held records one window
+ * after their window has closed when no later record did
+ */
+void
+dedup_timer (void *opaque)
+{
+    OpsecEnv *pEnv = (OpsecEnv *) opaque;
+
+    dedup_expire ((unsigned long) time (NULL) - cfgvalues.dedup_window);
+    if (dedup.last_pos >= 0)
+    {
+        watermark.submitted_pos = dedup_handoff_pos (dedup.last_pos);
+    }
+    opsec_schedule (pEnv, 1000, dedup_timer, pEnv);
+}
+
+/*
+ * function dedup_report
+ */
+void
+dedup_report ()
+{
+    stringstream sstream;
+
+    dedup.slots.clear();
+    if (cfgvalues.dedup_window <= 0)
+    {
+        return;
+    }
+    sstream << "dedup_records=" << dedup.records
+            << "|dedup_suppressed=" << dedup.suppressed
+            << "|dedup_emitted=" << dedup.emitted
+            << "|dedup_evictions=" << dedup.evictions
+            << "|dedup_suppression_pct="
+            << ((dedup.records > 0) ? dedup.suppressed * 100 / dedup.records : 0);
+    metrics_emit (sstream.str());
+}
+
+/*
+ * BEGIN: function string_get_token
+ */
+char *
+string_get_token (char **tokstring, char separator)
+{
+    char *tempstring = NULL;
+    char *returnstring;
+    int strlength;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_get_token\n");
+    }
+
+    /*
+     * return if tokstring is NULL
+     */
+    if (*tokstring == NULL)
+    {
+        return NULL;
+    }
+
+    /*
+     * search for first separator
+     */
+    tempstring = strchr (*tokstring, separator);
+
+    /*
+     * calculate string length
+     */
+    if (tempstring)
+    {
+        tempstring = tempstring + 1;
+        strlength = strlen (*tokstring) - strlen (tempstring);
+    }
+    else
+    {
+        strlength = strlen (*tokstring) + 1;
+    }
+
+    returnstring = (char *) malloc (strlength + 1);
+    if (returnstring == NULL)
+    {
+        fprintf (stderr, "ERROR: Out of memory\n");
+        exit_loggrabber (1);
+    }
+    strncpy (returnstring, *tokstring, strlength);
+    returnstring[strlength - 1] = '\0';
+
+    *tokstring = tempstring;
+    return returnstring;
+}
+
+/*
+ * BEGIN: function string_duplicate
+ */
+char *
+string_duplicate (const char *src)
+{
+    size_t length;
+    char *dst;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_duplicate\n");
+    }
+
+    if (src == NULL)
+    {
+        return NULL;
+    }
+
+    length = strlen (src) + 1;
+    dst = (char*) malloc (length);
+    if (!dst)
+    {
+        fprintf (stderr, "ERROR: out of memory\n");
+        exit_loggrabber (1);
+    }
+    return ((char*) memcpy (dst, src, length));
+}
+
+/*
+ * BEGIN: function string_left_trim
+ */
+char *
+string_left_trim (char *string, char character)
+{
+    char *tmp;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_left_trim\n");
+    }
+
+    if (string == NULL)
+    {
+        return NULL;
+    }
+    tmp = string + strlen (string);
+    while ((string[0] == character) && (string < tmp))
+        string++;
+    return (string);
+}
+
+/*
+ * BEGIN: function string_right_trim
+ */
+char *
+string_right_trim (char *string, char character)
+{
+    int tmp;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_right_trim\n");
+    }
+
+    if (string == NULL)
+    {
+        return NULL;
+    }
+    tmp = strlen (string);
+    while ((string[tmp - 1] == character) && (tmp != 0))
+        tmp--;
+    string[tmp] = '\0';
+    return (string);
+}
+
+/*
+ * BEGIN: function string_trim
+ */
+char *
+string_trim (char *string, char character)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_trim\n");
+    }
+
+    return (string_right_trim
+            (string_left_trim (string, character), character));
+}
+
+/*
+ * BEGIN: function string_mask_newlines
+ */
+char *
+string_mask_newlines (char *string)
+{
+    int i = 0;
+    int z1, z2;
+    int length = strlen (string);
+    char *sptr = string;
+    char *s;
+
+    sptr = strchr (sptr, '\n');
+    while (sptr != NULL)
+    {
+        i++;
+        sptr = strchr (++sptr, '\n');
+    }
+
+    s = (char *) malloc (length + (i * 2) + 1);
+
+    if (!s)
+    {
+        fprintf (stderr, "ERROR: out of memory\n");
+        exit_loggrabber (1);
+    }
+
+    for (z1 = 0, z2 = 0; z1 < length; z1++)
+    {
+        if (string[z1] == '\n')
+        {
+            s[z2++] = '(';
+            s[z2++] = '+';
+            s[z2++] = ')';
+        }
+        else
+        {
+            s[z2++] = string[z1];
+        }
+    }
+
+    s[z2] = '\0';
+
+    return (s);
+}
+
+/*
+ * BEGIN: function string_escape
+ */
+char *
+string_escape (const char *string, char character)
+{
+    int i = strlen (string);
+    int z1, z2;
+    char *s = (char *) malloc (i * 2 + 1);
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_escape\n");
+    }
+
+    /*
+     * return if string is NULL
+     */
+    if (string == NULL)
+    {
+        return NULL;
+    }
+
+    if (!s)
+    {
+        fprintf (stderr, "ERROR: out of memory\n");
+        exit_loggrabber (1);
+    }
+
+    for (z1 = 0, z2 = 0; z1 < i; z1++)
+    {
+        if ((string[z1] == character) || (string[z1] == '\\'))
+        {
+            s[z2++] = '\\';
+        }
+        s[z2++] = string[z1];
+    }
+
+    s[z2] = '\0';
+
+    return (s);
+}
+
+/*
+ * BEGIN: function string_rmchar
+ */
+char *
+string_rmchar (char *string, char character)
+{
+    int i = strlen (string);
+    int z1, z2;
+    char *s = (char *) malloc (i + 1);
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_rmchar\n");
+    }
+
+    /*
+     * return if string is NULL
+     */
+    if (string == NULL)
+    {
+        return NULL;
+    }
+
+    if (!s)
+    {
+        fprintf (stderr, "ERROR: out of memory\n");
+        exit_loggrabber (1);
+    }
+
+    for (z1 = 0, z2 = 0; z1 < i; z1++)
+    {
+        if (string[z1] != character)
+        {
+            s[z2++] = string[z1];
+        }
+    }
+
+    s[z2] = '\0';
+
+    return (s);
+}
+
+/*
+ * BEGIN: function string_touppper
+ */
+char *
+string_toupper (const char *str1)
+{
+    char *tempstr1;
+    unsigned int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_toupper\n");
+    }
+
+    /*
+     * return if string is NULL
+     */
+    if (str1 == NULL)
+    {
+        return NULL;
+    }
+
+    tempstr1 = string_duplicate (str1);
+
+    for (i = 0; i < strlen (tempstr1); i++)
+    {
+        tempstr1[i] = toupper (tempstr1[i]);
+    }
+
+    return (tempstr1);
+}
+
+/*
+ * BEGIN: function string_icmp
+ */
+int
+string_icmp (const char *str1, const char *str2)
+{
+    char *tempstr1;
+    char *tempstr2;
+    int cmpresult;
+    unsigned int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_icmp\n");
+    }
+
+    tempstr1 = string_duplicate (str1);
+    tempstr2 = string_duplicate (str2);
+
+    for (i = 0; i < strlen (tempstr1); i++)
+    {
+        tempstr1[i] = tolower (tempstr1[i]);
+    }
+
+    for (i = 0; i < strlen (tempstr2); i++)
+    {
+        tempstr2[i] = tolower (tempstr2[i]);
+    }
+
+    cmpresult = strcmp (tempstr1, tempstr2);
+
+    free (tempstr1);
+    free (tempstr2);
+
+    return (cmpresult);
+}
+
+/*
+ * BEGIN: function string_incmp
+ */
+int
+string_incmp (const char *str1, const char *str2, size_t count)
+{
+    char *tempstr1;
+    char *tempstr2;
+    int cmpresult;
+    unsigned int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function string_incmp\n");
+    }
+
+    tempstr1 = string_duplicate (str1);
+    tempstr2 = string_duplicate (str2);
+
+    for (i = 0; i < strlen (tempstr1); i++)
+    {
+        tempstr1[i] = tolower (tempstr1[i]);
+    }
+
+    for (i = 0; i < strlen (tempstr2); i++)
+    {
+        tempstr2[i] = tolower (tempstr2[i]);
+    }
+
+    cmpresult = strncmp (tempstr1, tempstr2, count);
+
+    free (tempstr1);
+    free (tempstr2);
+
+    return (cmpresult);
+}
+
+/*
+ * BEGIN: function to read configuration file
+ */
+void
+read_config_file (char *filename, configvalues * cfgvalues)
+{
+    FILE *configfile;
+    char line[256];
+    char *position;
+    char *configparameter;
+    char *configvalue;
+    char *tmpstr;
+
+    if ((configfile = fopen (filename, "r")) == NULL)
+    {
+        fprintf (stderr, "ERROR: Cannot open configfile (%s)\n", filename);
+        exit_loggrabber (1);
+    }
+
+    while (fgets (line, sizeof line, configfile))
+    {
+        position = strchr (line, '\n');
+        if (position)
+        {
+            *position = 0;
+        }
+
+        position = strchr (line, '#');
+        if (position)
+        {
+            *position = 0;
+        }
+
+        configparameter = string_trim (strtok (line, "="), ' ');
+        if (configparameter)
+        {
+            configvalue = string_trim (strtok (NULL, ""), ' ');
+        }
+
+        if (configparameter && configvalue)
+        {
+            if (debug_mode == 1)
+            {
+                fprintf (stderr, "DEBUG: %s=%s\n", configparameter,
+                         configvalue);
+            }
+            if (strcmp (configparameter, "RECORD_SEPARATOR") == 0)
+            {
+                tmpstr = string_trim (configvalue, '"');
+                if (tmpstr)
+                {
+                    cfgvalues->record_separator = tmpstr[0];
+                }
+            }
+            else if (strcmp (configparameter, "DEBUG_LEVEL") == 0)
+            {
+                cfgvalues->debug_mode = atoi (string_trim (configvalue, '"'));
+            }
+
+            else if (strcmp (configparameter, "SPLUNK_REST_MAX_RETRIES") == 0)
+            {
+                cfgvalues->splunkRestMaxRetries = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "SPLUNK_REST_RETRY_FACTOR") == 0)
+            {
+                cfgvalues->splunkRestRetryFactor = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "SPLUNK_REST_STATUS_COMMIT") == 0)
+            {
+                cfgvalues->splunkRestStatusCommit = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "SPLUNK_REST_STATUS_COMMIT_INTERVAL") == 0)
+            {
+                cfgvalues->splunkRestStatusCommitInterval = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "SPLUNK_REST_STATUS_COMMIT_MAX_BACKOFF") == 0)
+            {
+                cfgvalues->splunkRestStatusCommitMaxBackoff = atoi (string_trim (configvalue, '"'));
+                if (cfgvalues->splunkRestStatusCommitMaxBackoff < 1)
+                {
+                    cfgvalues->splunkRestStatusCommitMaxBackoff = 1;
+                }
+            }
+            else if (strcmp (configparameter, "RECONNECT_BACKOFF_MIN_MS") == 0)
+            {
+                cfgvalues->reconnect_backoff_min_ms = atoi (string_trim (configvalue, '"'));
+                if (cfgvalues->reconnect_backoff_min_ms < 1)
+                {
+                    cfgvalues->reconnect_backoff_min_ms = 1;
+                }
+            }
+            else if (strcmp (configparameter, "RECONNECT_BACKOFF_MAX_MS") == 0)
+            {
+                cfgvalues->reconnect_backoff_max_ms = atoi (string_trim (configvalue, '"'));
+                if (cfgvalues->reconnect_backoff_max_ms < 1)
+                {
+                    cfgvalues->reconnect_backoff_max_ms = 1;
+                }
+            }
+            else if (strcmp (configparameter, "BACKFILL_PARTITIONS") == 0)
+            {
+                cfgvalues->backfill_partitions = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "BACKFILL_OUTPUT") == 0)
+            {
+                configvalue = string_trim (configvalue, '"');
+                if (strcmp (configvalue, "split") == 0)
+                {
+                    cfgvalues->backfill_split = TRUE;
+                }
+                else if (strcmp (configvalue, "merged") == 0)
+                {
+                    cfgvalues->backfill_split = FALSE;
+                }
+                else
+                {
+                    fprintf (stderr, "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+            }
+            else if (strcmp (configparameter, "CHECKPOINT_DIR") == 0)
+            {
+                cfgvalues->checkpoint_dir = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "CHECKPOINT_FSYNC_BATCH") == 0)
+            {
+                cfgvalues->checkpoint_fsync_batch = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "ONLINE_MODE") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "no") == 0)
+                {
+                    cfgvalues->online_mode = 0;
+                }
+                else if (string_icmp (configvalue, "yes") == 0)
+                {
+                    cfgvalues->online_mode = 1;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "STALL_TIMEOUT") == 0)
+            {
+                cfgvalues->stall_timeout = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "SSL_SESSION_DIR") == 0)
+            {
+                cfgvalues->ssl_session_dir = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "CATCHUP_MODE") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "no") == 0)
+                {
+                    cfgvalues->catchup_mode = 0;
+                }
+                else if (string_icmp (configvalue, "yes") == 0)
+                {
+                    cfgvalues->catchup_mode = 1;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "RESOLVE_MODE") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "no") == 0)
+                {
+                    cfgvalues->resolve_mode = 0;
+                }
+                else if (string_icmp (configvalue, "yes") == 0)
+                {
+                    cfgvalues->resolve_mode = 1;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "FW1_TYPE") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "ng") == 0)
+                {
+                    cfgvalues->fw1_2000 = 0;
+                }
+                else if (string_icmp (configvalue, "2000") == 0)
+                {
+                    cfgvalues->fw1_2000 = 1;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "FW1_MODE") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "normal") == 0)
+                {
+                    cfgvalues->audit_mode = 0;
+                }
+                else if (string_icmp (configvalue, "audit") == 0)
+                {
+                    cfgvalues->audit_mode = 1;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "DATEFORMAT") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "cp") == 0)
+                {
+                    cfgvalues->dateformat = DATETIME_CP;
+                }
+                else if (string_icmp (configvalue, "unix") == 0)
+                {
+                    cfgvalues->dateformat = DATETIME_UNIX;
+                }
+                else if (string_icmp (configvalue, "std") == 0)
+                {
+                    cfgvalues->dateformat = DATETIME_STD;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "LOGGING_CONFIGURATION") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "screen") == 0)
+                {
+                    cfgvalues->log_mode = SCREEN;
+                }
+                else if (string_icmp (configvalue, "file") == 0)
+                {
+                    cfgvalues->log_mode = LOGFILE;
+                }
+                else if (string_icmp (configvalue, "archive") == 0)
+                {
+                    cfgvalues->log_mode = ARCHIVE;
+                }
+                else if (string_icmp (configvalue, "columnar") == 0)
+                {
+                    cfgvalues->log_mode = COLUMNAR;
+                }
+                else if (string_icmp (configvalue, "binary") == 0)
+                {
+                    cfgvalues->log_mode = BINARY;
+                }
+                else if (string_icmp (configvalue, "hec") == 0)
+                {
+                    cfgvalues->log_mode = HEC;
+                }
+                else if (string_icmp (configvalue, "stream") == 0)
+                {
+                    cfgvalues->log_mode = STREAM;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "OUTPUT_FILE_PREFIX") == 0)
+            {
+                cfgvalues->output_file_prefix =
+                    string_duplicate (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "OUTPUT_FILE_ROTATESIZE") == 0)
+            {
+                cfgvalues->output_file_rotatesize =
+                    atol (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "OUTPUT_COMPRESSION") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "none") == 0)
+                {
+                    cfgvalues->output_compression = COMPRESS_NONE;
+                }
+                else if (string_icmp (configvalue, "gzip") == 0)
+                {
+                    cfgvalues->output_compression = COMPRESS_GZIP;
+                }
+                else if (string_icmp (configvalue, "zstd") == 0)
+                {
+                    cfgvalues->output_compression = COMPRESS_ZSTD;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "OUTPUT_COMPRESSION_LEVEL") == 0)
+            {
+                cfgvalues->output_compression_level =
+                    atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "OUTPUT_COMPRESSION_BLOCK") == 0)
+            {
+                cfgvalues->output_compression_block =
+                    atol (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "OUTPUT_ROW_GROUP") == 0)
+            {
+                cfgvalues->output_row_group = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "OUTPUT_FORMAT") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "kv") == 0)
+                {
+                    cfgvalues->output_format = FORMAT_KV;
+                }
+                else if (string_icmp (configvalue, "csv") == 0)
+                {
+                    cfgvalues->output_format = FORMAT_CSV;
+                }
+                else if (string_icmp (configvalue, "tsv") == 0)
+                {
+                    cfgvalues->output_format = FORMAT_TSV;
+                }
+                else if (string_icmp (configvalue, "cef") == 0)
+                {
+                    cfgvalues->output_format = FORMAT_CEF;
+                }
+                else if (string_icmp (configvalue, "leef") == 0)
+                {
+                    cfgvalues->output_format = FORMAT_LEEF;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "HEC_URL") == 0)
+            {
+                cfgvalues->hec_url = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "HEC_TOKEN") == 0)
+            {
+                cfgvalues->hec_token = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "HEC_HOST") == 0)
+            {
+                cfgvalues->hec_host = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "HEC_SOURCE") == 0)
+            {
+                cfgvalues->hec_source = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "HEC_SOURCETYPE") == 0)
+            {
+                cfgvalues->hec_sourcetype = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "HEC_INDEX") == 0)
+            {
+                cfgvalues->hec_index = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "HEC_CHANNEL") == 0)
+            {
+                cfgvalues->hec_channel = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "HEC_BATCH_EVENTS") == 0)
+            {
+                cfgvalues->hec_batch_events = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "HEC_BATCH_BYTES") == 0)
+            {
+                cfgvalues->hec_batch_bytes = atol (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "HEC_BATCH_MS") == 0)
+            {
+                cfgvalues->hec_batch_ms = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "HEC_CONNECTIONS") == 0)
+            {
+                cfgvalues->hec_connections = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "HEC_ACK") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "yes") == 0)
+                {
+                    cfgvalues->hec_ack = TRUE;
+                }
+                else if (string_icmp (configvalue, "no") == 0)
+                {
+                    cfgvalues->hec_ack = FALSE;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "HEC_TIMEOUT") == 0)
+            {
+                cfgvalues->hec_timeout = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "HEC_ACK_TIMEOUT") == 0)
+            {
+                cfgvalues->hec_ack_timeout = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "STREAM_TARGET") == 0)
+            {
+                cfgvalues->stream_target = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "STREAM_FRAMING") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "newline") == 0)
+                {
+                    cfgvalues->stream_framing = STREAM_NEWLINE;
+                }
+                else if (string_icmp (configvalue, "length") == 0)
+                {
+                    cfgvalues->stream_framing = STREAM_LENGTH;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "STREAM_BATCH_BYTES") == 0)
+            {
+                cfgvalues->stream_batch_bytes = atol (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "STREAM_BATCH_MS") == 0)
+            {
+                cfgvalues->stream_batch_ms = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "STREAM_QUEUE_BYTES") == 0)
+            {
+                cfgvalues->stream_queue_bytes = atol (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "STREAM_OVERFLOW") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "block") == 0)
+                {
+                    cfgvalues->stream_overflow = STREAM_BLOCK;
+                }
+                else if (string_icmp (configvalue, "drop") == 0)
+                {
+                    cfgvalues->stream_overflow = STREAM_DROP;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "STREAM_TIMEOUT") == 0)
+            {
+                cfgvalues->stream_timeout = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "STREAM_TLS") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "yes") == 0)
+                {
+                    cfgvalues->stream_tls = TRUE;
+                }
+                else if (string_icmp (configvalue, "no") == 0)
+                {
+                    cfgvalues->stream_tls = FALSE;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "STREAM_TLS_CA") == 0)
+            {
+                cfgvalues->stream_tls_ca = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "STREAM_TLS_CERT") == 0)
+            {
+                cfgvalues->stream_tls_cert = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "STREAM_TLS_KEY") == 0)
+            {
+                cfgvalues->stream_tls_key = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "FW1_OUTPUT") == 0)
+            {
+                configvalue = string_duplicate (string_trim (configvalue, '"'));
+                if (string_icmp (configvalue, "files") == 0)
+                {
+                    cfgvalues->showfiles_mode = 1;
+                }
+                else if (string_icmp (configvalue, "logs") == 0)
+                {
+                    cfgvalues->showfiles_mode = 0;
+                }
+                else
+                {
+                    fprintf (stderr,
+                             "WARNING: Illegal entry in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                }
+                free (configvalue);
+            }
+            else if (strcmp (configparameter, "FW1_LOGFILE") == 0)
+            {
+                cfgvalues->fw1_logfile =
+                    string_duplicate (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "FIELDS") == 0)
+            {
+                if (cfgvalues->fields != NULL)
+                {
+                    fprintf (stderr,
+                             "ERROR: multiple FIELDS definitions in configuration file: %s=%s\n",
+                             configparameter, configvalue);
+                    exit_loggrabber (1);
+                }
+                cfgvalues->fields =
+                    string_duplicate (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "FW1_FILTER_RULE") == 0)
+            {
+                cfgvalues->fw1_filter_count++;
+                cfgvalues->fw1_filter_array =
+                    (char **) realloc (cfgvalues->fw1_filter_array,
+                                       cfgvalues->fw1_filter_count *
+                                       sizeof (char *));
+                if (cfgvalues->fw1_filter_array == NULL)
+                {
+                    fprintf (stderr, "ERROR: Out of memory\n");
+                    exit_loggrabber (1);
+                }
+                cfgvalues->fw1_filter_array[cfgvalues->fw1_filter_count - 1] =
+                    string_duplicate (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "AGGREGATE_WINDOW") == 0)
+            {
+                cfgvalues->aggregate_window = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "AGGREGATE_MAX_KEYS") == 0)
+            {
+                cfgvalues->aggregate_max_keys = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "DEDUP_WINDOW") == 0)
+            {
+                cfgvalues->dedup_window = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "DEDUP_FIELDS") == 0)
+            {
+                cfgvalues->dedup_fields = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "DEDUP_TABLE_SIZE") == 0)
+            {
+                cfgvalues->dedup_table_size = atoi (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "SAMPLE_RATES") == 0)
+            {
+                cfgvalues->sample_rates = string_trim (configvalue, '"');
+            }
+            else if (strcmp (configparameter, "POST_FILTER_RULE") == 0)
+            {
+                cfgvalues->post_filters.push_back (string_trim (configvalue, '"'));
+            }
+            else if (strcmp (configparameter, "AUDIT_FILTER_RULE") == 0)
+            {
+                cfgvalues->audit_filter_count++;
+                cfgvalues->audit_filter_array =
+                    (char **) realloc (cfgvalues->audit_filter_array,
+                                       cfgvalues->audit_filter_count *
+                                       sizeof (char *));
+                if (cfgvalues->audit_filter_array == NULL)
+                {
+                    fprintf (stderr, "ERROR: Out of memory\n");
+                    exit_loggrabber (1);
+                }
+                cfgvalues->audit_filter_array[cfgvalues->audit_filter_count -
+                                              1] =
+                                                  string_duplicate (string_trim (configvalue, '"'));
+            }
+            else
+            {
+                fprintf (stderr,
+                         "WARNING: Illegal entry in configuration file: %s=%s\n",
+                         configparameter, configvalue);
+            }
+        }
+    }
+
+    fclose (configfile);
+}
+
+/*
+ * BEGIN: function to initialize fields headers of logfile fields
+ */
+void
+initialize_lfield_headers (char **headers[NUMBER_LIDX_FIELDS])
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function initialize_lfield_headers\n");
+    }
+
+    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    {
+        headers[i] = (char**) malloc (sizeof (char *));
+        *headers[i] = NULL;
+    }
+
+    *headers[LIDX_NUM] = string_duplicate ("loc");
+    *headers[LIDX_TIME] = string_duplicate ("time");
+    *headers[LIDX_ACTION] = string_duplicate ("action");
+    *headers[LIDX_ORIG] = string_duplicate ("orig");
+    *headers[LIDX_ALERT] = string_duplicate ("alert");
+    *headers[LIDX_IF_DIR] = string_duplicate ("i/f_dir");
+    *headers[LIDX_IF_NAME] = string_duplicate ("i/f_name");
+    *headers[LIDX_HAS_ACCOUNTING] = string_duplicate ("has_accounting");
+    *headers[LIDX_UUID] = string_duplicate ("uuid");
+    *headers[LIDX_PRODUCT] = string_duplicate ("product");
+    *headers[LIDX_POLICY_ID_TAG] = string_duplicate ("__policy_id_tag");
+    *headers[LIDX_SRC] = string_duplicate ("src");
+    *headers[LIDX_S_PORT] = string_duplicate ("s_port");
+    *headers[LIDX_DST] = string_duplicate ("dst");
+    *headers[LIDX_SERVICE] = string_duplicate ("service");
+    *headers[LIDX_TCP_FLAGS] = string_duplicate ("tcp_flags");
+    *headers[LIDX_PROTO] = string_duplicate ("proto");
+    *headers[LIDX_RULE] = string_duplicate ("rule");
+    *headers[LIDX_XLATESRC] = string_duplicate ("xlatesrc");
+    *headers[LIDX_XLATEDST] = string_duplicate ("xlatedst");
+    *headers[LIDX_XLATESPORT] = string_duplicate ("xlatesport");
+    *headers[LIDX_XLATEDPORT] = string_duplicate ("xlatedport");
+    *headers[LIDX_NAT_RULENUM] = string_duplicate ("NAT_rulenum");
+    *headers[LIDX_NAT_ADDRULENUM] = string_duplicate ("NAT_addtnl_rulenum");
+    *headers[LIDX_RESOURCE] = string_duplicate ("resource");
+    *headers[LIDX_ELAPSED] = string_duplicate ("elapsed");
+    *headers[LIDX_PACKETS] = string_duplicate ("packets");
+    *headers[LIDX_BYTES] = string_duplicate ("bytes");
+    *headers[LIDX_REASON] = string_duplicate ("reason");
+    *headers[LIDX_SERVICE_NAME] = string_duplicate ("service_name");
+    *headers[LIDX_AGENT] = string_duplicate ("agent");
+    *headers[LIDX_FROM] = string_duplicate ("from");
+    *headers[LIDX_TO] = string_duplicate ("to");
+    *headers[LIDX_SYS_MSGS] = string_duplicate ("sys_msgs");
+    *headers[LIDX_FW_MESSAGE] = string_duplicate ("fw_message");
+    *headers[LIDX_INTERNAL_CA] = string_duplicate ("Internal_CA:");
+    *headers[LIDX_SERIAL_NUM] = string_duplicate ("serial_num:");
+    *headers[LIDX_DN] = string_duplicate ("dn:");
+    *headers[LIDX_ICMP] = string_duplicate ("ICMP");
+    *headers[LIDX_ICMP_TYPE] = string_duplicate ("icmp-type");
+    *headers[LIDX_ICMP_TYPE2] = string_duplicate ("ICMP Type");
+    *headers[LIDX_ICMP_CODE] = string_duplicate ("icmp-code");
+    *headers[LIDX_ICMP_CODE2] = string_duplicate ("ICMP Code");
+    *headers[LIDX_MSGID] = string_duplicate ("msgid");
+    *headers[LIDX_MESSAGE_INFO] = string_duplicate ("message_info");
+    *headers[LIDX_LOG_SYS_MESSAGE] = string_duplicate ("log_sys_message");
+    *headers[LIDX_SESSION_ID] = string_duplicate ("session_id:");
+    *headers[LIDX_DNS_QUERY] = string_duplicate ("dns_query");
+    *headers[LIDX_DNS_TYPE] = string_duplicate ("dns_type");
+    *headers[LIDX_SCHEME] = string_duplicate ("scheme:");
+    *headers[LIDX_SRCKEYID] = string_duplicate ("srckeyid");
+    *headers[LIDX_DSTKEYID] = string_duplicate ("dstkeyid");
+    *headers[LIDX_METHODS] = string_duplicate ("methods:");
+    *headers[LIDX_PEER_GATEWAY] = string_duplicate ("peer gateway");
+    *headers[LIDX_IKE] = string_duplicate ("IKE:");
+    *headers[LIDX_IKE_IDS] = string_duplicate ("IKE IDs:");
+    *headers[LIDX_ENCRYPTION_FAILURE] =
+        string_duplicate ("encryption failure:");
+    *headers[LIDX_ENCRYPTION_FAIL_R] =
+        string_duplicate ("encryption fail reason:");
+    *headers[LIDX_COOKIEI] = string_duplicate ("CookieI");
+    *headers[LIDX_COOKIER] = string_duplicate ("CookieR");
+    *headers[LIDX_START_TIME] = string_duplicate ("start_time");
+    *headers[LIDX_SEGMENT_TIME] = string_duplicate ("segment_time");
+    *headers[LIDX_CLIENT_IN_PACKETS] =
+        string_duplicate ("client_inbound_packets");
+    *headers[LIDX_CLIENT_OUT_PACKETS] =
+        string_duplicate ("client_outbound_packets");
+    *headers[LIDX_CLIENT_IN_BYTES] = string_duplicate ("client_inbound_bytes");
+    *headers[LIDX_CLIENT_OUT_BYTES] =
+        string_duplicate ("client_outbound_bytes");
+    *headers[LIDX_CLIENT_IN_IF] = string_duplicate ("client_inbound_interface");
+    *headers[LIDX_CLIENT_OUT_IF] =
+        string_duplicate ("client_outbound_interface");
+    *headers[LIDX_SERVER_IN_PACKETS] =
+        string_duplicate ("server_inbound_packets");
+    *headers[LIDX_SERVER_OUT_PACKETS] =
+        string_duplicate ("server_outbound_packets");
+    *headers[LIDX_SERVER_IN_BYTES] = string_duplicate ("server_inbound_bytes");
+    *headers[LIDX_SERVER_OUT_BYTES] =
+        string_duplicate ("server_outbound_bytes");
+    *headers[LIDX_SERVER_IN_IF] = string_duplicate ("server_inbound_interface");
+    *headers[LIDX_SERVER_OUT_IF] =
+        string_duplicate ("server_outbound_interface");
+    *headers[LIDX_MESSAGE] = string_duplicate ("message");
+    *headers[LIDX_USER] = string_duplicate ("user");
+    *headers[LIDX_SRCNAME] = string_duplicate ("srcname");
+    *headers[LIDX_OM] = string_duplicate ("OM:");
+    *headers[LIDX_OM_METHOD] = string_duplicate ("om_method:");
+    *headers[LIDX_ASSIGNED_IP] = string_duplicate ("assigned_IP:");
+    *headers[LIDX_VPN_USER] = string_duplicate ("vpn_user");
+    *headers[LIDX_MAC] = string_duplicate ("MAC:");
+    *headers[LIDX_ATTACK] = string_duplicate ("attack");
+    *headers[LIDX_ATTACK_INFO] = string_duplicate ("Attack Info");
+    *headers[LIDX_CLUSTER_INFO] = string_duplicate ("Cluster_Info");
+    *headers[LIDX_DCE_RPC_UUID] = string_duplicate ("DCE-RPC Interface UUID");
+    *headers[LIDX_DCE_RPC_UUID_1] =
+        string_duplicate ("DCE-RPC Interface UUID-1");
+    *headers[LIDX_DCE_RPC_UUID_2] =
+        string_duplicate ("DCE-RPC Interface UUID-2");
+    *headers[LIDX_DCE_RPC_UUID_3] =
+        string_duplicate ("DCE-RPC Interface UUID-3");
+    *headers[LIDX_DURING_SEC] = string_duplicate ("during_sec");
+    *headers[LIDX_FRAGMENTS_DROPPED] = string_duplicate ("fragments_dropped");
+    *headers[LIDX_IP_ID] = string_duplicate ("ip_id");
+    *headers[LIDX_IP_LEN] = string_duplicate ("ip_len");
+    *headers[LIDX_IP_OFFSET] = string_duplicate ("ip_offset");
+    *headers[LIDX_TCP_FLAGS2] = string_duplicate ("TCP flags");
+    *headers[LIDX_SYNC_INFO] = string_duplicate ("sync_info:");
+    *headers[LIDX_LOG] = string_duplicate ("log");
+    *headers[LIDX_CPMAD] = string_duplicate ("cpmad");
+    *headers[LIDX_AUTH_METHOD] = string_duplicate ("auth_method");
+    *headers[LIDX_TCP_PACKET_OOS] =
+        string_duplicate ("TCP packet out of state");
+    *headers[LIDX_RPC_PROG] = string_duplicate ("rpc_prog");
+    *headers[LIDX_TH_FLAGS] = string_duplicate ("th_flags");
+    *headers[LIDX_CP_MESSAGE] = string_duplicate ("cp_message:");
+    *headers[LIDX_REJECT_CATEGORY] = string_duplicate ("reject_category");
+    *headers[LIDX_IKE_LOG] = string_duplicate ("IKE Log:");
+    *headers[LIDX_NEGOTIATION_ID] = string_duplicate ("Negotiation Id:");
+    *headers[LIDX_DECRYPTION_FAILURE] =
+        string_duplicate ("decryption failure:");
+    *headers[LIDX_LEN] = string_duplicate ("len");
+}
+
+/*
+ * BEGIN: function to free pointers in logfile arrays
+ */
+void
+free_lfield_arrays (char **headers[NUMBER_LIDX_FIELDS])
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function free_lfield_arrays\n");
+    }
+
+    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    {
+        if (headers[i] != NULL)
+        {
+            if (*headers[i] != NULL)
+            {
+                free (*headers[i]);
+                *headers[i] = NULL;
+            }
+        }
+        free (headers[i]);
+    }
+}
+
+/*
+ * BEGIN: function to initialize fields headers of audit fields
+ */
+void
+initialize_afield_headers (char **headers[NUMBER_AIDX_FIELDS])
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function initialize_afield_headers\n");
+    }
+
+    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    {
+        headers[i] = (char**) malloc (sizeof (char *));
+        *headers[i] = NULL;
+    }
+
+    *headers[AIDX_NUM] = string_duplicate ("loc");
+    *headers[AIDX_TIME] = string_duplicate ("time");
+    *headers[AIDX_ACTION] = string_duplicate ("action");
+    *headers[AIDX_ORIG] = string_duplicate ("orig");
+    *headers[AIDX_IF_DIR] = string_duplicate ("i/f_dir");
+    *headers[AIDX_IF_NAME] = string_duplicate ("i/f_name");
+    *headers[AIDX_HAS_ACCOUNTING] = string_duplicate ("has_accounting");
+    *headers[AIDX_UUID] = string_duplicate ("uuid");
+    *headers[AIDX_PRODUCT] = string_duplicate ("product");
+    *headers[AIDX_OBJECTNAME] = string_duplicate ("ObjectName");
+    *headers[AIDX_OBJECTTYPE] = string_duplicate ("ObjectType");
+    *headers[AIDX_OBJECTTABLE] = string_duplicate ("ObjectTable");
+    *headers[AIDX_OPERATION] = string_duplicate ("Operation");
+    *headers[AIDX_UID] = string_duplicate ("Uid");
+    *headers[AIDX_ADMINISTRATOR] = string_duplicate ("Administrator");
+    *headers[AIDX_MACHINE] = string_duplicate ("Machine");
+    *headers[AIDX_SUBJECT] = string_duplicate ("Subject");
+    *headers[AIDX_AUDIT_STATUS] = string_duplicate ("Audit Status");
+    *headers[AIDX_ADDITIONAL_INFO] = string_duplicate ("Additional Info");
+    *headers[AIDX_OPERATION_NUMBER] = string_duplicate ("Operation Number");
+    *headers[AIDX_FIELDSCHANGES] = string_duplicate ("FieldsChanges");
+}
+
+/*
+ * BEGIN: function to free pointers in audit arrays
+ */
+void
+free_afield_arrays (char **headers[NUMBER_AIDX_FIELDS])
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function free_afield_arrays\n");
+    }
+
+    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    {
+        if (headers[i] != NULL)
+        {
+            if (*headers[i] != NULL)
+            {
+                free (*headers[i]);
+                *headers[i] = NULL;
+            }
+        }
+        free (headers[i]);
+    }
+}
+
+/*
+ * BEGIN: function to initialize fields values of logfile fields
+ */
+void
+initialize_lfield_values (char **values[NUMBER_LIDX_FIELDS])
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function initialize_lfield_values\n");
+    }
+
+    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    {
+        values[i] = (char**) malloc (sizeof (char *));
+        *values[i] = NULL;
+    }
+}
+
+/*
+ * BEGIN: function to initialize fields values of audit fields
+ */
+void
+initialize_afield_values (char **values[NUMBER_AIDX_FIELDS])
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function initialize_afield_values\n");
+    }
+
+    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    {
+        values[i] = (char**) malloc (sizeof (char *));
+        *values[i] = NULL;
+    }
+}
+
+/*
+ * BEGIN: function to initialize order values of logfile fields
+ */
+void
+initialize_lfield_order (int *order)
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function initialize_lfield_order\n");
+    }
+
+    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    {
+        order[i] = -1;
+    }
+}
+
+/*
+ * BEGIN: function to initialize order values of logfile fields
+ */
+void
+initialize_afield_order (int *order)
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function initialize_afield_order\n");
+    }
+
+    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    {
+        order[i] = -1;
+    }
+}
+
+/*
+ * BEGIN: function to initialize output values of logfile fields
+ */
+void
+initialize_lfield_output (int *output)
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function initialize_lfield_output\n");
+    }
+
+    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    {
+        output[i] = 0;
+    }
+}
+
+/*
+ * BEGIN: function to initialize output values of audit fields
+ */
+void
+initialize_afield_output (int *output)
+{
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function initialize_afield_output\n");
+    }
+
+    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    {
+        output[i] = 0;
+    }
+}
+
+/*
+ * BEGIN: function to cleanup environment and exit fw1-loggrabber
+ */
+void
+exit_loggrabber (int errorcode, const std::string& entity)
+{
+    checkpoint_sync_stop ();
+    fw1_env_close ();
+    if (entity.length() > 0)
+    {
+        postEntityHealthStatus(entity, cfgvalues.status_server,
+                               cfgvalues.entity_health_endpoint,
+                               cfgvalues.status_server_auth_token,
+                               0);
+    }
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function exit_loggrabber\n");
+    }
+
+    free_lfield_arrays (lfield_headers);
+    free_afield_arrays (afield_headers);
+    free_lfield_arrays (lfields);
+    free_afield_arrays (afields);
+
+    if (LogfileName != NULL)
+    {
+        free (LogfileName);
+    }
+//      if (cfgvalues.fw1_logfile) {
+//              free(cfgvalues.fw1_logfile);
+//      }
+
+//  for (i = 0; i < filtercount; i++)
+//    {
+//      if (filterarray[i])
+//      {
+//        free (filterarray[i]);
+//      }
+//    }
+
+//  if (cfgvalues.config_filename != NULL) {
+//    free (cfgvalues.config_filename);
+//  }
+
+//  if (cfgvalues.leaconfig_filename != NULL) {
+//    free (cfgvalues.leaconfig_filename);
+//  }
+    exit (errorcode);
+}
+
+/*
+ * initilization function to define open, submit and close handler
+ */
+void
+logging_init_env (int logging)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function logging_init_env\n");
+    }
+
+    watermark.fileid = LEA_NORMAL_FILEID;
+    watermark.submitted_pos = -1;
+    watermark.flushed_pos = -1;
+    watermark.flushed_offset = -1;
+
+    // Specifies which logging operation shall be executed.
+    switch (logging)
+    {
+    case SCREEN:
+        open_log = &open_screen;
+        submit_log = &submit_screen;
+        flush_log = &flush_screen;
+        close_log = &close_screen;
+        break;
+    case LOGFILE:
+    case ARCHIVE:
+        open_log = &open_logfile;
+        submit_log = &submit_logfile;
+        flush_log = &flush_logfile;
+        close_log = &close_logfile;
+        break;
+    case COLUMNAR:
+        open_log = &open_columnar;
+        submit_log = &submit_columnar;
+        flush_log = &flush_columnar;
+        close_log = &close_columnar;
+        break;
+    case BINARY:
+        open_log = &open_binary;
+        submit_log = &submit_binary;
+        flush_log = &flush_binary;
+        close_log = &close_binary;
+        break;
+    case HEC:
+        open_log = &open_hec;
+        submit_log = &submit_hec;
+        flush_log = &flush_hec;
+        close_log = &close_hec;
+        break;
+    case STREAM:
+        open_log = &open_stream;
+        submit_log = &submit_stream;
+        flush_log = &flush_stream;
+        close_log = &close_stream;
+        break;
+    default:
+        open_log = &open_screen;
+        submit_log = &submit_screen;
+        flush_log = &flush_screen;
+        close_log = &close_screen;
+        break;
+    }
+    return;
+}
+
+/*
+ * screen initializations
+ */
+void
+open_screen ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function open_screen\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: Open connection to screen.\n");
+    }
+    //We don't need to do anything here
+    return;
+}
+
+void
+submit_screen (char *message)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function submit_screen\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: Submit message to screen.\n");
+    }
+    csv_header ();
+    fprintf (stdout, "%s\n", message);
+    fflush (NULL);
+    return;
+}
+
+int
+flush_screen ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function flush_screen\n");
+    }
+
+    if (fflush (stdout) != 0)
+    {
+        return FLUSH_FAILED;
+    }
+    watermark.flushed_pos = watermark.submitted_pos;
+    return watermark.flushed_pos;
+}
+
+void
+close_screen ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function close_screen\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: Close connection to screen.\n");
+    }
+    //We don't need to do anything here
+    return;
+}
 
-                /*
-                 * transform values (accept, drop, reject) into corresponding values
-                 */
-                if (strcmp (argumentsinglevalue, "ctl") == 0)
-                {
-                    tempint = 0;
-                }
-                else if (strcmp (argumentsinglevalue, "drop") == 0)
-                {
-                    tempint = 2;
-                }
-                else if (strcmp (argumentsinglevalue, "reject") == 0)
-                {
-                    tempint = 3;
-                }
-                else if (strcmp (argumentsinglevalue, "accept") == 0)
-                {
-                    tempint = 4;
-                }
-                else if (strcmp (argumentsinglevalue, "encrypt") == 0)
-                {
-                    tempint = 5;
-                }
-                else if (strcmp (argumentsinglevalue, "decrypt") == 0)
-                {
-                    tempint = 6;
-                }
-                else if (strcmp (argumentsinglevalue, "keyinst") == 0)
-                {
-                    tempint = 7;
-                }
-                else
-                {
-                    fprintf (stderr, "ERROR: invalid value for action: '%s'\n",
-                             argumentsinglevalue);
-                    return NULL;
-                }
+/*
+ * log file initializations
+ */
+void
+open_logfile ()
+{
 
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_ACTION,
-                         tempint) == OPSEC_SESSION_ERR)
-                {
-                    fprintf (stderr, "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
+    char *output_file_name;
+    long fsize;
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("action", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function open_logfile\n");
+    }
 
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: Initilize log file and open log file.\n");
+    }
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    //an archive is always compressed
+    if ((cfgvalues.log_mode == ARCHIVE) &&
+            (cfgvalues.output_compression == COMPRESS_NONE))
+    {
+        cfgvalues.output_compression = COMPRESS_GZIP;
+    }
 
-            lea_filter_predicate_destroy (ppred);
+    //create current output filename
+    output_file_name =
+        (char *) malloc (strlen (cfgvalues.output_file_prefix) +
+                         strlen (logfile_suffix ()) + 1);
+    if (output_file_name == NULL)
+    {
+        fprintf (stderr, "ERROR: Out of memory\n");
+        exit_loggrabber (1);
+    }
+    strcpy (output_file_name, cfgvalues.output_file_prefix);
+    strcat (output_file_name, logfile_suffix ());
+
+    if ((logstream = fopen (output_file_name, "a+")) == NULL)
+    {
+        fprintf (stderr, "ERROR: Fail to open the log file.\n");
+        exit_loggrabber (1);
+    }
+
+    watermark_open (output_file_name, logstream);
+
+    if (cfgvalues.output_compression != COMPRESS_NONE)
+    {
+        compress_start (output_file_name);
+    }
+    free (output_file_name);
+
+    //A csv header only goes at the top of the file
+    if (compressor.running)
+    {
+        fsize = compressor.offset;
+    }
+    else
+    {
+        fseek (logstream, 0, SEEK_END);
+        fsize = ftell (logstream);
+    }
+    csv.header_pending = ((cfgvalues.output_format == FORMAT_CSV) ||
+                          (cfgvalues.output_format == FORMAT_TSV)) && (fsize == 0);
+
+    return;
+}
+
+void
+submit_logfile (char *message)
+{
+
+    long fsize;
+    // char sn[100];
+    char* sn = NULL;
+    char *output_file_name;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function submit_logfile\n");
+    }
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: Submit message to log file.\n");
+    }
+    csv_header ();
+
+    if (compressor.running)
+    {
+        //The file only grows when a whole block was handed on
+        if (!compress_submit (message))
+        {
+            return;
         }
+        pthread_mutex_lock (&compressor.lock);
+        fsize = compressor.offset;
+        pthread_mutex_unlock (&compressor.lock);
+    }
+    else
+    {
+        fprintf (logstream, "%s\n", message);
 
-        /*
-         * process arguments of type "orig"
-         */
-        else if (strcmp (argumentname, "orig") == 0)
+        //Check and see if it reaches the log file limitation
+        fseek (logstream, 0, SEEK_CUR);
+        fsize = ftell (logstream);
+    }
+    /* File size check and see whether or not it reaches maximum */
+    if (fsize > cfgvalues.output_file_rotatesize)
+    {
+        //A rotated file has to end with a complete block
+        if (compressor.running && !compress_drain ())
         {
-            /*
-             * if the value specifies a network, create the filter predicate directly
-             */
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                if (strlen (argumentsinglevalue) == 0)
-                {
-                    fprintf (stderr,
-                             "ERROR: syntax error in rule value of argument orig: '%s'.\n"
-                             "       Required syntax: 'orig=aaa.bbb.ccc.ddd'\n",
-                             argumentsinglevalue);
-                    return NULL;
-                }
-                argumentcount++;
-                if (val_arr)
-                {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-                else
-                {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
+            fprintf (stderr, "ERROR: Cannot write the log file (%s)\n",
+                     strerror (compressor.failed));
+            exit_loggrabber (1);
+        }
+        //The log file will be refreshed.
+        fclose (logstream);
+        //create current output filename
+        output_file_name =
+            (char *) malloc (strlen (cfgvalues.output_file_prefix) +
+                             strlen (logfile_suffix ()) + 1);
+        strcpy (output_file_name, cfgvalues.output_file_prefix);
+        strcat (output_file_name, logfile_suffix ());
+        //Copy log file
+        sn = string_duplicate (rotated_file_name (logfile_suffix ()).c_str());
+        if (!fileCopy (output_file_name, sn) || !sync_directory_of (sn))
+        {
+            fprintf (stderr, "ERROR: Cannot rotate the log file to %s (%s)\n",
+                     sn, strerror (errno));
+            exit_loggrabber (1);
+        }
+        //Clean log file
+        if ((logstream = fopen (output_file_name, "w")) == NULL)
+        {
+            ;
+            fprintf (stderr, "ERROR: Fail to open the log file.\n");
+            exit_loggrabber (1);
+        }     //end of inner if
+        if (compressor.running)
+        {
+            compress_rotate (output_file_name, sn);
+        }
+        //everything submitted so far lives in the rotated copy now
+        if (watermark.path.length() > 0)
+        {
+            watermark.flushed_offset = 0;
+            watermark.flushed_pos = watermark.submitted_pos;
+            watermark_write ();
+        }
+        csv.header_pending = (cfgvalues.output_format == FORMAT_CSV) ||
+                             (cfgvalues.output_format == FORMAT_TSV);
+        free (output_file_name);
+    }       //end of if
 
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_IP_ADDR,
-                         inet_addr (argumentsinglevalue)) == OPSEC_SESSION_ERR)
-                {
-                    fprintf (stderr,
-                             "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("orig", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+    free(sn);
+    return;
+}
 
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
+/*
+ * function rotated_file_name
+ *
+ * <prefix>-YYYY-MM-DD_HHMMSS<suffix>, with _<n> before the suffix if
+ * events come in too fast and that file exists already
+ */
+string
+rotated_file_name (const char *suffix)
+{
+    time_t time_date = time (NULL);
+    struct tm *current_date = localtime (&time_date);
+    stringstream sstream;
+    char stamp[32];
+    string name;
+    int i;
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    strftime (stamp, sizeof stamp, "-%Y-%m-%d_%H%M%S", current_date);
+    name = string (cfgvalues.output_file_prefix) + stamp + suffix;
+    for (i = 1; fileExist (name.c_str()); i++)
+    {
+        sstream.str ("");
+        sstream << cfgvalues.output_file_prefix << stamp << "_" << i << suffix;
+        name = sstream.str();
+    }
+    return name;
+}
 
-            lea_filter_predicate_destroy (ppred);
-        }
+int
+flush_logfile ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function flush_logfile\n");
+    }
 
-        /*
-         * process arguments of type "dst"
-         */
-        else if (strcmp (argumentname, "dst") == 0)
+    if (compressor.running && !compress_drain ())
+    {
+        fprintf (stderr, "ERROR: Cannot write the log file (%s)\n",
+                 strerror (compressor.failed));
+        return FLUSH_FAILED;
+    }
+    if (fflush (logstream) != 0)
+    {
+        return FLUSH_FAILED;
+    }
+    if ((compressor.index != NULL) && ((fflush (compressor.index) != 0) ||
+                                       ((watermark.path.length() > 0) &&
+                                        (fsync (fileno (compressor.index)) != 0))))
+    {
+        fprintf (stderr, "ERROR: Cannot sync the archive index (%s)\n",
+                 strerror (errno));
+        return FLUSH_FAILED;
+    }
+    if (watermark.path.length() > 0)
+    {
+        if (fsync (fileno (logstream)) != 0)
         {
-            /*
-             * check whether values are valid
-             */
-            if ((strchr (argumentvalue, ',')) && (strchr (argumentvalue, '/')))
-            {
-                fprintf (stderr,
-                         "ERROR: use either netmask OR multiple IP addresses");
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+            fprintf (stderr, "ERROR: Cannot sync the log file (%s)\n",
+                     strerror (errno));
+            return FLUSH_FAILED;
+        }
+        watermark.flushed_offset = ftell (logstream);
+        watermark.flushed_pos = watermark.submitted_pos;
+        if (!watermark_write ())
+        {
+            return FLUSH_FAILED;
+        }
+    }
+    else
+    {
+        watermark.flushed_pos = watermark.submitted_pos;
+    }
+    return watermark.flushed_pos;
+}
 
-            /*
-             * if the value specifies a network, create the filter predicate directly
-             */
-            if (strchr (argumentvalue, '/'))
-            {
-                tmpstring1 =
-                    string_trim (string_get_token (&argumentvalue, '/'), ' ');
-                tmpstring2 =
-                    string_trim (string_get_token (&argumentvalue, '/'), ' ');
-                if ((strlen (tmpstring1) == 0) || (strlen (tmpstring2) == 0))
-                {
-                    fprintf (stderr,
-                             "ERROR: syntax error in rule value of argument dst: '%s/%s'.\n"
-                             "       Required syntax: 'dst=aaa.bbb.ccc.ddd/eee.fff.ggg.hhh'\n",
-                             tmpstring1, tmpstring2);
-                    return NULL;
-                }
-                if ((ppred =
-                            lea_filter_predicate_create ("dst", -1, negation,
-                                    LEA_FILTER_PRED_BELONGS_TO_MASK,
-                                    inet_addr (tmpstring1),
-                                    inet_addr (tmpstring2))) ==
-                        NULL)
-                {
-                    fprintf (stderr, "ERROR: failed to create predicate\n");
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
-            else
-            {
-                argumentcount = 0;
-                /*
-                 * get argument values separated by ","
-                 */
-                while (argumentvalue)
-                {
-                    argumentsinglevalue =
-                        string_trim (string_get_token (&argumentvalue, ','), ' ');
-                    if (strlen (argumentsinglevalue) == 0)
-                    {
-                        fprintf (stderr,
-                                 "ERROR: syntax error in rule value of argument dst: '%s'.\n"
-                                 "       Required syntax: 'dst=aaa.bbb.ccc.ddd'\n",
-                                 argumentsinglevalue);
-                        return NULL;
-                    }
-                    argumentcount++;
-                    if (val_arr)
-                    {
-                        val_arr =
-                            (lea_value_ex_t **) realloc (val_arr,
-                                                         argumentcount *
-                                                         sizeof (lea_value_ex_t
-                                                                 *));
-                        if (val_arr == NULL)
-                        {
-                            fprintf (stderr, "ERROR: Out of memory\n");
-                            exit_loggrabber (1);
-                        }
-                    }
-                    else
-                    {
-                        val_arr =
-                            (lea_value_ex_t **) malloc (argumentcount *
-                                                        sizeof (lea_value_ex_t
-                                                                *));
-                        if (val_arr == NULL)
-                        {
-                            fprintf (stderr, "ERROR: Out of memory\n");
-                            exit_loggrabber (1);
-                        }
-                    }
+/*
+ * columnar output initializations
+ */
+void
+open_columnar ()
+{
+    char ***headers = cfgvalues.audit_mode ? afield_headers : lfield_headers;
+    int number_fields =
+        cfgvalues.audit_mode ? NUMBER_AIDX_FIELDS : NUMBER_LIDX_FIELDS;
+    int i;
 
-                    /*
-                     * create extended opsec value
-                     */
-                    val_arr[argumentcount - 1] = lea_value_ex_create ();
-                    if (lea_value_ex_set
-                            (val_arr[argumentcount - 1], LEA_VT_IP_ADDR,
-                             inet_addr (argumentsinglevalue)) == OPSEC_SESSION_ERR)
-                    {
-                        fprintf (stderr,
-                                 "ERROR: failed to set rule value (%s)\n",
-                                 opsec_errno_str (opsec_errno));
-                        lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                        lea_filter_rule_destroy (prule);
-                        return NULL;
-                    }
-                }
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function open_columnar\n");
+    }
+
+    columnar.path = string (cfgvalues.output_file_prefix) + ".col";
+    if ((columnar.stream = fopen (columnar.path.c_str(), "a+")) == NULL)
+    {
+        fprintf (stderr, "ERROR: Fail to open the columnar file.\n");
+        exit_loggrabber (1);
+    }
+    watermark_open (columnar.path.c_str(), columnar.stream);
+    fseek (columnar.stream, 0, SEEK_END);
+    if (ftell (columnar.stream) == 0)
+    {
+        fputs (COLUMNAR_MAGIC, columnar.stream);
+    }
+
+    columnar.names.clear();
+    for (i = 0; i < number_fields; i++)
+    {
+        columnar.names.push_back ((*headers[i] != NULL) ? *headers[i] : "");
+    }
+    columnar.loc_column = cfgvalues.audit_mode ? AIDX_NUM : LIDX_NUM;
+    columnar.time_column = cfgvalues.audit_mode ? AIDX_TIME : LIDX_TIME;
+    columnar.sample_column = columnar.names.size();
+    columnar.names.push_back ("sample_rate");
+    columnar.message_column = columnar.names.size();
+    columnar.names.push_back ("message");
+    columnar.chunks.clear();
+    columnar.chunks.resize (columnar.names.size());
+    for (i = 0; i < (int) columnar.chunks.size(); i++)
+    {
+        columnar.chunks[i].type = COL_NONE;
+        columnar.chunks[i].count = 0;
+    }
+    columnar.slots.clear();
+    columnar.rows = 0;
+    columnar.groups = 0;
+    columnar.records = 0;
+    columnar.bytes = 0;
+    if (cfgvalues.output_row_group < 1)
+    {
+        cfgvalues.output_row_group = 1;
+    }
+}
 
-                /*
-                 * create filter predicate
-                 */
-                if ((ppred =
-                            lea_filter_predicate_create ("dst", -1, negation,
-                                    LEA_FILTER_PRED_BELONGS_TO,
-                                    argumentcount,
-                                    val_arr)) == NULL)
-                {
-                    fprintf (stderr, "ERROR: failed to create predicate\n");
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
+/*
+ * function columnar_wanted
+ *
+ * FALSE if --fields leaves the column out
+ */
+static int
+columnar_wanted (const string& name)
+{
+    return (output_fields.size() == 0) ||
+           (output_fields.find (name) != output_fields.end());
+}
 
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-            }
+/*
+ * function columnar_column
+ *
+ * column of an attribute id, -1 if it is left out. The ids of a session are
+ * resolved once, attributes beyond the known field set get a column of
+ * their own.
+ */
+static int
+columnar_column (OpsecSession * pSession, int id)
+{
+    vector<int>& slots = columnar.slots[pSession];
+    unsigned int k;
+    char *name;
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
+    if (id < 0)
+    {
+        return -1;
+    }
+    if ((unsigned int) id >= slots.size())
+    {
+        slots.resize (id + 1, -2);
+    }
+    if (slots[id] == -2)
+    {
+        slots[id] = -1;
+        name = lea_attr_name (pSession, id);
+        if ((name == NULL) || !columnar_wanted (name))
+        {
+            return -1;
+        }
+        for (k = 0; k < columnar.names.size(); k++)
+        {
+            if (columnar.names[k] == name)
             {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
+                break;
             }
-
-            lea_filter_predicate_destroy (ppred);
         }
-
-        /*
-         * process arguments of type "proto"
-         */
-        else if (strcmp (argumentname, "proto") == 0)
+        if (k == columnar.names.size())
         {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                argumentcount++;
-                if (val_arr)
-                {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-                else
-                {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
+            columnar.names.push_back (name);
+            columnar.chunks.resize (columnar.names.size());
+            columnar.chunks[k].type = COL_NONE;
+            columnar.chunks[k].count = 0;
+        }
+        slots[id] = k;
+    }
+    return slots[id];
+}
 
-                /*
-                 * transform values (icmp, tcp, udp) into corresponding values
-                 */
-                if (strcmp (argumentsinglevalue, "icmp") == 0)
-                {
-                    tempint = 1;
-                }
-                else if (strcmp (argumentsinglevalue, "tcp") == 0)
-                {
-                    tempint = 6;
-                }
-                else if (strcmp (argumentsinglevalue, "udp") == 0)
-                {
-                    tempint = 17;
-                }
-                else
-                {
-                    fprintf (stderr, "ERROR: invalid value for action: '%s'\n",
-                             argumentsinglevalue);
-                    return NULL;
-                }
+/*
+ * function columnar_present
+ *
+ * marks row as having a value in the column, FALSE if it already has one
+ */
+static int
+columnar_present (column_chunk * chunk, unsigned int row)
+{
+    if (chunk->present.size() <= row / 8)
+    {
+        chunk->present.resize (row / 8 + 1, 0);
+    }
+    if (chunk->present[row / 8] & (1 << (row % 8)))
+    {
+        return FALSE;
+    }
+    chunk->present[row / 8] |= (1 << (row % 8));
+    return TRUE;
+}
 
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_IP_PROTO,
-                         tempint) == OPSEC_SESSION_ERR)
-                {
-                    fprintf (stderr, "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
+/*
+ * function columnar_format
+ */
+static string
+columnar_format (int type, long long value)
+{
+    char text[32];
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("proto", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+    if (type == COL_IP)
+    {
+        snprintf (text, sizeof text, "%d.%d.%d.%d", (int) ((value >> 24) & 0xff),
+                  (int) ((value >> 16) & 0xff), (int) ((value >> 8) & 0xff),
+                  (int) (value & 0xff));
+    }
+    else
+    {
+        snprintf (text, sizeof text, "%lld", value);
+    }
+    return text;
+}
 
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
+/*
+ * function columnar_add_word
+ */
+static void
+columnar_add_word (column_chunk * chunk, const string& value)
+{
+    map<string, unsigned int>::iterator it = chunk->dict.find (value);
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    if (it == chunk->dict.end())
+    {
+        it = chunk->dict.insert (make_pair (value, (unsigned int) chunk->words.size())).first;
+        chunk->words.push_back (value);
+    }
+    chunk->codes.push_back (it->second);
+    chunk->count++;
+}
 
-            lea_filter_predicate_destroy (ppred);
-        }
+/*
+ * function columnar_to_string
+ *
+ * turns the numbers collected so far into words
+ */
+static void
+columnar_to_string (column_chunk * chunk)
+{
+    unsigned int i;
 
-        /*
-         * process arguments of type "starttime"
-         */
-        else if (strcmp (argumentname, "starttime") == 0)
-        {
-            argumentsinglevalue = string_trim (argumentvalue, ' ');
-            if (strlen (argumentsinglevalue) != 14)
-            {
-                fprintf (stderr,
-                         "ERROR: syntax error in rule value of argument rule: '%s'.\n"
-                         "       Required syntax: 'starttime=YYYYMMDDhhmmss'\n",
-                         argumentsinglevalue);
-                return NULL;
-            }
+    chunk->count = 0;
+    for (i = 0; i < chunk->numbers.size(); i++)
+    {
+        columnar_add_word (chunk, columnar_format (chunk->type, chunk->numbers[i]));
+    }
+    chunk->numbers.clear();
+    chunk->type = COL_STRING;
+}
 
-            /*
-             * convert starttime parameter to proper form (unixtime)
-             */
-            strncpy (tempchararray, argumentsinglevalue, 4);
-            tempchararray[4] = '\0';
-            timestruct.tm_year =
-                strtol (tempchararray, (char **) NULL, 10) - 1900;
-            argumentsinglevalue += 4 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_mon = strtol (tempchararray, (char **) NULL, 10) - 1;
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_mday = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_hour = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_min = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_sec = strtol (tempchararray, (char **) NULL, 10);
+/*
+ * function columnar_put_string
+ */
+static void
+columnar_put_string (int col, unsigned int row, const string& value)
+{
+    column_chunk *chunk = &(columnar.chunks[col]);
 
-            /*
-             * convert starttime parameter to long int
-             */
-            if ((timestruct.tm_mon > 11) || (timestruct.tm_mday > 31)
-                    || (timestruct.tm_hour > 23) || (timestruct.tm_min > 59)
-                    || (timestruct.tm_sec > 59))
-            {
-                fprintf (stderr,
-                         "ERROR: illegal date format in argumentvalue\n");
-                return NULL;
-            }
-            templong = (unsigned long) mktime (&timestruct);
-            if (templong == -1)
-            {
-                fprintf (stderr,
-                         "ERROR: illegal date format in argumentvalue\n");
-                return NULL;
-            }
+    if (chunk->type == COL_NONE)
+    {
+        chunk->type = COL_STRING;
+    }
+    else if (chunk->type != COL_STRING)
+    {
+        columnar_to_string (chunk);
+    }
+    if (columnar_present (chunk, row))
+    {
+        columnar_add_word (chunk, value);
+    }
+}
 
-            /*
-             * create extended opsec value
-             */
-            lea_value = lea_value_ex_create ();
-            if (lea_value_ex_set (lea_value, LEA_VT_TIME, templong) ==
-                    OPSEC_SESSION_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to set starttime value (%s)\n",
-                         opsec_errno_str (opsec_errno));
-                lea_value_ex_destroy (lea_value);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+/*
+ * function columnar_put_number
+ */
+static void
+columnar_put_number (int col, unsigned int row, int type, long long value)
+{
+    column_chunk *chunk = &(columnar.chunks[col]);
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("time", -1, negation,
-                                LEA_FILTER_PRED_GREATER_EQUAL,
-                                lea_value)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+    if (chunk->type == COL_NONE)
+    {
+        chunk->type = type;
+    }
+    else if (chunk->type != type)
+    {
+        columnar_put_string (col, row, columnar_format (type, value));
+        return;
+    }
+    if (!columnar_present (chunk, row))
+    {
+        return;
+    }
+    if ((chunk->count == 0) || (value < chunk->min))
+    {
+        chunk->min = value;
+    }
+    if ((chunk->count == 0) || (value > chunk->max))
+    {
+        chunk->max = value;
+    }
+    chunk->numbers.push_back (value);
+    chunk->count++;
+}
 
-            lea_value_ex_destroy (lea_value);
+/*
+ * function columnar_put
+ *
+ * appends an unsigned little endian integer of size bytes
+ */
+static void
+columnar_put (string& out, unsigned long long value, int size)
+{
+    int i;
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    for (i = 0; i < size; i++)
+    {
+        out.push_back ((char) ((value >> (8 * i)) & 0xff));
+    }
+}
 
-            lea_filter_predicate_destroy (ppred);
-        }
+/*
+ * function columnar_record
+ *
+ * adds a record to the row group as typed values
+ */
+void
+columnar_record (OpsecSession * pSession, lea_record * pRec, int pos,
+                 unsigned long sample_rate)
+{
+    unsigned int row = columnar.rows;
+    lea_field *field;
+    int col;
+    int i;
 
-        /*
-         * process arguments of type "endtime"
-         */
-        else if (strcmp (argumentname, "endtime") == 0)
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function columnar_record\n");
+    }
+
+    if (columnar_wanted (columnar.names[columnar.loc_column]))
+    {
+        columnar_put_number (columnar.loc_column, row, COL_INT64, pos);
+    }
+    for (i = 0; i < pRec->n_fields; i++)
+    {
+        field = &(pRec->fields[i]);
+        if ((col = columnar_column (pSession, field->lea_attr_id)) < 0)
         {
-            argumentsinglevalue = string_trim (argumentvalue, ' ');
-            if (strlen (argumentsinglevalue) != 14)
-            {
-                fprintf (stderr,
-                         "ERROR: syntax error in rule value of argument rule: '%s'.\n"
-                         "       Required syntax: 'endtime=YYYYMMDDhhmmss'\n",
-                         argumentsinglevalue);
-                return NULL;
-            }
+            continue;
+        }
+        if (col == columnar.time_column)
+        {
+            columnar_put_number (col, row, COL_INT64, field->lea_value.ul_value);
+            continue;
+        }
+        switch (field->lea_val_type)
+        {
+        case LEA_VT_IP_ADDR:
+            columnar_put_number (col, row, COL_IP,
+                                 ntohl ((uint32_t) field->lea_value.ul_value));
+            break;
+        case LEA_VT_TCP_PORT:
+        case LEA_VT_UDP_PORT:
+            columnar_put_number (col, row, COL_PORT,
+                                 ntohs (field->lea_value.ush_value));
+            break;
+        default:
+            columnar_put_string (col, row, lea_resolve_field (pSession, *field));
+            break;
+        }
+    }
+    if ((sample_rate > 1) && columnar_wanted ("sample_rate"))
+    {
+        columnar_put_number (columnar.sample_column, row, COL_INT64, sample_rate);
+    }
 
-            /*
-             * convert starttime parameter to proper form (unixtime)
-             */
-            strncpy (tempchararray, argumentsinglevalue, 4);
-            tempchararray[4] = '\0';
-            timestruct.tm_year =
-                strtol (tempchararray, (char **) NULL, 10) - 1900;
-            argumentsinglevalue += 4 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_mon = strtol (tempchararray, (char **) NULL, 10) - 1;
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_mday = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_hour = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_min = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_sec = strtol (tempchararray, (char **) NULL, 10);
+    columnar.rows++;
+    columnar.records++;
+    if (columnar.rows >= (unsigned int) cfgvalues.output_row_group)
+    {
+        columnar_write_group ();
+    }
+}
 
-            /*
-             * convert starttime parameter to long int
-             */
-            if ((timestruct.tm_mon > 11) || (timestruct.tm_mday > 31)
-                    || (timestruct.tm_hour > 23) || (timestruct.tm_min > 59)
-                    || (timestruct.tm_sec > 59))
+/*
+ * function columnar_rotate
+ */
+static void
+columnar_rotate ()
+{
+    string rotated = rotated_file_name (".col");
+
+    //the rotated file has to be on disk before the watermark moves past it
+    if ((fflush (columnar.stream) != 0) || (fsync (fileno (columnar.stream)) != 0))
+    {
+        fprintf (stderr, "ERROR: Cannot sync the columnar file (%s)\n",
+                 strerror (errno));
+        exit_loggrabber (1);
+    }
+    fclose (columnar.stream);
+    if ((rename (columnar.path.c_str(), rotated.c_str()) != 0) ||
+            !sync_directory_of (rotated))
+    {
+        fprintf (stderr, "ERROR: Cannot rotate the columnar file (%s)\n",
+                 strerror (errno));
+        exit_loggrabber (1);
+    }
+    if ((columnar.stream = fopen (columnar.path.c_str(), "w")) == NULL)
+    {
+        fprintf (stderr, "ERROR: Fail to open the columnar file.\n");
+        exit_loggrabber (1);
+    }
+    fputs (COLUMNAR_MAGIC, columnar.stream);
+    //everything submitted so far lives in the rotated file now
+    if (watermark.path.length() > 0)
+    {
+        watermark.flushed_offset = 0;
+        watermark.flushed_pos = watermark.submitted_pos;
+        watermark_write ();
+    }
+}
+
+/*
+ * function columnar_write_group
+ *
+ * writes the row group, see columnar_state for the layout
+ */
+void
+columnar_write_group ()
+{
+    string group;
+    string column;
+    string header;
+    column_chunk *chunk;
+    unsigned int columns = 0;
+    unsigned int i;
+    unsigned int k;
+    unsigned int low;
+    unsigned int high;
+
+    if (columnar.rows == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < columnar.chunks.size(); i++)
+    {
+        chunk = &(columnar.chunks[i]);
+        if (chunk->count == 0)
+        {
+            continue;
+        }
+        column.clear();
+        columnar_put (column, columnar.names[i].length(), 2);
+        column += columnar.names[i];
+        columnar_put (column, chunk->type, 1);
+        columnar_put (column, columnar.rows - chunk->count, 4);
+        if (chunk->type == COL_STRING)
+        {
+            low = 0;
+            high = 0;
+            for (k = 1; k < chunk->words.size(); k++)
             {
-                fprintf (stderr,
-                         "ERROR: illegal date format in argumentvalue\n");
-                return NULL;
+                low = (chunk->words[k] < chunk->words[low]) ? k : low;
+                high = (chunk->words[k] > chunk->words[high]) ? k : high;
             }
-            templong = (unsigned long) mktime (&timestruct);
-            if (templong == -1)
+            columnar_put (column, chunk->words[low].length(), 4);
+            column += chunk->words[low];
+            columnar_put (column, chunk->words[high].length(), 4);
+            column += chunk->words[high];
+        }
+        else
+        {
+            columnar_put (column, chunk->min, 8);
+            columnar_put (column, chunk->max, 8);
+        }
+        chunk->present.resize ((columnar.rows + 7) / 8, 0);
+        column.append ((const char *) &(chunk->present[0]), chunk->present.size());
+        if (chunk->type == COL_STRING)
+        {
+            columnar_put (column, chunk->words.size(), 4);
+            for (k = 0; k < chunk->words.size(); k++)
             {
-                fprintf (stderr,
-                         "ERROR: illegal date format in argumentvalue\n");
-                return NULL;
+                columnar_put (column, chunk->words[k].length(), 4);
+                column += chunk->words[k];
             }
-
-            /*
-             * create extended opsec value
-             */
-            lea_value = lea_value_ex_create ();
-            if (lea_value_ex_set (lea_value, LEA_VT_TIME, templong) ==
-                    OPSEC_SESSION_ERR)
+            for (k = 0; k < chunk->codes.size(); k++)
             {
-                fprintf (stderr, "ERROR: failed to set endtime value (%s)\n",
-                         opsec_errno_str (opsec_errno));
-                lea_value_ex_destroy (lea_value);
-                lea_filter_rule_destroy (prule);
-                return NULL;
+                columnar_put (column, chunk->codes[k], 4);
             }
-
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("time", -1, negation,
-                                LEA_FILTER_PRED_SMALLER_EQUAL,
-                                lea_value)) == NULL)
+        }
+        else
+        {
+            for (k = 0; k < chunk->numbers.size(); k++)
             {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
+                columnar_put (column, chunk->numbers[k],
+                              (chunk->type == COL_IP) ? 4 :
+                              (chunk->type == COL_PORT) ? 2 : 8);
             }
+        }
+        columnar_put (group, column.length(), 4);
+        group += column;
+        columns++;
 
-            lea_value_ex_destroy (lea_value);
+        chunk->type = COL_NONE;
+        chunk->present.clear();
+        chunk->numbers.clear();
+        chunk->codes.clear();
+        chunk->dict.clear();
+        chunk->words.clear();
+        chunk->count = 0;
+    }
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    header = "RG";
+    columnar_put (header, 4 + 2 + group.length(), 4);
+    columnar_put (header, columnar.rows, 4);
+    columnar_put (header, columns, 2);
+    if ((fwrite (header.data(), 1, header.length(), columnar.stream) !=
+            header.length()) ||
+            (fwrite (group.data(), 1, group.length(), columnar.stream) !=
+             group.length()))
+    {
+        fprintf (stderr, "ERROR: Cannot write the columnar file (%s)\n",
+                 strerror (errno));
+        exit_loggrabber (1);
+    }
+    columnar.bytes += header.length() + group.length();
+    columnar.groups++;
+    columnar.rows = 0;
 
-            lea_filter_predicate_destroy (ppred);
-        }
+    if (ftell (columnar.stream) > cfgvalues.output_file_rotatesize)
+    {
+        columnar_rotate ();
+    }
+}
 
-        /*
-         * process arguments of type "rule"
-         */
-        else if (strcmp (argumentname, "rule") == 0)
+/*
+ * function submit_columnar
+ *
+ * a formatted message that did not come from a record is kept as a row
+ * of its own in the message column
+ */
+void
+submit_columnar (char *message)
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function submit_columnar\n");
+    }
+
+    columnar_put_string (columnar.message_column, columnar.rows, message);
+    columnar.rows++;
+    columnar.records++;
+    if (columnar.rows >= (unsigned int) cfgvalues.output_row_group)
+    {
+        columnar_write_group ();
+    }
+}
+
+int
+flush_columnar ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function flush_columnar\n");
+    }
+
+    columnar_write_group ();
+    if (fflush (columnar.stream) != 0)
+    {
+        return FLUSH_FAILED;
+    }
+    if (watermark.path.length() > 0)
+    {
+        if (fsync (fileno (columnar.stream)) != 0)
         {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                if (strlen (argumentsinglevalue) == 0)
-                {
-                    fprintf (stderr,
-                             "ERROR: syntax error in rule value of argument rule: '%s'.\n"
-                             "       Required syntax: 'rule=x'\n",
-                             argumentsinglevalue);
-                    return NULL;
-                }
+            fprintf (stderr, "ERROR: Cannot sync the columnar file (%s)\n",
+                     strerror (errno));
+            return FLUSH_FAILED;
+        }
+        watermark.flushed_offset = ftell (columnar.stream);
+        watermark.flushed_pos = watermark.submitted_pos;
+        if (!watermark_write ())
+        {
+            return FLUSH_FAILED;
+        }
+    }
+    else
+    {
+        watermark.flushed_pos = watermark.submitted_pos;
+    }
+    return watermark.flushed_pos;
+}
 
-                /*
-                 * get ranges separated by "-", if there is no "-" start and end value of the
-                 * range is the same.
-                 */
-                tmpstring1 =
-                    string_trim (string_get_token (&argumentsinglevalue, '-'),
-                                 ' ');
-                tmpstring2 =
-                    (argumentsinglevalue ==
-                     NULL) ? tmpstring1 :
-                    string_trim (string_get_token (&argumentsinglevalue, '-'),
-                                 ' ');
-                tmpint1 = (int) strtol (tmpstring1, (char **) NULL, 10);
-                tmpint2 = (int) strtol (tmpstring2, (char **) NULL, 10);
-
-                for (tempint = tmpint1; tempint <= tmpint2; tempint++)
-                {
-                    argumentcount++;
-                    if (val_arr)
-                    {
-                        val_arr =
-                            (lea_value_ex_t **) realloc (val_arr,
-                                                         argumentcount *
-                                                         sizeof (lea_value_ex_t
-                                                                 *));
-                        if (val_arr == NULL)
-                        {
-                            fprintf (stderr, "ERROR: Out of memory\n");
-                            exit_loggrabber (1);
-                        }
-                    }
-                    else
-                    {
-                        val_arr =
-                            (lea_value_ex_t **) malloc (argumentcount *
-                                                        sizeof (lea_value_ex_t
-                                                                *));
-                        if (val_arr == NULL)
-                        {
-                            fprintf (stderr, "ERROR: Out of memory\n");
-                            exit_loggrabber (1);
-                        }
-                    }
+void
+close_columnar ()
+{
+    stringstream sstream;
 
-                    /*
-                     * create extended opsec value
-                     */
-                    val_arr[argumentcount - 1] = lea_value_ex_create ();
-                    if (lea_value_ex_set
-                            (val_arr[argumentcount - 1], LEA_VT_RULE,
-                             tempint) == OPSEC_SESSION_ERR)
-                    {
-                        fprintf (stderr,
-                                 "ERROR: failed to set rule value (%s)\n",
-                                 opsec_errno_str (opsec_errno));
-                        lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                        lea_filter_rule_destroy (prule);
-                        return NULL;
-                    }
-                }
-            }
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function close_columnar\n");
+    }
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("rule", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+    flush_columnar ();
+    fclose (columnar.stream);
 
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
+    sstream << "columnar_records=" << columnar.records
+            << "|columnar_groups=" << columnar.groups
+            << "|columnar_bytes=" << columnar.bytes;
+    metrics_emit (sstream.str());
+}
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+/*
+ * binary output initializations
+ */
+void
+open_binary ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function open_binary\n");
+    }
 
-            lea_filter_predicate_destroy (ppred);
-        }
+    binary.sessions.clear();
+    binary.next_session = 1;
+    binary.frames = 0;
+    binary.bytes = 0;
+    fwrite (LEABIN_MAGIC, 1, LEABIN_MAGIC_LEN, stdout);
+}
 
-        /*
-         * process arguments of type "service"
-         */
-        else if (strcmp (argumentname, "service") == 0)
-        {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                if (strlen (argumentsinglevalue) == 0)
-                {
-                    fprintf (stderr,
-                             "ERROR: syntax error in rule value of argument service: '%s'.\n"
-                             "       Required syntax: 'service=<Port-Number>'\n",
-                             argumentsinglevalue);
-                    return NULL;
-                }
+/*
+ * function binary_varint
+ *
+ * appends an unsigned LEB128 value
+ */
+static void
+binary_varint (string& out, unsigned long value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back ((char) ((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back ((char) value);
+}
 
-                /*
-                 * get ranges separated by "-", if there is no "-" start and end value of the
-                 * range is the same.
-                 */
-                tmpstring1 =
-                    string_trim (string_get_token (&argumentsinglevalue, '-'),
-                                 ' ');
-                tmpstring2 =
-                    (argumentsinglevalue ==
-                     NULL) ? tmpstring1 :
-                    string_trim (string_get_token (&argumentsinglevalue, '-'),
-                                 ' ');
-                tmpushort1 =
-                    (unsigned short) strtol (tmpstring1, (char **) NULL, 10);
-                tmpushort2 =
-                    (unsigned short) strtol (tmpstring2, (char **) NULL, 10);
-
-                for (tempushort = tmpushort1; tempushort <= tmpushort2;
-                        tempushort++)
-                {
-                    argumentcount++;
-                    if (val_arr)
-                    {
-                        val_arr =
-                            (lea_value_ex_t **) realloc (val_arr,
-                                                         argumentcount *
-                                                         sizeof (lea_value_ex_t
-                                                                 *));
-                        if (val_arr == NULL)
-                        {
-                            fprintf (stderr, "ERROR: Out of memory\n");
-                            exit_loggrabber (1);
-                        }
-                    }
-                    else
-                    {
-                        val_arr =
-                            (lea_value_ex_t **) malloc (argumentcount *
-                                                        sizeof (lea_value_ex_t
-                                                                *));
-                        if (val_arr == NULL)
-                        {
-                            fprintf (stderr, "ERROR: Out of memory\n");
-                            exit_loggrabber (1);
-                        }
-                    }
+/*
+ * function binary_bytes
+ */
+static void
+binary_bytes (string& out, const char *value, size_t len)
+{
+    binary_varint (out, len);
+    out.append (value, len);
+}
 
-                    /*
-                     * create extended opsec value
-                     */
-                    val_arr[argumentcount - 1] = lea_value_ex_create ();
-                    if (lea_value_ex_set
-                            (val_arr[argumentcount - 1], LEA_VT_USHORT,
-                             tempushort) == OPSEC_SESSION_ERR)
-                    {
-                        fprintf (stderr,
-                                 "ERROR: failed to set rule value (%s)\n",
-                                 opsec_errno_str (opsec_errno));
-                        lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                        lea_filter_rule_destroy (prule);
-                        return NULL;
-                    }
-                }
-            }
+/*
+ * function binary_write
+ *
+ * writes body as a frame of the given kind
+ */
+static void
+binary_write (int kind, const string& body)
+{
+    string header;
+
+    binary_varint (header, body.length() + 1);
+    header.push_back ((char) kind);
+    fwrite (header.data(), 1, header.length(), stdout);
+    fwrite (body.data(), 1, body.length(), stdout);
+    binary.frames++;
+    binary.bytes += header.length() + body.length();
+}
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("service", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+/*
+ * function binary_record
+ *
+ * writes a record frame, preceded by a dictionary frame for the attribute
+ * ids the session has not announced yet
+ */
+void
+binary_record (OpsecSession * pSession, lea_record * pRec, int pos,
+               unsigned long sample_rate)
+{
+    map<OpsecSession *, binary_session>::iterator it =
+        binary.sessions.find (pSession);
+    string& frame = binary.frame;
+    string& dict = binary.dict;
+    const char *time_name =
+        cfgvalues.audit_mode ? *afield_headers[AIDX_TIME] : *lfield_headers[LIDX_TIME];
+    unsigned long fields = 0;
+    unsigned long names = 0;
+    unsigned long ip;
+    lea_field *field;
+    char *name;
+    char *value;
+    int id;
+    int i;
 
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function binary_record\n");
+    }
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    if (it == binary.sessions.end())
+    {
+        it = binary.sessions.insert (make_pair (pSession, binary_session ())).first;
+        it->second.number = binary.next_session++;
+    }
+    vector<char>& announced = it->second.announced;
 
-            lea_filter_predicate_destroy (ppred);
+    frame.clear();
+    dict.clear();
+    for (i = 0; i < pRec->n_fields; i++)
+    {
+        field = &(pRec->fields[i]);
+        id = field->lea_attr_id;
+        if ((id < 0) || ((name = lea_attr_name (pSession, id)) == NULL))
+        {
+            continue;
+        }
+        if ((output_fields.size() > 0) &&
+                (output_fields.find (name) == output_fields.end()))
+        {
+            continue;
+        }
+        if ((unsigned int) id >= announced.size())
+        {
+            announced.resize (id + 1, FALSE);
+        }
+        if (!announced[id])
+        {
+            binary_varint (dict, id);
+            binary_bytes (dict, name, strlen (name));
+            announced[id] = TRUE;
+            names++;
         }
 
-        /*
-         * process arguments of type "src"
-         */
-        else if (strcmp (argumentname, "src") == 0)
+        binary_varint (frame, id);
+        if (strcmp (name, time_name) == 0)
         {
-            /*
-             * check whether values are valid
-             */
-            if ((strchr (argumentvalue, ',')) && (strchr (argumentvalue, '/')))
-            {
-                fprintf (stderr,
-                         "ERROR: use either netmask OR multiple IP addresses");
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+            frame.push_back ((char) LEABIN_TIME);
+            binary_varint (frame, field->lea_value.ul_value);
+        }
+        else if (field->lea_val_type == LEA_VT_IP_ADDR)
+        {
+            ip = ntohl ((uint32_t) field->lea_value.ul_value);
+            frame.push_back ((char) LEABIN_IP);
+            frame.push_back ((char) ((ip >> 24) & 0xff));
+            frame.push_back ((char) ((ip >> 16) & 0xff));
+            frame.push_back ((char) ((ip >> 8) & 0xff));
+            frame.push_back ((char) (ip & 0xff));
+        }
+        else if ((field->lea_val_type == LEA_VT_TCP_PORT) ||
+                 (field->lea_val_type == LEA_VT_UDP_PORT))
+        {
+            frame.push_back ((char) LEABIN_PORT);
+            binary_varint (frame, ntohs (field->lea_value.ush_value));
+        }
+        else
+        {
+            value = (field->lea_val_type == LEA_VT_STRING) ?
+                    field->lea_value.string_value : lea_resolve_field (pSession, *field);
+            frame.push_back ((char) LEABIN_STRING);
+            binary_bytes (frame, value, (value != NULL) ? strlen (value) : 0);
+        }
+        fields++;
+    }
 
-            /*
-             * if the value specifies a network, create the filter predicate directly
-             */
-            if (strchr (argumentvalue, '/'))
-            {
-                tmpstring1 =
-                    string_trim (string_get_token (&argumentvalue, '/'), ' ');
-                tmpstring2 =
-                    string_trim (string_get_token (&argumentvalue, '/'), ' ');
-                if ((strlen (tmpstring1) == 0) || (strlen (tmpstring2) == 0))
-                {
-                    fprintf (stderr,
-                             "ERROR: syntax error in rule value of argument src: '%s/%s'.\n"
-                             "       Required syntax: 'src=aaa.bbb.ccc.ddd/eee.fff.ggg.hhh'\n",
-                             tmpstring1, tmpstring2);
-                    return NULL;
-                }
-                if ((ppred =
-                            lea_filter_predicate_create ("src", -1, negation,
-                                    LEA_FILTER_PRED_BELONGS_TO_MASK,
-                                    inet_addr (tmpstring1),
-                                    inet_addr (tmpstring2))) ==
-                        NULL)
-                {
-                    fprintf (stderr, "ERROR: failed to create predicate\n");
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
-            else
-            {
-                argumentcount = 0;
-                /*
-                 * get argument values separated by ","
-                 */
-                while (argumentvalue)
-                {
-                    argumentsinglevalue =
-                        string_trim (string_get_token (&argumentvalue, ','), ' ');
-                    if (strlen (argumentsinglevalue) == 0)
-                    {
-                        fprintf (stderr,
-                                 "ERROR: syntax error in rule value of argument src: '%s'.\n"
-                                 "       Required syntax: 'src=aaa.bbb.ccc.ddd'\n",
-                                 argumentsinglevalue);
-                        return NULL;
-                    }
-                    argumentcount++;
-                    if (val_arr)
-                    {
-                        val_arr =
-                            (lea_value_ex_t **) realloc (val_arr,
-                                                         argumentcount *
-                                                         sizeof (lea_value_ex_t
-                                                                 *));
-                        if (val_arr == NULL)
-                        {
-                            fprintf (stderr, "ERROR: Out of memory\n");
-                            exit_loggrabber (1);
-                        }
-                    }
-                    else
-                    {
-                        val_arr =
-                            (lea_value_ex_t **) malloc (argumentcount *
-                                                        sizeof (lea_value_ex_t
-                                                                *));
-                        if (val_arr == NULL)
-                        {
-                            fprintf (stderr, "ERROR: Out of memory\n");
-                            exit_loggrabber (1);
-                        }
-                    }
+    if (names > 0)
+    {
+        string body;
+
+        binary_varint (body, it->second.number);
+        binary_varint (body, names);
+        binary_write (LEABIN_DICT, body + dict);
+    }
+    dict.clear();
+    binary_varint (dict, it->second.number);
+    binary_varint (dict, pos);
+    binary_varint (dict, sample_rate);
+    binary_varint (dict, fields);
+    binary_write (LEABIN_RECORD, dict + frame);
+}
+
+/*
+ * function submit_binary
+ *
+ * a formatted message that did not come from a record, e.g. a rollup
+ */
+void
+submit_binary (char *message)
+{
+    string body;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function submit_binary\n");
+    }
+
+    binary_bytes (body, message, strlen (message));
+    binary_write (LEABIN_MESSAGE, body);
+}
+
+int
+flush_binary ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function flush_binary\n");
+    }
+
+    if (fflush (stdout) != 0)
+    {
+        return FLUSH_FAILED;
+    }
+    watermark.flushed_pos = watermark.submitted_pos;
+    return watermark.flushed_pos;
+}
 
-                    /*
-                     * create extended opsec value
-                     */
-                    val_arr[argumentcount - 1] = lea_value_ex_create ();
-                    if (lea_value_ex_set
-                            (val_arr[argumentcount - 1], LEA_VT_IP_ADDR,
-                             inet_addr (argumentsinglevalue)) == OPSEC_SESSION_ERR)
-                    {
-                        fprintf (stderr,
-                                 "ERROR: failed to set rule value (%s)\n",
-                                 opsec_errno_str (opsec_errno));
-                        lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                        lea_filter_rule_destroy (prule);
-                        return NULL;
-                    }
-                }
+void
+close_binary ()
+{
+    stringstream sstream;
 
-                /*
-                 * create filter predicate
-                 */
-                if ((ppred =
-                            lea_filter_predicate_create ("src", -1, negation,
-                                    LEA_FILTER_PRED_BELONGS_TO,
-                                    argumentcount,
-                                    val_arr)) == NULL)
-                {
-                    fprintf (stderr, "ERROR: failed to create predicate\n");
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function close_binary\n");
+    }
 
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-            }
+    fflush (stdout);
+    sstream << "binary_frames=" << binary.frames
+            << "|binary_bytes=" << binary.bytes
+            << "|binary_sessions=" << (binary.next_session - 1);
+    metrics_emit (sstream.str());
+}
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
+/*
+ * HTTP Event Collector output initializations
+ */
+void
+open_hec ()
+{
+    string url = cfgvalues.hec_url;
+    unsigned char uuid[16];
+    char hostname[256];
+    char text[40];
+    size_t slash;
+    size_t colon;
+    FILE *random;
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function open_hec\n");
+    }
+
+    // http://host[:port][/path], https is left to a forwarder in front
+    if (url.compare (0, 7, "http://") != 0)
+    {
+        fprintf (stderr, "ERROR: HEC_URL must be an http:// URL.\n");
+        exit_loggrabber (1);
+    }
+    url = url.substr (7);
+    slash = url.find ('/');
+    hec.path = (slash != string::npos) ? url.substr (slash) : "";
+    while ((hec.path.length() > 0) && (hec.path[hec.path.length() - 1] == '/'))
+    {
+        hec.path.erase (hec.path.length() - 1);
+    }
+    url = url.substr (0, slash);
+    colon = url.find (':');
+    hec.host = url.substr (0, colon);
+    hec.port = (colon != string::npos) ? url.substr (colon + 1) : "8088";
+
+    if (cfgvalues.hec_host.length() == 0)
+    {
+        hostname[0] = '\0';
+        gethostname (hostname, sizeof hostname);
+        hostname[sizeof hostname - 1] = '\0';
+        cfgvalues.hec_host = hostname;
+    }
+    if (cfgvalues.hec_source.length() == 0)
+    {
+        cfgvalues.hec_source = cfgvalues.fw1_logfile;
+    }
+    if (cfgvalues.hec_ack && (cfgvalues.hec_channel.length() == 0))
+    {
+        // acks are kept per channel, a random version 4 UUID
+        if (((random = fopen ("/dev/urandom", "rb")) == NULL) ||
+                (fread (uuid, 1, sizeof uuid, random) != sizeof uuid))
+        {
+            for (i = 0; i < (int) sizeof uuid; i++)
             {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
+                uuid[i] = (unsigned char) (rand () ^ (current_time_ms () >> i));
             }
-
-            lea_filter_predicate_destroy (ppred);
         }
-
-        /*
-         * process unknown arguments
-         */
-        else
+        if (random != NULL)
         {
-            fprintf (stderr, "ERROR: Unknown filterargument: '%s'\n",
-                     argumentname);
-            return NULL;
+            fclose (random);
+        }
+        uuid[6] = (uuid[6] & 0x0f) | 0x40;
+        uuid[8] = (uuid[8] & 0x3f) | 0x80;
+        for (i = 0; i < (int) sizeof uuid; i++)
+        {
+            snprintf (text + 2 * i, 3, "%02x", uuid[i]);
         }
+        cfgvalues.hec_channel = string (text, 8) + "-" + string (text + 8, 4) + "-" +
+                                string (text + 12, 4) + "-" + string (text + 16, 4) +
+                                "-" + string (text + 20, 12);
     }
 
-    /*
-     * add current rule to rulebase
-     */
-    if (lea_filter_rulebase_add_rule (prulebase, prule) != OPSEC_SESSION_OK)
+    hec.meta = "\"host\":\"";
+    hec_json (hec.meta, cfgvalues.hec_host.c_str());
+    hec.meta += "\",\"source\":\"";
+    hec_json (hec.meta, cfgvalues.hec_source.c_str());
+    hec.meta += "\",\"sourcetype\":\"";
+    hec_json (hec.meta, cfgvalues.hec_sourcetype.c_str());
+    if (cfgvalues.hec_index.length() > 0)
     {
-        fprintf (stderr, "failed to add rule to rulebase\n");
-        lea_filter_rulebase_destroy (prulebase);
-        lea_filter_rule_destroy (prule);
-        return NULL;
+        hec.meta += "\",\"index\":\"";
+        hec_json (hec.meta, cfgvalues.hec_index.c_str());
     }
+    hec.meta += "\",\"event\":\"";
 
-    lea_filter_rule_destroy (prule);
+    if (cfgvalues.hec_connections < 1)
+    {
+        cfgvalues.hec_connections = 1;
+    }
+    if (cfgvalues.hec_batch_events < 1)
+    {
+        cfgvalues.hec_batch_events = 1;
+    }
+    // a header line has no place in a stream of events
+    csv.header_pending = FALSE;
+    signal (SIGPIPE, SIG_IGN);
 
-    return prulebase;
+    pthread_mutex_init (&hec.lock, NULL);
+    pthread_cond_init (&hec.wakeup, NULL);
+    pthread_cond_init (&hec.done, NULL);
+    hec.stop = FALSE;
+    hec.failed = 0;
+    hec.pending = NULL;
+    hec.outstanding = 0;
+    hec.polling = FALSE;
+    hec.last_poll = 0;
+    hec.threads.resize (cfgvalues.hec_connections);
+    for (i = 0; i < cfgvalues.hec_connections; i++)
+    {
+        if (pthread_create (&hec.threads[i], NULL, hec_thread, NULL) != 0)
+        {
+            fprintf (stderr, "ERROR: Cannot start HEC sender thread\n");
+            exit_loggrabber (1);
+        }
+    }
+    hec.running = TRUE;
+
+    if (cfgvalues.debug_mode)
+    {
+        fprintf (stderr, "DEBUG: Posting to %s:%s%s, channel %s\n",
+                 hec.host.c_str(), hec.port.c_str(), hec.path.c_str(),
+                 cfgvalues.hec_channel.c_str());
+    }
 }
 
 /*
- * function create_audit_filter_rule
+ * function utf8_length
+ *
+ * the length of the valid UTF-8 sequence at value, 0 if there is none.
+ * Overlong forms, surrogates and code points beyond U+10FFFF are invalid.
  */
-LeaFilterRulebase *
-create_audit_filter_rule (LeaFilterRulebase * prulebase,
-                          char filterstring[255])
+static int
+utf8_length (const unsigned char *value)
 {
-    LeaFilterRule *prule;
-    LeaFilterPredicate *ppred;
-    char *filterargument;
-    char *argumentvalue;
-    char *argumentname;
-    unsigned int tempint;
-    unsigned long templong;
-    lea_value_ex_t **val_arr;
-    lea_value_ex_t *lea_value;
-    char *argumentsinglevalue;
-    int argumentcount;
-    int negation;
-    struct tm timestruct;
-    char tempchararray[10];
+    unsigned char c = value[0];
+    unsigned char lo = 0x80;
+    unsigned char hi = 0xbf;
+    int len;
+    int i;
 
-    if (cfgvalues.debug_mode >= 2)
+    if (c < 0x80)
     {
-        fprintf (stderr, "DEBUG: function create_audit_filter_rule\n");
+        return 1;
     }
-
-    /*
-     * create an empty rule with action "pass"
-     */
-    if ((prule = lea_filter_rule_create (LEA_FILTER_ACTION_PASS)) == NULL)
+    if ((c >= 0xc2) && (c <= 0xdf))
     {
-        fprintf (stderr, "ERROR: failed to create rule\n");
-        lea_filter_rulebase_destroy (prulebase);
-        return NULL;
+        len = 2;
     }
-
-    /*
-     * split filter string in arguments separated by ";"
-     */
-    filterargument = strtok (filterstring, ";");
-    while (filterargument != NULL)
+    else if ((c >= 0xe0) && (c <= 0xef))
     {
-        /*
-         * split argument into name and value separated by "="
-         */
-        argumentvalue = strchr (filterargument, '=');
-        if (argumentvalue == NULL)
+        len = 3;
+        lo = (c == 0xe0) ? 0xa0 : 0x80;
+        hi = (c == 0xed) ? 0x9f : 0xbf;
+    }
+    else if ((c >= 0xf0) && (c <= 0xf4))
+    {
+        len = 4;
+        lo = (c == 0xf0) ? 0x90 : 0x80;
+        hi = (c == 0xf4) ? 0x8f : 0xbf;
+    }
+    else
+    {
+        return 0;
+    }
+    if ((value[1] < lo) || (value[1] > hi))
+    {
+        return 0;
+    }
+    for (i = 2; i < len; i++)
+    {
+        if ((value[i] < 0x80) || (value[i] > 0xbf))
         {
-            fprintf (stderr, "ERROR: syntax error in rule argument '%s'.\n"
-                     "       Required syntax: 'argument=value'\n",
-                     filterargument);
-            return NULL;
+            return 0;
         }
-        argumentvalue++;
-        argumentname = filterargument;
-        argumentname[argumentvalue - filterargument - 1] = '\0';
-        argumentvalue = string_trim (argumentvalue, ' ');
-        argumentname = string_trim (argumentname, ' ');
-        filterargument = strtok (NULL, ";");
-        val_arr = NULL;
+    }
+    return len;
+}
 
-        if (argumentname[strlen (argumentname) - 1] == '!')
+/*
+ * function hec_json
+ *
+ * appends a value as the contents of a JSON string. Bytes that are not
+ * valid UTF-8 become U+FFFD, the collector would reject the batch.
+ */
+void
+hec_json (string& out, const char *value)
+{
+    const unsigned char *c = (const unsigned char *) value;
+    char text[8];
+    int len;
+
+    while (*c)
+    {
+        if ((*c == '"') || (*c == '\\'))
         {
-            negation = 1;
-            argumentname = string_trim (argumentname, '!');
+            out.push_back ('\\');
+            out.push_back (*c++);
         }
-        else
+        else if (*c < 0x20)
         {
-            negation = 0;
+            snprintf (text, sizeof text, "\\u%04x", *c++);
+            out += text;
         }
-
-        /*
-         * change argument name to lower case letters
-         */
-        for (tempint = 0; tempint < strlen (argumentname); tempint++)
+        else if ((len = utf8_length (c)) == 0)
         {
-            argumentname[tempint] = tolower (argumentname[tempint]);
+            out += "\\ufffd";
+            c++;
         }
-
-        /*
-         * process arguments of type "product"
-         */
-        if (strcmp (argumentname, "product") == 0)
+        else
         {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                argumentcount++;
-                if (val_arr)
-                {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-                else
-                {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
+            out.append ((const char *) c, len);
+            c += len;
+        }
+    }
+}
 
-                /*
-                 * check validity of argument value
-                 */
-                if (!((strcmp (argumentsinglevalue, "SmartDashboard") == 0) ||
-                        (strcmp (argumentsinglevalue, "Policy Editor") == 0) ||
-                        (strcmp (argumentsinglevalue, "SmartView Tracker") == 0)
-                        || (strcmp (argumentsinglevalue, "SmartView Status") == 0)
-                        || (strcmp (argumentsinglevalue, "SmartView Monitor") ==
-                            0)
-                        || (strcmp (argumentsinglevalue, "System Monitor") == 0)
-                        || (strcmp (argumentsinglevalue, "cpstat_monitor") == 0)
-                        || (strcmp (argumentsinglevalue, "SmartUpdate") == 0)
-                        || (strcmp (argumentsinglevalue, "CPMI Client") == 0)))
-                {
-                    fprintf (stderr, "ERROR: invalid value for product: '%s'\n",
-                             argumentsinglevalue);
-                    return NULL;
-                }
+/*
+ * function hec_seal
+ *
+ * hands the batch collecting events to the senders, hec.lock is held
+ */
+static void
+hec_seal ()
+{
+    if (hec.pending == NULL)
+    {
+        return;
+    }
+    hec.queue.push_back (hec.pending);
+    hec.pending = NULL;
+    hec.outstanding++;
+    pthread_cond_signal (&hec.wakeup);
+}
 
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_STRING,
-                         argumentsinglevalue) == OPSEC_SESSION_ERR)
-                {
-                    fprintf (stderr, "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
+void
+submit_hec (char *message)
+{
+    unsigned long t = compressor.stamp_time;
+    char text[32];
+    int failed;
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("product", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function submit_hec\n");
+    }
 
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
+    compress_stamp (-1, 0);
+    pthread_mutex_lock (&hec.lock);
+    while (!hec.failed &&
+            (hec.outstanding >= HEC_QUEUE_BATCHES * cfgvalues.hec_connections))
+    {
+        pthread_cond_wait (&hec.done, &hec.lock);
+    }
+    if ((failed = hec.failed) != 0)
+    {
+        pthread_mutex_unlock (&hec.lock);
+        fprintf (stderr,
+                 "ERROR: The HTTP Event Collector rejected a batch (HTTP %d)\n",
+                 failed);
+        exit_loggrabber (1);
+    }
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    if (hec.pending == NULL)
+    {
+        hec.pending = new hec_batch;
+        hec.pending->gzipped = FALSE;
+        hec.pending->events = 0;
+        hec.pending->opened = current_time_ms ();
+        hec.pending->ack_id = 0;
+        hec.pending->posted = 0;
+    }
+    hec_batch *batch = hec.pending;
+    batch->body.push_back ('{');
+    if (t > 0)
+    {
+        snprintf (text, sizeof text, "\"time\":%lu,", t);
+        batch->body += text;
+    }
+    batch->body += hec.meta;
+    hec_json (batch->body, message);
+    batch->body += "\"}\n";
+    batch->events++;
+    hec.events++;
+    if ((batch->events >= cfgvalues.hec_batch_events) ||
+            ((long) batch->body.length() >= cfgvalues.hec_batch_bytes))
+    {
+        hec_seal ();
+    }
+    pthread_mutex_unlock (&hec.lock);
+}
 
-            lea_filter_predicate_destroy (ppred);
-        }
+/*
+ * function hec_connect
+ *
+ * -1 if the collector cannot be reached
+ */
+static int
+hec_connect ()
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    struct addrinfo *ai;
+    struct timeval tv;
+    int fd = -1;
 
-        /*
-         * process arguments of type "Administrator"
-         */
-        else if (strcmp (argumentname, "administrator") == 0)
+    memset (&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo (hec.host.c_str(), hec.port.c_str(), &hints, &res) != 0)
+    {
+        return -1;
+    }
+    tv.tv_sec = cfgvalues.hec_timeout;
+    tv.tv_usec = 0;
+    for (ai = res; ai != NULL; ai = ai->ai_next)
+    {
+        if ((fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
         {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                argumentcount++;
-                if (val_arr)
-                {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-                else
-                {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_STRING,
-                         argumentsinglevalue) == OPSEC_SESSION_ERR)
-                {
-                    fprintf (stderr, "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
-
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("Administrator", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
-
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
-
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
-
-            lea_filter_predicate_destroy (ppred);
+            continue;
         }
-
-        /*
-         * process arguments of type "orig"
-         */
-        else if (strcmp (argumentname, "orig") == 0)
+        setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, (char *) &tv, sizeof tv);
+        setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, (char *) &tv, sizeof tv);
+        if (connect (fd, ai->ai_addr, ai->ai_addrlen) == 0)
         {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
-            {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                if (strlen (argumentsinglevalue) == 0)
-                {
-                    fprintf (stderr,
-                             "ERROR: syntax error in rule value of argument orig: '%s'.\n"
-                             "       Required syntax: 'orig=aaa.bbb.ccc.ddd'\n",
-                             argumentsinglevalue);
-                    return NULL;
-                }
-                argumentcount++;
-                if (val_arr)
-                {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-                else
-                {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
+            break;
+        }
+        close (fd);
+        fd = -1;
+    }
+    freeaddrinfo (res);
+    return fd;
+}
+
+/*
+ * function hec_recv
+ *
+ * appends what the connection has to data, FALSE at its end
+ */
+static int
+hec_recv (int fd, string& data)
+{
+    char buffer[16384];
+    ssize_t len;
+
+    do
+    {
+        len = recv (fd, buffer, sizeof buffer, 0);
+    }
+    while ((len < 0) && (errno == EINTR));
+    if (len <= 0)
+    {
+        return FALSE;
+    }
+    data.append (buffer, len);
+    return TRUE;
+}
 
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_IP_ADDR,
-                         inet_addr (argumentsinglevalue)) == OPSEC_SESSION_ERR)
-                {
-                    fprintf (stderr,
-                             "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
-                }
-            }
+/*
+ * function hec_request
+ *
+ * posts body to target over the connection in *fd, opening it if need be.
+ * The HTTP status, -1 if the connection failed.
+ */
+static int
+hec_request (int *fd, const string& target, const string& body, int gzipped,
+             string *response)
+{
+    stringstream sstream;
+    string head;
+    string data;
+    string lower;
+    struct iovec iov[2];
+    size_t end;
+    size_t pos;
+    size_t size;
+    ssize_t len;
+    long length = -1;
+    int status = -1;
+    int chunked;
+    int i;
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("orig", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+    if ((*fd < 0) && ((*fd = hec_connect ()) < 0))
+    {
+        return -1;
+    }
 
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
+    sstream << "POST " << target << " HTTP/1.1\r\n"
+            << "Host: " << hec.host << ":" << hec.port << "\r\n"
+            << "Authorization: Splunk " << cfgvalues.hec_token << "\r\n";
+    if (cfgvalues.hec_channel.length() > 0)
+    {
+        sstream << "X-Splunk-Request-Channel: " << cfgvalues.hec_channel << "\r\n";
+    }
+    if (gzipped)
+    {
+        sstream << "Content-Encoding: gzip\r\n";
+    }
+    sstream << "Content-Type: application/json\r\n"
+            << "Content-Length: " << body.length() << "\r\n\r\n";
+    head = sstream.str();
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    // header and body in one go
+    iov[0].iov_base = (char *) head.data();
+    iov[0].iov_len = head.length();
+    iov[1].iov_base = (char *) body.data();
+    iov[1].iov_len = body.length();
+    i = 0;
+    while (i < 2)
+    {
+        len = writev (*fd, iov + i, 2 - i);
+        if ((len < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        if (len <= 0)
+        {
+            goto broken;
+        }
+        while ((i < 2) && ((size_t) len >= iov[i].iov_len))
+        {
+            len -= iov[i].iov_len;
+            i++;
+        }
+        if (i < 2)
+        {
+            iov[i].iov_base = (char *) iov[i].iov_base + len;
+            iov[i].iov_len -= len;
+        }
+    }
 
-            lea_filter_predicate_destroy (ppred);
+    while ((end = data.find ("\r\n\r\n")) == string::npos)
+    {
+        if (!hec_recv (*fd, data))
+        {
+            goto broken;
         }
+    }
+    if (sscanf (data.c_str(), "HTTP/%*s %d", &status) != 1)
+    {
+        goto broken;
+    }
+    lower = data.substr (0, end + 2);
+    for (pos = 0; pos < lower.length(); pos++)
+    {
+        lower[pos] = tolower (lower[pos]);
+    }
+    if ((pos = lower.find ("\r\ncontent-length:")) != string::npos)
+    {
+        length = atol (lower.c_str() + pos + 17);
+    }
+    chunked = (lower.find ("\r\ntransfer-encoding: chunked") != string::npos);
+    data.erase (0, end + 4);
 
-        /*
-         * process arguments of type "action"
-         */
-        else if (strcmp (argumentname, "action") == 0)
+    response->clear();
+    if (chunked)
+    {
+        while (TRUE)
         {
-            argumentcount = 0;
-            /*
-             * get argument values separated by ","
-             */
-            while (argumentvalue)
+            while ((end = data.find ("\r\n")) == string::npos)
             {
-                argumentsinglevalue =
-                    string_trim (string_get_token (&argumentvalue, ','), ' ');
-                argumentcount++;
-                if (val_arr)
-                {
-                    val_arr =
-                        (lea_value_ex_t **) realloc (val_arr,
-                                                     argumentcount *
-                                                     sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-                else
-                {
-                    val_arr =
-                        (lea_value_ex_t **) malloc (argumentcount *
-                                                    sizeof (lea_value_ex_t *));
-                    if (val_arr == NULL)
-                    {
-                        fprintf (stderr, "ERROR: Out of memory\n");
-                        exit_loggrabber (1);
-                    }
-                }
-
-                /*
-                 * transform values (accept, drop, reject) into corresponding values
-                 */
-                if (strcmp (argumentsinglevalue, "ctl") == 0)
-                {
-                    tempint = 0;
-                }
-                else if (strcmp (argumentsinglevalue, "drop") == 0)
-                {
-                    tempint = 2;
-                }
-                else if (strcmp (argumentsinglevalue, "reject") == 0)
-                {
-                    tempint = 3;
-                }
-                else if (strcmp (argumentsinglevalue, "accept") == 0)
-                {
-                    tempint = 4;
-                }
-                else if (strcmp (argumentsinglevalue, "encrypt") == 0)
-                {
-                    tempint = 5;
-                }
-                else if (strcmp (argumentsinglevalue, "decrypt") == 0)
-                {
-                    tempint = 6;
-                }
-                else if (strcmp (argumentsinglevalue, "keyinst") == 0)
-                {
-                    tempint = 7;
-                }
-                else
+                if (!hec_recv (*fd, data))
                 {
-                    fprintf (stderr, "ERROR: invalid value for action: '%s'\n",
-                             argumentsinglevalue);
-                    return NULL;
-                }
-
-                /*
-                 * create extended opsec value
-                 */
-                val_arr[argumentcount - 1] = lea_value_ex_create ();
-                if (lea_value_ex_set
-                        (val_arr[argumentcount - 1], LEA_VT_ACTION,
-                         tempint) == OPSEC_SESSION_ERR)
-                {
-                    fprintf (stderr, "ERROR: failed to set rule value (%s)\n",
-                             opsec_errno_str (opsec_errno));
-                    lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                    lea_filter_rule_destroy (prule);
-                    return NULL;
+                    goto broken;
                 }
             }
-
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("action", -1, negation,
-                                LEA_FILTER_PRED_BELONGS_TO,
-                                argumentcount, val_arr)) == NULL)
+            size = strtoul (data.c_str(), NULL, 16);
+            while (data.length() < end + 2 + size + 2)
             {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
+                if (!hec_recv (*fd, data))
+                {
+                    goto broken;
+                }
             }
-
-            lea_value_ex_destroy (val_arr[argumentcount - 1]);
-
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
+            response->append (data, end + 2, size);
+            data.erase (0, end + 2 + size + 2);
+            if (size == 0)
             {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
+                break;
             }
-
-            lea_filter_predicate_destroy (ppred);
         }
-
-        /*
-         * process arguments of type "starttime"
-         */
-        else if (strcmp (argumentname, "starttime") == 0)
+    }
+    else if (length >= 0)
+    {
+        while ((long) data.length() < length)
         {
-            argumentsinglevalue = string_trim (argumentvalue, ' ');
-            if (strlen (argumentsinglevalue) != 14)
+            if (!hec_recv (*fd, data))
             {
-                fprintf (stderr,
-                         "ERROR: syntax error in rule value of argument rule: '%s'.\n"
-                         "       Required syntax: 'starttime=YYYYMMDDhhmmss'\n",
-                         argumentsinglevalue);
-                return NULL;
+                goto broken;
             }
+        }
+        response->assign (data, 0, length);
+    }
+    else
+    {
+        // the body ends with the connection
+        while (hec_recv (*fd, data))
+        {
+        }
+        *response = data;
+        lower += "\r\nconnection: close";
+    }
+    if (lower.find ("\r\nconnection: close") != string::npos)
+    {
+        close (*fd);
+        *fd = -1;
+    }
+    return status;
 
-            /*
-             * convert starttime parameter to proper form (unixtime)
-             */
-            strncpy (tempchararray, argumentsinglevalue, 4);
-            tempchararray[4] = '\0';
-            timestruct.tm_year =
-                strtol (tempchararray, (char **) NULL, 10) - 1900;
-            argumentsinglevalue += 4 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_mon = strtol (tempchararray, (char **) NULL, 10) - 1;
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_mday = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_hour = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_min = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_sec = strtol (tempchararray, (char **) NULL, 10);
+broken:
+    close (*fd);
+    *fd = -1;
+    return -1;
+}
 
-            /*
-             * convert starttime parameter to long int
-             */
-            if ((timestruct.tm_mon > 11) || (timestruct.tm_mday > 31)
-                    || (timestruct.tm_hour > 23) || (timestruct.tm_min > 59)
-                    || (timestruct.tm_sec > 59))
-            {
-                fprintf (stderr,
-                         "ERROR: illegal date format in argumentvalue\n");
-                return NULL;
-            }
-            templong = (unsigned long) mktime (&timestruct);
-            if (templong == -1)
-            {
-                fprintf (stderr,
-                         "ERROR: illegal date format in argumentvalue\n");
-                return NULL;
-            }
+/*
+ * function hec_number
+ *
+ * the number after "name": in a JSON response, -1 if it has none
+ */
+static long
+hec_number (const string& response, const char *name)
+{
+    size_t pos = response.find (string ("\"") + name + "\"");
 
-            /*
-             * create extended opsec value
-             */
-            lea_value = lea_value_ex_create ();
-            if (lea_value_ex_set (lea_value, LEA_VT_TIME, templong) ==
-                    OPSEC_SESSION_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to set starttime value (%s)\n",
-                         opsec_errno_str (opsec_errno));
-                lea_value_ex_destroy (lea_value);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+    if (pos == string::npos)
+    {
+        return -1;
+    }
+    pos = response.find_first_not_of (" :", pos + strlen (name) + 2);
+    if ((pos == string::npos) || !isdigit ((unsigned char) response[pos]))
+    {
+        return -1;
+    }
+    return atol (response.c_str() + pos);
+}
 
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("time", -1, negation,
-                                LEA_FILTER_PRED_GREATER_EQUAL,
-                                lea_value)) == NULL)
-            {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
-            }
+/*
+ * function hec_data_error
+ *
+ * TRUE if a 400 response blames the events of the batch rather than the
+ * request, see the status codes of the HTTP Event Collector
+ */
+static int
+hec_data_error (const string& response)
+{
+    switch (hec_number (response, "code"))
+    {
+    case 5:			// no data
+    case 6:			// invalid data format
+    case 12:			// event field is required
+    case 13:			// event field cannot be blank
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
 
-            lea_value_ex_destroy (lea_value);
+/*
+ * function hec_gzip
+ */
+static void
+hec_gzip (hec_batch * batch)
+{
+    batch->raw_bytes = batch->body.length();
+#ifdef USE_ZLIB
+    z_stream strm;
+    string out;
 
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
-            {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
-            }
+    memset (&strm, 0, sizeof strm);
+    if (deflateInit2 (&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return;
+    }
+    out.resize (deflateBound (&strm, batch->body.length()));
+    strm.next_in = (Bytef *) batch->body.data();
+    strm.avail_in = batch->body.length();
+    strm.next_out = (Bytef *) & out[0];
+    strm.avail_out = out.length();
+    if (deflate (&strm, Z_FINISH) == Z_STREAM_END)
+    {
+        out.resize (strm.total_out);
+        batch->body.swap (out);
+        batch->gzipped = TRUE;
+    }
+    deflateEnd (&strm);
+#endif
+}
 
-            lea_filter_predicate_destroy (ppred);
+/*
+ * function hec_acked
+ *
+ * a batch is delivered, hec.lock is held
+ */
+static void
+hec_acked (hec_batch * batch)
+{
+    delete batch;
+    hec.outstanding--;
+    pthread_cond_broadcast (&hec.done);
+}
+
+/*
+ * function hec_poll_acks
+ *
+ * asks the collector which of the posted batches are indexed, hec.lock is
+ * held and released while asking. Batches not acknowledged in time are
+ * posted again.
+ */
+static void
+hec_poll_acks (int *fd)
+{
+    map<unsigned long, hec_batch *>::iterator it;
+    stringstream sstream;
+    string response;
+    string key;
+    size_t pos;
+    long now;
+    int status;
+
+    hec.polling = TRUE;
+    sstream << "{\"acks\":[";
+    for (it = hec.unacked.begin(); it != hec.unacked.end(); it++)
+    {
+        sstream << ((it == hec.unacked.begin()) ? "" : ",") << it->first;
+    }
+    sstream << "]}";
+    pthread_mutex_unlock (&hec.lock);
+    status = hec_request (fd, hec.path + "/services/collector/ack", sstream.str(),
+                          FALSE, &response);
+    pthread_mutex_lock (&hec.lock);
+
+    now = current_time_ms ();
+    it = hec.unacked.begin();
+    while (it != hec.unacked.end())
+    {
+        sstream.str ("");
+        sstream << "\"" << it->first << "\"";
+        key = sstream.str();
+        pos = (status == 200) ? response.find (key) : string::npos;
+        if (pos != string::npos)
+        {
+            pos = response.find_first_not_of (" :", pos + key.length());
+        }
+        if ((pos != string::npos) && (response.compare (pos, 4, "true") == 0))
+        {
+            hec_acked (it->second);
+            hec.unacked.erase (it++);
+        }
+        else if (now - it->second->posted >= cfgvalues.hec_ack_timeout * 1000L)
+        {
+            hec.queue.push_front (it->second);
+            hec.retries++;
+            hec.unacked.erase (it++);
+        }
+        else
+        {
+            it++;
         }
+    }
+    hec.polling = FALSE;
+    hec.last_poll = now;
+}
 
-        /*
-         * process arguments of type "endtime"
-         */
-        else if (strcmp (argumentname, "endtime") == 0)
+/*
+ * function hec_thread
+ *
+ * a sender: posts queued batches over a connection of its own, closes a
+ * batch that is due and polls the acks. A batch that cannot be posted is
+ * queued again and posted after the reconnect backoff. One the collector
+ * rejects as invalid data is dropped, any other rejection stops the output.
+ */
+void *
+hec_thread (void *arg)
+{
+    string target = hec.path + "/services/collector/event";
+    string response;
+    hec_batch *batch;
+    struct timespec ts;
+    struct timeval tv;
+    long ack_id;
+    long delay;
+    int attempt = 0;
+    int fd = -1;
+    int status;
+
+    pthread_mutex_lock (&hec.lock);
+    while (TRUE)
+    {
+        if ((hec.pending != NULL) &&
+                (current_time_ms () - hec.pending->opened >= cfgvalues.hec_batch_ms))
         {
-            argumentsinglevalue = string_trim (argumentvalue, ' ');
-            if (strlen (argumentsinglevalue) != 14)
+            hec_seal ();
+        }
+        if (!hec.queue.empty() && !hec.failed)
+        {
+            batch = hec.queue.front();
+            hec.queue.pop_front();
+            pthread_mutex_unlock (&hec.lock);
+            if (!batch->gzipped)
             {
-                fprintf (stderr,
-                         "ERROR: syntax error in rule value of argument rule: '%s'.\n"
-                         "       Required syntax: 'endtime=YYYYMMDDhhmmss'\n",
-                         argumentsinglevalue);
-                return NULL;
+                hec_gzip (batch);
             }
+            status = hec_request (&fd, target, batch->body, batch->gzipped, &response);
+            pthread_mutex_lock (&hec.lock);
+            hec.posts++;
 
-            /*
-             * convert starttime parameter to proper form (unixtime)
-             */
-            strncpy (tempchararray, argumentsinglevalue, 4);
-            tempchararray[4] = '\0';
-            timestruct.tm_year =
-                strtol (tempchararray, (char **) NULL, 10) - 1900;
-            argumentsinglevalue += 4 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_mon = strtol (tempchararray, (char **) NULL, 10) - 1;
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_mday = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_hour = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_min = strtol (tempchararray, (char **) NULL, 10);
-            argumentsinglevalue += 2 * sizeof (char);
-            strncpy (tempchararray, argumentsinglevalue, 2);
-            tempchararray[2] = '\0';
-            timestruct.tm_sec = strtol (tempchararray, (char **) NULL, 10);
-
-            /*
-             * convert starttime parameter to long int
-             */
-            if ((timestruct.tm_mon > 11) || (timestruct.tm_mday > 31)
-                    || (timestruct.tm_hour > 23) || (timestruct.tm_min > 59)
-                    || (timestruct.tm_sec > 59))
+            delay = 0;
+            if (status == 200)
             {
-                fprintf (stderr,
-                         "ERROR: illegal date format in argumentvalue\n");
-                return NULL;
+                attempt = 0;
+                hec.bytes_in += batch->raw_bytes;
+                hec.bytes_out += batch->body.length();
+                ack_id = hec_number (response, "ackId");
+                if (cfgvalues.hec_ack && (ack_id >= 0))
+                {
+                    batch->ack_id = ack_id;
+                    batch->posted = current_time_ms ();
+                    hec.unacked[batch->ack_id] = batch;
+                }
+                else
+                {
+                    hec_acked (batch);
+                }
             }
-            templong = (unsigned long) mktime (&timestruct);
-            if (templong == -1)
+            else if ((status < 0) || (status == 429) || (status >= 500))
             {
-                fprintf (stderr,
-                         "ERROR: illegal date format in argumentvalue\n");
-                return NULL;
+                // the collector is down or busy, try again
+                hec.queue.push_front (batch);
+                hec.retries++;
+                delay = reconnect_delay_ms (attempt++);
+                if (cfgvalues.debug_mode)
+                {
+                    fprintf (stderr, "DEBUG: HEC post failed (%d), retrying in %ld ms\n",
+                             status, delay);
+                }
             }
-
-            /*
-             * create extended opsec value
-             */
-            lea_value = lea_value_ex_create ();
-            if (lea_value_ex_set (lea_value, LEA_VT_TIME, templong) ==
-                    OPSEC_SESSION_ERR)
+            else if ((status == 400) && hec_data_error (response))
             {
-                fprintf (stderr, "ERROR: failed to set endtime value (%s)\n",
-                         opsec_errno_str (opsec_errno));
-                lea_value_ex_destroy (lea_value);
-                lea_filter_rule_destroy (prule);
-                return NULL;
+                attempt = 0;
+                fprintf (stderr,
+                         "WARNING: HEC dropped a batch of %ld events as invalid (HTTP %d): %s\n",
+                         batch->events, status, response.c_str());
+                hec.rejected++;
+                hec.rejected_events += batch->events;
+                hec_acked (batch);
             }
-
-            /*
-             * create filter predicate
-             */
-            if ((ppred =
-                        lea_filter_predicate_create ("time", -1, negation,
-                                LEA_FILTER_PRED_SMALLER_EQUAL,
-                                lea_value)) == NULL)
+            else
             {
-                fprintf (stderr, "ERROR: failed to create predicate\n");
-                lea_value_ex_destroy (val_arr[argumentcount - 1]);
-                lea_filter_rule_destroy (prule);
-                return NULL;
+                fprintf (stderr, "ERROR: HEC post rejected (HTTP %d): %s\n", status,
+                         response.c_str());
+                hec.failed = status;
+                hec_acked (batch);
             }
-
-            lea_value_ex_destroy (lea_value);
-
-            /*
-             * add current predicate to current rule
-             */
-            if (lea_filter_rule_add_predicate (prule, ppred) == LEA_FILTER_ERR)
+            if (delay > 0)
             {
-                fprintf (stderr, "ERROR: failed to add predicate to rule\n");
-                lea_filter_rule_destroy (prule);
-                lea_filter_predicate_destroy (ppred);
-                return NULL;
+                pthread_mutex_unlock (&hec.lock);
+                SLEEP_MS (delay);
+                pthread_mutex_lock (&hec.lock);
             }
-
-            lea_filter_predicate_destroy (ppred);
+            continue;
         }
-
-        /*
-         * process unknown arguments
-         */
-        else
+        if (!hec.unacked.empty() && !hec.polling &&
+                (current_time_ms () - hec.last_poll >= HEC_ACK_INTERVAL_MS))
         {
-            fprintf (stderr, "ERROR: Unknown filterargument: '%s'\n",
-                     argumentname);
-            return NULL;
+            hec_poll_acks (&fd);
+            continue;
+        }
+        if (hec.stop)
+        {
+            break;
         }
+        gettimeofday (&tv, NULL);
+        ts.tv_sec = tv.tv_sec;
+        ts.tv_nsec = (tv.tv_usec + 100000) * 1000L;
+        if (ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait (&hec.wakeup, &hec.lock, &ts);
     }
-
-    /*
-     * add current rule to rulebase
-     */
-    if (lea_filter_rulebase_add_rule (prulebase, prule) != OPSEC_SESSION_OK)
+    pthread_mutex_unlock (&hec.lock);
+    if (fd >= 0)
     {
-        fprintf (stderr, "failed to add rule to rulebase\n");
-        lea_filter_rulebase_destroy (prulebase);
-        lea_filter_rule_destroy (prule);
-        return NULL;
+        close (fd);
     }
-
-    lea_filter_rule_destroy (prule);
-
-    return prulebase;
+    return NULL;
 }
 
 /*
- * BEGIN: function string_get_token
+ * function hec_drain
+ *
+ * closes the collecting batch and waits until every batch is acknowledged,
+ * for at most limit_ms if it is above 0. FALSE if batches are left.
  */
-char *
-string_get_token (char **tokstring, char separator)
+static int
+hec_drain (long limit_ms)
 {
-    char *tempstring = NULL;
-    char *returnstring;
-    int strlength;
+    long started = current_time_ms ();
+    struct timespec ts;
+    struct timeval tv;
+    int drained;
+
+    pthread_mutex_lock (&hec.lock);
+    hec_seal ();
+    while ((hec.outstanding > 0) && !hec.failed &&
+            ((limit_ms <= 0) || (current_time_ms () - started < limit_ms)))
+    {
+        gettimeofday (&tv, NULL);
+        ts.tv_sec = tv.tv_sec + 1;
+        ts.tv_nsec = tv.tv_usec * 1000L;
+        pthread_cond_timedwait (&hec.done, &hec.lock, &ts);
+    }
+    drained = (hec.outstanding == 0) && !hec.failed;
+    pthread_mutex_unlock (&hec.lock);
+    return drained;
+}
 
+int
+flush_hec ()
+{
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function string_get_token\n");
+        fprintf (stderr, "DEBUG: function flush_hec\n");
     }
 
-    /*
-     * return if tokstring is NULL
-     */
-    if (*tokstring == NULL)
+    if (!hec_drain (0))
     {
-        return NULL;
+        return FLUSH_FAILED;
     }
+    watermark.flushed_pos = watermark.submitted_pos;
+    return watermark.flushed_pos;
+}
 
-    /*
-     * search for first separator
-     */
-    tempstring = strchr (*tokstring, separator);
+void
+close_hec ()
+{
+    stringstream sstream;
+    unsigned int i;
+    int left;
 
-    /*
-     * calculate string length
-     */
-    if (tempstring)
+    if (cfgvalues.debug_mode >= 2)
     {
-        tempstring = tempstring + 1;
-        strlength = strlen (*tokstring) - strlen (tempstring);
+        fprintf (stderr, "DEBUG: function close_hec\n");
     }
-    else
+
+    if (!hec.running)
     {
-        strlength = strlen (*tokstring) + 1;
+        return;
     }
-
-    returnstring = (char *) malloc (strlength + 1);
-    if (returnstring == NULL)
+    // what is not acknowledged by then is read again from the checkpoint
+    hec_drain (cfgvalues.hec_ack_timeout * 1000L);
+    pthread_mutex_lock (&hec.lock);
+    left = hec.outstanding;
+    if ((left > 0) && !hec.failed)
     {
-        fprintf (stderr, "ERROR: Out of memory\n");
-        exit_loggrabber (1);
+        fprintf (stderr, "WARNING: %d HEC batches are not acknowledged\n", left);
     }
-    strncpy (returnstring, *tokstring, strlength);
-    returnstring[strlength - 1] = '\0';
+    pthread_mutex_unlock (&hec.lock);
+    pthread_mutex_lock (&hec.lock);
+    hec.stop = TRUE;
+    pthread_cond_broadcast (&hec.wakeup);
+    pthread_mutex_unlock (&hec.lock);
+    for (i = 0; i < hec.threads.size(); i++)
+    {
+        pthread_join (hec.threads[i], NULL);
+    }
+    hec.running = FALSE;
 
-    *tokstring = tempstring;
-    return returnstring;
+    sstream << "hec_events=" << hec.events
+            << "|hec_posts=" << hec.posts
+            << "|hec_retries=" << hec.retries
+            << "|hec_rejected_batches=" << hec.rejected
+            << "|hec_rejected_events=" << hec.rejected_events
+            << "|hec_bytes_in=" << hec.bytes_in
+            << "|hec_bytes_out=" << hec.bytes_out
+            << "|hec_unacknowledged=" << left;
+    metrics_emit (sstream.str());
 }
 
 /*
- * BEGIN: function string_duplicate
+ * stream socket output initializations
  */
-char *
-string_duplicate (const char *src)
+void
+open_stream ()
 {
-    size_t length;
-    char *dst;
+    string target = cfgvalues.stream_target;
+    struct sockaddr_un addr;
+    size_t colon;
 
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function string_duplicate\n");
+        fprintf (stderr, "DEBUG: function open_stream\n");
     }
 
-    if (src == NULL)
+    // tcp://<host>:<port> or unix:<path>
+    if (target.compare (0, 6, "tcp://") == 0)
     {
-        return NULL;
+        target = target.substr (6);
+        colon = target.rfind (':');
+        if ((colon == string::npos) || (colon == 0) || (colon + 1 == target.length()))
+        {
+            fprintf (stderr, "ERROR: STREAM_TARGET must be tcp://<host>:<port>.\n");
+            exit_loggrabber (1);
+        }
+        stream.host = target.substr (0, colon);
+        stream.port = target.substr (colon + 1);
+        // [::1]:5140
+        if ((stream.host.length() > 2) && (stream.host[0] == '[') &&
+                (stream.host[stream.host.length() - 1] == ']'))
+        {
+            stream.host = stream.host.substr (1, stream.host.length() - 2);
+        }
     }
-
-    length = strlen (src) + 1;
-    dst = (char*) malloc (length);
-    if (!dst)
+    else if (target.compare (0, 5, "unix:") == 0)
     {
-        fprintf (stderr, "ERROR: out of memory\n");
+        stream.path = target.substr (5);
+        if ((stream.path.length() == 0) ||
+                (stream.path.length() >= sizeof addr.sun_path))
+        {
+            fprintf (stderr,
+                     "ERROR: STREAM_TARGET unix:<path> needs a path of less than %d characters.\n",
+                     (int) sizeof addr.sun_path);
+            exit_loggrabber (1);
+        }
+    }
+    else
+    {
+        fprintf (stderr,
+                 "ERROR: STREAM_TARGET must be tcp://<host>:<port> or unix:<path>.\n");
         exit_loggrabber (1);
     }
-    return ((char*) memcpy (dst, src, length));
-}
-
-/*
- * BEGIN: function string_left_trim
- */
-char *
-string_left_trim (char *string, char character)
-{
-    char *tmp;
 
-    if (cfgvalues.debug_mode >= 2)
+    if (cfgvalues.stream_batch_bytes < 1)
     {
-        fprintf (stderr, "DEBUG: function string_left_trim\n");
+        cfgvalues.stream_batch_bytes = 1;
     }
-
-    if (string == NULL)
+    if (cfgvalues.stream_queue_bytes < cfgvalues.stream_batch_bytes)
     {
-        return NULL;
+        cfgvalues.stream_queue_bytes = cfgvalues.stream_batch_bytes;
     }
-    tmp = string + strlen (string);
-    while ((string[0] == character) && (string < tmp))
-        string++;
-    return (string);
-}
-
-/*
- * BEGIN: function string_right_trim
- */
-char *
-string_right_trim (char *string, char character)
-{
-    int tmp;
-
-    if (cfgvalues.debug_mode >= 2)
+    if (cfgvalues.stream_timeout < 1)
     {
-        fprintf (stderr, "DEBUG: function string_right_trim\n");
+        cfgvalues.stream_timeout = 1;
     }
-
-    if (string == NULL)
+    if (cfgvalues.stream_tls)
     {
-        return NULL;
+#ifdef USE_OPENSSL
+        stream_tls_init ();
+#else
+        fprintf (stderr, "ERROR: STREAM_TLS is not available in this build.\n");
+        exit_loggrabber (1);
+#endif
     }
-    tmp = strlen (string);
-    while ((string[tmp - 1] == character) && (tmp != 0))
-        tmp--;
-    string[tmp] = '\0';
-    return (string);
-}
+    // the collector may be restarted between any two records
+    csv.header_pending = FALSE;
+    signal (SIGPIPE, SIG_IGN);
+
+    pthread_mutex_init (&stream.lock, NULL);
+    pthread_cond_init (&stream.wakeup, NULL);
+    pthread_cond_init (&stream.done, NULL);
+    stream.stop = FALSE;
+    stream.pending.reserve (cfgvalues.stream_batch_bytes);
+    stream.sent = 0;
+    stream.queued_bytes = 0;
+    stream.overflowing = FALSE;
+    stream.drop_pos = -1;
+    if (pthread_create (&stream.thread, NULL, stream_thread, NULL) != 0)
+    {
+        fprintf (stderr, "ERROR: Cannot start stream writer thread\n");
+        exit_loggrabber (1);
+    }
+    stream.running = TRUE;
 
-/*
- * BEGIN: function string_trim
- */
-char *
-string_trim (char *string, char character)
-{
-    if (cfgvalues.debug_mode >= 2)
+    if (cfgvalues.debug_mode)
     {
-        fprintf (stderr, "DEBUG: function string_trim\n");
+        fprintf (stderr, "DEBUG: Writing to %s\n", cfgvalues.stream_target.c_str());
     }
-
-    return (string_right_trim
-            (string_left_trim (string, character), character));
 }
 
 /*
- * BEGIN: function string_mask_newlines
+ * function stream_connect_fd
+ *
+ * connects fd without waiting for more than STREAM_TIMEOUT, fd is left
+ * non blocking
  */
-char *
-string_mask_newlines (char *string)
+static int
+stream_connect_fd (int fd, const struct sockaddr *addr, socklen_t len)
 {
-    int i = 0;
-    int z1, z2;
-    int length = strlen (string);
-    char *sptr = string;
-    char *s;
+    struct pollfd pfd;
+    socklen_t errlen = sizeof (int);
+    int err = 0;
+    int on = 1;
 
-    sptr = strchr (sptr, '\n');
-    while (sptr != NULL)
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+    if (addr->sa_family != AF_UNIX)
     {
-        i++;
-        sptr = strchr (++sptr, '\n');
+        setsockopt (fd, SOL_SOCKET, SO_KEEPALIVE, (char *) &on, sizeof on);
     }
-
-    s = (char *) malloc (length + (i * 2) + 1);
-
-    if (!s)
+    if (connect (fd, addr, len) == 0)
     {
-        fprintf (stderr, "ERROR: out of memory\n");
-        exit_loggrabber (1);
+        return TRUE;
     }
-
-    for (z1 = 0, z2 = 0; z1 < length; z1++)
+    if (errno != EINPROGRESS)
     {
-        if (string[z1] == '\n')
-        {
-            s[z2++] = '(';
-            s[z2++] = '+';
-            s[z2++] = ')';
-        }
-        else
-        {
-            s[z2++] = string[z1];
-        }
+        return FALSE;
     }
-
-    s[z2] = '\0';
-
-    return (s);
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    if (poll (&pfd, 1, cfgvalues.stream_timeout * 1000) <= 0)
+    {
+        errno = ETIMEDOUT;
+        return FALSE;
+    }
+    if ((getsockopt (fd, SOL_SOCKET, SO_ERROR, (char *) &err, &errlen) != 0) ||
+            (err != 0))
+    {
+        errno = err;
+        return FALSE;
+    }
+    return TRUE;
 }
 
 /*
- * BEGIN: function string_escape
+ * function stream_connect
+ *
+ * the connection to STREAM_TARGET, -1 with errno set if there is none
  */
-char *
-string_escape (const char *string, char character)
+static int
+stream_connect ()
 {
-    int i = strlen (string);
-    int z1, z2;
-    char *s = (char *) malloc (i * 2 + 1);
-
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function string_escape\n");
-    }
+    struct sockaddr_un addr;
+    struct addrinfo hints;
+    struct addrinfo *res;
+    struct addrinfo *ai;
+    int fd;
 
-    /*
-     * return if string is NULL
-     */
-    if (string == NULL)
+    if (stream.path.length() > 0)
     {
-        return NULL;
+        memset (&addr, 0, sizeof addr);
+        addr.sun_family = AF_UNIX;
+        strncpy (addr.sun_path, stream.path.c_str(), sizeof addr.sun_path - 1);
+        if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+        {
+            return -1;
+        }
+        if (!stream_connect_fd (fd, (struct sockaddr *) &addr, sizeof addr))
+        {
+            close (fd);
+            return -1;
+        }
+        return fd;
     }
 
-    if (!s)
+    // resolved again every time, the collector may have moved
+    memset (&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo (stream.host.c_str(), stream.port.c_str(), &hints, &res) != 0)
     {
-        fprintf (stderr, "ERROR: out of memory\n");
-        exit_loggrabber (1);
+        errno = EHOSTUNREACH;
+        return -1;
     }
-
-    for (z1 = 0, z2 = 0; z1 < i; z1++)
+    fd = -1;
+    for (ai = res; ai != NULL; ai = ai->ai_next)
     {
-        if ((string[z1] == character) || (string[z1] == '\\'))
+        if ((fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
         {
-            s[z2++] = '\\';
+            continue;
         }
-        s[z2++] = string[z1];
+        if (stream_connect_fd (fd, ai->ai_addr, ai->ai_addrlen))
+        {
+            break;
+        }
+        close (fd);
+        fd = -1;
     }
-
-    s[z2] = '\0';
-
-    return (s);
+    freeaddrinfo (res);
+    return fd;
 }
 
+#ifdef USE_OPENSSL
 /*
- * BEGIN: function string_rmchar
+ * function stream_tls_reason
+ *
+ * the oldest error OpenSSL queued, errno if there is none
  */
-char *
-string_rmchar (char *string, char character)
+static string
+stream_tls_reason ()
 {
-    int i = strlen (string);
-    int z1, z2;
-    char *s = (char *) malloc (i + 1);
-
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function string_rmchar\n");
-    }
+    char text[256];
+    unsigned long code = ERR_get_error ();
 
-    /*
-     * return if string is NULL
-     */
-    if (string == NULL)
+    ERR_clear_error ();
+    if (code == 0)
     {
-        return NULL;
+        return (errno != 0) ? strerror (errno) : "connection closed";
     }
+    ERR_error_string_n (code, text, sizeof text);
+    return text;
+}
 
-    if (!s)
+/*
+ * function stream_tls_init
+ */
+void
+stream_tls_init ()
+{
+    SSL_library_init ();
+    SSL_load_error_strings ();
+    if ((stream.tls_ctx = SSL_CTX_new (SSLv23_client_method ())) == NULL)
     {
-        fprintf (stderr, "ERROR: out of memory\n");
+        fprintf (stderr, "ERROR: Cannot create the TLS context (%s)\n",
+                 stream_tls_reason ().c_str());
         exit_loggrabber (1);
     }
+    SSL_CTX_set_options (stream.tls_ctx, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+    // a partly written record is retried from where it stopped
+    SSL_CTX_set_mode (stream.tls_ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                      SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    SSL_CTX_set_verify (stream.tls_ctx, SSL_VERIFY_PEER, NULL);
+    if ((cfgvalues.stream_tls_ca.length() > 0) ?
+            !SSL_CTX_load_verify_locations (stream.tls_ctx,
+                                            cfgvalues.stream_tls_ca.c_str(), NULL) :
+            !SSL_CTX_set_default_verify_paths (stream.tls_ctx))
+    {
+        fprintf (stderr, "ERROR: Cannot load the CA certificates %s (%s)\n",
+                 cfgvalues.stream_tls_ca.c_str(), stream_tls_reason ().c_str());
+        exit_loggrabber (1);
+    }
+    if ((cfgvalues.stream_tls_cert.length() > 0) &&
+            ((SSL_CTX_use_certificate_chain_file (stream.tls_ctx,
+                    cfgvalues.stream_tls_cert.c_str()) != 1) ||
+             (SSL_CTX_use_PrivateKey_file (stream.tls_ctx,
+                                           ((cfgvalues.stream_tls_key.length() > 0) ?
+                                            cfgvalues.stream_tls_key :
+                                            cfgvalues.stream_tls_cert).c_str(),
+                                           SSL_FILETYPE_PEM) != 1)))
+    {
+        fprintf (stderr, "ERROR: Cannot load the client certificate %s (%s)\n",
+                 cfgvalues.stream_tls_cert.c_str(), stream_tls_reason ().c_str());
+        exit_loggrabber (1);
+    }
+}
 
-    for (z1 = 0, z2 = 0; z1 < i; z1++)
+/*
+ * function stream_tls_handshake
+ *
+ * waits no longer than STREAM_TIMEOUT for the handshake on the non blocking
+ * socket of conn
+ */
+static int
+stream_tls_handshake (stream_conn * conn, string& reason)
+{
+    long deadline = current_time_ms () + cfgvalues.stream_timeout * 1000L;
+    struct in6_addr ip;
+    struct pollfd pfd;
+    long wait;
+    int ret;
+
+    conn->tls = SSL_new (stream.tls_ctx);
+    SSL_set_fd (conn->tls, conn->fd);
+    if (stream.host.length() > 0)
     {
-        if (string[z1] != character)
+        if ((inet_pton (AF_INET, stream.host.c_str(), &ip) == 1) ||
+                (inet_pton (AF_INET6, stream.host.c_str(), &ip) == 1))
         {
-            s[z2++] = string[z1];
+            X509_VERIFY_PARAM_set1_ip_asc (SSL_get0_param (conn->tls),
+                                           stream.host.c_str());
+        }
+        else
+        {
+            SSL_set_tlsext_host_name (conn->tls, (char *) stream.host.c_str());
+            X509_VERIFY_PARAM_set1_host (SSL_get0_param (conn->tls),
+                                         stream.host.c_str(), 0);
         }
     }
 
-    s[z2] = '\0';
-
-    return (s);
+    while ((ret = SSL_connect (conn->tls)) != 1)
+    {
+        pfd.fd = conn->fd;
+        switch (SSL_get_error (conn->tls, ret))
+        {
+        case SSL_ERROR_WANT_READ:
+            pfd.events = POLLIN;
+            break;
+        case SSL_ERROR_WANT_WRITE:
+            pfd.events = POLLOUT;
+            break;
+        default:
+            if (SSL_get_verify_result (conn->tls) != X509_V_OK)
+            {
+                reason = X509_verify_cert_error_string (SSL_get_verify_result (conn->tls));
+                ERR_clear_error ();
+            }
+            else
+            {
+                reason = stream_tls_reason ();
+            }
+            return FALSE;
+        }
+        if (((wait = deadline - current_time_ms ()) <= 0) ||
+                (poll (&pfd, 1, wait) <= 0))
+        {
+            reason = strerror (ETIMEDOUT);
+            return FALSE;
+        }
+    }
+    return TRUE;
 }
+#endif
 
 /*
- * BEGIN: function string_touppper
+ * function stream_close
  */
-char *
-string_toupper (const char *str1)
+static void
+stream_close (stream_conn * conn)
 {
-    char *tempstr1;
-    unsigned int i;
-
-    if (cfgvalues.debug_mode >= 2)
+#ifdef USE_OPENSSL
+    if (conn->tls != NULL)
     {
-        fprintf (stderr, "DEBUG: function string_toupper\n");
+        // close_notify if the socket takes it right away, nothing is awaited
+        SSL_shutdown (conn->tls);
+        SSL_free (conn->tls);
+        conn->tls = NULL;
+        ERR_clear_error ();
     }
-
-    /*
-     * return if string is NULL
-     */
-    if (str1 == NULL)
+#endif
+    if (conn->fd >= 0)
     {
-        return NULL;
+        close (conn->fd);
+        conn->fd = -1;
     }
+}
 
-    tempstr1 = string_duplicate (str1);
-
-    for (i = 0; i < strlen (tempstr1); i++)
+/*
+ * function stream_open
+ *
+ * connects conn to STREAM_TARGET, with STREAM_TLS including the handshake.
+ * FALSE with the reason if that fails.
+ */
+static int
+stream_open (stream_conn * conn, string& reason)
+{
+    conn->want = 0;
+    if ((conn->fd = stream_connect ()) < 0)
     {
-        tempstr1[i] = toupper (tempstr1[i]);
+        reason = strerror (errno);
+        return FALSE;
     }
-
-    return (tempstr1);
+#ifdef USE_OPENSSL
+    conn->tls = NULL;
+    if (cfgvalues.stream_tls && !stream_tls_handshake (conn, reason))
+    {
+        stream_close (conn);
+        return FALSE;
+    }
+#endif
+    return TRUE;
 }
 
 /*
- * BEGIN: function string_icmp
+ * function stream_alive
+ *
+ * FALSE once the collector closed the connection, which a write would only
+ * notice after losing what it wrote. Anything the collector sends is read
+ * and ignored.
  */
-int
-string_icmp (const char *str1, const char *str2)
+static int
+stream_alive (stream_conn * conn, string& reason)
 {
-    char *tempstr1;
-    char *tempstr2;
-    int cmpresult;
-    unsigned int i;
+    char buffer[4096];
+    ssize_t len;
 
-    if (cfgvalues.debug_mode >= 2)
+#ifdef USE_OPENSSL
+    if (conn->tls != NULL)
     {
-        fprintf (stderr, "DEBUG: function string_icmp\n");
+        // a write waiting to be retried must not be interleaved with reads
+        if (conn->want != 0)
+        {
+            return TRUE;
+        }
+        while ((len = SSL_read (conn->tls, buffer, sizeof buffer)) > 0)
+        {
+            continue;
+        }
+        switch (SSL_get_error (conn->tls, len))
+        {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            return TRUE;
+        case SSL_ERROR_ZERO_RETURN:
+            reason = "closed by the collector";
+            return FALSE;
+        default:
+            reason = stream_tls_reason ();
+            return FALSE;
+        }
     }
-
-    tempstr1 = string_duplicate (str1);
-    tempstr2 = string_duplicate (str2);
-
-    for (i = 0; i < strlen (tempstr1); i++)
+#endif
+    while ((len = recv (conn->fd, buffer, sizeof buffer, 0)) > 0)
     {
-        tempstr1[i] = tolower (tempstr1[i]);
+        continue;
     }
-
-    for (i = 0; i < strlen (tempstr2); i++)
+    if (len == 0)
     {
-        tempstr2[i] = tolower (tempstr2[i]);
+        reason = strerror (ECONNRESET);
+        return FALSE;
     }
-
-    cmpresult = strcmp (tempstr1, tempstr2);
-
-    free (tempstr1);
-    free (tempstr2);
-
-    return (cmpresult);
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+    {
+        return TRUE;
+    }
+    reason = strerror (errno);
+    return FALSE;
 }
 
 /*
- * BEGIN: function string_incmp
+ * function stream_write
+ *
+ * writes as much of the n buffers as the socket takes without blocking, 0
+ * if it takes nothing and -1 with the reason if the connection broke. TLS
+ * has no writev, the buffers are written one after the other.
  */
-int
-string_incmp (const char *str1, const char *str2, size_t count)
+static ssize_t
+stream_write (stream_conn * conn, struct iovec *iov, int n, string& reason)
 {
-    char *tempstr1;
-    char *tempstr2;
-    int cmpresult;
-    unsigned int i;
+    ssize_t len;
 
-    if (cfgvalues.debug_mode >= 2)
+#ifdef USE_OPENSSL
+    if (conn->tls != NULL)
     {
-        fprintf (stderr, "DEBUG: function string_incmp\n");
-    }
-
-    tempstr1 = string_duplicate (str1);
-    tempstr2 = string_duplicate (str2);
+        ssize_t written = 0;
+        int i;
 
-    for (i = 0; i < strlen (tempstr1); i++)
+        conn->want = 0;
+        for (i = 0; i < n; i++)
+        {
+            len = SSL_write (conn->tls, iov[i].iov_base, iov[i].iov_len);
+            if (len > 0)
+            {
+                written += len;
+                if ((size_t) len < iov[i].iov_len)
+                {
+                    break;
+                }
+                continue;
+            }
+            switch (SSL_get_error (conn->tls, len))
+            {
+            case SSL_ERROR_WANT_READ:
+                conn->want = POLLIN;
+                break;
+            case SSL_ERROR_WANT_WRITE:
+                conn->want = POLLOUT;
+                break;
+            default:
+                if (written == 0)
+                {
+                    reason = stream_tls_reason ();
+                    return -1;
+                }
+            }
+            break;
+        }
+        return written;
+    }
+#endif
+    if ((len = writev (conn->fd, iov, n)) < 0)
     {
-        tempstr1[i] = tolower (tempstr1[i]);
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+        {
+            return 0;
+        }
+        reason = strerror (errno);
     }
+    return len;
+}
 
-    for (i = 0; i < strlen (tempstr2); i++)
+/*
+ * function stream_seal
+ *
+ * hands the records collected so far to the writer, stream.lock is held
+ */
+static void
+stream_seal ()
+{
+    if (stream.pending.empty())
     {
-        tempstr2[i] = tolower (tempstr2[i]);
+        return;
     }
-
-    cmpresult = strncmp (tempstr1, tempstr2, count);
-
-    free (tempstr1);
-    free (tempstr2);
-
-    return (cmpresult);
+    stream.queue.push_back (new string);
+    stream.queue.back()->swap (stream.pending);
+    stream.pending.reserve (cfgvalues.stream_batch_bytes);
+    pthread_cond_signal (&stream.wakeup);
 }
 
 /*
- * BEGIN: function to read configuration file
+ * function stream_frame_start
+ *
+ * offset of the record that byte offset sent of a chunk belongs to
  */
-void
-read_config_file (char *filename, configvalues * cfgvalues)
+static size_t
+stream_frame_start (const string& chunk, size_t sent)
 {
-    FILE *configfile;
-    char line[256];
-    char *position;
-    char *configparameter;
-    char *configvalue;
-    char *tmpstr;
+    size_t start = 0;
+    size_t next;
+    size_t pos;
 
-    if ((configfile = fopen (filename, "r")) == NULL)
+    if (sent == 0)
     {
-        fprintf (stderr, "ERROR: Cannot open configfile (%s)\n", filename);
-        exit_loggrabber (1);
+        return 0;
     }
-
-    while (fgets (line, sizeof line, configfile))
+    if (cfgvalues.stream_framing == STREAM_NEWLINE)
     {
-        position = strchr (line, '\n');
-        if (position)
+        // newlines in records are masked, see string_mask_newlines
+        pos = chunk.rfind ('\n', sent - 1);
+        return (pos == string::npos) ? 0 : pos + 1;
+    }
+    while (start + 4 <= chunk.length())
+    {
+        next = start + 4 +
+               (((size_t) (unsigned char) chunk[start] << 24) |
+                ((size_t) (unsigned char) chunk[start + 1] << 16) |
+                ((size_t) (unsigned char) chunk[start + 2] << 8) |
+                (size_t) (unsigned char) chunk[start + 3]);
+        if (next > sent)
         {
-            *position = 0;
+            break;
         }
+        start = next;
+    }
+    return start;
+}
 
-        position = strchr (line, '#');
-        if (position)
-        {
-            *position = 0;
-        }
+/*
+ * function stream_thread
+ *
+ * writes the queued chunks, as many as STREAM_IOV with one writev
+ */
+void *
+stream_thread (void *arg)
+{
+    struct iovec iov[STREAM_IOV];
+    struct pollfd pfd;
+    struct timespec ts;
+    struct timeval tv;
+    stream_conn conn;
+    string reason;
+    long progress = 0;		// current_time_ms () of the last write
+    long delay;
+    ssize_t len;
+    size_t left;
+    string *chunk;
+    int connected = FALSE;
+    int attempt = 0;
+    int n;
+
+    conn.fd = -1;
+#ifdef USE_OPENSSL
+    conn.tls = NULL;
+#endif
 
-        configparameter = string_trim (strtok (line, "="), ' ');
-        if (configparameter)
+    pthread_mutex_lock (&stream.lock);
+    while (!stream.stop)
+    {
+        if (!stream.pending.empty() &&
+                (current_time_ms () - stream.opened >= cfgvalues.stream_batch_ms))
         {
-            configvalue = string_trim (strtok (NULL, ""), ' ');
+            stream_seal ();
         }
-
-        if (configparameter && configvalue)
+        if (stream.queue.empty())
         {
-            if (debug_mode == 1)
-            {
-                fprintf (stderr, "DEBUG: %s=%s\n", configparameter,
-                         configvalue);
-            }
-            if (strcmp (configparameter, "RECORD_SEPARATOR") == 0)
-            {
-                tmpstr = string_trim (configvalue, '"');
-                if (tmpstr)
-                {
-                    cfgvalues->record_separator = tmpstr[0];
-                }
-            }
-            else if (strcmp (configparameter, "DEBUG_LEVEL") == 0)
-            {
-                cfgvalues->debug_mode = atoi (string_trim (configvalue, '"'));
-            }
-
-            else if (strcmp (configparameter, "SPLUNK_REST_MAX_RETRIES") == 0)
-            {
-                cfgvalues->splunkRestMaxRetries = atoi (string_trim (configvalue, '"'));
-            }
-            else if (strcmp (configparameter, "SPLUNK_REST_RETRY_FACTOR") == 0)
-            {
-                cfgvalues->splunkRestRetryFactor = atoi (string_trim (configvalue, '"'));
-            }
-            else if (strcmp (configparameter, "SPLUNK_REST_STATUS_COMMIT") == 0)
-            {
-                cfgvalues->splunkRestStatusCommit = atoi (string_trim (configvalue, '"'));
-            }
-            else if (strcmp (configparameter, "ONLINE_MODE") == 0)
-            {
-                configvalue = string_duplicate (string_trim (configvalue, '"'));
-                if (string_icmp (configvalue, "no") == 0)
-                {
-                    cfgvalues->online_mode = 0;
-                }
-                else if (string_icmp (configvalue, "yes") == 0)
-                {
-                    cfgvalues->online_mode = 1;
-                }
-                else
-                {
-                    fprintf (stderr,
-                             "WARNING: Illegal entry in configuration file: %s=%s\n",
-                             configparameter, configvalue);
-                }
-                free (configvalue);
-            }
-            else if (strcmp (configparameter, "RESOLVE_MODE") == 0)
-            {
-                configvalue = string_duplicate (string_trim (configvalue, '"'));
-                if (string_icmp (configvalue, "no") == 0)
-                {
-                    cfgvalues->resolve_mode = 0;
-                }
-                else if (string_icmp (configvalue, "yes") == 0)
-                {
-                    cfgvalues->resolve_mode = 1;
-                }
-                else
-                {
-                    fprintf (stderr,
-                             "WARNING: Illegal entry in configuration file: %s=%s\n",
-                             configparameter, configvalue);
-                }
-                free (configvalue);
-            }
-            else if (strcmp (configparameter, "FW1_TYPE") == 0)
+            gettimeofday (&tv, NULL);
+            ts.tv_sec = tv.tv_sec;
+            ts.tv_nsec = (tv.tv_usec + 100000) * 1000L;
+            if (ts.tv_nsec >= 1000000000L)
             {
-                configvalue = string_duplicate (string_trim (configvalue, '"'));
-                if (string_icmp (configvalue, "ng") == 0)
-                {
-                    cfgvalues->fw1_2000 = 0;
-                }
-                else if (string_icmp (configvalue, "2000") == 0)
-                {
-                    cfgvalues->fw1_2000 = 1;
-                }
-                else
-                {
-                    fprintf (stderr,
-                             "WARNING: Illegal entry in configuration file: %s=%s\n",
-                             configparameter, configvalue);
-                }
-                free (configvalue);
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
             }
-            else if (strcmp (configparameter, "FW1_MODE") == 0)
+            pthread_cond_timedwait (&stream.wakeup, &stream.lock, &ts);
+            continue;
+        }
+
+        if (conn.fd < 0)
+        {
+            delay = reconnect_delay_ms (attempt);
+            pthread_mutex_unlock (&stream.lock);
+            if (delay > 0)
             {
-                configvalue = string_duplicate (string_trim (configvalue, '"'));
-                if (string_icmp (configvalue, "normal") == 0)
-                {
-                    cfgvalues->audit_mode = 0;
-                }
-                else if (string_icmp (configvalue, "audit") == 0)
-                {
-                    cfgvalues->audit_mode = 1;
-                }
-                else
-                {
-                    fprintf (stderr,
-                             "WARNING: Illegal entry in configuration file: %s=%s\n",
-                             configparameter, configvalue);
-                }
-                free (configvalue);
+                SLEEP_MS (delay);
             }
-            else if (strcmp (configparameter, "DATEFORMAT") == 0)
+            n = stream_open (&conn, reason);
+            pthread_mutex_lock (&stream.lock);
+            if (!n)
             {
-                configvalue = string_duplicate (string_trim (configvalue, '"'));
-                if (string_icmp (configvalue, "cp") == 0)
-                {
-                    cfgvalues->dateformat = DATETIME_CP;
-                }
-                else if (string_icmp (configvalue, "unix") == 0)
-                {
-                    cfgvalues->dateformat = DATETIME_UNIX;
-                }
-                else if (string_icmp (configvalue, "std") == 0)
+                if (attempt++ == 0)
                 {
-                    cfgvalues->dateformat = DATETIME_STD;
-                }
-                else
-                {
-                    fprintf (stderr,
-                             "WARNING: Illegal entry in configuration file: %s=%s\n",
-                             configparameter, configvalue);
+                    fprintf (stderr, "WARNING: Cannot connect to %s (%s), retrying\n",
+                             cfgvalues.stream_target.c_str(), reason.c_str());
                 }
-                free (configvalue);
+                continue;
             }
-            else if (strcmp (configparameter, "LOGGING_CONFIGURATION") == 0)
+            if (cfgvalues.debug_mode)
             {
-                configvalue = string_duplicate (string_trim (configvalue, '"'));
-                if (string_icmp (configvalue, "screen") == 0)
-                {
-                    cfgvalues->log_mode = SCREEN;
-                }
-                else if (string_icmp (configvalue, "file") == 0)
-                {
-                    cfgvalues->log_mode = LOGFILE;
-                }
-                else
-                {
-                    fprintf (stderr,
-                             "WARNING: Illegal entry in configuration file: %s=%s\n",
-                             configparameter, configvalue);
-                }
-                free (configvalue);
+                fprintf (stderr, "DEBUG: Connected to %s\n",
+                         cfgvalues.stream_target.c_str());
             }
-            else if (strcmp (configparameter, "OUTPUT_FILE_PREFIX") == 0)
+            if (connected)
             {
-                cfgvalues->output_file_prefix =
-                    string_duplicate (string_trim (configvalue, '"'));
+                stream.reconnects++;
             }
-            else if (strcmp (configparameter, "OUTPUT_FILE_ROTATESIZE") == 0)
+            connected = TRUE;
+            attempt = 0;
+            // a record cut off by the last connection is written again whole
+            if (!stream.queue.empty())
             {
-                cfgvalues->output_file_rotatesize =
-                    atol (string_trim (configvalue, '"'));
+                stream.sent = stream_frame_start (*stream.queue.front(), stream.sent);
             }
-            else if (strcmp (configparameter, "FW1_OUTPUT") == 0)
+            progress = current_time_ms ();
+        }
+
+        for (n = 0; (n < STREAM_IOV) && (n < (int) stream.queue.size()); n++)
+        {
+            chunk = stream.queue[n];
+            left = (n == 0) ? stream.sent : 0;
+            iov[n].iov_base = (char *) chunk->data() + left;
+            iov[n].iov_len = chunk->length() - left;
+        }
+        pthread_mutex_unlock (&stream.lock);
+        len = 0;
+        pfd.fd = conn.fd;
+        pfd.events = (conn.want != 0) ? conn.want : POLLOUT;
+        if (!stream_alive (&conn, reason))
+        {
+            len = -1;
+        }
+        else if (poll (&pfd, 1, 100) > 0)
+        {
+            len = stream_write (&conn, iov, n, reason);
+        }
+        if ((len == 0) &&
+                (current_time_ms () - progress >= cfgvalues.stream_timeout * 1000L))
+        {
+            len = -1;
+            reason = strerror (ETIMEDOUT);
+        }
+        pthread_mutex_lock (&stream.lock);
+
+        if (len < 0)
+        {
+            fprintf (stderr, "WARNING: Lost the connection to %s (%s), reconnecting\n",
+                     cfgvalues.stream_target.c_str(), reason.c_str());
+            stream_close (&conn);
+            continue;
+        }
+        if (len == 0)
+        {
+            continue;
+        }
+        progress = current_time_ms ();
+        stream.writes++;
+        stream.bytes += len;
+        while (len > 0)
+        {
+            chunk = stream.queue.front();
+            left = chunk->length() - stream.sent;
+            if ((size_t) len < left)
             {
-                configvalue = string_duplicate (string_trim (configvalue, '"'));
-                if (string_icmp (configvalue, "files") == 0)
-                {
-                    cfgvalues->showfiles_mode = 1;
-                }
-                else if (string_icmp (configvalue, "logs") == 0)
-                {
-                    cfgvalues->showfiles_mode = 0;
-                }
-                else
-                {
-                    fprintf (stderr,
-                             "WARNING: Illegal entry in configuration file: %s=%s\n",
-                             configparameter, configvalue);
-                }
-                free (configvalue);
+                stream.sent += len;
+                break;
             }
-            else if (strcmp (configparameter, "FW1_LOGFILE") == 0)
+            len -= left;
+            stream.queued_bytes -= chunk->length();
+            stream.queue.pop_front();
+            stream.sent = 0;
+            delete chunk;
+        }
+        pthread_cond_broadcast (&stream.done);
+    }
+    pthread_mutex_unlock (&stream.lock);
+
+    stream_close (&conn);
+    return NULL;
+}
+
+/*
+ * function submit_stream
+ *
+ * frames the record onto the chunk being collected. Once STREAM_QUEUE_BYTES
+ * are waiting the record path waits for the writer, or the record is
+ * dropped with STREAM_OVERFLOW=drop.
+ */
+void
+submit_stream (char *message)
+{
+    size_t len = strlen (message);
+    size_t framed = len + ((cfgvalues.stream_framing == STREAM_LENGTH) ? 4 : 1);
+    char prefix[4];
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function submit_stream\n");
+    }
+
+    pthread_mutex_lock (&stream.lock);
+    if (stream.queued_bytes + (long) framed > cfgvalues.stream_queue_bytes)
+    {
+        if (cfgvalues.stream_overflow == STREAM_DROP)
+        {
+            if (stream.drop_pos < 0)
             {
-                cfgvalues->fw1_logfile =
-                    string_duplicate (string_trim (configvalue, '"'));
+                // record_submit has set the position of this record
+                stream.drop_pos = watermark.submitted_pos;
             }
-            else if (strcmp (configparameter, "FIELDS") == 0)
+            if (!stream.overflowing)
             {
-                if (cfgvalues->fields != NULL)
-                {
-                    fprintf (stderr,
-                             "ERROR: multiple FIELDS definitions in configuration file: %s=%s\n",
-                             configparameter, configvalue);
-                    exit_loggrabber (1);
-                }
-                cfgvalues->fields =
-                    string_duplicate (string_trim (configvalue, '"'));
+                fprintf (stderr,
+                         "WARNING: %s falls behind, dropping records, the checkpoint stays before position %d\n",
+                         cfgvalues.stream_target.c_str(), stream.drop_pos);
+                stream.overflowing = TRUE;
             }
-            else if (strcmp (configparameter, "FW1_FILTER_RULE") == 0)
+            stream.dropped++;
+            pthread_mutex_unlock (&stream.lock);
+            return;
+        }
+        while ((stream.queued_bytes > 0) &&
+                (stream.queued_bytes + (long) framed > cfgvalues.stream_queue_bytes))
+        {
+            stream_seal ();
+            pthread_cond_wait (&stream.done, &stream.lock);
+        }
+    }
+    stream.overflowing = FALSE;
+
+    if (stream.pending.empty())
+    {
+        stream.opened = current_time_ms ();
+    }
+    if (cfgvalues.stream_framing == STREAM_LENGTH)
+    {
+        prefix[0] = (char) ((len >> 24) & 0xff);
+        prefix[1] = (char) ((len >> 16) & 0xff);
+        prefix[2] = (char) ((len >> 8) & 0xff);
+        prefix[3] = (char) (len & 0xff);
+        stream.pending.append (prefix, 4);
+        stream.pending.append (message, len);
+    }
+    else
+    {
+        stream.pending.append (message, len);
+        stream.pending.push_back ('\n');
+    }
+    stream.queued_bytes += framed;
+    stream.records++;
+    if (stream.pending.length() >= (size_t) cfgvalues.stream_batch_bytes)
+    {
+        stream_seal ();
+    }
+    pthread_mutex_unlock (&stream.lock);
+}
+
+/*
+ * function stream_drain
+ *
+ * queues the chunk being collected and waits until every chunk is written,
+ * for at most limit_ms if it is above 0. FALSE if bytes are left.
+ */
+static int
+stream_drain (long limit_ms)
+{
+    long started = current_time_ms ();
+    struct timespec ts;
+    struct timeval tv;
+    int drained;
+
+    pthread_mutex_lock (&stream.lock);
+    stream_seal ();
+    while (!stream.queue.empty() &&
+            ((limit_ms <= 0) || (current_time_ms () - started < limit_ms)))
+    {
+        gettimeofday (&tv, NULL);
+        ts.tv_sec = tv.tv_sec + 1;
+        ts.tv_nsec = tv.tv_usec * 1000L;
+        pthread_cond_timedwait (&stream.done, &stream.lock, &ts);
+    }
+    drained = stream.queue.empty();
+    pthread_mutex_unlock (&stream.lock);
+    return drained;
+}
+
+int
+flush_stream ()
+{
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function flush_stream\n");
+    }
+
+    // handed to the socket is as far as a stream can tell
+    if (!stream_drain (0))
+    {
+        return FLUSH_FAILED;
+    }
+    watermark.flushed_pos = (stream.drop_pos >= 0) ?
+                            stream.drop_pos - 1 : watermark.submitted_pos;
+    return watermark.flushed_pos;
+}
+
+void
+close_stream ()
+{
+    stringstream sstream;
+    long left;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function close_stream\n");
+    }
+
+    if (!stream.running)
+    {
+        return;
+    }
+    // a collector that stays away must not hold up the shutdown for good
+    stream_drain (cfgvalues.stream_timeout * 1000L);
+    pthread_mutex_lock (&stream.lock);
+    left = stream.queued_bytes;
+    if (left > 0)
+    {
+        fprintf (stderr, "WARNING: %ld bytes were not written to %s\n", left,
+                 cfgvalues.stream_target.c_str());
+    }
+    stream.stop = TRUE;
+    pthread_cond_broadcast (&stream.wakeup);
+    pthread_mutex_unlock (&stream.lock);
+    pthread_join (stream.thread, NULL);
+    while (!stream.queue.empty())
+    {
+        delete stream.queue.front();
+        stream.queue.pop_front();
+    }
+    stream.running = FALSE;
+#ifdef USE_OPENSSL
+    if (stream.tls_ctx != NULL)
+    {
+        SSL_CTX_free (stream.tls_ctx);
+        stream.tls_ctx = NULL;
+    }
+#endif
+
+    sstream << "stream_records=" << stream.records
+            << "|stream_dropped=" << stream.dropped
+            << "|stream_bytes=" << stream.bytes
+            << "|stream_writes=" << stream.writes
+            << "|stream_reconnects=" << stream.reconnects
+            << "|stream_unwritten=" << left;
+    metrics_emit (sstream.str());
+}
+
+/*
+ * function csv_add_column
+ *
+ * a FIELDS entry, in the order given
+ */
+void
+csv_add_column (const char *name)
+{
+    unsigned int k;
+
+    for (k = 0; k < csv.columns.size(); k++)
+    {
+        if (csv.columns[k] == name)
+        {
+            return;
+        }
+    }
+    csv.columns.push_back (name);
+}
+
+/*
+ * function csv_init
+ *
+ * fixes the column layout of OUTPUT_FORMAT=csv and tsv
+ */
+void
+csv_init ()
+{
+    char ***headers = cfgvalues.audit_mode ? afield_headers : lfield_headers;
+    int *order = cfgvalues.audit_mode ? afield_order : lfield_order;
+    int number_fields =
+        cfgvalues.audit_mode ? NUMBER_AIDX_FIELDS : NUMBER_LIDX_FIELDS;
+    unsigned int k;
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function csv_init\n");
+    }
+
+    csv.header_pending = FALSE;
+    if ((cfgvalues.output_format != FORMAT_CSV) &&
+            (cfgvalues.output_format != FORMAT_TSV))
+    {
+        return;
+    }
+    if (csv.columns.size() == 0)
+    {
+        fprintf (stderr,
+                 "ERROR: OUTPUT_FORMAT=csv and tsv need the columns in FIELDS.\n");
+        exit_loggrabber (1);
+    }
+
+    csv.delimiter =
+        (cfgvalues.output_format == FORMAT_TSV) ? '\t' : cfgvalues.record_separator;
+    if (cfgvalues.sample_rates.length() > 0)
+    {
+        csv_add_column ("sample_rate");
+    }
+    for (k = 0; k < csv.columns.size(); k++)
+    {
+        if (csv.columns[k] == "repeat_count")
+        {
+            csv.columns.erase (csv.columns.begin() + k);
+            break;
+        }
+    }
+    if (cfgvalues.dedup_window > 0)
+    {
+        // appended by dedup_emit, so it has to come last
+        csv.columns.push_back ("repeat_count");
+    }
+
+    csv.sample_column = -1;
+    for (k = 0; k < csv.columns.size(); k++)
+    {
+        for (i = 0; i < number_fields; i++)
+        {
+            if ((*headers[i] != NULL) && (csv.columns[k] == *headers[i]))
             {
-                cfgvalues->fw1_filter_count++;
-                cfgvalues->fw1_filter_array =
-                    (char **) realloc (cfgvalues->fw1_filter_array,
-                                       cfgvalues->fw1_filter_count *
-                                       sizeof (char *));
-                if (cfgvalues->fw1_filter_array == NULL)
-                {
-                    fprintf (stderr, "ERROR: Out of memory\n");
-                    exit_loggrabber (1);
-                }
-                cfgvalues->fw1_filter_array[cfgvalues->fw1_filter_count - 1] =
-                    string_duplicate (string_trim (configvalue, '"'));
+                order[i] = k;
             }
-            else if (strcmp (configparameter, "AUDIT_FILTER_RULE") == 0)
+        }
+        if (csv.columns[k] == "sample_rate")
+        {
+            csv.sample_column = k;
+        }
+    }
+    csv.repeat_column =
+        (cfgvalues.dedup_window > 0) ? (int) csv.columns.size() - 1 : -1;
+    csv.loc_column = order[cfgvalues.audit_mode ? AIDX_NUM : LIDX_NUM];
+    csv.time_column = order[cfgvalues.audit_mode ? AIDX_TIME : LIDX_TIME];
+    csv.slots.clear();
+    csv.header_pending = TRUE;
+}
+
+/*
+ * function csv_column
+ *
+ * column of an attribute id, -1 if it is left out. A known field takes its
+ * column from lfield_order/afield_order, any other attribute is looked up
+ * in FIELDS by name. The ids of a session are resolved once.
+ */
+static int
+csv_column (OpsecSession * pSession, int id)
+{
+    char ***headers = cfgvalues.audit_mode ? afield_headers : lfield_headers;
+    int *order = cfgvalues.audit_mode ? afield_order : lfield_order;
+    int number_fields =
+        cfgvalues.audit_mode ? NUMBER_AIDX_FIELDS : NUMBER_LIDX_FIELDS;
+    vector<int>& slots = csv.slots[pSession];
+    unsigned int k;
+    char *name;
+    int i;
+
+    if (id < 0)
+    {
+        return -1;
+    }
+    if ((unsigned int) id >= slots.size())
+    {
+        slots.resize (id + 1, -2);
+    }
+    if (slots[id] == -2)
+    {
+        slots[id] = -1;
+        if ((name = lea_attr_name (pSession, id)) == NULL)
+        {
+            return -1;
+        }
+        for (i = 0; i < number_fields; i++)
+        {
+            if ((*headers[i] != NULL) && (strcmp (name, *headers[i]) == 0))
             {
-                cfgvalues->audit_filter_count++;
-                cfgvalues->audit_filter_array =
-                    (char **) realloc (cfgvalues->audit_filter_array,
-                                       cfgvalues->audit_filter_count *
-                                       sizeof (char *));
-                if (cfgvalues->audit_filter_array == NULL)
-                {
-                    fprintf (stderr, "ERROR: Out of memory\n");
-                    exit_loggrabber (1);
-                }
-                cfgvalues->audit_filter_array[cfgvalues->audit_filter_count -
-                                              1] =
-                                                  string_duplicate (string_trim (configvalue, '"'));
+                slots[id] = order[i];
+                return slots[id];
             }
-            else
+        }
+        for (k = 0; k < csv.columns.size(); k++)
+        {
+            if (csv.columns[k] == name)
             {
-                fprintf (stderr,
-                         "WARNING: Illegal entry in configuration file: %s=%s\n",
-                         configparameter, configvalue);
+                slots[id] = k;
+                break;
             }
         }
     }
+    return slots[id];
+}
 
-    fclose (configfile);
+/*
+ * function csv_append
+ *
+ * a value is quoted if it holds the delimiter or a quote, quotes are
+ * doubled
+ */
+static void
+csv_append (string& line, const string& value)
+{
+    char special[] = { csv.delimiter, '"', '\n', '\r', '\0' };
+    size_t i;
+
+    if (value.find_first_of (special) == string::npos)
+    {
+        line += value;
+        return;
+    }
+    line.push_back ('"');
+    for (i = 0; i < value.length(); i++)
+    {
+        if (value[i] == '"')
+        {
+            line.push_back ('"');
+        }
+        line.push_back (value[i]);
+    }
+    line.push_back ('"');
 }
 
 /*
- * BEGIN: function to initialize fields headers of logfile fields
+ * function csv_value
+ *
+ * text of a field as the name=value output has it
+ */
+static string
+csv_value (OpsecSession * pSession, lea_field * field, int is_time)
+{
+    char text[32];
+    time_t logtime;
+    unsigned long ul;
+
+    if (is_time && (cfgvalues.dateformat == DATETIME_UNIX))
+    {
+        snprintf (text, sizeof text, "%lu", field->lea_value.ul_value);
+        return text;
+    }
+    if (is_time && (cfgvalues.dateformat == DATETIME_STD))
+    {
+        logtime = (time_t) field->lea_value.ul_value;
+        strftime (text, sizeof text, "%Y-%m-%d %H:%M:%S", localtime (&logtime));
+        return text;
+    }
+    if (!is_time && !cfgvalues.resolve_mode)
+    {
+        switch (field->lea_val_type)
+        {
+        case LEA_VT_IP_ADDR:
+            ul = ntohl ((uint32_t) field->lea_value.ul_value);
+            snprintf (text, sizeof text, "%lu.%lu.%lu.%lu", (ul >> 24) & 0xff,
+                      (ul >> 16) & 0xff, (ul >> 8) & 0xff, ul & 0xff);
+            return text;
+        case LEA_VT_TCP_PORT:
+        case LEA_VT_UDP_PORT:
+            snprintf (text, sizeof text, "%d", ntohs (field->lea_value.ush_value));
+            return text;
+        }
+    }
+    return lea_resolve_field (pSession, *field);
+}
+
+/*
+ * function csv_format
+ *
+ * the values of a record in column order, the time of the record goes to
+ * rec_time if it is a column
+ */
+string
+csv_format (OpsecSession * pSession, lea_record * pRec, int pos,
+            unsigned long sample_rate, unsigned long *rec_time)
+{
+    vector<string> values (csv.columns.size());
+    lea_field *field;
+    string line;
+    char text[32];
+    unsigned int k;
+    int col;
+    int i;
+
+    if (cfgvalues.debug_mode >= 2)
+    {
+        fprintf (stderr, "DEBUG: function csv_format\n");
+    }
+
+    if (csv.loc_column >= 0)
+    {
+        snprintf (text, sizeof text, "%d", pos);
+        values[csv.loc_column] = text;
+    }
+    for (i = 0; i < pRec->n_fields; i++)
+    {
+        field = &(pRec->fields[i]);
+        if ((col = csv_column (pSession, field->lea_attr_id)) < 0)
+        {
+            continue;
+        }
+        if (col == csv.time_column)
+        {
+            *rec_time = field->lea_value.ul_value;
+        }
+        values[col] = csv_value (pSession, field, col == csv.time_column);
+    }
+    if (csv.sample_column >= 0)
+    {
+        snprintf (text, sizeof text, "%lu", sample_rate);
+        values[csv.sample_column] = text;
+    }
+
+    // repeat_count is added by dedup_emit
+    for (k = 0; k < values.size(); k++)
+    {
+        if ((int) k == csv.repeat_column)
+        {
+            break;
+        }
+        if (k > 0)
+        {
+            line.push_back (csv.delimiter);
+        }
+        csv_append (line, values[k]);
+    }
+    return line;
+}
+
+/*
+ * function csv_header
+ *
+ * writes the header line if the output file has none yet, ahead of the
+ * record being submitted
  */
 void
-initialize_lfield_headers (char **headers[NUMBER_LIDX_FIELDS])
+csv_header ()
+{
+    int stamp_loc = compressor.stamp_loc;
+    unsigned long stamp_time = compressor.stamp_time;
+    string line;
+    unsigned int k;
+
+    if (!csv.header_pending)
+    {
+        return;
+    }
+    csv.header_pending = FALSE;
+
+    for (k = 0; k < csv.columns.size(); k++)
+    {
+        if (k > 0)
+        {
+            line.push_back (csv.delimiter);
+        }
+        csv_append (line, csv.columns[k]);
+    }
+    // the block index stamp belongs to the record
+    compress_stamp (-1, 0);
+    submit_log ((char *) line.c_str());
+    compress_stamp (stamp_loc, stamp_time);
+}
+
+/*
+ * function cef_key
+ *
+ * an extension key as the format allows it, letters, digits and
+ * underscores
+ */
+static string
+cef_key (const char *name)
+{
+    string key;
+
+    for (; *name; name++)
+    {
+        if (isalnum ((unsigned char) *name) || (*name == '_'))
+        {
+            key.push_back (*name);
+        }
+    }
+    return (key.length() > 0) ? key + "=" : key;
+}
+
+/*
+ * function cef_init
+ *
+ * compiles cef_mappings for the chosen format
+ */
+void
+cef_init ()
 {
+    int leef = (cfgvalues.output_format == FORMAT_LEEF);
+    cef_emit emit;
+    const char *key;
+    const char *other;
     int i;
+    int j;
 
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function initialize_lfield_headers\n");
+        fprintf (stderr, "DEBUG: function cef_init\n");
     }
 
-    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    if ((cfgvalues.output_format != FORMAT_CEF) && !leef)
     {
-        headers[i] = (char**) malloc (sizeof (char *));
-        *headers[i] = NULL;
+        return;
+    }
+    cef.separator = leef ? '\t' : ' ';
+    cef.loc_key = "externalId=";
+    cef.sample_key = leef ? "sampleRate=" : "cn1Label=Sample Rate cn1=";
+    cef.repeat_key = leef ? "repeatCount=" : "cnt=";
+    if ((output_fields.size() > 0) &&
+            (output_fields.find ("loc") == output_fields.end()))
+    {
+        cef.loc_key.clear();
     }
 
-    *headers[LIDX_NUM] = string_duplicate ("loc");
-    *headers[LIDX_TIME] = string_duplicate ("time");
-    *headers[LIDX_ACTION] = string_duplicate ("action");
-    *headers[LIDX_ORIG] = string_duplicate ("orig");
-    *headers[LIDX_ALERT] = string_duplicate ("alert");
-    *headers[LIDX_IF_DIR] = string_duplicate ("i/f_dir");
-    *headers[LIDX_IF_NAME] = string_duplicate ("i/f_name");
-    *headers[LIDX_HAS_ACCOUNTING] = string_duplicate ("has_accounting");
-    *headers[LIDX_UUID] = string_duplicate ("uuid");
-    *headers[LIDX_PRODUCT] = string_duplicate ("product");
-    *headers[LIDX_POLICY_ID_TAG] = string_duplicate ("__policy_id_tag");
-    *headers[LIDX_SRC] = string_duplicate ("src");
-    *headers[LIDX_S_PORT] = string_duplicate ("s_port");
-    *headers[LIDX_DST] = string_duplicate ("dst");
-    *headers[LIDX_SERVICE] = string_duplicate ("service");
-    *headers[LIDX_TCP_FLAGS] = string_duplicate ("tcp_flags");
-    *headers[LIDX_PROTO] = string_duplicate ("proto");
-    *headers[LIDX_RULE] = string_duplicate ("rule");
-    *headers[LIDX_XLATESRC] = string_duplicate ("xlatesrc");
-    *headers[LIDX_XLATEDST] = string_duplicate ("xlatedst");
-    *headers[LIDX_XLATESPORT] = string_duplicate ("xlatesport");
-    *headers[LIDX_XLATEDPORT] = string_duplicate ("xlatedport");
-    *headers[LIDX_NAT_RULENUM] = string_duplicate ("NAT_rulenum");
-    *headers[LIDX_NAT_ADDRULENUM] = string_duplicate ("NAT_addtnl_rulenum");
-    *headers[LIDX_RESOURCE] = string_duplicate ("resource");
-    *headers[LIDX_ELAPSED] = string_duplicate ("elapsed");
-    *headers[LIDX_PACKETS] = string_duplicate ("packets");
-    *headers[LIDX_BYTES] = string_duplicate ("bytes");
-    *headers[LIDX_REASON] = string_duplicate ("reason");
-    *headers[LIDX_SERVICE_NAME] = string_duplicate ("service_name");
-    *headers[LIDX_AGENT] = string_duplicate ("agent");
-    *headers[LIDX_FROM] = string_duplicate ("from");
-    *headers[LIDX_TO] = string_duplicate ("to");
-    *headers[LIDX_SYS_MSGS] = string_duplicate ("sys_msgs");
-    *headers[LIDX_FW_MESSAGE] = string_duplicate ("fw_message");
-    *headers[LIDX_INTERNAL_CA] = string_duplicate ("Internal_CA:");
-    *headers[LIDX_SERIAL_NUM] = string_duplicate ("serial_num:");
-    *headers[LIDX_DN] = string_duplicate ("dn:");
-    *headers[LIDX_ICMP] = string_duplicate ("ICMP");
-    *headers[LIDX_ICMP_TYPE] = string_duplicate ("icmp-type");
-    *headers[LIDX_ICMP_TYPE2] = string_duplicate ("ICMP Type");
-    *headers[LIDX_ICMP_CODE] = string_duplicate ("icmp-code");
-    *headers[LIDX_ICMP_CODE2] = string_duplicate ("ICMP Code");
-    *headers[LIDX_MSGID] = string_duplicate ("msgid");
-    *headers[LIDX_MESSAGE_INFO] = string_duplicate ("message_info");
-    *headers[LIDX_LOG_SYS_MESSAGE] = string_duplicate ("log_sys_message");
-    *headers[LIDX_SESSION_ID] = string_duplicate ("session_id:");
-    *headers[LIDX_DNS_QUERY] = string_duplicate ("dns_query");
-    *headers[LIDX_DNS_TYPE] = string_duplicate ("dns_type");
-    *headers[LIDX_SCHEME] = string_duplicate ("scheme:");
-    *headers[LIDX_SRCKEYID] = string_duplicate ("srckeyid");
-    *headers[LIDX_DSTKEYID] = string_duplicate ("dstkeyid");
-    *headers[LIDX_METHODS] = string_duplicate ("methods:");
-    *headers[LIDX_PEER_GATEWAY] = string_duplicate ("peer gateway");
-    *headers[LIDX_IKE] = string_duplicate ("IKE:");
-    *headers[LIDX_IKE_IDS] = string_duplicate ("IKE IDs:");
-    *headers[LIDX_ENCRYPTION_FAILURE] =
-        string_duplicate ("encryption failure:");
-    *headers[LIDX_ENCRYPTION_FAIL_R] =
-        string_duplicate ("encryption fail reason:");
-    *headers[LIDX_COOKIEI] = string_duplicate ("CookieI");
-    *headers[LIDX_COOKIER] = string_duplicate ("CookieR");
-    *headers[LIDX_START_TIME] = string_duplicate ("start_time");
-    *headers[LIDX_SEGMENT_TIME] = string_duplicate ("segment_time");
-    *headers[LIDX_CLIENT_IN_PACKETS] =
-        string_duplicate ("client_inbound_packets");
-    *headers[LIDX_CLIENT_OUT_PACKETS] =
-        string_duplicate ("client_outbound_packets");
-    *headers[LIDX_CLIENT_IN_BYTES] = string_duplicate ("client_inbound_bytes");
-    *headers[LIDX_CLIENT_OUT_BYTES] =
-        string_duplicate ("client_outbound_bytes");
-    *headers[LIDX_CLIENT_IN_IF] = string_duplicate ("client_inbound_interface");
-    *headers[LIDX_CLIENT_OUT_IF] =
-        string_duplicate ("client_outbound_interface");
-    *headers[LIDX_SERVER_IN_PACKETS] =
-        string_duplicate ("server_inbound_packets");
-    *headers[LIDX_SERVER_OUT_PACKETS] =
-        string_duplicate ("server_outbound_packets");
-    *headers[LIDX_SERVER_IN_BYTES] = string_duplicate ("server_inbound_bytes");
-    *headers[LIDX_SERVER_OUT_BYTES] =
-        string_duplicate ("server_outbound_bytes");
-    *headers[LIDX_SERVER_IN_IF] = string_duplicate ("server_inbound_interface");
-    *headers[LIDX_SERVER_OUT_IF] =
-        string_duplicate ("server_outbound_interface");
-    *headers[LIDX_MESSAGE] = string_duplicate ("message");
-    *headers[LIDX_USER] = string_duplicate ("user");
-    *headers[LIDX_SRCNAME] = string_duplicate ("srcname");
-    *headers[LIDX_OM] = string_duplicate ("OM:");
-    *headers[LIDX_OM_METHOD] = string_duplicate ("om_method:");
-    *headers[LIDX_ASSIGNED_IP] = string_duplicate ("assigned_IP:");
-    *headers[LIDX_VPN_USER] = string_duplicate ("vpn_user");
-    *headers[LIDX_MAC] = string_duplicate ("MAC:");
-    *headers[LIDX_ATTACK] = string_duplicate ("attack");
-    *headers[LIDX_ATTACK_INFO] = string_duplicate ("Attack Info");
-    *headers[LIDX_CLUSTER_INFO] = string_duplicate ("Cluster_Info");
-    *headers[LIDX_DCE_RPC_UUID] = string_duplicate ("DCE-RPC Interface UUID");
-    *headers[LIDX_DCE_RPC_UUID_1] =
-        string_duplicate ("DCE-RPC Interface UUID-1");
-    *headers[LIDX_DCE_RPC_UUID_2] =
-        string_duplicate ("DCE-RPC Interface UUID-2");
-    *headers[LIDX_DCE_RPC_UUID_3] =
-        string_duplicate ("DCE-RPC Interface UUID-3");
-    *headers[LIDX_DURING_SEC] = string_duplicate ("during_sec");
-    *headers[LIDX_FRAGMENTS_DROPPED] = string_duplicate ("fragments_dropped");
-    *headers[LIDX_IP_ID] = string_duplicate ("ip_id");
-    *headers[LIDX_IP_LEN] = string_duplicate ("ip_len");
-    *headers[LIDX_IP_OFFSET] = string_duplicate ("ip_offset");
-    *headers[LIDX_TCP_FLAGS2] = string_duplicate ("TCP flags");
-    *headers[LIDX_SYNC_INFO] = string_duplicate ("sync_info:");
-    *headers[LIDX_LOG] = string_duplicate ("log");
-    *headers[LIDX_CPMAD] = string_duplicate ("cpmad");
-    *headers[LIDX_AUTH_METHOD] = string_duplicate ("auth_method");
-    *headers[LIDX_TCP_PACKET_OOS] =
-        string_duplicate ("TCP packet out of state");
-    *headers[LIDX_RPC_PROG] = string_duplicate ("rpc_prog");
-    *headers[LIDX_TH_FLAGS] = string_duplicate ("th_flags");
-    *headers[LIDX_CP_MESSAGE] = string_duplicate ("cp_message:");
-    *headers[LIDX_REJECT_CATEGORY] = string_duplicate ("reject_category");
-    *headers[LIDX_IKE_LOG] = string_duplicate ("IKE Log:");
-    *headers[LIDX_NEGOTIATION_ID] = string_duplicate ("Negotiation Id:");
-    *headers[LIDX_DECRYPTION_FAILURE] =
-        string_duplicate ("decryption failure:");
-    *headers[LIDX_LEN] = string_duplicate ("len");
+    emit.resolved = TRUE;
+    for (i = 0; cef_mappings[i].attr != NULL; i++)
+    {
+        key = leef ? cef_mappings[i].leef_key : cef_mappings[i].cef_key;
+        emit.header = cef_mappings[i].header;
+        emit.is_time = (strcmp (cef_mappings[i].attr, "time") == 0);
+        emit.raw = TRUE;
+        emit.shared = FALSE;
+        for (j = 0; (key != NULL) && (cef_mappings[j].attr != NULL); j++)
+        {
+            other = leef ? cef_mappings[j].leef_key : cef_mappings[j].cef_key;
+            if ((j != i) && (other != NULL) && (strcmp (key, other) == 0))
+            {
+                emit.shared = TRUE;
+            }
+        }
+        emit.key = (key != NULL) ? string (key) + "=" : "";
+        cef.compiled[cef_mappings[i].attr] = emit;
+    }
+    cef.slots.clear();
+}
+
+/*
+ * function cef_emit_of
+ *
+ * emit entry of an attribute id, resolved once per session
+ */
+static cef_emit *
+cef_emit_of (OpsecSession * pSession, int id)
+{
+    vector<cef_emit>& slots = cef.slots[pSession];
+    map<string, cef_emit>::iterator it;
+    cef_emit unresolved;
+    cef_emit *emit;
+    char *name;
+
+    if ((unsigned int) id >= slots.size())
+    {
+        unresolved.resolved = FALSE;
+        slots.resize (id + 1, unresolved);
+    }
+    emit = &(slots[id]);
+    if (!emit->resolved)
+    {
+        emit->resolved = TRUE;
+        emit->header = -1;
+        emit->is_time = FALSE;
+        emit->raw = FALSE;
+        emit->shared = FALSE;
+        emit->key.clear();
+        if ((name = lea_attr_name (pSession, id)) == NULL)
+        {
+            return emit;
+        }
+        if ((it = cef.compiled.find (name)) != cef.compiled.end())
+        {
+            *emit = it->second;
+        }
+        else
+        {
+            emit->key = cef_key (name);
+        }
+        // FIELDS selects the extensions, the header is always filled
+        if ((output_fields.size() > 0) &&
+                (output_fields.find (name) == output_fields.end()))
+        {
+            emit->key.clear();
+        }
+    }
+    return emit;
 }
 
 /*
- * BEGIN: function to free pointers in logfile arrays
+ * function cef_escape
+ *
+ * CEF escapes backslashes and pipes in the header, and backslashes, equal
+ * signs and line breaks in extension values. LEEF has no escapes beyond the
+ * pipe in the header; tabs and line breaks in values become blanks.
  */
-void
-free_lfield_arrays (char **headers[NUMBER_LIDX_FIELDS])
+static void
+cef_escape (string& out, const char *value, int header)
 {
-    int i;
+    int leef = (cfgvalues.output_format == FORMAT_LEEF);
+
+    for (; *value; value++)
+    {
+        switch (*value)
+        {
+        case '\\':
+            out += leef ? "\\" : "\\\\";
+            break;
+        case '|':
+            out += header ? "\\|" : "|";
+            break;
+        case '=':
+            out += (header || leef) ? "=" : "\\=";
+            break;
+        case '\n':
+            out += (header || leef) ? " " : "\\n";
+            break;
+        case '\r':
+            out += (header || leef) ? " " : "\\r";
+            break;
+        case '\t':
+            out.push_back (leef ? ' ' : '\t');
+            break;
+        default:
+            out.push_back (*value);
+            break;
+        }
+    }
+}
 
-    if (cfgvalues.debug_mode >= 2)
+/*
+ * function cef_value
+ *
+ * appends the value of a field as the name=value output has it. The time
+ * is in epoch milliseconds for CEF and in LEEF_TIME_FORMAT for LEEF, raw
+ * asks for addresses and ports as numbers whatever the resolve mode.
+ */
+static void
+cef_value (string& out, OpsecSession * pSession, lea_field * field,
+           int is_time, int raw, int header)
+{
+    char text[64];
+    unsigned long ul;
+    time_t logtime;
+
+    if (is_time && (cfgvalues.output_format == FORMAT_LEEF))
     {
-        fprintf (stderr, "DEBUG: function free_lfield_arrays\n");
+        logtime = (time_t) field->lea_value.ul_value;
+        strftime (text, sizeof text, "%b %d %Y %H:%M:%S %z", localtime (&logtime));
+        out += text;
+        return;
     }
-
-    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    if (is_time)
     {
-        if (headers[i] != NULL)
+        snprintf (text, sizeof text, "%lu000", field->lea_value.ul_value);
+        out += text;
+        return;
+    }
+    if (raw || !cfgvalues.resolve_mode)
+    {
+        switch (field->lea_val_type)
         {
-            if (*headers[i] != NULL)
-            {
-                free (*headers[i]);
-                *headers[i] = NULL;
-            }
+        case LEA_VT_IP_ADDR:
+            ul = ntohl ((uint32_t) field->lea_value.ul_value);
+            snprintf (text, sizeof text, "%lu.%lu.%lu.%lu", (ul >> 24) & 0xff,
+                      (ul >> 16) & 0xff, (ul >> 8) & 0xff, ul & 0xff);
+            out += text;
+            return;
+        case LEA_VT_TCP_PORT:
+        case LEA_VT_UDP_PORT:
+            snprintf (text, sizeof text, "%d", ntohs (field->lea_value.ush_value));
+            out += text;
+            return;
         }
-        free (headers[i]);
     }
+    cef_escape (out, lea_resolve_field (pSession, *field), header);
 }
 
 /*
- * BEGIN: function to initialize fields headers of audit fields
+ * function cef_severity
+ *
+ * 0-10, from the severity of the record if it has one, else from the
+ * action
  */
-void
-initialize_afield_headers (char **headers[NUMBER_AIDX_FIELDS])
+static int
+cef_severity (OpsecSession * pSession, lea_field * severity, lea_field * action)
 {
-    int i;
+    const char *value;
 
-    if (cfgvalues.debug_mode >= 2)
+    if (severity != NULL)
     {
-        fprintf (stderr, "DEBUG: function initialize_afield_headers\n");
+        value = lea_resolve_field (pSession, *severity);
+        if (isdigit ((unsigned char) value[0]))
+        {
+            return (atoi (value) > 10) ? 10 : atoi (value);
+        }
+        if (string_icmp (value, "critical") == 0)
+        {
+            return 10;
+        }
+        if (string_icmp (value, "high") == 0)
+        {
+            return 8;
+        }
+        if (string_icmp (value, "medium") == 0)
+        {
+            return 5;
+        }
+        if (string_icmp (value, "low") == 0)
+        {
+            return 3;
+        }
+        return 1;
     }
-
-    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    if (action != NULL)
     {
-        headers[i] = (char**) malloc (sizeof (char *));
-        *headers[i] = NULL;
+        value = lea_resolve_field (pSession, *action);
+        if ((string_icmp (value, "drop") == 0) ||
+                (string_icmp (value, "reject") == 0) ||
+                (string_icmp (value, "block") == 0))
+        {
+            return 5;
+        }
     }
-
-    *headers[AIDX_NUM] = string_duplicate ("loc");
-    *headers[AIDX_TIME] = string_duplicate ("time");
-    *headers[AIDX_ACTION] = string_duplicate ("action");
-    *headers[AIDX_ORIG] = string_duplicate ("orig");
-    *headers[AIDX_IF_DIR] = string_duplicate ("i/f_dir");
-    *headers[AIDX_IF_NAME] = string_duplicate ("i/f_name");
-    *headers[AIDX_HAS_ACCOUNTING] = string_duplicate ("has_accounting");
-    *headers[AIDX_UUID] = string_duplicate ("uuid");
-    *headers[AIDX_PRODUCT] = string_duplicate ("product");
-    *headers[AIDX_OBJECTNAME] = string_duplicate ("ObjectName");
-    *headers[AIDX_OBJECTTYPE] = string_duplicate ("ObjectType");
-    *headers[AIDX_OBJECTTABLE] = string_duplicate ("ObjectTable");
-    *headers[AIDX_OPERATION] = string_duplicate ("Operation");
-    *headers[AIDX_UID] = string_duplicate ("Uid");
-    *headers[AIDX_ADMINISTRATOR] = string_duplicate ("Administrator");
-    *headers[AIDX_MACHINE] = string_duplicate ("Machine");
-    *headers[AIDX_SUBJECT] = string_duplicate ("Subject");
-    *headers[AIDX_AUDIT_STATUS] = string_duplicate ("Audit Status");
-    *headers[AIDX_ADDITIONAL_INFO] = string_duplicate ("Additional Info");
-    *headers[AIDX_OPERATION_NUMBER] = string_duplicate ("Operation Number");
-    *headers[AIDX_FIELDSCHANGES] = string_duplicate ("FieldsChanges");
+    return 3;
 }
 
 /*
- * BEGIN: function to free pointers in audit arrays
+ * function cef_format
+ *
+ * the CEF or LEEF line of a record. The extensions are written while going
+ * over the fields, the header fields are only remembered and written in
+ * front of them. The line is valid until the next call.
  */
-void
-free_afield_arrays (char **headers[NUMBER_AIDX_FIELDS])
+const char *
+cef_format (OpsecSession * pSession, lea_record * pRec, int pos,
+            unsigned long sample_rate, unsigned long *rec_time)
 {
+    lea_field *header[CEF_HDR_COUNT] = { NULL, NULL, NULL, NULL };
+    lea_field *field;
+    cef_emit *emit;
+    vector<cef_emit *> shared;
+    char text[32];
+    int timed = FALSE;
+    unsigned int k;
     int i;
 
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function free_afield_arrays\n");
+        fprintf (stderr, "DEBUG: function cef_format\n");
     }
 
-    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    cef.ext.clear();
+    if (cef.loc_key.length() > 0)
     {
-        if (headers[i] != NULL)
+        snprintf (text, sizeof text, "%d", pos);
+        cef.ext += cef.loc_key;
+        cef.ext += text;
+    }
+    for (i = 0; i < pRec->n_fields; i++)
+    {
+        field = &(pRec->fields[i]);
+        if (field->lea_attr_id < 0)
         {
-            if (*headers[i] != NULL)
+            continue;
+        }
+        emit = cef_emit_of (pSession, field->lea_attr_id);
+        if (emit->header >= 0)
+        {
+            header[emit->header] = field;
+        }
+        if (emit->is_time)
+        {
+            *rec_time = field->lea_value.ul_value;
+        }
+        if (emit->key.length() == 0)
+        {
+            continue;
+        }
+        // e.g. user and Administrator, the first one wins
+        if (emit->shared)
+        {
+            for (k = 0; (k < shared.size()) && (shared[k]->key != emit->key); k++)
+                ;
+            if (k < shared.size())
             {
-                free (*headers[i]);
-                *headers[i] = NULL;
+                continue;
             }
+            shared.push_back (emit);
         }
-        free (headers[i]);
+        if (cef.ext.length() > 0)
+        {
+            cef.ext.push_back (cef.separator);
+        }
+        cef.ext += emit->key;
+        cef_value (cef.ext, pSession, field, emit->is_time, emit->raw, FALSE);
+        timed = timed || emit->is_time;
+    }
+    if (timed && (cfgvalues.output_format == FORMAT_LEEF))
+    {
+        cef.ext.push_back (cef.separator);
+        cef.ext += "devTimeFormat=" LEEF_TIME_FORMAT;
+    }
+    if (sample_rate > 1)
+    {
+        snprintf (text, sizeof text, "%lu", sample_rate);
+        if (cef.ext.length() > 0)
+        {
+            cef.ext.push_back (cef.separator);
+        }
+        cef.ext += cef.sample_key;
+        cef.ext += text;
+    }
+
+    if (cfgvalues.output_format == FORMAT_LEEF)
+    {
+        cef.line = "LEEF:1.0|Check Point|";
+    }
+    else
+    {
+        cef.line = "CEF:0|Check Point|";
+    }
+    if (header[CEF_HDR_PRODUCT] != NULL)
+    {
+        cef_value (cef.line, pSession, header[CEF_HDR_PRODUCT], FALSE, FALSE, TRUE);
+    }
+    else
+    {
+        cef.line += "VPN-1 & FireWall-1";
     }
+    cef.line += "|" VERSION "|";
+    // signature id or event id
+    if (header[CEF_HDR_ACTION] != NULL)
+    {
+        cef_value (cef.line, pSession, header[CEF_HDR_ACTION], FALSE, FALSE, TRUE);
+    }
+    else
+    {
+        cef.line += "log";
+    }
+    cef.line.push_back ('|');
+    snprintf (text, sizeof text, "%d",
+              cef_severity (pSession, header[CEF_HDR_SEVERITY],
+                            header[CEF_HDR_ACTION]));
+    if (cfgvalues.output_format == FORMAT_LEEF)
+    {
+        cef.line += "sev=";
+        cef.line += text;
+        if (cef.ext.length() > 0)
+        {
+            cef.line.push_back (cef.separator);
+        }
+    }
+    else
+    {
+        // name, severity
+        if (header[CEF_HDR_ATTACK] != NULL)
+        {
+            cef_value (cef.line, pSession, header[CEF_HDR_ATTACK], FALSE, FALSE, TRUE);
+        }
+        else if (header[CEF_HDR_ACTION] != NULL)
+        {
+            cef_value (cef.line, pSession, header[CEF_HDR_ACTION], FALSE, FALSE, TRUE);
+        }
+        else
+        {
+            cef.line += "log";
+        }
+        cef.line.push_back ('|');
+        cef.line += text;
+        cef.line.push_back ('|');
+    }
+    cef.line += cef.ext;
+    return cef.line.c_str();
 }
 
 /*
- * BEGIN: function to initialize fields values of logfile fields
+ * function session_caches_forget
+ *
+ * drops what was cached per session once it has ended, attribute ids are
+ * only valid within their session
  */
 void
-initialize_lfield_values (char **values[NUMBER_LIDX_FIELDS])
+session_caches_forget (OpsecSession * pSession)
 {
-    int i;
+    post_filter.slots.erase (pSession);
+    sampling.slots.erase (pSession);
+    aggregate.slots.erase (pSession);
+    dedup.slots.erase (pSession);
+    columnar.slots.erase (pSession);
+    binary.sessions.erase (pSession);
+    csv.slots.erase (pSession);
+    cef.slots.erase (pSession);
+}
 
-    if (cfgvalues.debug_mode >= 2)
+/*
+ * function watermark_open
+ *
+ * when checkpointing, cut off whatever was written to an output file after
+ * the last durable watermark; those records are read again from the
+ * checkpoint
+ */
+void
+watermark_open (const char *path, FILE *stream)
+{
+    struct stat st;
+    long offset;
+
+    if (cfgvalues.app_name.length() == 0)
     {
-        fprintf (stderr, "DEBUG: function initialize_lfield_values\n");
+        return;
     }
-
-    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    watermark.path = string (path) + ".wm";
+    watermark_read (watermark.path.c_str(), &offset);
+    if ((offset >= 0) && (fstat (fileno (stream), &st) == 0) &&
+            (st.st_size > offset))
     {
-        values[i] = (char**) malloc (sizeof (char *));
-        *values[i] = NULL;
+        if (cfgvalues.debug_mode)
+        {
+            fprintf (stderr,
+                     "DEBUG: Truncating log file from %ld to watermark %ld\n",
+                     (long) st.st_size, offset);
+        }
+        if (ftruncate (fileno (stream), offset) != 0)
+        {
+            fprintf (stderr, "ERROR: Cannot truncate the log file (%s)\n",
+                     strerror (errno));
+            exit_loggrabber (1);
+        }
     }
+    watermark.flushed_offset = (offset >= 0) ? offset : 0;
 }
 
 /*
- * BEGIN: function to initialize fields values of audit fields
+ * function watermark_read
+ *
+ * reads the watermark file written next to the log file:
+ *   offset=<bytes durably written>
+ *   fileid=<fileid>|pos=<last record contained in those bytes>
+ *   ...
  */
 void
-initialize_afield_values (char **values[NUMBER_AIDX_FIELDS])
+watermark_read (const char *path, long *offset)
 {
-    int i;
+    FILE *wm;
+    char line[256];
+    int fileid;
+    int pos;
 
-    if (cfgvalues.debug_mode >= 2)
+    *offset = -1;
+    watermark.resume.clear();
+    if ((wm = fopen (path, "r")) == NULL)
     {
-        fprintf (stderr, "DEBUG: function initialize_afield_values\n");
+        return;
     }
-
-    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    while (fgets (line, sizeof line, wm))
     {
-        values[i] = (char**) malloc (sizeof (char *));
-        *values[i] = NULL;
+        if (sscanf (line, "offset=%ld", offset) == 1)
+        {
+            continue;
+        }
+        if (sscanf (line, "fileid=%d|pos=%d", &fileid, &pos) == 2)
+        {
+            watermark.resume[fileid] = pos;
+        }
     }
+    fclose (wm);
 }
 
 /*
- * BEGIN: function to initialize order values of logfile fields
+ * function watermark_write
+ *
+ * replaces the watermark file atomically (write, fsync, rename)
  */
-void
-initialize_lfield_order (int *order)
+int
+watermark_write ()
 {
-    int i;
+    map<int, int>::iterator it;
+    string tmppath = watermark.path + ".tmp";
+    FILE *wm;
 
-    if (cfgvalues.debug_mode >= 2)
+    if (watermark.flushed_pos >= 0)
     {
-        fprintf (stderr, "DEBUG: function initialize_lfield_order\n");
+        watermark.resume[watermark.fileid] = watermark.flushed_pos;
     }
-
-    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    if ((wm = fopen (tmppath.c_str(), "w")) == NULL)
     {
-        order[i] = -1;
+        fprintf (stderr, "ERROR: Cannot write watermark file %s (%s)\n",
+                 tmppath.c_str(), strerror (errno));
+        return FALSE;
+    }
+    fprintf (wm, "offset=%ld\n", watermark.flushed_offset);
+    for (it = watermark.resume.begin(); it != watermark.resume.end(); it++)
+    {
+        fprintf (wm, "fileid=%d|pos=%d\n", it->first, it->second);
+    }
+    if ((fflush (wm) != 0) || (fsync (fileno (wm)) != 0))
+    {
+        fprintf (stderr, "ERROR: Cannot write watermark file %s (%s)\n",
+                 tmppath.c_str(), strerror (errno));
+        fclose (wm);
+        return FALSE;
+    }
+    fclose (wm);
+    if (rename (tmppath.c_str(), watermark.path.c_str()) != 0)
+    {
+        fprintf (stderr, "ERROR: Cannot replace watermark file %s (%s)\n",
+                 watermark.path.c_str(), strerror (errno));
+        return FALSE;
     }
+    return TRUE;
 }
 
-/*
- * BEGIN: function to initialize order values of logfile fields
- */
 void
-initialize_afield_order (int *order)
+close_logfile ()
 {
-    int i;
 
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function initialize_afield_order\n");
+        fprintf (stderr, "DEBUG: function close_logfile\n");
     }
 
-    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
+    if (cfgvalues.debug_mode)
     {
-        order[i] = -1;
+        fprintf (stderr, "DEBUG: Close the log file.\n");
     }
+    compress_stop ();
+    if (watermark.path.length() > 0)
+    {
+        flush_logfile ();
+    }
+    fclose (logstream);
+
+    return;
 }
 
 /*
- * BEGIN: function to initialize output values of logfile fields
+ * function logfile_suffix
+ */
+const char *
+logfile_suffix ()
+{
+    switch (cfgvalues.output_compression)
+    {
+    case COMPRESS_GZIP:
+        return ".log.gz";
+    case COMPRESS_ZSTD:
+        return ".log.zst";
+    default:
+        return ".log";
+    }
+}
+
+/*
+ * function compress_start
+ *
+ * starts the compressor thread for the log file opened by open_logfile.
+ * When archiving, index entries of blocks cut off by the watermark are
+ * dropped and the index is reopened for appending.
  */
 void
-initialize_lfield_output (int *output)
+compress_start (const char *path)
 {
-    int i;
+    int level = cfgvalues.output_compression_level;
 
     if (cfgvalues.debug_mode >= 2)
     {
-        fprintf (stderr, "DEBUG: function initialize_lfield_output\n");
+        fprintf (stderr, "DEBUG: function compress_start\n");
+    }
+
+#ifndef USE_ZLIB
+    if (cfgvalues.output_compression == COMPRESS_GZIP)
+    {
+        fprintf (stderr,
+                 "ERROR: gzip output compression is not available in this build\n");
+        exit_loggrabber (1);
+    }
+#endif
+#ifndef USE_ZSTD
+    if (cfgvalues.output_compression == COMPRESS_ZSTD)
+    {
+        fprintf (stderr,
+                 "ERROR: zstd output compression is not available in this build\n");
+        exit_loggrabber (1);
+    }
+#endif
+    if ((level < 0) ||
+            ((cfgvalues.output_compression == COMPRESS_GZIP) && (level > 9)) ||
+            ((cfgvalues.output_compression == COMPRESS_ZSTD) && (level > 22)))
+    {
+        fprintf (stderr, "ERROR: Invalid OUTPUT_COMPRESSION_LEVEL %d\n", level);
+        exit_loggrabber (1);
+    }
+    if (cfgvalues.output_compression_block < 4096)
+    {
+        cfgvalues.output_compression_block = 4096;
+    }
+
+    // a backfill worker has dropped the parent's compressor, see compress_forget
+    pthread_mutex_init (&compressor.lock, NULL);
+    pthread_cond_init (&compressor.wakeup, NULL);
+    pthread_cond_init (&compressor.drained, NULL);
+    compressor.stop = FALSE;
+    compressor.busy = FALSE;
+    compressor.failed = 0;
+    compressor.pending.data.clear();
+    compressor.pending.data.reserve (cfgvalues.output_compression_block + 4096);
+    compressor.pending.records = 0;
+    compressor.queue.clear();
+    compressor.blocks = 0;
+    compressor.bytes_in = 0;
+    compressor.bytes_out = 0;
+    compressor.index = NULL;
+    compressor.stamp_loc = -1;
+    compressor.stamp_time = 0;
+    fseek (logstream, 0, SEEK_END);
+    compressor.offset = ftell (logstream);
+
+    if (cfgvalues.log_mode == ARCHIVE)
+    {
+        string index_path = string (path) + ".idx";
+        vector<string> entries;
+        char line[512];
+        long offset;
+        long length;
+        unsigned int i;
+
+        if ((compressor.index = fopen (index_path.c_str(), "r")) != NULL)
+        {
+            while (fgets (line, sizeof line, compressor.index))
+            {
+                if ((sscanf (line, "offset=%ld|length=%ld", &offset, &length) == 2)
+                        && (offset + length <= compressor.offset))
+                {
+                    entries.push_back (line);
+                }
+            }
+            fclose (compressor.index);
+        }
+        if ((compressor.index = fopen (index_path.c_str(), "w")) == NULL)
+        {
+            fprintf (stderr, "ERROR: Cannot open the archive index %s (%s)\n",
+                     index_path.c_str(), strerror (errno));
+            exit_loggrabber (1);
+        }
+        for (i = 0; i < entries.size(); i++)
+        {
+            fputs (entries[i].c_str(), compressor.index);
+        }
     }
 
-    for (i = 0; i < NUMBER_LIDX_FIELDS; i++)
+    if (pthread_create (&compressor.thread, NULL, compress_thread, NULL) != 0)
     {
-        output[i] = 0;
+        fprintf (stderr, "ERROR: Cannot start compressor thread\n");
+        exit_loggrabber (1);
     }
+    compressor.running = TRUE;
 }
 
 /*
- * BEGIN: function to initialize output values of audit fields
+ * function compress_stamp
+ *
+ * sets the loc and record time of the next record submitted, they extend
+ * the range of its block in the archive index
  */
 void
-initialize_afield_output (int *output)
+compress_stamp (int loc, unsigned long t)
 {
-    int i;
-
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function initialize_afield_output\n");
-    }
-
-    for (i = 0; i < NUMBER_AIDX_FIELDS; i++)
-    {
-        output[i] = 0;
-    }
+    compressor.stamp_loc = loc;
+    compressor.stamp_time = t;
 }
 
 /*
- * BEGIN: function to cleanup environment and exit fw1-loggrabber
+ * function compress_submit
+ *
+ * adds a record to the current block, TRUE if a block was handed to the
+ * compressor thread. A block never spans two logfiles.
  */
-void
-exit_loggrabber (int errorcode, const std::string& entity)
+int
+compress_submit (const char *message)
 {
-    if (entity.length() > 0)
+    compress_block *block = &(compressor.pending);
+    int queued = FALSE;
+
+    if ((block->records > 0) && (block->fileid != watermark.fileid))
     {
-        postEntityHealthStatus(entity, cfgvalues.status_server,
-                               cfgvalues.entity_health_endpoint,
-                               cfgvalues.status_server_auth_token,
-                               0);
+        queued = compress_queue ();
     }
-    if (cfgvalues.debug_mode >= 2)
+    if (block->records == 0)
     {
-        fprintf (stderr, "DEBUG: function exit_loggrabber\n");
+        block->fileid = watermark.fileid;
+        block->loc_min = -1;
+        block->loc_max = -1;
+        block->time_min = 0;
+        block->time_max = 0;
     }
-
-    free_lfield_arrays (lfield_headers);
-    free_afield_arrays (afield_headers);
-    free_lfield_arrays (lfields);
-    free_afield_arrays (afields);
-
-    if (LogfileName != NULL)
+    if (compressor.stamp_loc > 0)
     {
-        free (LogfileName);
+        if ((block->loc_min < 0) || (compressor.stamp_loc < block->loc_min))
+        {
+            block->loc_min = compressor.stamp_loc;
+        }
+        if (compressor.stamp_loc > block->loc_max)
+        {
+            block->loc_max = compressor.stamp_loc;
+        }
     }
-//      if (cfgvalues.fw1_logfile) {
-//              free(cfgvalues.fw1_logfile);
-//      }
-
-//  for (i = 0; i < filtercount; i++)
-//    {
-//      if (filterarray[i])
-//      {
-//        free (filterarray[i]);
-//      }
-//    }
-
-    while (sl)
+    if (compressor.stamp_time > 0)
     {
-        sl = stringlist_delete (&sl);
+        if ((block->time_min == 0) || (compressor.stamp_time < block->time_min))
+        {
+            block->time_min = compressor.stamp_time;
+        }
+        if (compressor.stamp_time > block->time_max)
+        {
+            block->time_max = compressor.stamp_time;
+        }
     }
+    compressor.stamp_loc = -1;
+    compressor.stamp_time = 0;
 
-//  if (cfgvalues.config_filename != NULL) {
-//    free (cfgvalues.config_filename);
-//  }
-
-//  if (cfgvalues.leaconfig_filename != NULL) {
-//    free (cfgvalues.leaconfig_filename);
-//  }
-    exit (errorcode);
+    block->data.append (message);
+    block->data.push_back ('\n');
+    block->records++;
+    if ((long) block->data.length() >= cfgvalues.output_compression_block)
+    {
+        queued = compress_queue ();
+    }
+    return queued;
 }
 
 /*
- * initilization function to define open, submit and close handler
+ * function compress_queue
+ *
+ * hands the current block to the compressor thread, waits while
+ * COMPRESS_QUEUE_BLOCKS blocks are queued. FALSE if the block was empty.
  */
-void
-logging_init_env (int logging)
+int
+compress_queue ()
 {
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function logging_init_env\n");
-    }
+    compress_block *block;
 
-    // Specifies which logging operation shall be executed.
-    switch (logging)
+    if (compressor.pending.records == 0)
     {
-    case SCREEN:
-        open_log = &open_screen;
-        submit_log = &submit_screen;
-        close_log = &close_screen;
-        break;
-    case LOGFILE:
-        open_log = &open_logfile;
-        submit_log = &submit_logfile;
-        close_log = &close_logfile;
-        break;
-    default:
-        open_log = &open_screen;
-        submit_log = &submit_screen;
-        close_log = &close_screen;
-        break;
+        return FALSE;
     }
-    return;
+    block = new compress_block;
+    block->data.reserve (cfgvalues.output_compression_block + 4096);
+    block->data.swap (compressor.pending.data);
+    block->fileid = compressor.pending.fileid;
+    block->loc_min = compressor.pending.loc_min;
+    block->loc_max = compressor.pending.loc_max;
+    block->time_min = compressor.pending.time_min;
+    block->time_max = compressor.pending.time_max;
+    block->records = compressor.pending.records;
+    compressor.pending.records = 0;
+
+    pthread_mutex_lock (&compressor.lock);
+    while (compressor.queue.size() >= COMPRESS_QUEUE_BLOCKS)
+    {
+        pthread_cond_wait (&compressor.drained, &compressor.lock);
+    }
+    compressor.queue.push_back (block);
+    pthread_cond_signal (&compressor.wakeup);
+    pthread_mutex_unlock (&compressor.lock);
+    return TRUE;
 }
 
 /*
- * screen initializations
+ * function compress_drain
+ *
+ * hands on the partial block and waits until everything is written, so the
+ * log file ends with a complete block. FALSE if a block could not be written.
  */
-void
-open_screen ()
+int
+compress_drain ()
 {
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function open_screen\n");
-    }
+    int ok;
 
-    if (cfgvalues.debug_mode)
+    compress_queue ();
+    pthread_mutex_lock (&compressor.lock);
+    while (!compressor.queue.empty() || compressor.busy)
     {
-        fprintf (stderr, "DEBUG: Open connection to screen.\n");
+        pthread_cond_wait (&compressor.drained, &compressor.lock);
     }
-    //We don't need to do anything here
-    return;
+    ok = (compressor.failed == 0);
+    pthread_mutex_unlock (&compressor.lock);
+    return ok;
 }
 
-void
-submit_screen (char *message)
+/*
+ * function compress_thread
+ *
+ * compresses the queued blocks in order, each one into a complete gzip
+ * member or zstd frame, and appends them to the log file and the archive
+ * index. logstream is only touched here while blocks are queued, see
+ * compress_drain.
+ */
+void *
+compress_thread (void *arg)
 {
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function submit_screen\n");
+    vector<char> out;
+    compress_block *block;
+    size_t len;
+    long offset;
+    int error;
+#ifdef USE_ZLIB
+    z_stream strm;
+    int level = (cfgvalues.output_compression_level > 0) ?
+                cfgvalues.output_compression_level : Z_DEFAULT_COMPRESSION;
+
+    memset (&strm, 0, sizeof strm);
+    if ((cfgvalues.output_compression == COMPRESS_GZIP) &&
+            (deflateInit2 (&strm, level, Z_DEFLATED, 15 + 16, 8,
+                           Z_DEFAULT_STRATEGY) != Z_OK))
+    {
+        fprintf (stderr, "ERROR: Cannot initialize gzip compression\n");
+        pthread_mutex_lock (&compressor.lock);
+        compressor.failed = EINVAL;
+        pthread_mutex_unlock (&compressor.lock);
     }
+#endif
+#ifdef USE_ZSTD
+    ZSTD_CCtx *cctx = NULL;
 
-    if (cfgvalues.debug_mode)
+    if (cfgvalues.output_compression == COMPRESS_ZSTD)
     {
-        fprintf (stderr, "DEBUG: Submit message to screen.\n");
+        cctx = ZSTD_createCCtx ();
     }
-    fprintf (stdout, "%s\n", message);
-    fflush (NULL);
-    return;
-}
+#endif
 
-void
-close_screen ()
-{
-    if (cfgvalues.debug_mode >= 2)
+    for (;;)
     {
-        fprintf (stderr, "DEBUG: function close_screen\n");
+        pthread_mutex_lock (&compressor.lock);
+        while (compressor.queue.empty() && !compressor.stop)
+        {
+            pthread_cond_wait (&compressor.wakeup, &compressor.lock);
+        }
+        if (compressor.queue.empty())
+        {
+            pthread_mutex_unlock (&compressor.lock);
+            break;
+        }
+        block = compressor.queue.front();
+        compressor.queue.pop_front();
+        compressor.busy = TRUE;
+        error = compressor.failed;
+        offset = compressor.offset;
+        pthread_mutex_unlock (&compressor.lock);
+
+        len = 0;
+#ifdef USE_ZLIB
+        if (!error && (cfgvalues.output_compression == COMPRESS_GZIP))
+        {
+            out.resize (deflateBound (&strm, block->data.length()));
+            strm.next_in = (Bytef *) block->data.data();
+            strm.avail_in = block->data.length();
+            strm.next_out = (Bytef *) & out[0];
+            strm.avail_out = out.size();
+            if (deflate (&strm, Z_FINISH) == Z_STREAM_END)
+            {
+                len = strm.total_out;
+            }
+            deflateReset (&strm);
+        }
+#endif
+#ifdef USE_ZSTD
+        if (!error && (cfgvalues.output_compression == COMPRESS_ZSTD) &&
+                (cctx != NULL))
+        {
+            out.resize (ZSTD_compressBound (block->data.length()));
+            len = ZSTD_compressCCtx (cctx, &out[0], out.size(),
+                                     block->data.data(), block->data.length(),
+                                     cfgvalues.output_compression_level);
+            if (ZSTD_isError (len))
+            {
+                len = 0;
+            }
+        }
+#endif
+        if (!error && (len == 0))
+        {
+            fprintf (stderr, "ERROR: Cannot compress a block of the log file\n");
+            error = EINVAL;
+        }
+        if (!error && (fwrite (&out[0], 1, len, logstream) != len))
+        {
+            error = errno;
+        }
+        if (!error && (compressor.index != NULL) &&
+                (fprintf (compressor.index,
+                          "offset=%ld|length=%lu|fileid=%d|loc=%d-%d|time=%lu-%lu|records=%ld\n",
+                          offset, (unsigned long) len, block->fileid,
+                          block->loc_min, block->loc_max, block->time_min,
+                          block->time_max, block->records) < 0))
+        {
+            error = errno;
+        }
+
+        pthread_mutex_lock (&compressor.lock);
+        if (error)
+        {
+            compressor.failed = error;
+        }
+        else
+        {
+            compressor.offset += len;
+            compressor.blocks++;
+            compressor.bytes_in += block->data.length();
+            compressor.bytes_out += len;
+        }
+        compressor.busy = FALSE;
+        pthread_cond_broadcast (&compressor.drained);
+        pthread_mutex_unlock (&compressor.lock);
+        delete block;
     }
 
-    if (cfgvalues.debug_mode)
+#ifdef USE_ZLIB
+    if (cfgvalues.output_compression == COMPRESS_GZIP)
     {
-        fprintf (stderr, "DEBUG: Close connection to screen.\n");
+        deflateEnd (&strm);
     }
-    //We don't need to do anything here
-    return;
+#endif
+#ifdef USE_ZSTD
+    if (cctx != NULL)
+    {
+        ZSTD_freeCCtx (cctx);
+    }
+#endif
+    return NULL;
 }
 
 /*
- * log file initializations
+ * function compress_rotate
+ *
+ * called by submit_logfile once the drained log file was copied to rotated
+ * and truncated, the archive index goes along with it
  */
 void
-open_logfile ()
+compress_rotate (const char *path, const char *rotated)
 {
+    string index_path = string (path) + ".idx";
 
-    char *output_file_name;
-
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function open_logfile\n");
-    }
-
-    if (cfgvalues.debug_mode)
+    pthread_mutex_lock (&compressor.lock);
+    compressor.offset = 0;
+    pthread_mutex_unlock (&compressor.lock);
+    if (compressor.index == NULL)
     {
-        fprintf (stderr, "DEBUG: Initilize log file and open log file.\n");
+        return;
     }
-
-    //create current output filename
-    output_file_name =
-        (char *) malloc (strlen (cfgvalues.output_file_prefix) + 5);
-    if (output_file_name == NULL)
+    fclose (compressor.index);
+    if (!fileCopy (index_path.c_str(), (string (rotated) + ".idx").c_str()))
     {
-        fprintf (stderr, "ERROR: Out of memory\n");
-        exit_loggrabber (1);
+        fprintf (stderr, "WARNING: Cannot copy the archive index %s (%s)\n",
+                 index_path.c_str(), strerror (errno));
     }
-    strcpy (output_file_name, cfgvalues.output_file_prefix);
-    strcat (output_file_name, ".log");
-
-    if ((logstream = fopen (output_file_name, "a+")) == NULL)
+    if ((compressor.index = fopen (index_path.c_str(), "w")) == NULL)
     {
-        fprintf (stderr, "ERROR: Fail to open the log file.\n");
+        fprintf (stderr, "ERROR: Cannot open the archive index %s (%s)\n",
+                 index_path.c_str(), strerror (errno));
         exit_loggrabber (1);
     }
-
-    return;
 }
 
+/*
+ * function compress_forget
+ *
+ * drops the compressor inherited by a forked backfill worker: its thread
+ * did not survive the fork, and the queued records and the archive index
+ * belong to the parent. The locks may have been held by that thread.
+ */
 void
-submit_logfile (char *message)
+compress_forget ()
 {
+    unsigned int i;
 
-    int i;
-    long fsize;
-    // char sn[100];
-    char* sn;
-    char *output_file_name;
-
-    time_t time_date;
-    struct tm *current_date;
-    int month;      // 1 through 12
-    int day;      // 1 through max_days
-    int year;     // 1500 through 2200
-    int hour;     // 0 through 23
-    int minute;     // 0 through 59
-    int second;     // 0 through 59
-
-    const char* indexed_format_str = "%s-%4.4d-%2.2d-%2.2d_%2.2d%2.2d%2.2d_%d.log";
-    const char* format_str =         "%s-%4.4d-%2.2d-%2.2d_%2.2d%2.2d%2.2d.log";
-
-    if (cfgvalues.debug_mode >= 2)
-    {
-        fprintf (stderr, "DEBUG: function submit_logfile\n");
-    }
-
-    if (cfgvalues.debug_mode)
-    {
-        fprintf (stderr, "DEBUG: Submit message to log file.\n");
-    }
-
-    fprintf (logstream, "%s\n", message);
-
-    //Check and see if it reaches the log file limitation
-    fseek (logstream, 0, SEEK_CUR);
-    fsize = ftell (logstream);
-    /* File size check and see whether or not it reaches maximum */
-    if (fsize > cfgvalues.output_file_rotatesize)
-    {
-        //The log file will be refreshed.
-        fclose (logstream);
-        time_date = time (NULL);
-        current_date = localtime (&time_date);
-        month = current_date->tm_mon + 1;
-        day = current_date->tm_mday;
-        year = current_date->tm_year + 1900;
-        hour = current_date->tm_hour;
-        minute = current_date->tm_min;
-        second = current_date->tm_sec;
-        //create current output filename
-        output_file_name =
-            (char *) malloc (strlen (cfgvalues.output_file_prefix) + 5);
-        strcpy (output_file_name, cfgvalues.output_file_prefix);
-        strcat (output_file_name, ".log");
-        //Copy log file
-        int size = 1 + snprintf(NULL, 0, format_str,
-                                cfgvalues.output_file_prefix, year, month, day, hour, minute,
-                                second);
-
-        sn = (char*) malloc(size);
-        snprintf(sn, size, format_str,
-                 cfgvalues.output_file_prefix, year, month, day, hour, minute,
-                 second);
-
-        if (fileExist (sn))
-        {
-            //Unfortunately, events come in too fast
-            i = 1;
-            int size = 1 + snprintf(NULL, 0, indexed_format_str,
-                                    cfgvalues.output_file_prefix, year, month, day, hour, minute,
-                                    second, i);
-
-            sn = (char*) malloc(size);
-            snprintf(sn, size, indexed_format_str,
-                     cfgvalues.output_file_prefix, year, month, day, hour, minute,
-                     second, i);
-
-            while (fileExist (sn))
-            {
-                i++;
-                snprintf (sn, size, indexed_format_str,
-                          cfgvalues.output_file_prefix, year, month, day, hour,
-                          minute, second, i);
-            }     //end of while
-        }     //end of inner if
-        fileCopy (output_file_name, sn);
-        //Clean log file
-        if ((logstream = fopen (output_file_name, "w")) == NULL)
-        {
-            ;
-            fprintf (stderr, "ERROR: Fail to open the log file.\n");
-            exit_loggrabber (1);
-        }     //end of inner if
-    }       //end of if
-
-
-    free(sn);
-    return;
+    pthread_mutex_init (&compressor.lock, NULL);
+    pthread_cond_init (&compressor.wakeup, NULL);
+    pthread_cond_init (&compressor.drained, NULL);
+    compressor.running = FALSE;
+    compressor.stop = FALSE;
+    compressor.busy = FALSE;
+    compressor.failed = 0;
+    compressor.pending.data.clear();
+    compressor.pending.records = 0;
+    for (i = 0; i < compressor.queue.size(); i++)
+    {
+        delete compressor.queue[i];
+    }
+    compressor.queue.clear();
+    compressor.index = NULL;
 }
 
+/*
+ * function compress_stop
+ *
+ * writes the remaining records and stops the compressor thread
+ */
 void
-close_logfile ()
+compress_stop ()
 {
+    stringstream sstream;
 
-    if (cfgvalues.debug_mode >= 2)
+    if (!compressor.running)
     {
-        fprintf (stderr, "DEBUG: function close_logfile\n");
+        return;
     }
-
-    if (cfgvalues.debug_mode)
+    if (!compress_drain ())
     {
-        fprintf (stderr, "DEBUG: Close the log file.\n");
+        fprintf (stderr, "ERROR: Cannot write the log file (%s)\n",
+                 strerror (compressor.failed));
+    }
+    pthread_mutex_lock (&compressor.lock);
+    compressor.stop = TRUE;
+    pthread_cond_signal (&compressor.wakeup);
+    pthread_mutex_unlock (&compressor.lock);
+    pthread_join (compressor.thread, NULL);
+    compressor.running = FALSE;
+    if (compressor.index != NULL)
+    {
+        fclose (compressor.index);
+        compressor.index = NULL;
     }
-    fclose (logstream);
 
-    return;
+    sstream << "compress_blocks=" << compressor.blocks
+            << "|compress_in_bytes=" << compressor.bytes_in
+            << "|compress_out_bytes=" << compressor.bytes_out
+            << "|compress_ratio_pct=" << ((compressor.bytes_in > 0) ?
+                    (100 * compressor.bytes_out / compressor.bytes_in) : 0);
+    metrics_emit (sstream.str());
 }
 
-void
+/*
+ * function fileCopy
+ *
+ * copies inputFile to outputFile and fsyncs the copy. Returns FALSE if the
+ * copy may be incomplete.
+ */
+int
 fileCopy (const char *inputFile, const char *outputFile)
 {
 
     // The most recent character from input file to output file
-    char x;
+    int x;
+    int ok;
 
     // fpi points to the input file, fpo points to the output file
     FILE *fpi, *fpo;
@@ -6484,21 +13497,34 @@ fileCopy (const char *inputFile, const char *outputFile)
     }
 
     // Open input file, read-only
-    fpi = fopen (inputFile, "r");
+    if ((fpi = fopen (inputFile, "rb")) == NULL)
+    {
+        return FALSE;
+    }
     // Open output file, write-only
-    fpo = fopen (outputFile, "w");
+    if ((fpo = fopen (outputFile, "wb")) == NULL)
+    {
+        fclose (fpi);
+        return FALSE;
+    }
 
     // Get next char from input file, store in x, until we reach EOF
-    while ((x = getc (fpi)) != -1)
+    while ((x = getc (fpi)) != EOF)
     {
         putc (x, fpo);
     }
 
+    //the copy has to be on disk before the original is truncated
+    ok = !ferror (fpi) && (fflush (fpo) == 0) && (fsync (fileno (fpo)) == 0);
+
     //After we have done, close both files
     fclose (fpi);
-    fclose (fpo);
+    if (fclose (fpo) != 0)
+    {
+        ok = FALSE;
+    }
 
-    return;
+    return ok;
 }
 
 int
@@ -38,33 +38,76 @@
 #include <time.h>
 #include <string>
 #include <map>
+#include <vector>
+#include <deque>
 
 #ifdef SOLARIS2
 #	define  BIG_ENDIAN    4321
 #	define  LITTLE_ENDIAN 1234
 #	define  BYTE_ORDER BIG_ENDIAN
 #	define  SLEEP(sec) sleep(sec)
+#	define  SLEEP_MS(msec) usleep(1000*(msec))
 #	include <netinet/in.h>
 #	include <arpa/inet.h>
+#	include <netdb.h>
+#	include <regex.h>
 #	include <syslog.h>
 #	include <unistd.h>
+#	include <sys/time.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <pthread.h>
+#	include <sys/wait.h>
+#	include <sys/socket.h>
+#	include <sys/uio.h>
+#	include <sys/un.h>
+#	include <poll.h>
+#	include <signal.h>
 #elif WIN32
 #	define  BIG_ENDIAN    4321
 #	define  LITTLE_ENDIAN 1234
 #	define  BYTE_ORDER LITTLE_ENDIAN
 #	define  BUFSIZE MAX_PATH
 #	define  SLEEP(sec) Sleep(1000*sec)
+#	define  SLEEP_MS(msec) Sleep(msec)
 #	include <windows.h>
 #	include <winsock.h>
 #else
 #	define  SLEEP(sec) sleep(sec)
+#	define  SLEEP_MS(msec) usleep(1000*(msec))
 #	include <netinet/in.h>
 #	include <arpa/inet.h>
+#	include <netdb.h>
+#	include <regex.h>
 #	include <unistd.h>
 #	include <endian.h>
 #	include <syslog.h>
+#	include <sys/time.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <pthread.h>
+#	include <sys/wait.h>
+#	include <sys/socket.h>
+#	include <sys/uio.h>
+#	include <sys/un.h>
+#	include <poll.h>
+#	include <signal.h>
 #endif
 
+#ifdef USE_ZLIB
+#	include <zlib.h>
+#endif
+#ifdef USE_ZSTD
+#	include <zstd.h>
+#endif
+#ifdef USE_OPENSSL
+#	include <openssl/ssl.h>
+#	include <openssl/err.h>
+#	include <openssl/x509v3.h>
+#endif
+
+#include "lea_binary.h"
+
 #include "opsec/lea.h"
 #include "opsec/lea_filter.h"
 #include "opsec/lea_filter_ext.h"
@@ -236,6 +279,13 @@
 #define SYSLOG                  2
 #define ODBC                    3
 #define SNMP                    4	// For future use
+#define ARCHIVE                 5	// compressed log file with block index
+#define COLUMNAR                6	// typed columns in row groups
+#define BINARY                  7	// length prefixed frames on stdout
+#define HEC                     8	// Splunk HTTP Event Collector
+#define STREAM                  9	// TCP or unix stream socket
+
+#define FLUSH_FAILED            -2	// returned by flush_log, see there
 
 #define INITIAL_CAPACITY   1024
 #define CAPACITY_INCREMENT 4096
@@ -243,14 +293,6 @@
 /*
  * Type definitions
  */
-typedef struct stringlist
-{
-    char *data;
-    int normalFID;
-    int accountFID;
-    struct stringlist *next;
-} stringlist;
-
 typedef struct configvalues
 {
     int debug_mode;
@@ -293,8 +335,667 @@ typedef struct configvalues
     int splunkRestMaxRetries;
     int splunkRestRetryFactor;
     int splunkRestStatusCommit;
+    int splunkRestStatusCommitInterval;
+    int splunkRestStatusCommitMaxBackoff;
+    std::string checkpoint_dir;
+    int checkpoint_fsync_batch;
+    int reconnect_backoff_min_ms;
+    int reconnect_backoff_max_ms;
+    int backfill_partitions;
+    int backfill_split;
+    unsigned long start_time;
+    unsigned long end_time;
+    int catchup_mode;
+    std::string ssl_session_dir;
+    int stall_timeout;
+    std::vector<std::string> post_filters;
+    std::string sample_rates;
+    int aggregate_window;
+    int aggregate_max_keys;
+    int dedup_window;
+    std::string dedup_fields;
+    int dedup_table_size;
+    int output_compression;
+    int output_compression_level;
+    long output_compression_block;
+    int output_row_group;
+    int output_format;
+    std::string hec_url;
+    std::string hec_token;
+    std::string hec_host;
+    std::string hec_source;
+    std::string hec_sourcetype;
+    std::string hec_index;
+    std::string hec_channel;
+    int hec_batch_events;
+    long hec_batch_bytes;
+    int hec_batch_ms;
+    int hec_connections;
+    int hec_ack;
+    int hec_timeout;
+    int hec_ack_timeout;
+    std::string stream_target;
+    int stream_framing;
+    long stream_batch_bytes;
+    int stream_batch_ms;
+    long stream_queue_bytes;
+    int stream_overflow;
+    int stream_timeout;
+    int stream_tls;
+    std::string stream_tls_ca;
+    std::string stream_tls_cert;
+    std::string stream_tls_key;
 } configvalues;
 
+typedef struct checkpoint_state
+{
+    int last_commit_pos;		// last position posted to the status server
+    int last_seen_pos;		// last position handed to the sink
+    int records_since_commit;
+    time_t last_commit_time;
+    int backoff;			// multiplier applied to the commit cadence
+    std::string journal_path;
+    int journal_fd;
+    int journal_unsynced;		// appends not yet fsync'ed
+    time_t journal_last_sync;
+    int resume_pos;		// records up to here were emitted before the restart
+} checkpoint_state;
+
+/*
+ * counters reported on stderr as "METRICS: name=value|..."
+ */
+typedef struct metrics_state
+{
+    long reconnects;
+    long disconnected_at;		// current_time_ms() of the last session loss, 0 if connected
+    long recover_ms_last;
+    long recover_ms_total;
+} metrics_state;
+
+/*
+ * durable watermark reported by the output sink: everything submitted up to
+ * flushed_pos has been flushed and, for files, fsync'ed at flushed_offset
+ */
+typedef struct sink_watermark
+{
+    int fileid;
+    int submitted_pos;
+    int flushed_pos;
+    long flushed_offset;
+    std::string path;		// <output file>.wm, empty if the sink has none
+    std::map<int, int> resume;	// fileid -> position recovered on open
+} sink_watermark;
+
+/*
+ * OUTPUT_COMPRESSION of the logfile sink. Records are collected into blocks
+ * of OUTPUT_COMPRESSION_BLOCK bytes; the compressor thread turns every block
+ * into a gzip member or zstd frame of its own and appends it to the log file,
+ * so the file can be decompressed up to any block boundary.
+ */
+#define COMPRESS_NONE		0
+#define COMPRESS_GZIP		1
+#define COMPRESS_ZSTD		2
+#define COMPRESS_QUEUE_BLOCKS	4
+
+/*
+ * a block of records and the range it covers, written to the block index
+ * <log file>.idx of LOGGING_CONFIGURATION=archive as
+ *   offset=<bytes>|length=<bytes>|fileid=<id>|loc=<min>-<max>|time=<min>-<max>|records=<n>
+ * with loc -1 and time 0 if no record of the block carried them
+ */
+typedef struct compress_block
+{
+    std::string data;
+    int fileid;
+    int loc_min;
+    int loc_max;
+    unsigned long time_min;
+    unsigned long time_max;
+    long records;
+} compress_block;
+
+typedef struct compress_state
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;		// a block was queued or stop was set
+    pthread_cond_t drained;		// a block was written
+    pthread_t thread;
+    int running;
+    int stop;
+    int busy;			// the thread is working on a block
+    int failed;			// errno of the first failed block, 0 if none
+    compress_block pending;	// records not yet handed to the thread
+    std::deque<compress_block *> queue;
+    long offset;			// size of the log file once the queue is written
+    FILE *index;			// block index, NULL unless archiving
+    int stamp_loc;		// loc and time of the next record, see compress_stamp
+    unsigned long stamp_time;
+    long blocks;
+    long long bytes_in;
+    long long bytes_out;
+} compress_state;
+
+/*
+ * LOGGING_CONFIGURATION=columnar writes <prefix>.col, records are collected
+ * into row groups of OUTPUT_ROW_GROUP rows. Columns are the LIDX_ or AIDX_
+ * fields followed by any other attribute met. Layout, little endian:
+ *
+ *   file     := "LEACOL1\n" group*
+ *   group    := "RG" u32 length u32 rows u16 columns column*
+ *   column   := u32 length u16 namelen name u8 type u32 nulls min max
+ *               bitmap values
+ *   min, max := i64 for the numeric types, u32 len + bytes for COL_STRING
+ *   bitmap   := (rows + 7) / 8 bytes, bit r % 8 of byte r / 8 set if row r
+ *               has a value
+ *   values   := one u32 (COL_IP), u16 (COL_PORT) or i64 (COL_INT64) per
+ *               value; for COL_STRING u32 words, u32 len + bytes per word,
+ *               then one u32 word index per value
+ *
+ * length counts the bytes after the length field, so readers can skip a
+ * group or a column whose min/max rule it out. Only columns with a value in
+ * the group are written. A column holding values of different types in one
+ * group is written as COL_STRING.
+ */
+#define COLUMNAR_MAGIC	"LEACOL1\n"
+#define COL_NONE	0
+#define COL_STRING	1	// dictionary encoded
+#define COL_IP		2	// IPv4 address as a number, a.b.c.d = a << 24 | ...
+#define COL_PORT	3
+#define COL_INT64	4	// loc, time, sample_rate
+
+typedef struct column_chunk
+{
+    int type;			// COL_NONE while the column has no value
+    std::vector<unsigned char> present;
+    std::vector<long long> numbers;
+    std::vector<unsigned int> codes;
+    std::map<std::string, unsigned int> dict;
+    std::vector<std::string> words;
+    long long min;
+    long long max;
+    unsigned int count;
+} column_chunk;
+
+typedef struct columnar_state
+{
+    FILE *stream;
+    std::string path;
+    std::vector<std::string> names;
+    std::vector<column_chunk> chunks;	// indexed like names
+    std::map<OpsecSession *, std::vector<int> > slots;	// attr id -> column
+    unsigned int rows;
+    int loc_column;
+    int time_column;
+    int sample_column;
+    int message_column;
+    long groups;
+    long long records;
+    long long bytes;
+} columnar_state;
+
+/*
+ * LOGGING_CONFIGURATION=binary, see lea_binary.h. Sessions are numbered in
+ * the order they deliver their first record.
+ */
+typedef struct binary_session
+{
+    unsigned long number;
+    std::vector<char> announced;	// attr id -> in a dictionary frame already
+} binary_session;
+
+typedef struct binary_state
+{
+    std::map<OpsecSession *, binary_session> sessions;
+    unsigned long next_session;
+    std::string frame;
+    std::string dict;
+    long long frames;
+    long long bytes;
+} binary_state;
+
+/*
+ * OUTPUT_FORMAT=csv or tsv: one column per FIELDS entry in that order and
+ * values only, after a header line at the top of every output file.
+ * lfield_order/afield_order hold the column of a known field, the column of
+ * an attribute id is resolved once per session.
+ */
+#define FORMAT_KV	0	// name=value
+#define FORMAT_CSV	1	// separated by RECORD_SEPARATOR
+#define FORMAT_TSV	2	// separated by tabs
+#define FORMAT_CEF	3	// ArcSight Common Event Format
+#define FORMAT_LEEF	4	// QRadar Log Event Extended Format
+
+typedef struct csv_state
+{
+    char delimiter;
+    std::vector<std::string> columns;
+    std::map<OpsecSession *, std::vector<int> > slots;	// attr id -> column
+    int loc_column;		// -1 if not in FIELDS
+    int time_column;
+    int sample_column;
+    int repeat_column;		// --dedup
+    int header_pending;		// the output file has no header yet
+} csv_state;
+
+/*
+ * OUTPUT_FORMAT=cef or leef. cef_mappings names the extension key of an
+ * attribute and the header field it fills; cef_init compiles it for the
+ * chosen format, and every session resolves an attribute id into its emit
+ * entry once. A record then goes to its line in one pass over its fields.
+ * Attributes without a mapping keep their name, cut down to letters, digits
+ * and underscores. Mapped keys are written once per record, and addresses
+ * and ports under them always as numbers, even with resolve mode.
+ */
+#define CEF_HDR_PRODUCT		0
+#define CEF_HDR_ACTION		1
+#define CEF_HDR_ATTACK		2
+#define CEF_HDR_SEVERITY	3
+#define CEF_HDR_COUNT		4
+
+// devTime of LEEF, the pattern of strftime "%b %d %Y %H:%M:%S %z"
+#define LEEF_TIME_FORMAT	"MMM dd yyyy HH:mm:ss Z"
+
+typedef struct cef_mapping
+{
+    const char *attr;
+    const char *cef_key;		// NULL if the attribute only goes to the header
+    const char *leef_key;
+    int header;			// CEF_HDR_, -1 for none
+} cef_mapping;
+
+typedef struct cef_emit
+{
+    int resolved;
+    int header;
+    int is_time;			// epoch milliseconds, the LEEF date format in LEEF
+    int raw;			// addresses and ports unresolved, as the key is typed
+    int shared;			// another attribute maps to the same key
+    std::string key;		// "key=", empty to leave the value out
+} cef_emit;
+
+typedef struct cef_state
+{
+    std::map<std::string, cef_emit> compiled;	// attribute name -> emit
+    std::map<OpsecSession *, std::vector<cef_emit> > slots;	// attr id -> emit
+    std::string loc_key;
+    std::string sample_key;
+    std::string repeat_key;	// appended by dedup_emit
+    char separator;		// between extensions
+    std::string line;		// reused for every record
+    std::string ext;
+} cef_state;
+
+/*
+ * LOGGING_CONFIGURATION=hec posts the records to a Splunk HTTP Event
+ * Collector. Records are collected into batches of newline separated JSON
+ * events, closed after HEC_BATCH_EVENTS events, HEC_BATCH_BYTES bytes or
+ * HEC_BATCH_MS milliseconds. HEC_CONNECTIONS sender threads post them,
+ * gzip'ed, each over a persistent connection of its own, so several batches
+ * are in flight. With HEC_ACK the senders poll the ack endpoint for the
+ * ackId of every batch and post it again if it is not acknowledged within
+ * HEC_ACK_TIMEOUT seconds. flush_hec waits until every batch is
+ * acknowledged, so checkpoints only cover acknowledged records. A batch the
+ * collector rejects as invalid data (HTTP 400) is dropped and counted,
+ * any other rejection stops the output.
+ */
+#define HEC_QUEUE_BATCHES	4	// per connection, before submit_hec waits
+#define HEC_ACK_INTERVAL_MS	1000
+
+typedef struct hec_batch
+{
+    std::string body;
+    int gzipped;
+    long raw_bytes;
+    long events;
+    long opened;			// current_time_ms () of the first event
+    unsigned long ack_id;
+    long posted;			// current_time_ms () of the post awaiting its ack
+} hec_batch;
+
+typedef struct hec_state
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;		// a batch was queued or stop was set
+    pthread_cond_t done;		// a batch was acknowledged or rejected
+    std::vector<pthread_t> threads;
+    int running;
+    int stop;
+    int failed;			// HTTP status of a rejected batch, 0 if none
+    std::string host;		// of HEC_URL
+    std::string port;
+    std::string path;
+    std::string meta;		// "host":...,"sourcetype":... of every event
+    hec_batch *pending;		// collecting events, NULL if none
+    std::deque<hec_batch *> queue;	// waiting for a sender
+    std::map<unsigned long, hec_batch *> unacked;	// ackId -> batch
+    int outstanding;		// batches queued, being posted or unacked
+    int polling;			// a sender is polling the acks
+    long last_poll;
+    long long events;
+    long long posts;
+    long long retries;
+    long long rejected;		// batches dropped as invalid data
+    long long rejected_events;
+    long long bytes_in;
+    long long bytes_out;
+} hec_state;
+
+/*
+ * LOGGING_CONFIGURATION=stream writes the records to a collector listening
+ * on STREAM_TARGET, tcp://<host>:<port> or unix:<path>. Every record is
+ * framed by a trailing newline or, with STREAM_FRAMING=length, preceded by
+ * its length as 4 bytes in network order. Records are collected into chunks
+ * of STREAM_BATCH_BYTES or STREAM_BATCH_MS milliseconds, which the writer
+ * thread hands to the socket with writev. The connection is opened non
+ * blocking and opened again with reconnect_delay_ms once it breaks or makes
+ * no progress for STREAM_TIMEOUT seconds; the record cut off then is
+ * written again whole. Once STREAM_QUEUE_BYTES are waiting, submit_stream waits for
+ * the writer or, with STREAM_OVERFLOW=drop, drops the record. A dropped
+ * record holds the checkpoint before its position for the rest of the run,
+ * so a restart reads it again.
+ * With STREAM_TLS=yes (builds with USE_OPENSSL) the connection is wrapped
+ * in TLS. The collector's certificate is verified against STREAM_TLS_CA or
+ * the default CA paths and must name the host of STREAM_TARGET;
+ * STREAM_TLS_CERT and STREAM_TLS_KEY present a client certificate.
+ */
+#define STREAM_NEWLINE		0
+#define STREAM_LENGTH		1
+
+#define STREAM_BLOCK		0
+#define STREAM_DROP		1
+
+#define STREAM_IOV		64	// chunks per writev
+
+typedef struct stream_conn
+{
+    int fd;			// -1 if not connected
+#ifdef USE_OPENSSL
+    SSL *tls;			// NULL without STREAM_TLS
+#endif
+    short want;			// poll events a TLS write is waiting for, 0 if none
+} stream_conn;
+
+typedef struct stream_state
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;		// a chunk was queued or stop was set
+    pthread_cond_t done;		// a chunk was written
+    pthread_t thread;
+    int running;
+    int stop;
+    std::string host;		// of tcp://, empty for unix:
+    std::string port;
+    std::string path;		// of unix:
+    std::string pending;		// framed records not queued yet
+    long opened;			// current_time_ms () of the first of them
+    std::deque<std::string *> queue;	// chunks waiting for the writer
+    size_t sent;			// bytes of the first chunk written
+    long queued_bytes;		// in pending and queue
+    int overflowing;		// records are being dropped
+    int drop_pos;			// of the first dropped record, -1 if none
+#ifdef USE_OPENSSL
+    SSL_CTX *tls_ctx;
+#endif
+    long long records;
+    long long dropped;
+    long long bytes;
+    long long writes;
+    long long reconnects;
+} stream_state;
+
+/*
+ * position waiting to be posted to the status server by the sync thread
+ */
+typedef struct checkpoint_pending
+{
+    int fileid;
+    std::string filename;
+    int pos;
+} checkpoint_pending;
+
+typedef struct checkpoint_sync_state
+{
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    pthread_t thread;
+    int running;
+    int stop;
+    std::string entity;
+    std::map<int, checkpoint_pending> pending;
+    int established;		// as it was when the positions were queued
+    std::vector<int> fetch;	// fileids to ask the status server for
+    std::map<int, int> remote;	// fileid -> position of the status server
+} checkpoint_sync_state;
+
+/*
+ * the environment and entity pair shared by all sessions of a process, see
+ * fw1_env_open. Each session is bound to the role its events are handled as.
+ */
+#define SESSION_ROLE_LIST	1
+#define SESSION_ROLE_PROBE	2
+#define SESSION_ROLE_READ	3
+
+/*
+ * state of a session between its creation and OPSEC_SESSION_ESTABLISHED.
+ * The SSL session cache is snapshotted, a handshake that left its contents
+ * unchanged resumed a cached session.
+ */
+typedef struct handshake_pending
+{
+    long started;			// ms, see current_time_ms
+    int cached;			// the cache file exists
+    std::string cache;		// its contents
+} handshake_pending;
+
+typedef struct fw1_environment
+{
+    OpsecEnv *env;
+    OpsecEntity *client;
+    OpsecEntity *server;
+    std::vector<std::string> args;	// lea config fetched from splunkd
+    std::map<OpsecSession *, int> roles;
+    int filters_compiled;
+    int setups;
+    int sessions;
+    std::string session_cache;	// <SSL_SESSION_DIR>/<entity>/sslsess.C
+    std::map<OpsecSession *, handshake_pending> handshaking;
+    long handshakes;
+    long resumed;
+    long handshake_ms;		// summed over all handshakes
+} fw1_environment;
+
+/*
+ * the logfiles offered by the server, see get_fw1_logfiles. Record time
+ * ranges are learned on demand and kept in <CHECKPOINT_DIR>/<entity>.catalog
+ */
+typedef struct catalog_entry
+{
+    std::string name;
+    int normalFID;
+    int accountFID;
+    int known;			// first_time and last_time have been learned
+    unsigned long first_time;	// 0 if the logfile has no records
+    unsigned long last_time;
+} catalog_entry;
+
+typedef struct logfile_catalog
+{
+    std::vector<catalog_entry> entries;	// in the order of the server
+    std::map<std::string, int> by_name;
+    std::map<int, int> by_fileid;
+    int loaded;
+    int dirty;
+} logfile_catalog;
+
+/*
+ * hand-off between a live session and the offline session draining the
+ * backlog behind it, see catchup_open
+ */
+typedef struct catchup_state
+{
+    OpsecSession *live;
+    OpsecSession *session;	// the catch-up session, NULL if there is none
+    int active;			// the backlog has not been handed off yet
+    int failed;			// the catch-up session ended before the hand-off
+    int handoff_pos;		// first position left to the live session, -1 if unknown
+    int last_pos;		// last position emitted by the catch-up session
+    long started;
+    long records;
+} catchup_state;
+
+/*
+ * position range served by a backfill worker, see backfill_fw1_logfile
+ */
+typedef struct backfill_range
+{
+    int index;			// -1 when not running as a backfill worker
+    int count;
+    int start_pos;		// also set for a --start-time/--end-time window
+    int end_pos;		// last position of the range, -1 if unbounded
+    long records;
+} backfill_range;
+
+/*
+ * probe sessions reading a single record, used to locate positions
+ */
+typedef struct probe_env
+{
+    OpsecEnv *env;
+    OpsecEntity *client;
+    OpsecEntity *server;
+    int probes;
+} probe_env;
+
+typedef struct probe_result
+{
+    int found;
+    int pos;
+    unsigned long time;
+} probe_result;
+
+/*
+ * watchdog of the live session in online mode, see stall_timer. A silence
+ * longer than STALL_TIMEOUT, or than STALL_GAP_FACTOR times the learned gap
+ * between records but at least STALL_MIN_MS, is checked with a probe behind
+ * the last record; a record found there means the session is stalled.
+ */
+#define STALL_MIN_MS		30000
+#define STALL_GAP_FACTOR	50
+#define STALL_MIN_SAMPLES	100
+
+typedef struct stall_watch
+{
+    OpsecSession *session;	// the watched live session, NULL if none
+    OpsecEntity *client;
+    OpsecEntity *server;
+    LeaFilterRulebase *rb;
+    char *logfile;
+    int fileid;
+    int last_pos;		// LEA position of the last record
+    long last_record;		// ms of the last record or of the session start
+    long gap_avg;		// learned gap between records, ms
+    long samples;
+    OpsecSession *probe;	// pending probe, NULL if none
+    probe_result result;
+    long probe_started;
+    int tripped;		// the session was ended as stalled
+    long stalls;
+    long quiet;			// probes that found nothing newer
+} stall_watch;
+
+/*
+ * compiled filter definitions, see compile_filter_rule
+ */
+typedef struct filter_value
+{
+    int type;			// LEA_VT_*
+    unsigned long num;
+    std::string str;
+} filter_value;
+
+typedef struct filter_pred
+{
+    std::string attr;
+    int negation;
+    int op;			// LEA_FILTER_PRED_*
+    std::vector<filter_value> values;	// from/to pairs for BELONGS_TO_RANGE
+} filter_pred;
+
+typedef struct filter_rule
+{
+    int action;			// LEA_FILTER_ACTION_*
+    std::vector<filter_pred> preds;
+} filter_rule;
+
+typedef std::vector<filter_rule> filter_program;
+
+/*
+ * local filter for what the LEA filter API cannot express, applied to the
+ * raw record before it is formatted. A record passes if any rule matches,
+ * a rule if all of its terms do. See post_filter_compile.
+ */
+#define POST_OP_MATCH		1	// =~ regular expression
+#define POST_OP_NOMATCH		2	// !~
+#define POST_OP_CONTAINS	3	// *= substring
+#define POST_OP_EQ		4	// ==
+#define POST_OP_NE		5	// !=
+#define POST_OP_LT		6	// <
+#define POST_OP_LE		7	// <=
+#define POST_OP_GT		8	// >
+#define POST_OP_GE		9	// >=
+
+typedef struct post_term
+{
+    int slot;			// index into post_filter_state.attrs
+    int op;			// POST_OP_*
+    int numeric;		// compare lea_value numerically against num
+    long num;
+    std::string str;
+    regex_t *regex;		// compiled pattern of =~ and !~
+} post_term;
+
+typedef struct post_rule
+{
+    std::string text;
+    unsigned int first;		// terms[first] .. terms[first + count - 1]
+    unsigned int count;
+    long hits;
+} post_rule;
+
+typedef struct post_filter_state
+{
+    std::vector<post_term> terms;
+    std::vector<post_rule> rules;
+    std::vector<std::string> attrs;	// attribute names used by the terms
+    std::map<OpsecSession *, std::vector<int> > slots;	// attr id -> slot
+    std::vector<lea_field *> values;	// field of each slot in the current record
+    long records;
+    long dropped;
+} post_filter_state;
+
+/*
+ * sampling by action or product, see sample_compile. A record is kept if
+ * the hash of its connection falls into the 1/N given for its action.
+ */
+#define SAMPLE_ACTION	0
+#define SAMPLE_PRODUCT	1
+#define SAMPLE_SRC	2
+#define SAMPLE_DST	3
+#define SAMPLE_PROTO	4
+#define SAMPLE_SPORT	5
+#define SAMPLE_SERVICE	6
+
+typedef struct sample_state
+{
+    std::map<std::string, unsigned long> rates;	// action or product -> N, 0 drops all
+    unsigned long default_rate;	// rate of "*", 1 if not given
+    std::vector<std::string> attrs;	// fields indexed by SAMPLE_*
+    std::map<OpsecSession *, std::vector<int> > slots;	// attr id -> SAMPLE_*
+    std::vector<lea_field *> values;
+    long kept;
+    long skipped;
+} sample_state;
+
 typedef struct _SESSION_CONTEXT
 {
     std::string config_server;
@@ -305,8 +1006,92 @@ typedef struct _SESSION_CONTEXT
     std::string log_status_endpoint;
     std::string status_server_auth_token;
     std::string config_entity;
+    OpsecEnv *env;
+    OpsecSession *session;
+    int fileid;
+    checkpoint_state checkpoint;
 } SESSION_CONTEXT, *PSESSION_CONTEXT;
 
+/*
+ * rollup of records per (src, dst, service, action, rule) and tumbling
+ * window of record time, see aggregate_record. The table uses open
+ * addressing with linear probing and is flushed when the window ends or
+ * when it holds AGGREGATE_MAX_KEYS connections.
+ */
+#define AGG_TIME	0
+#define AGG_SRC		1
+#define AGG_DST		2
+#define AGG_SERVICE	3
+#define AGG_ACTION	4
+#define AGG_RULE	5
+#define AGG_BYTES	6
+#define AGG_PACKETS	7
+#define AGG_ELAPSED	8
+
+typedef struct aggregate_entry
+{
+    int used;
+    unsigned long src;
+    unsigned long dst;
+    unsigned long service;
+    unsigned long action;
+    unsigned long rule;
+    long count;
+    unsigned long bytes;
+    unsigned long packets;
+    unsigned long elapsed;
+} aggregate_entry;
+
+typedef struct aggregate_state
+{
+    std::vector<aggregate_entry> table;
+    unsigned long used;
+    unsigned long window_start;	// record time, 0 while the window is empty
+    std::vector<std::string> attrs;	// fields indexed by AGG_*
+    std::map<OpsecSession *, std::vector<int> > slots;	// attr id -> AGG_*
+    std::vector<lea_field *> values;
+    PSESSION_CONTEXT context;	// checkpointed when the table is flushed
+    int last_pos;		// last position folded into the table
+    long records;
+    long summaries;
+    long evictions;		// flushes forced by the memory cap
+} aggregate_state;
+
+/*
+ * suppression of repeated records, see dedup_record. The first record of
+ * a key is held until its window closes and is then emitted with the
+ * number of records it stands for. A key is looked up in DEDUP_PROBES
+ * slots of the fixed size table, the oldest of them is evicted if none is
+ * free.
+ */
+#define DEDUP_PROBES	8
+
+typedef struct dedup_entry
+{
+    int used;
+    std::string key;		// raw values of the DEDUP_FIELDS
+    unsigned long first_time;	// record time of the held record
+    int pos;			// position of the held record
+    long repeats;
+    std::string message;	// the held record, formatted
+    unsigned long generation;
+} dedup_entry;
+
+typedef struct dedup_state
+{
+    std::vector<dedup_entry> table;
+    std::deque<std::pair<unsigned long, unsigned long> > order;	// slot, generation by arrival
+    std::vector<std::string> attrs;	// DEDUP_FIELDS, then time
+    std::map<OpsecSession *, std::vector<int> > slots;	// attr id -> index in attrs
+    std::vector<lea_field *> values;
+    unsigned long generation;
+    int last_pos;		// last position seen
+    long records;
+    long suppressed;
+    long emitted;
+    long evictions;
+} dedup_state;
+
 /*
  * Function prototypes
  */
@@ -393,10 +1178,127 @@ int get_fw1_logfiles_dict (OpsecSession *, int, LEA_VT, int);
 int get_fw1_logfiles_end (OpsecSession *);
 
 /*
- * function to create a new rule for a filter rulebase
+ * functions to compile the filter definitions and to create the filter
+ * rulebase of a session from them
+ */
+int filter_parse_time (const std::string&, const std::string&, unsigned long *);
+int compile_filter_rule (const char *, int, filter_rule *);
+int post_filter_compile ();
+int post_filter_match (OpsecSession *, lea_record *);
+void post_filter_report ();
+int sample_compile ();
+unsigned long sample_record (OpsecSession *, lea_record *, int);
+void sample_report ();
+void aggregate_init ();
+void aggregate_record (OpsecSession *, lea_record *, PSESSION_CONTEXT, int,
+                       unsigned long);
+void aggregate_flush (int);
+void aggregate_timer (void *);
+void aggregate_report ();
+void dedup_init ();
+int dedup_record (OpsecSession *, lea_record *, int);
+void dedup_hold (int, const char *);
+int dedup_handoff_pos (int);
+void dedup_flush ();
+void dedup_timer (void *);
+void dedup_report ();
+int compile_filters ();
+LeaFilterRulebase *filter_rulebase_create ();
+
+/*
+ * checkpoint scheduler, commits the last flushed position after N records,
+ * T seconds or at end of file, whichever comes first
+ */
+void checkpoint_init (PSESSION_CONTEXT, int);
+void checkpoint_record (PSESSION_CONTEXT, int);
+int checkpoint_commit (PSESSION_CONTEXT);
+void checkpoint_timer (void *);
+void checkpoint_close (PSESSION_CONTEXT);
+long current_time_ms ();
+void metrics_emit (const std::string&);
+long reconnect_delay_ms (int);
+
+/*
+ * local append-only checkpoint journal per (entity, fileid)
  */
-LeaFilterRulebase *create_fw1_filter_rule (LeaFilterRulebase *, char[255]);
-LeaFilterRulebase *create_audit_filter_rule (LeaFilterRulebase *, char[255]);
+std::string checkpoint_file_prefix (const std::string&);
+std::string checkpoint_journal_path (const std::string&, int);
+int checkpoint_journal_read (const std::string&, int);
+int checkpoint_journal_scan (const std::string&);
+int checkpoint_resume_pos (const std::string&, int);
+int checkpoint_journal_append (checkpoint_state *, int);
+void checkpoint_journal_sync (checkpoint_state *, int);
+int sync_directory_of (const std::string&);
+
+/*
+ * background thread posting journaled positions to the status server
+ */
+void checkpoint_sync_start (const std::string&);
+void checkpoint_sync_post (const std::string&, int, const char *, int);
+void checkpoint_sync_fetch (const std::string&, int);
+int checkpoint_sync_remote (int);
+void *checkpoint_sync_thread (void *);
+void checkpoint_sync_stop ();
+
+/*
+ * parallel backfill of one logfile over several position ranges
+ */
+int backfill_fw1_logfile (char **, const std::string&, int);
+void backfill_run_range (char **, const std::string&, int, int, int, int, int);
+int backfill_merge_range (int);
+std::string backfill_range_prefix (int);
+int probe_open (const std::string&, probe_env *);
+OpsecSession *probe_start (OpsecEntity *, OpsecEntity *, char *, int, int,
+                           LeaFilterRulebase *, probe_result *);
+int probe_record (probe_env *, char *, int, int, probe_result *);
+int probe_last_pos (probe_env *, char *, int);
+int probe_time_pos (probe_env *, char *, int, int, unsigned long);
+int probe_window (probe_env *, char *, int, int *, int *);
+int locate_time_window (char **, const std::string&, int);
+void probe_close (probe_env *);
+int probe_record_handler (OpsecSession *, lea_record *, int[]);
+int probe_eof_handler (OpsecSession *);
+
+/*
+ * functions to select logfiles from the catalog
+ */
+void catalog_add (const char *, int, int);
+int catalog_select (const std::string&, const char *, std::vector<int>&);
+int catalog_learn (probe_env *, catalog_entry *);
+void catalog_load (const std::string&);
+int catalog_save (const std::string&);
+
+/*
+ * functions to drain the backlog next to a live session (--catchup)
+ */
+OpsecSession *catchup_open (OpsecEntity *, OpsecEntity *, char *, int, int,
+                            LeaFilterRulebase *);
+int catchup_admit (OpsecSession *, int);
+void catchup_complete ();
+int catchup_end (OpsecSession *);
+
+/*
+ * watchdog ending online sessions that stopped delivering records
+ */
+void stall_watch_start (OpsecSession *, OpsecEntity *, OpsecEntity *, char *,
+                        int, LeaFilterRulebase *);
+void stall_watch_record (OpsecSession *, int);
+void stall_timer (void *);
+
+/*
+ * functions to manage the shared opsec environment and to dispatch the
+ * events of its sessions
+ */
+int fw1_env_open (const std::string&);
+void fw1_env_close ();
+void fw1_env_forget ();
+void fw1_env_bind (OpsecSession *, int, void *);
+std::string ssl_session_path (const std::string&);
+int fw1_env_record (OpsecSession *, lea_record *, int[]);
+int fw1_env_dict (OpsecSession *, int, LEA_VT, int);
+int fw1_env_eof (OpsecSession *);
+int fw1_env_established (OpsecSession *);
+int fw1_env_end (OpsecSession *);
 
 /*
  * function to clean up the opsec environment
@@ -429,6 +1331,7 @@ void close_syslog ();
  */
 void open_screen ();
 void submit_screen (char *);
+int flush_screen ();
 void close_screen ();
 
 /*
@@ -436,7 +1339,80 @@ void close_screen ();
  */
 void open_logfile ();
 void submit_logfile (char *);
+int flush_logfile ();
+void watermark_open (const char *, FILE *);
+void watermark_read (const char *, long *);
+int watermark_write ();
 void close_logfile ();
+const char *logfile_suffix ();
+std::string rotated_file_name (const char *);
+
+/*
+ * columnar output
+ */
+void open_columnar ();
+void submit_columnar (char *);
+int flush_columnar ();
+void close_columnar ();
+void columnar_record (OpsecSession *, lea_record *, int, unsigned long);
+void columnar_write_group ();
+
+/*
+ * HTTP Event Collector output
+ */
+void open_hec ();
+void submit_hec (char *);
+int flush_hec ();
+void close_hec ();
+void *hec_thread (void *);
+void hec_json (std::string&, const char *);
+
+/*
+ * stream socket output
+ */
+void open_stream ();
+void submit_stream (char *);
+int flush_stream ();
+void close_stream ();
+void *stream_thread (void *);
+#ifdef USE_OPENSSL
+void stream_tls_init ();
+#endif
+
+/*
+ * binary output
+ */
+void open_binary ();
+void submit_binary (char *);
+int flush_binary ();
+void close_binary ();
+void binary_record (OpsecSession *, lea_record *, int, unsigned long);
+void session_caches_forget (OpsecSession *);
+
+/*
+ * csv and tsv output format
+ */
+void csv_init ();
+void csv_add_column (const char *);
+std::string csv_format (OpsecSession *, lea_record *, int, unsigned long,
+                        unsigned long *);
+void csv_header ();
+
+/*
+ * cef and leef output format
+ */
+void cef_init ();
+const char *cef_format (OpsecSession *, lea_record *, int, unsigned long,
+                        unsigned long *);
+void compress_start (const char *);
+void compress_stamp (int, unsigned long);
+int compress_submit (const char *);
+int compress_queue ();
+int compress_drain ();
+void compress_rotate (const char *, const char *);
+void *compress_thread (void *);
+void compress_stop ();
+void compress_forget ();
 
 /*
  * array initializations
@@ -467,10 +1443,6 @@ exit_loggrabber (int errorcode, const std::string& entity = "");
 /*
  * helper functions for working with lists
  */
-int stringlist_append (stringlist **, char *, int, int);
-void stringlist_print (stringlist **);
-stringlist *stringlist_search (stringlist **, char *, char **);
-stringlist *stringlist_delete (stringlist **);
 
 /*
  * helper function to work with strings
@@ -493,7 +1465,7 @@ char getschar ();
  * file operation functions
  */
 // copy a file into another file
-void fileCopy (const char *inputfile, const char *outputfile);
+int fileCopy (const char *inputfile, const char *outputfile);
 
 // check and see whether or not a file exists
 int fileExist (const char *fileName);
@@ -507,6 +1479,10 @@ void (*open_log) ();
 //pointer to function submit
 void (*submit_log) (char *message);
 
+//pointer to function flush log pipe, returns the durable position, -1 if
+//there is none yet, or FLUSH_FAILED
+int (*flush_log) ();
+
 //pointer to function close log pipe
 void (*close_log) ();
 
@@ -520,9 +1496,17 @@ int resolve_mode = -1;
 char *LogfileName = NULL;
 int fw1_2000 = -1;
 int audit_log = -1;
-stringlist *sl = NULL;
+int backfill_partitions = -1;
+int backfill_split = -1;
+char *start_time_arg = NULL;
+char *end_time_arg = NULL;
+int catchup_mode = -1;
 char **filterarray = NULL;
 int filtercount = 0;
+std::vector<std::string> post_filter_args;
+char *sample_arg = NULL;
+int aggregate_window = -1;
+int dedup_window = -1;
 std::map<std::string, bool>  output_fields;
 int mysql_mode = -1;
 int fieldnames_mode = -1;
@@ -586,6 +1570,56 @@ configvalues cfgvalues =
     3,                // splunkRestMaxRetries
     2,                // splunkRestRetryFactor
     10000,            // splunkRestStatusCommit
+    30,               // splunkRestStatusCommitInterval
+    16,               // splunkRestStatusCommitMaxBackoff
+    "",               // checkpoint_dir
+    16,               // checkpoint_fsync_batch
+    500,              // reconnect_backoff_min_ms
+    60000,            // reconnect_backoff_max_ms
+    0,                // backfill_partitions
+    FALSE,            // backfill_split
+    0,                // start_time
+    0,                // end_time
+    FALSE,            // catchup_mode
+    "",               // ssl_session_dir
+    0,                // stall_timeout
+    std::vector<std::string>(),	// post_filters
+    "",               // sample_rates
+    0,                // aggregate_window
+    100000,           // aggregate_max_keys
+    0,                // dedup_window
+    "rule;src;dst;service;action;attack",	// dedup_fields
+    65536,            // dedup_table_size
+    COMPRESS_NONE,    // output_compression
+    0,                // output_compression_level
+    1048576,          // output_compression_block
+    65536,            // output_row_group
+    FORMAT_KV,        // output_format
+    "",               // hec_url
+    "",               // hec_token
+    "",               // hec_host
+    "",               // hec_source
+    "opsec",          // hec_sourcetype
+    "",               // hec_index
+    "",               // hec_channel
+    1000,             // hec_batch_events
+    1048576,          // hec_batch_bytes
+    1000,             // hec_batch_ms
+    4,                // hec_connections
+    FALSE,            // hec_ack
+    30,               // hec_timeout
+    300,              // hec_ack_timeout
+    "",               // stream_target
+    STREAM_NEWLINE,   // stream_framing
+    262144,           // stream_batch_bytes
+    100,              // stream_batch_ms
+    16777216,         // stream_queue_bytes
+    STREAM_BLOCK,     // stream_overflow
+    30,               // stream_timeout
+    FALSE,            // stream_tls
+    "",               // stream_tls_ca
+    "",               // stream_tls_cert
+    "",               // stream_tls_key
 };
 
 
@@ -600,14 +1634,147 @@ FILE *logstream;
 int keepAlive = TRUE;
 
 /**
- * The recover interval with unit of second
+ * The flag, which indicates whether or not the session has been established
  **/
-int recoverInterval = 10;
+int established = FALSE;
 
 /**
- * The flag, which indicates whether or not the session has been established
+ * Whether the current connection attempt got its session established
  **/
-int established = FALSE;
+int attempt_established = FALSE;
+
+/**
+ * The state of the thread posting checkpoints to the status server
+ **/
+checkpoint_sync_state checkpoint_sync;
+
+/**
+ * The flush watermark of the output sink
+ **/
+sink_watermark watermark;
+
+/**
+ * The compressor of the logfile sink
+ **/
+compress_state compressor;
+
+/**
+ * The row group of LOGGING_CONFIGURATION=columnar
+ **/
+columnar_state columnar;
+
+/**
+ * The sessions of LOGGING_CONFIGURATION=binary
+ **/
+binary_state binary;
+
+/**
+ * The batches and senders of LOGGING_CONFIGURATION=hec
+ **/
+hec_state hec;
+
+/**
+ * The chunks and writer of LOGGING_CONFIGURATION=stream
+ **/
+stream_state stream;
+
+/**
+ * The column layout of OUTPUT_FORMAT=csv and tsv
+ **/
+csv_state csv;
+
+/**
+ * The extension keys of OUTPUT_FORMAT=cef and leef
+ **/
+cef_mapping cef_mappings[] =
+{
+    { "time", "rt", "devTime", -1 },
+    { "product", NULL, NULL, CEF_HDR_PRODUCT },
+    { "action", "act", "action", CEF_HDR_ACTION },
+    { "attack", "cs2Label=Attack cs2", "attack", CEF_HDR_ATTACK },
+    { "severity", NULL, NULL, CEF_HDR_SEVERITY },
+    { "orig", "dvchost", "devName", -1 },
+    { "src", "src", "src", -1 },
+    { "dst", "dst", "dst", -1 },
+    { "s_port", "spt", "srcPort", -1 },
+    { "service", "dpt", "dstPort", -1 },
+    { "proto", "proto", "proto", -1 },
+    { "rule", "cs1Label=Rule cs1", "rule", -1 },
+    { "rule_name", "cs3Label=Rule Name cs3", "ruleName", -1 },
+    { "xlatesrc", "sourceTranslatedAddress", "srcPostNAT", -1 },
+    { "xlatedst", "destinationTranslatedAddress", "dstPostNAT", -1 },
+    { "xlatesport", "sourceTranslatedPort", "srcPostNATPort", -1 },
+    { "xlatedport", "destinationTranslatedPort", "dstPostNATPort", -1 },
+    { "user", "suser", "usrName", -1 },
+    { "Administrator", "suser", "usrName", -1 },
+    { "reason", "reason", "reason", -1 },
+    { "message_info", "msg", "msg", -1 },
+    { "Subject", "msg", "msg", -1 },
+    { "reject_category", "cat", "cat", -1 },
+    { NULL, NULL, NULL, -1 }
+};
+
+/**
+ * The compiled emit table of OUTPUT_FORMAT=cef and leef
+ **/
+cef_state cef;
+
+/**
+ * The counters behind the METRICS lines
+ **/
+metrics_state metrics;
+
+/**
+ * The compiled filter rules
+ **/
+filter_program filter_rules;
+
+/**
+ * The compiled local filter and its counters
+ **/
+post_filter_state post_filter;
+
+/**
+ * The sampling rates and counters
+ **/
+sample_state sampling;
+
+/**
+ * The connection rollup of --aggregate
+ **/
+aggregate_state aggregate;
+
+/**
+ * The records held by --dedup
+ **/
+dedup_state dedup;
+
+/**
+ * The opsec environment shared by all sessions
+ **/
+fw1_environment fw1_env;
+
+/**
+ * The logfiles offered by the server
+ **/
+logfile_catalog catalog;
+
+/**
+ * The hand-off state of the current --catchup session pair
+ **/
+catchup_state catchup = { NULL, NULL, FALSE, FALSE, -1, -1, 0, 0 };
+
+/**
+ * The watchdog of the live session, the learned gap between records is kept
+ * across reconnects
+ **/
+stall_watch stall;
+
+/**
+ * The position range this process reads when it is a backfill worker or
+ * reads a time window
+ **/
+backfill_range backfill = { -1, 0, -1, -1, 0 };
 
 int initialCapacity = 1024;
 int capacityIncrement = 4096;